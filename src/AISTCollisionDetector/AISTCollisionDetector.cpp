@@ -7,6 +7,7 @@
 #include <algorithm>
 #include <random>
 #include <set>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
@@ -15,6 +16,13 @@ namespace {
 
 const bool ENABLE_SHUFFLE = false;
 
+/**
+   The maximum number of the distance calculations for a geometry pair in the continuous collision
+   detection. The advancement may not converge within this number when the geometries keep moving
+   close to each other, and then only the positions at the end of the motion are checked.
+*/
+const int MaxContinuousDetectionIterations = 100;
+
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
 CollisionDetector* factory()
@@ -35,14 +43,64 @@ typedef ref_ptr<ColdetModelEx> ColdetModelExPtr;
 class ColdetModelEx : public ColdetModel
 {
 public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+        
     ReferencedPtr object;
     int groupId;
     bool isEnabled;
     bool isStatic;
     stdx::optional<Isometry3> localPosition;
     ColdetModelExPtr sibling;
+
+    // The following variables are used for the continuous collision detection and the distance detection
+    Isometry3 position;
+    Vector3 translation;
+    Vector3 rotationAxis;
+    double rotationAngle;
+    // The upper bound of the distance moved by any point of the model
+    double motionBound;
+    // The radius of the sphere that encloses the model with the center at the model origin
+    double boundingRadius;
     
-    ColdetModelEx() : groupId(0), isEnabled(true), isStatic(false) { }
+    ColdetModelEx() : groupId(0), isEnabled(true), isStatic(false) {
+        position.setIdentity();
+        boundingRadius = -1.0;
+    }
+
+    void updatePosition(const Isometry3& T){
+        position = T;
+        setPosition(T);
+    }
+
+    double getBoundingRadius(){
+        if(boundingRadius < 0.0){
+            float radius2 = 0.0f;
+            const int n = getNumVertices();
+            for(int i=0; i < n; ++i){
+                float x, y, z;
+                getVertex(i, x, y, z);
+                radius2 = std::max(radius2, x * x + y * y + z * z);
+            }
+            boundingRadius = std::sqrt(static_cast<double>(radius2));
+        }
+        return boundingRadius;
+    }
+
+    void setMotion(const Isometry3& endPosition){
+        getBoundingRadius();
+        translation = endPosition.translation() - position.translation();
+        AngleAxis rotation(position.linear().transpose() * endPosition.linear());
+        rotationAxis = rotation.axis();
+        rotationAngle = rotation.angle();
+        motionBound = translation.norm() + rotationAngle * boundingRadius;
+    }
+
+    void setInterpolatedPosition(double t){
+        Isometry3 T;
+        T.translation() = position.translation() + t * translation;
+        T.linear() = position.linear() * AngleAxis(t * rotationAngle, rotationAxis).toRotationMatrix();
+        setPosition(T);
+    }
 };
 
 class ColdetModelPairEx;
@@ -136,6 +194,7 @@ public:
     bool isReady;
     bool isDynamicGeometryPairChangeEnabled;
     CollisionPair collisionPair;
+    double continuousDetectionTolerance;
         
     Impl();
     Impl(const AISTCollisionDetector::Impl& org);
@@ -149,6 +208,14 @@ public:
     void detectCollisions(GeometryHandle geometry, const std::function<void(const CollisionPair&)>& callback);
     void detectCollisions(const std::function<void(const CollisionPair&)>& callback);
     void detectCollisionsInParallel(const std::function<void(const CollisionPair&)>& callback);
+    void detectContinuousCollisions(
+        const std::function<void(Referenced* object, Isometry3*& out_position)>& endPositionQuery,
+        const std::function<void(const CollisionPair& collisionPair, double time)>& callback);
+    double detectContactTime(ColdetModelPairEx* modelPair);
+    void detectDistances(
+        GeometryHandle* geometry, double maxDistance,
+        const std::function<void(const CollisionPair& collisionPair, double distance,
+                                 const Vector3& point1, const Vector3& point2)>& callback);
 
     // for multithread version
     int numThreads;
@@ -175,6 +242,7 @@ AISTCollisionDetector::Impl::Impl()
 {
     isDynamicGeometryPairChangeEnabled = false;
     maxNumThreads = 0;
+    continuousDetectionTolerance = 1.0e-4;
 
     initialize();
 }
@@ -190,6 +258,7 @@ AISTCollisionDetector::Impl::Impl(const AISTCollisionDetector::Impl& org)
 {
     isDynamicGeometryPairChangeEnabled = org.isDynamicGeometryPairChangeEnabled;
     maxNumThreads = org.maxNumThreads;
+    continuousDetectionTolerance = org.continuousDetectionTolerance;
 
     initialize();
 }
@@ -455,9 +524,9 @@ void AISTCollisionDetector::updatePosition(GeometryHandle geometry, const Isomet
     do {
         if(model->localPosition){
             Isometry3 T = position * (*model->localPosition);
-            model->setPosition(T);
+            model->updatePosition(T);
         } else {
-            model->setPosition(position);
+            model->updatePosition(position);
         }
         model = model->sibling;
     } while(model);
@@ -473,9 +542,9 @@ void AISTCollisionDetector::updatePositions
             positionQuery(model->object, T);
             if(model->localPosition){
                 Isometry3 T2 = (*T) * (*model->localPosition);
-                model->setPosition(T2);
+                model->updatePosition(T2);
             } else {
-                model->setPosition(*T);
+                model->updatePosition(*T);
             }
             model = model->sibling; // Elements in models are overridden here if auto& is used
         } while(model);
@@ -642,3 +711,217 @@ double AISTCollisionDetector::detectDistance
     return ColdetModelPair::computeDistance(
         getColdetModel(geometry1), getColdetModel(geometry2), out_point1.data(), out_point2.data());
 }
+
+
+bool AISTCollisionDetector::detectDistances
+(double maxDistance,
+ std::function<void(const CollisionPair& collisionPair, double distance,
+                    const Vector3& point1, const Vector3& point2)> callback)
+{
+    if(!impl->isReady){
+        impl->makeReady();
+    }
+    impl->detectDistances(nullptr, maxDistance, callback);
+    return true;
+}
+
+
+bool AISTCollisionDetector::detectDistances
+(GeometryHandle geometry, double maxDistance,
+ std::function<void(const CollisionPair& collisionPair, double distance,
+                    const Vector3& point1, const Vector3& point2)> callback)
+{
+    if(!impl->isReady){
+        impl->makeReady();
+    }
+    impl->detectDistances(&geometry, maxDistance, callback);
+    return true;
+}
+
+
+/**
+   The model pair objects keep the closest triangle pairs found in the previous detection so that
+   the distances can be computed with the temporal coherence.
+*/
+void AISTCollisionDetector::Impl::detectDistances
+(GeometryHandle* geometry, double maxDistance,
+ const std::function<void(const CollisionPair& collisionPair, double distance,
+                          const Vector3& point1, const Vector3& point2)>& callback)
+{
+    Vector3 point0, point1, closestPoint0, closestPoint1;
+    
+    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+        ColdetModelPairEx* topModelPair = modelPair;
+        if(geometry){
+            if(getHandle(modelPair->model(0)) != *geometry && getHandle(modelPair->model(1)) != *geometry){
+                continue;
+            }
+        }
+        double minDistance = maxDistance;
+        bool found = false;
+        do {
+            auto model0 = modelPair->model(0);
+            auto model1 = modelPair->model(1);
+            if(model0->isEnabled && model1->isEnabled && model0->isValid() && model1->isValid()){
+                if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(modelPair)){
+                    const double sphereDistance =
+                        (model0->position.translation() - model1->position.translation()).norm()
+                        - model0->getBoundingRadius() - model1->getBoundingRadius();
+                    if(sphereDistance < minDistance){
+                        double distance =
+                            modelPair->computeCoherentDistance(minDistance, point0.data(), point1.data());
+                        if(distance < minDistance){
+                            minDistance = distance;
+                            closestPoint0 = point0;
+                            closestPoint1 = point1;
+                            found = true;
+                        }
+                    }
+                }
+            }
+            modelPair = modelPair->sibling;
+        } while(modelPair);
+
+        if(found){
+            for(int i=0; i < 2; ++i){
+                auto model = topModelPair->model(i);
+                collisionPair.object(i) = model->object;
+                collisionPair.geometry(i) = getHandle(model);
+            }
+            collisionPair.clearCollisions();
+            callback(collisionPair, minDistance, closestPoint0, closestPoint1);
+        }
+    }
+}
+
+
+void AISTCollisionDetector::detectContinuousCollisions
+(std::function<void(Referenced* object, Isometry3*& out_position)> endPositionQuery,
+ std::function<void(const CollisionPair& collisionPair, double time)> callback)
+{
+    if(!impl->isReady){
+        impl->makeReady();
+    }
+    impl->detectContinuousCollisions(endPositionQuery, callback);
+}
+
+
+void AISTCollisionDetector::Impl::detectContinuousCollisions
+(const std::function<void(Referenced* object, Isometry3*& out_position)>& endPositionQuery,
+ const std::function<void(const CollisionPair& collisionPair, double time)>& callback)
+{
+    for(ColdetModelEx* model : models){ // Do not use auto&
+        do {
+            Isometry3* T;
+            endPositionQuery(model->object, T);
+            if(model->localPosition){
+                model->setMotion((*T) * (*model->localPosition));
+            } else {
+                model->setMotion(*T);
+            }
+            model = model->sibling;
+        } while(model);
+    }
+
+    collisionPair.clearCollisions();
+
+    for(ColdetModelPairEx* modelPair : modelPairs){ // Do not use auto&
+        ColdetModelPairEx* topModelPair = modelPair;
+        double contactTime = std::numeric_limits<double>::max();
+        do {
+            if(modelPair->model(0)->isEnabled && modelPair->model(1)->isEnabled){
+                if(!isDynamicGeometryPairChangeEnabled || checkIfModelPairEnabled(modelPair)){
+                    double time = detectContactTime(modelPair);
+                    if(time >= 0.0 && time < contactTime){
+                        contactTime = time;
+                    }
+                }
+            }
+            modelPair = modelPair->sibling;
+        } while(modelPair);
+
+        if(contactTime <= 1.0){
+            for(int i=0; i < 2; ++i){
+                auto model = topModelPair->model(i);
+                collisionPair.object(i) = model->object;
+                collisionPair.geometry(i) = getHandle(model);
+            }
+            callback(collisionPair, contactTime);
+        }
+    }
+
+    // Restore the positions changed in the detection
+    for(ColdetModelEx* model : models){
+        do {
+            model->setPosition(model->position);
+            model = model->sibling;
+        } while(model);
+    }
+}
+
+
+/**
+   This function detects the contact time of a model pair with the conservative advancement.
+   The time is advanced by the current distance divided by the upper bound of the relative
+   motion so that the models never pass through each other in the advanced time.
+   If the time does not converge within MaxContinuousDetectionIterations, the contact is only
+   detected at the end of the motion.
+   \return The contact time or a negative value if the models do not come in contact.
+*/
+double AISTCollisionDetector::Impl::detectContactTime(ColdetModelPairEx* modelPair)
+{
+    auto model0 = modelPair->model(0);
+    auto model1 = modelPair->model(1);
+    if(!model0->isValid() || !model1->isValid()){
+        return -1.0;
+    }
+    const double motionBound = model0->motionBound + model1->motionBound;
+
+    // The bounding spheres are checked first to avoid the distance calculations of the separated models
+    const double sphereDistance =
+        (model0->position.translation() - model1->position.translation()).norm()
+        - model0->boundingRadius - model1->boundingRadius;
+    if(sphereDistance > motionBound + continuousDetectionTolerance){
+        return -1.0;
+    }
+
+    Vector3 point0, point1;
+    double time = 0.0;
+    for(int i=0; i < MaxContinuousDetectionIterations; ++i){
+        model0->setInterpolatedPosition(time);
+        model1->setInterpolatedPosition(time);
+        const double distance =
+            ColdetModelPair::computeDistance(model0, model1, point0.data(), point1.data());
+        if(distance <= continuousDetectionTolerance){
+            return time;
+        }
+        if(motionBound <= 0.0){
+            return -1.0;
+        }
+        time += distance / motionBound;
+        if(time > 1.0){
+            return -1.0;
+        }
+    }
+
+
+    /*
+      The models keep moving close to each other without coming in contact. Regarding them as
+      being in contact at the current time would give a false contact, so only the end positions
+      are checked in the same way as the discrete collision detection.
+    */
+    model0->setInterpolatedPosition(1.0);
+    model1->setInterpolatedPosition(1.0);
+    const double distance =
+        ColdetModelPair::computeDistance(model0, model1, point0.data(), point1.data());
+    if(distance <= continuousDetectionTolerance){
+        return 1.0;
+    }
+    return -1.0;
+}
+
+
+void AISTCollisionDetector::setContinuousDetectionTolerance(double distance)
+{
+    impl->continuousDetectionTolerance = distance;
+}
@@ -6,7 +6,8 @@
 
 namespace cnoid {
 
-class CNOID_EXPORT AISTCollisionDetector : public CollisionDetector, public CollisionDetectorDistanceAPI
+class CNOID_EXPORT AISTCollisionDetector
+    : public CollisionDetector, public CollisionDetectorDistanceAPI, public CollisionDetectorContinuousDetectionAPI
 {
 public:
     AISTCollisionDetector();
@@ -34,6 +35,20 @@ public:
 
     // CollisionDetectorDistanceAPI
     virtual double detectDistance(GeometryHandle geometry1, GeometryHandle geometry2, Vector3& out_point1, Vector3& out_point2) override;
+    virtual bool detectDistances(
+        double maxDistance,
+        std::function<void(const CollisionPair& collisionPair, double distance,
+                           const Vector3& point1, const Vector3& point2)> callback) override;
+    virtual bool detectDistances(
+        GeometryHandle geometry, double maxDistance,
+        std::function<void(const CollisionPair& collisionPair, double distance,
+                           const Vector3& point1, const Vector3& point2)> callback) override;
+
+    // CollisionDetectorContinuousDetectionAPI
+    virtual void detectContinuousCollisions(
+        std::function<void(Referenced* object, Isometry3*& out_position)> endPositionQuery,
+        std::function<void(const CollisionPair& collisionPair, double time)> callback) override;
+    virtual void setContinuousDetectionTolerance(double distance) override;
 
     // experimental
     void setNumThreads(int n);
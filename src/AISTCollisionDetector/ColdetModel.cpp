@@ -5,14 +5,105 @@
 #include "ColdetModel.h"
 #include "ColdetModelInternalModel.h"
 #include "Opcode/Opcode.h"
+#include <cnoid/MappedFile>
+#include <cnoid/UTF8>
+#include <cnoid/stdx/filesystem>
+#include <fmt/format.h>
 #include <map>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <cstring>
+#include <cstdlib>
 #include <iostream>
 
 using namespace std;
 using namespace cnoid;
+namespace filesystem = cnoid::stdx::filesystem;
 
 namespace {
 
+const uint32_t TreeCacheFormatVersion = 1;
+
+struct TreeCacheHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t nodeRecordSize;
+    uint32_t numVertices;
+    uint32_t numTriangles;
+    uint32_t numNodes;
+    uint32_t reserved;
+    uint64_t hash;
+};
+
+/**
+   The pointers of a node are replaced with the node indices in a cache file.
+   The lowest bit of the data is set for a leaf node as well as AABBCollisionNode::mData.
+   The children of a node always have larger indices than the node, and the parent of the
+   root node is the root node itself.
+*/
+struct TreeCacheNodeRecord
+{
+    float center[3];
+    float extents[3];
+    uint32_t data;
+    uint32_t parent;
+};
+
+const char TreeCacheMagic[8] = { 'C', 'N', 'O', 'I', 'D', 'C', 'T', 'R' };
+
+std::mutex treeCacheMutex;
+bool isTreeCacheDirectoryInitialized = false;
+string treeCacheDirectory_;
+int minNumTrianglesToCacheTree = 5000;
+
+string getDefaultTreeCacheDirectory()
+{
+    if(const char* dir = getenv("CNOID_COLDET_TREE_CACHE_DIR")){
+        return dir;
+    }
+    filesystem::path cacheDir;
+#ifdef _WIN32
+    if(const char* appdata = getenv("LOCALAPPDATA")){
+        cacheDir = filesystem::path(fromUTF8(appdata));
+    }
+#else
+    if(const char* xdgCache = getenv("XDG_CACHE_HOME")){
+        cacheDir = filesystem::path(xdgCache);
+    } else if(const char* home = getenv("HOME")){
+        cacheDir = filesystem::path(home) / ".cache";
+    }
+#endif
+    if(cacheDir.empty()){
+        return string();
+    }
+    return toUTF8((cacheDir / "choreonoid" / "coldet").string());
+}
+
+inline void mixHash(uint64_t& hash, uint64_t value)
+{
+    hash ^= value;
+    hash *= 0x100000001b3ULL;
+}
+
+template<class Element>
+void mixHash(uint64_t& hash, const std::vector<Element>& elements)
+{
+    const char* p = reinterpret_cast<const char*>(elements.data());
+    const size_t size = elements.size() * sizeof(Element);
+    const char* end = p + (size & ~static_cast<size_t>(7));
+    uint64_t word;
+    for(; p != end; p += 8){
+        memcpy(&word, p, 8);
+        mixHash(hash, word);
+    }
+    const char* tail = reinterpret_cast<const char*>(elements.data()) + size;
+    for(; p != tail; ++p){
+        mixHash(hash, static_cast<unsigned char>(*p));
+    }
+}
+
 class Edge
 {
     int vertex[2];
@@ -250,6 +341,32 @@ void ColdetModel::getBoundingBoxData(const int depth, std::vector<Vector3>& out_
 }
 
 
+void ColdetModel::setTreeCacheDirectory(const std::string& directory)
+{
+    std::lock_guard<std::mutex> lock(treeCacheMutex);
+    treeCacheDirectory_ = directory;
+    isTreeCacheDirectoryInitialized = true;
+}
+
+
+std::string ColdetModel::treeCacheDirectory()
+{
+    std::lock_guard<std::mutex> lock(treeCacheMutex);
+    if(!isTreeCacheDirectoryInitialized){
+        treeCacheDirectory_ = getDefaultTreeCacheDirectory();
+        isTreeCacheDirectoryInitialized = true;
+    }
+    return treeCacheDirectory_;
+}
+
+
+void ColdetModel::setMinNumTrianglesToCacheTree(int n)
+{
+    std::lock_guard<std::mutex> lock(treeCacheMutex);
+    minNumTrianglesToCacheTree = n;
+}
+
+
 bool ColdetModelInternalModel::build()
 {
     bool result = false;
@@ -258,21 +375,52 @@ bool ColdetModelInternalModel::build()
     
     if(triangles.size() > 0){
 
-        extractNeghiborTriangles();
-
-        Opcode::OPCODECREATE OPCC;
-
         iMesh.SetPointers(&triangles[0], &vertices[0]);
         iMesh.SetNbTriangles(triangles.size());
         iMesh.SetNbVertices(vertices.size());
+
+        string cacheDirectory;
+        string cacheFile;
+        uint64_t hash = 0;
+        int minNumTriangles;
+        {
+            std::lock_guard<std::mutex> lock(treeCacheMutex);
+            minNumTriangles = minNumTrianglesToCacheTree;
+        }
+        if(static_cast<int>(triangles.size()) >= minNumTriangles){
+            cacheDirectory = ColdetModel::treeCacheDirectory();
+        }
+        bool isTreeRestored = false;
+        if(!cacheDirectory.empty()){
+            hash = 0xcbf29ce484222325ULL;
+            mixHash(hash, vertices.size());
+            mixHash(hash, triangles.size());
+            mixHash(hash, vertices);
+            mixHash(hash, triangles);
+            cacheFile = toUTF8(
+                (filesystem::path(fromUTF8(cacheDirectory)) / fmt::format("{:016x}.tree", hash)).string());
+            isTreeRestored = loadCachedTree(cacheFile, hash);
+        }
+
+        if(!isTreeRestored){
+            extractNeghiborTriangles();
+
+            Opcode::OPCODECREATE OPCC;
+            OPCC.mIMesh = &iMesh;
+            OPCC.mNoLeaf = false;
+            OPCC.mQuantized = false;
+            OPCC.mKeepOriginal = false;
         
-        OPCC.mIMesh = &iMesh;
-        
-        OPCC.mNoLeaf = false;
-        OPCC.mQuantized = false;
-        OPCC.mKeepOriginal = false;
+            model.Build(OPCC);
+
+            if(!cacheFile.empty() && model.GetTree()){
+                saveTreeToCache(cacheDirectory, cacheFile, hash);
+            }
+        }
         
-        model.Build(OPCC);
+        AABBTreeMaxDepth = 0;
+        numBBMap.clear();
+        numLeafMap.clear();
         if(model.GetTree()){
             AABBTreeMaxDepth = computeDepth(((Opcode::AABBCollisionTree*)model.GetTree())->GetNodes(), 0, -1) + 1;
             for(int i=0; i<AABBTreeMaxDepth; i++)
@@ -286,6 +434,175 @@ bool ColdetModelInternalModel::build()
 }
 
 
+bool ColdetModelInternalModel::loadCachedTree(const std::string& filename, uint64_t hash)
+{
+    MappedFile file;
+    if(!filesystem::exists(filesystem::path(fromUTF8(filename))) || !file.open(filename)){
+        return false;
+    }
+    if(file.size() < sizeof(TreeCacheHeader)){
+        return false;
+    }
+    TreeCacheHeader header;
+    memcpy(&header, file.data(), sizeof(header));
+
+    const uint32_t numTriangles = triangles.size();
+    const uint32_t numNodes = numTriangles * 2 - 1;
+    if(memcmp(header.magic, TreeCacheMagic, sizeof(TreeCacheMagic)) != 0 ||
+       header.version != TreeCacheFormatVersion ||
+       header.nodeRecordSize != sizeof(TreeCacheNodeRecord) ||
+       header.numVertices != vertices.size() ||
+       header.numTriangles != numTriangles ||
+       header.numNodes != numNodes ||
+       header.hash != hash){
+        return false;
+    }
+    const size_t nodesSize = sizeof(TreeCacheNodeRecord) * numNodes;
+    const size_t neighborsSize = sizeof(int32_t) * 3 * numTriangles;
+    if(file.size() != sizeof(header) + nodesSize + neighborsSize){
+        return false;
+    }
+
+    const char* p = file.data() + sizeof(header);
+    auto nodes = new Opcode::AABBCollisionNode[numNodes];
+    TreeCacheNodeRecord record;
+    for(uint32_t i=0; i < numNodes; ++i){
+        memcpy(&record, p, sizeof(record));
+        p += sizeof(record);
+        auto& node = nodes[i];
+        node.mAABB.mCenter.Set(record.center[0], record.center[1], record.center[2]);
+        node.mAABB.mExtents.Set(record.extents[0], record.extents[1], record.extents[2]);
+        const uint32_t index = record.data >> 1;
+        bool isValid;
+        if(record.data & 1){
+            isValid = (index < numTriangles);
+            node.mData = record.data;
+        } else {
+            /*
+              The negative child is stored next to the positive child. The children must be
+              after the node so that a corrupted file cannot make a cycle in the tree.
+            */
+            isValid = (index > i && index + 1 < numNodes);
+            node.mData = reinterpret_cast<EXWORD>(&nodes[index]);
+        }
+        if(i == 0){
+            isValid = isValid && (record.parent == 0);
+        } else {
+            isValid = isValid && (record.parent < i);
+        }
+        if(!isValid){
+            delete[] nodes;
+            return false;
+        }
+        node.mB = &nodes[record.parent];
+    }
+
+    NeighborTriangleSetArray restoredNeighbors(numTriangles);
+    int32_t indices[3];
+    for(uint32_t i=0; i < numTriangles; ++i){
+        memcpy(indices, p, sizeof(indices));
+        p += sizeof(indices);
+        auto& neighbor = restoredNeighbors[i];
+        for(int j=0; j < 3; ++j){
+            if(indices[j] < -1 || indices[j] >= static_cast<int32_t>(numTriangles)){
+                delete[] nodes;
+                return false;
+            }
+            neighbor.neighbors[j] = indices[j];
+        }
+    }
+
+    if(!model.Restore(&iMesh, nodes, numNodes)){
+        delete[] nodes;
+        return false;
+    }
+    neighbors.swap(restoredNeighbors);
+
+    return true;
+}
+
+
+void ColdetModelInternalModel::saveTreeToCache
+(const std::string& directory, const std::string& filename, uint64_t hash)
+{
+    auto tree = static_cast<Opcode::AABBCollisionTree*>(model.GetTree());
+    const Opcode::AABBCollisionNode* nodes = tree->GetNodes();
+    const uint32_t numNodes = tree->GetNbNodes();
+
+    filesystem::path dirPath(fromUTF8(directory));
+    std::error_code ec;
+    filesystem::create_directories(dirPath, ec);
+    if(ec){
+        return;
+    }
+    
+    // Write to a temporary file first so that other processes never read an incomplete file
+    filesystem::path filePath(fromUTF8(filename));
+    filesystem::path tmpPath(filePath);
+    tmpPath += fmt::format(
+        ".{:x}{:x}.tmp",
+        reinterpret_cast<uintptr_t>(this), chrono::steady_clock::now().time_since_epoch().count());
+
+    {
+        ofstream out(tmpPath.string(), ios::out | ios::binary | ios::trunc);
+        if(!out){
+            return;
+        }
+        TreeCacheHeader header;
+        memcpy(header.magic, TreeCacheMagic, sizeof(TreeCacheMagic));
+        header.version = TreeCacheFormatVersion;
+        header.nodeRecordSize = sizeof(TreeCacheNodeRecord);
+        header.numVertices = vertices.size();
+        header.numTriangles = triangles.size();
+        header.numNodes = numNodes;
+        header.reserved = 0;
+        header.hash = hash;
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+        vector<TreeCacheNodeRecord> records(numNodes);
+        for(uint32_t i=0; i < numNodes; ++i){
+            auto& node = nodes[i];
+            auto& record = records[i];
+            const auto& c = node.mAABB.mCenter;
+            const auto& e = node.mAABB.mExtents;
+            record.center[0] = c.x;
+            record.center[1] = c.y;
+            record.center[2] = c.z;
+            record.extents[0] = e.x;
+            record.extents[1] = e.y;
+            record.extents[2] = e.z;
+            if(node.IsLeaf()){
+                record.data = node.mData;
+            } else {
+                record.data = (node.GetPos() - nodes) << 1;
+            }
+            record.parent = node.GetB() - nodes;
+        }
+        out.write(reinterpret_cast<const char*>(records.data()), sizeof(TreeCacheNodeRecord) * numNodes);
+
+        const int numTriangles = triangles.size();
+        vector<int32_t> indices(numTriangles * 3);
+        for(int i=0; i < numTriangles; ++i){
+            for(int j=0; j < 3; ++j){
+                indices[i * 3 + j] = neighbors[i][j];
+            }
+        }
+        out.write(reinterpret_cast<const char*>(indices.data()), sizeof(int32_t) * indices.size());
+
+        if(!out){
+            out.close();
+            filesystem::remove(tmpPath, ec);
+            return;
+        }
+    }
+
+    filesystem::rename(tmpPath, filePath, ec);
+    if(ec){
+        filesystem::remove(tmpPath, ec);
+    }
+}
+
+
 void ColdetModel::setPosition(const Isometry3& T)
 {
     transform->Set((float)T(0,0), (float)T(1,0), (float)T(2,0), 0.0f,
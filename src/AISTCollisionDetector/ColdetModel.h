@@ -129,6 +129,27 @@ public:
      */
     bool isValid() const { return isValid_; }
 
+    /**
+     * @brief set the directory to store the built trees of bounding boxes
+     *
+     * A tree built for a mesh is saved in the directory with the hash value of
+     * the mesh contents as the key, and it is reused by the build() function
+     * for the same mesh instead of building the tree again. The cache is disabled
+     * when an empty string is given. The default directory is given by the
+     * CNOID_COLDET_TREE_CACHE_DIR environment variable if it is defined.
+     * Otherwise "choreonoid/coldet" in the user cache directory is used.
+     */
+    static void setTreeCacheDirectory(const std::string& directory);
+    static std::string treeCacheDirectory();
+
+    /**
+     * @brief set the minimum number of triangles of a mesh whose tree is cached
+     *
+     * The trees of smaller meshes are built every time because building them
+     * is faster than accessing the cache files.
+     */
+    static void setMinNumTrianglesToCacheTree(int n);
+
 #ifdef CNOID_BACKWARD_COMPATIBILITY
     /**
      * @brief set position and orientation of this model
@@ -8,6 +8,8 @@
 #include "ColdetModel.h"
 #include "Opcode/Opcode.h"
 #include <vector>
+#include <string>
+#include <cstdint>
 
 namespace cnoid {
 
@@ -77,6 +79,8 @@ private:
     std::vector<int> numLeafMap;
 
     void extractNeghiborTriangles();
+    bool loadCachedTree(const std::string& filename, uint64_t hash);
+    void saveTreeToCache(const std::string& directory, const std::string& filename, uint64_t hash);
     int computeDepth(const Opcode::AABBCollisionNode* node, int currentDepth, int max );
 
     friend class ColdetModel;
@@ -37,6 +37,8 @@ struct figStruct {
 ColdetModelPair::ColdetModelPair()
 {
     collisionPairInserter = new Opcode::StdCollisionPairInserter;
+    closestTriangles[0] = -1;
+    closestTriangles[1] = -1;
 }
 
 
@@ -66,6 +68,8 @@ void ColdetModelPair::set(ColdetModel* model0, ColdetModel* model1)
 {
     models[0] = model0;
     models[1] = model1;
+    closestTriangles[0] = -1;
+    closestTriangles[1] = -1;
     // inverse order because of historical background
     // this should be fixed.(note that the direction of normal is inversed when the order inversed 
     if(model0 && model1){
@@ -651,6 +655,42 @@ double ColdetModelPair::computeDistance(int& triangle0, double* point0, int& tri
 }
 
 
+double ColdetModelPair::computeCoherentDistance(double maxDistance, double* point0, double* point1)
+{
+    if(models[0]->isValid() && models[1]->isValid()){
+
+        Opcode::BVTCache colCache;
+
+        colCache.Model0 = &models[1]->internalModel->model;
+        colCache.Model1 = &models[0]->internalModel->model;
+
+        Opcode::SSVTreeCollider collider;
+
+        if(closestTriangles[0] >= 0){
+            collider.SetTemporalCoherence(true);
+            colCache.id0 = closestTriangles[1];
+            colCache.id1 = closestTriangles[0];
+        }
+        
+        float d;
+        Point p0, p1;
+        float maxD = (maxDistance < MAX_FLOAT) ? static_cast<float>(maxDistance) : MAX_FLOAT;
+        collider.BoundedDistance(colCache, maxD, d, p0, p1, models[1]->transform, models[0]->transform);
+        point0[0] = p1.x;
+        point0[1] = p1.y;
+        point0[2] = p1.z;
+        point1[0] = p0.x;
+        point1[1] = p0.y;
+        point1[2] = p0.z;
+        closestTriangles[1] = colCache.id0;
+        closestTriangles[0] = colCache.id1;
+        return d;
+    }
+
+    return -1.0;
+}
+
+
 bool ColdetModelPair::detectIntersection()
 {
     if(models[0]->isValid() && models[1]->isValid()){
@@ -50,6 +50,16 @@ public:
     */
     double computeDistance(int& out_triangle0, double* out_point0, int& out_triangle1, double* out_point1);
 
+    /**
+       This function uses the closest triangle pair found by the previous call as the initial candidate
+       of the closest pair, and the pairs of the bounding volumes farther than maxDistance are not
+       traversed. The computation is much faster than computeDistance when the models move a little
+       from the previous call or they are far from each other.
+       @return The minimum distance. If it is not smaller than maxDistance, a value not smaller than
+       maxDistance is returned and the closest points are not valid.
+    */
+    double computeCoherentDistance(double maxDistance, double* out_point0, double* out_point1);
+
     bool detectIntersection();
 
     double tolerance() const { return tolerance_; }
@@ -84,6 +94,8 @@ private:
     bool detectPlaneMeshCollisions(bool detectAllContacts);
 
     ColdetModelPtr models[2];
+    // The indices of the closest triangles found by computeCoherentDistance
+    int closestTriangles[2];
     double tolerance_;
     Opcode::CollisionPairInserter* collisionPairInserter;
     int boxTestsCount;
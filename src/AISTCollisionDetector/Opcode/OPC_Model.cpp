@@ -213,6 +213,31 @@ bool Model::Build(const OPCODECREATE& create)
 }
 #pragma clang diagnostic pop
 
+#if 1 // Added by AIST
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Builds a normal collision model from the nodes of an AABBCollisionTree built in advance.
+ *	\param		mesh_interface	[in] mesh interface the nodes were built for
+ *	\param		nodes			[in] flattened nodes allocated with new[]. The model takes over them on success.
+ *	\param		nb_nodes		[in] number of nodes
+ *	\return		true if success
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+bool Model::Restore(const MeshInterface* mesh_interface, AABBCollisionNode* nodes, udword nb_nodes)
+{
+	if(!mesh_interface || !mesh_interface->IsValid() || !nodes)	return false;
+	if(nb_nodes != mesh_interface->GetNbTriangles()*2-1)		return false;
+
+	Release();
+	SetMeshInterface(mesh_interface);
+
+	if(!CreateTree(false, false))	return false;
+	static_cast<AABBCollisionTree*>(mTree)->SetNodes(nodes, nb_nodes);
+
+	return true;
+}
+#endif
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Gets the number of bytes used by the tree.
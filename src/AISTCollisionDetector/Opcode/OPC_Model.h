@@ -36,6 +36,19 @@
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		override(BaseModel)	bool				Build(const OPCODECREATE& create);
 
+#if 1 // Added by AIST
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+		/**
+		 *	Builds a normal collision model from the nodes of an AABBCollisionTree built in advance.
+		 *	\param		mesh_interface	[in] mesh interface the nodes were built for
+		 *	\param		nodes			[in] flattened nodes allocated with new[]. The model takes over them on success.
+		 *	\param		nb_nodes		[in] number of nodes
+		 *	\return		true if success
+		 */
+		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+							bool				Restore(const MeshInterface* mesh_interface, AABBCollisionNode* nodes, udword nb_nodes);
+#endif
+
 #ifdef __MESHMERIZER_H__
 		///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 		/**
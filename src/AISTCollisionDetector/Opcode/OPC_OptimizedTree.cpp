@@ -266,6 +266,21 @@ bool AABBCollisionTree::Build(AABBTree* tree)
 	return true;
 }
 
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+/**
+ *	Takes over a collision tree which has already been flattened.
+ *	The node array must have been allocated with new[], and its node links must point to the array itself.
+ *	\param		nodes			[in] flattened nodes
+ *	\param		nb_nodes		[in] number of nodes
+ */
+///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
+void AABBCollisionTree::SetNodes(AABBCollisionNode* nodes, udword nb_nodes)
+{
+	DELETEARRAY(mNodes);
+	mNodes = nodes;
+	mNbNodes = nb_nodes;
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 /**
  *	Refits the collision tree after vertices have been modified.
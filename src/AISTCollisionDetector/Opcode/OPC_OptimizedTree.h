@@ -188,6 +188,11 @@
 	class OPCODE_API AABBCollisionTree : public AABBOptimizedTree
 	{
 		IMPLEMENT_COLLISION_TREE(AABBCollisionTree, AABBCollisionNode)
+#if 1 // Added by AIST
+		public:
+		// Takes over a flattened node array which has been built in advance
+		void	SetNodes(AABBCollisionNode* nodes, udword nb_nodes);
+#endif
 	};
 
 	class OPCODE_API AABBNoLeafTree : public AABBOptimizedTree
@@ -26,43 +26,72 @@ bool SSVTreeCollider::Distance(BVTCache& cache,
     // Simple double-dispatch
     const AABBCollisionTree* T0 = (const AABBCollisionTree*)cache.Model0->GetTree();
     const AABBCollisionTree* T1 = (const AABBCollisionTree*)cache.Model1->GetTree();
-    Distance(T0, T1, world0, world1, &cache, minD, point0, point1);
+    Distance(T0, T1, world0, world1, &cache, MAX_FLOAT, minD, point0, point1);
     return true;
 }
 
-void SSVTreeCollider::Distance(const AABBCollisionTree* tree0, 
+bool SSVTreeCollider::BoundedDistance(BVTCache& cache, float maxD,
+                                      float& minD, Point &point0, Point&point1,
+                                      const Matrix4x4* world0, const Matrix4x4* world1)
+{
+    // Checkings
+    if(!cache.Model0 || !cache.Model1)                             return false;
+    if(cache.Model0->HasLeafNodes()!=cache.Model1->HasLeafNodes()) return false;
+    if(cache.Model0->IsQuantized()!=cache.Model1->IsQuantized())   return false;
+        
+    // Checkings
+    if(!Setup(cache.Model0->GetMeshInterface(), cache.Model1->GetMeshInterface())) return false;
+        
+    const AABBCollisionTree* T0 = (const AABBCollisionTree*)cache.Model0->GetTree();
+    const AABBCollisionTree* T1 = (const AABBCollisionTree*)cache.Model1->GetTree();
+    return Distance(T0, T1, world0, world1, &cache, maxD, minD, point0, point1);
+}
+
+bool SSVTreeCollider::Distance(const AABBCollisionTree* tree0, 
                                const AABBCollisionTree* tree1, 
                                const Matrix4x4* world0, const Matrix4x4* world1, 
-                               Pair* cache, float& minD, Point &point0, Point&point1)
+                               Pair* cache, float maxD, float& minD, Point &point0, Point&point1)
 {
     if (debug) std::cout << "Distance()" << std::endl;
     // Init collision query
     InitQuery(world0, world1);
     
     // Compute initial value using temporal coherency
-    // todo : cache should be used 
-
-    const AABBCollisionNode *n;
-    for (unsigned int i=0; i<tree0->GetNbNodes(); i++){
-        n = tree0->GetNodes()+i;
-        if (n->IsLeaf()){
-            mId0 = n->GetPrimitive();
-            break;
+    if(TemporalCoherenceEnabled() &&
+       cache->id0 < mIMesh0->GetNbTriangles() && cache->id1 < mIMesh1->GetNbTriangles()){
+        mId0 = cache->id0;
+        mId1 = cache->id1;
+    } else {
+        const AABBCollisionNode *n;
+        for (unsigned int i=0; i<tree0->GetNbNodes(); i++){
+            n = tree0->GetNodes()+i;
+            if (n->IsLeaf()){
+                mId0 = n->GetPrimitive();
+                break;
+            }
+        } 
+        for (unsigned int i=0; i<tree1->GetNbNodes(); i++){
+            n = tree1->GetNodes()+i;
+            if (n->IsLeaf()){
+                mId1 = n->GetPrimitive();
+                break;
+            }
         }
-    } 
-    for (unsigned int i=0; i<tree1->GetNbNodes(); i++){
-        n = tree1->GetNodes()+i;
-        if (n->IsLeaf()){
-            mId1 = n->GetPrimitive();
-            break;
-        }
-    } 
+    }
     Point p0, p1;
-    minD = PrimDist(mId0, mId1, p0, p1);
+    const float initialD = PrimDist(mId0, mId1, p0, p1);
+
+    // The node pairs farther than maxD are pruned in the traversal
+    minD = (initialD < maxD) ? initialD : maxD;
     
     // Perform distance computation
     _Distance(tree0->GetNodes(), tree1->GetNodes(), minD, p0, p1);
 
+    bool isWithinBound = (minD < maxD);
+    if(!isWithinBound){
+        minD = initialD;
+    }
+
     // transform points
     TransformPoint4x3(point0, p0, *world1);
     TransformPoint4x3(point1, p1, *world1);
@@ -70,6 +99,8 @@ void SSVTreeCollider::Distance(const AABBCollisionTree* tree0,
     // update cache
     cache->id0 = mId0;
     cache->id1 = mId1;
+
+    return isWithinBound;
 }
 
 bool SSVTreeCollider::Collide(BVTCache& cache, double tolerance,
@@ -134,6 +165,39 @@ float SSVTreeCollider::SsvSsvDist(const AABBCollisionNode *b0,
     return 0.0f;
 }
 
+float SSVTreeCollider::BoxBoxDistLowerBound(const AABBCollisionNode* b0, const AABBCollisionNode* b1)
+{
+    const Point& ea = b0->mAABB.mExtents;
+    const Point& ca = b0->mAABB.mCenter;
+    const Point& eb = b1->mAABB.mExtents;
+    const Point& cb = b1->mAABB.mCenter;
+
+    // The gap of the projections on a unit axis never exceeds the distance of the boxes
+    float Tx = (mR1to0.m[0][0]*cb.x + mR1to0.m[1][0]*cb.y + mR1to0.m[2][0]*cb.z) + mT1to0.x - ca.x;
+    float Ty = (mR1to0.m[0][1]*cb.x + mR1to0.m[1][1]*cb.y + mR1to0.m[2][1]*cb.z) + mT1to0.y - ca.y;
+    float Tz = (mR1to0.m[0][2]*cb.x + mR1to0.m[1][2]*cb.y + mR1to0.m[2][2]*cb.z) + mT1to0.z - ca.z;
+
+    // A's basis vectors
+    float d = fabsf(Tx) - (ea.x + eb.x*mAR.m[0][0] + eb.y*mAR.m[1][0] + eb.z*mAR.m[2][0]);
+    float g = fabsf(Ty) - (ea.y + eb.x*mAR.m[0][1] + eb.y*mAR.m[1][1] + eb.z*mAR.m[2][1]);
+    if(g > d) d = g;
+    g = fabsf(Tz) - (ea.z + eb.x*mAR.m[0][2] + eb.y*mAR.m[1][2] + eb.z*mAR.m[2][2]);
+    if(g > d) d = g;
+
+    // B's basis vectors
+    g = fabsf(Tx*mR1to0.m[0][0] + Ty*mR1to0.m[0][1] + Tz*mR1to0.m[0][2])
+        - (ea.x*mAR.m[0][0] + ea.y*mAR.m[0][1] + ea.z*mAR.m[0][2] + eb.x);
+    if(g > d) d = g;
+    g = fabsf(Tx*mR1to0.m[1][0] + Ty*mR1to0.m[1][1] + Tz*mR1to0.m[1][2])
+        - (ea.x*mAR.m[1][0] + ea.y*mAR.m[1][1] + ea.z*mAR.m[1][2] + eb.y);
+    if(g > d) d = g;
+    g = fabsf(Tx*mR1to0.m[2][0] + Ty*mR1to0.m[2][1] + Tz*mR1to0.m[2][2])
+        - (ea.x*mAR.m[2][0] + ea.y*mAR.m[2][1] + ea.z*mAR.m[2][2] + eb.z);
+    if(g > d) d = g;
+
+    return d;
+}
+
 float SSVTreeCollider::PssPssDist(float r0, const Point& center0, float r1, const Point& center1)
 {
     Point c0;
@@ -172,6 +236,9 @@ void SSVTreeCollider::_Distance(const AABBCollisionNode* b0, const AABBCollision
 {
     if (debug) std::cout << "_Distance()" << std::endl;
 
+    // The distance never becomes smaller when the primitives are already in contact
+    if(minD <= 0.0f) return;
+
     mNowNode0 = b0;
     mNowNode1 = b1;
     float d;
@@ -180,6 +247,8 @@ void SSVTreeCollider::_Distance(const AABBCollisionNode* b0, const AABBCollision
     d = SsvSsvDist(b0, b1);
 
     if(d > minD) return;
+
+    if(BoxBoxDistLowerBound(b0, b1) > minD) return;
     
     if(b0->IsLeaf() && b1->IsLeaf()) { 
         Point p0, p1;
@@ -33,6 +33,23 @@ public:
     bool Distance(BVTCache& cache, float& minD, Point &point0, Point&point1,
                   const Matrix4x4* world0=null, const Matrix4x4* world1=null);
 
+    /**
+     * @brief compute the minimum distance if it is smaller than the given upper bound.
+     * The node pairs farther than the bound are not traversed. If the temporal coherence is
+     * enabled, the primitive pair stored in the cache by the previous computation is used as
+     * the initial closest pair, which makes the traversal much faster when the links move a little.
+     * @param cache
+     * @param maxD the upper bound of the distance
+     * @param minD the minimum distance. The value is not smaller than maxD if false is returned.
+     * @param point0 the closest point on the first link
+     * @param point1 the closest point on the second link
+     * @param world0 transformation of the first link
+     * @param world1 transformation of the second link
+     * @return true if the distance is smaller than maxD, false otherwise
+     */
+    bool BoundedDistance(BVTCache& cache, float maxD, float& minD, Point &point0, Point&point1,
+                         const Matrix4x4* world0=null, const Matrix4x4* world1=null);
+
     /**
      * @brief detect collision between links. 
      * @param cache 
@@ -53,6 +70,16 @@ protected:
      */
     float SsvSsvDist(const AABBCollisionNode* b0, const AABBCollisionNode *b1);
 
+    /**
+     * @brief compute a lower bound of the distance between the boxes of the nodes
+     * with the separating axis test on the face normals of the boxes.
+     * The bound is much tighter than the SSV distance for the nodes of large flat triangles.
+     * @param b0 collision node from the left tree
+     * @param b1 collision node from the right tree
+     * @return the lower bound of the distance. A negative value is returned if the boxes overlap.
+     */
+    float BoxBoxDistLowerBound(const AABBCollisionNode* b0, const AABBCollisionNode* b1);
+
     /**
      * @brief compute distance between primitives(triangles)
      * @param id0 index of the first primitive
@@ -64,10 +91,10 @@ protected:
     float PrimDist(udword id0, udword id1, Point& point0, Point& point1);
 
 private:
-    void Distance(const AABBCollisionTree* tree0, 
+    bool Distance(const AABBCollisionTree* tree0, 
                   const AABBCollisionTree* tree1, 
                   const Matrix4x4* world0, const Matrix4x4* world1, 
-                  Pair* cache, float& minD,  Point &point0, Point&point1);
+                  Pair* cache, float maxD, float& minD,  Point &point0, Point&point1);
 
     void _Distance(const AABBCollisionNode* b0, const AABBCollisionNode* b1,
                    float& minD, Point& point0, Point& point1);
@@ -1,5 +1,6 @@
 #include "GeneralSceneFileImporterBase.h"
 #include <cnoid/SceneLoader>
+#include <cnoid/SceneGraph>
 #include <cnoid/Selection>
 #include <cnoid/ValueTree>
 #include <cnoid/ComboBox>
@@ -24,6 +25,7 @@ public:
     static int sharedImplCounter;
     
     unique_ptr<SceneLoader> sceneLoader;
+    shared_ptr<AbstractSceneLoader> actualSceneLoaderOnLastLoading;
     QWidget* optionPanel;
 
     Selection lengthUnitHint;
@@ -35,6 +37,7 @@ public:
     Impl();
     ~Impl();
     SgNode* loadScene(GeneralSceneFileImporterBase* self, const std::string& filename);
+    SgNode* takePreloadedScene(GeneralSceneFileImporterBase* self, const std::string& filename);
     void createOptionPanel();    
 };
 
@@ -43,6 +46,21 @@ int GeneralSceneFileImporterBase::Impl::sharedImplCounter = 0;
 
 }
 
+namespace {
+
+class PreloadedScene : public Referenced
+{
+public:
+    SgNodePtr scene;
+    shared_ptr<AbstractSceneLoader> actualSceneLoader;
+    int lengthUnitHint;
+    int upperAxisHint;
+};
+
+typedef ref_ptr<PreloadedScene> PreloadedScenePtr;
+
+}
+
 
 GeneralSceneFileImporterBase::GeneralSceneFileImporterBase(int api)
     : ItemFileIO("GENERAL-3D-MODEL", api)
@@ -63,7 +81,7 @@ GeneralSceneFileImporterBase::GeneralSceneFileImporterBase(int api)
 
 
 GeneralSceneFileImporterBase::GeneralSceneFileImporterBase()
-    : GeneralSceneFileImporterBase(Load | Options | OptionPanelForLoading)
+    : GeneralSceneFileImporterBase(Load | Options | OptionPanelForLoading | Preload)
 {
 
 }
@@ -111,6 +129,10 @@ SgNode* GeneralSceneFileImporterBase::loadScene(const std::string& filename)
 
 SgNode* GeneralSceneFileImporterBase::Impl::loadScene(GeneralSceneFileImporterBase* self, const std::string& filename)
 {
+    if(auto scene = takePreloadedScene(self, filename)){
+        return scene;
+    }
+    
     if(!sceneLoader){
         sceneLoader.reset(new SceneLoader);
         sceneLoader->setMessageSink(self->os());
@@ -121,6 +143,7 @@ SgNode* GeneralSceneFileImporterBase::Impl::loadScene(GeneralSceneFileImporterBa
     
     bool isSupported;
     SgNode* scene = sceneLoader->load(filename, isSupported);
+    actualSceneLoaderOnLastLoading = sceneLoader->actualSceneLoaderOnLastLoading();
 
     if(!scene){
         if(!isSupported){
@@ -134,9 +157,47 @@ SgNode* GeneralSceneFileImporterBase::Impl::loadScene(GeneralSceneFileImporterBa
 }
 
 
+SgNode* GeneralSceneFileImporterBase::Impl::takePreloadedScene
+(GeneralSceneFileImporterBase* self, const std::string& filename)
+{
+    auto preloaded = dynamic_pointer_cast<PreloadedScene>(self->takePreloadedData(filename));
+    if(!preloaded || !preloaded->scene ||
+       preloaded->lengthUnitHint != lengthUnitHint.which() ||
+       preloaded->upperAxisHint != upperAxisHint.which()){
+        return nullptr;
+    }
+    actualSceneLoaderOnLastLoading = preloaded->actualSceneLoader;
+    return preloaded->scene.retn();
+}
+
+
+/**
+   A scene loader is created for each call because this function may be executed by multiple
+   worker threads at the same time. The options are not changed while the files are preloaded.
+*/
+ReferencedPtr GeneralSceneFileImporterBase::preload(const std::string& filename, std::ostream& os)
+{
+    SceneLoader sceneLoader;
+    sceneLoader.setMessageSink(os);
+    PreloadedScenePtr preloaded = new PreloadedScene;
+    preloaded->lengthUnitHint = impl->lengthUnitHint.which();
+    preloaded->upperAxisHint = impl->upperAxisHint.which();
+    sceneLoader.setLengthUnitHint(static_cast<SceneLoader::LengthUnitType>(preloaded->lengthUnitHint));
+    sceneLoader.setUpperAxisHint(static_cast<SceneLoader::UpperAxisType>(preloaded->upperAxisHint));
+    
+    bool isSupported;
+    preloaded->scene = sceneLoader.load(filename, isSupported);
+    if(!preloaded->scene){
+        return nullptr;
+    }
+    preloaded->actualSceneLoader = sceneLoader.actualSceneLoaderOnLastLoading();
+    return preloaded;
+}
+
+
 std::shared_ptr<AbstractSceneLoader> GeneralSceneFileImporterBase::sceneLoaderOnLastLoading()
 {
-    return impl->sceneLoader->actualSceneLoaderOnLastLoading();
+    return impl->actualSceneLoaderOnLastLoading;
 }
 
 
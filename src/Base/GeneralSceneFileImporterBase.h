@@ -21,12 +21,17 @@ public:
     void setCurrentLengthUnitHint(LengthUnitType unitType);
 
 protected:
+    /**
+       The scene preloaded by the preload function is returned if it exists and the current
+       options are the same as the ones used in preloading.
+    */
     SgNode* loadScene(const std::string& filename);
     std::shared_ptr<AbstractSceneLoader> sceneLoaderOnLastLoading();
 
     //! This function has not been implemented yet
     bool saveScene(SgNode* scene, const std::string& filename);
     
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override;
     virtual void resetOptions() override;
     virtual void storeOptions(Mapping* archive) override;
     virtual bool restoreOptions(const Mapping* archive) override;
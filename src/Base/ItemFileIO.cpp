@@ -7,6 +7,9 @@
 #include <cnoid/UTF8>
 #include <cnoid/stdx/filesystem>
 #include <fmt/format.h>
+#include <sstream>
+#include <mutex>
+#include <map>
 #include "gettext.h"
 
 using namespace std;
@@ -38,6 +41,14 @@ public:
     std::time_t lastSelectedTimeInLoadDialog;
     std::time_t lastSelectedTimeInSaveDialog;
 
+    struct PreloadedData
+    {
+        ReferencedPtr data;
+        std::string messages;
+    };
+    std::map<std::string, PreloadedData> preloadedDataMap;
+    mutable std::mutex preloadMutex;
+
     // This variable actualy points a instance of the ClassInfo class defined in ItemManager.cpp
     mutable weak_ref_ptr<Referenced> itemClassInfo;
 
@@ -450,6 +461,73 @@ void ItemFileIO::setActuallyLoadedItem(Item* item)
 }
 
 
+bool ItemFileIO::preloadFile(const std::string& filename)
+{
+    if(!(impl->api & Preload)){
+        return false;
+    }
+    std::ostringstream messages;
+    ReferencedPtr data;
+    try {
+        data = preload(filename, messages);
+    } catch(const std::exception& ex){
+        messages << ex.what() << endl;
+    } catch(...){
+        // Exceptions such as ValueNode::Exception are not derived from std::exception.
+        // They are reported when the file is loaded again in the main thread.
+    }
+    if(!data){
+        // The file is loaded again by the load function to report the errors in the main thread
+        return false;
+    }
+    std::lock_guard<std::mutex> lock(impl->preloadMutex);
+    auto& preloaded = impl->preloadedDataMap[filename];
+    preloaded.data = data;
+    preloaded.messages = messages.str();
+    return true;
+}
+
+
+bool ItemFileIO::hasPreloadedData(const std::string& filename) const
+{
+    std::lock_guard<std::mutex> lock(impl->preloadMutex);
+    return impl->preloadedDataMap.find(filename) != impl->preloadedDataMap.end();
+}
+
+
+void ItemFileIO::clearPreloadedData()
+{
+    std::lock_guard<std::mutex> lock(impl->preloadMutex);
+    impl->preloadedDataMap.clear();
+}
+
+
+ReferencedPtr ItemFileIO::preload(const std::string& /* filename */, std::ostream& /* os */)
+{
+    return nullptr;
+}
+
+
+ReferencedPtr ItemFileIO::takePreloadedData(const std::string& filename)
+{
+    ReferencedPtr data;
+    string messages;
+    {
+        std::lock_guard<std::mutex> lock(impl->preloadMutex);
+        auto p = impl->preloadedDataMap.find(filename);
+        if(p != impl->preloadedDataMap.end()){
+            data = p->second.data;
+            messages = p->second.messages;
+            impl->preloadedDataMap.erase(p);
+        }
+    }
+    if(!messages.empty()){
+        os() << messages;
+    }
+    return data;
+}
+
+
 bool ItemFileIO::saveItem(Item* item, const std::string& filename, const Mapping* options)
 {
     bool saved = impl->saveItem(item, filename, options);
@@ -26,6 +26,7 @@ public:
         OptionPanelForLoading = 1 << 2,
         Save = 1 << 3,
         OptionPanelForSaving = 1 << 4,
+        Preload = 1 << 5
     };
     enum InterfaceLevel { Standard, Conversion, Internal };
     enum InvocationType { Direct, Dialog, DragAndDrop };
@@ -80,6 +81,17 @@ public:
 
     // Save API
     bool saveItem(Item* item, const std::string& filename, const Mapping* options = nullptr);
+
+    // Preload API
+    /**
+       The preloadFile function reads the file into an intermediate data object that does not
+       depend on any item or GUI object. The function is thread-safe and it can be executed in
+       a worker thread before the item is loaded with the loadItem function in the main thread.
+       The data is kept until it is taken by the load function or clearPreloadedData is called.
+    */
+    bool preloadFile(const std::string& filename);
+    bool hasPreloadedData(const std::string& filename) const;
+    void clearPreloadedData();
     
     // Options API
     virtual void resetOptions();
@@ -141,6 +153,21 @@ protected:
 
     // Save API
     virtual bool save(Item* item, const std::string& filename);
+
+    // Preload API
+    /**
+       This function is called from the preloadFile function, which may be executed in a worker
+       thread. The implementation must not access any items, GUI objects and the message view.
+       Messages must be output to the given stream instead.
+    */
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os);
+
+    /**
+       This function returns the data preloaded for the file and removes it from the pending data.
+       The messages output in preloading are put to the message view when this function is called.
+       Nullptr is returned if the file has not been preloaded.
+    */
+    ReferencedPtr takePreloadedData(const std::string& filename);
     
     std::ostream& os();
     void putWarning(const std::string& message);
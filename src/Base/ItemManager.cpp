@@ -787,27 +787,10 @@ ItemFileIO* ItemManager::findFileIO(const std::type_info& type, const std::strin
 }
 
 
-ItemFileIO* ItemManager::Impl::findMatchedFileIO
-(const type_info& type, const string& filename, const string& format, int ioTypeFlag)
+static ItemFileIO* findMatchedFileIOOfClass
+(ClassInfo* classInfo, const string& filename, const string& format, int ioTypeFlag)
 {
     ItemFileIO* targetFileIO = nullptr;
-    
-    auto p = itemClassIdToInfoMap.find(itemClassRegistry->getClassId(type));
-    if(p == itemClassIdToInfoMap.end()){
-        if(filename.empty()){
-            messageView->putln(
-                fmt::format(_("There is no file I/O processor registered for the \"{0}\" type."), type.name()),
-                MessageView::Error);
-        } else {
-            messageView->putln(
-                fmt::format(_("\"{0}\" cannot be accessed because there is no file I/O processor registered for the \"{1}\" type."),
-                            filename, type.name()),
-                MessageView::Error);
-        }
-        return targetFileIO;;
-    }
-    
-    ClassInfoPtr& classInfo = p->second;
     auto& fileIOs = classInfo->fileIOs;
 
     if(!format.empty() || filename.empty()){
@@ -840,6 +823,63 @@ ItemFileIO* ItemManager::Impl::findMatchedFileIO
         }
     }
 
+    return targetFileIO;
+}
+
+
+ItemFileIO* ItemManager::findFileIOForLoading
+(const std::string& moduleName, const std::string& className,
+ const std::string& filename, const std::string& format)
+{
+    auto p = moduleNameToItemManagerImplMap.find(moduleName);
+    if(p == moduleNameToItemManagerImplMap.end()){
+        if(auto alias = PluginManager::instance()->guessActualPluginName(moduleName)){
+            p = moduleNameToItemManagerImplMap.find(alias);
+        }
+    }
+    if(p != moduleNameToItemManagerImplMap.end()){
+        auto& itemClassNameToInfoMap = p->second->itemClassNameToInfoMap;
+        auto q = itemClassNameToInfoMap.find(className);
+        if(q != itemClassNameToInfoMap.end()){
+            return findMatchedFileIOOfClass(q->second, filename, format, ItemFileIO::Load);
+        }
+    }
+    auto r = aliasClassNameToAliasModuleNameToTrueNamePairMap.find(className);
+    if(r != aliasClassNameToAliasModuleNameToTrueNamePairMap.end()){
+        auto& aliasModuleNameToTrueNamePairMap = r->second;
+        auto s = aliasModuleNameToTrueNamePairMap.find(moduleName);
+        if(s != aliasModuleNameToTrueNamePairMap.end()){
+            auto& trueNamePair = s->second;
+            return findFileIOForLoading(trueNamePair.first, trueNamePair.second, filename, format);
+        }
+    }
+    return nullptr;
+}
+
+
+ItemFileIO* ItemManager::Impl::findMatchedFileIO
+(const type_info& type, const string& filename, const string& format, int ioTypeFlag)
+{
+    ItemFileIO* targetFileIO = nullptr;
+    
+    auto p = itemClassIdToInfoMap.find(itemClassRegistry->getClassId(type));
+    if(p == itemClassIdToInfoMap.end()){
+        if(filename.empty()){
+            messageView->putln(
+                fmt::format(_("There is no file I/O processor registered for the \"{0}\" type."), type.name()),
+                MessageView::Error);
+        } else {
+            messageView->putln(
+                fmt::format(_("\"{0}\" cannot be accessed because there is no file I/O processor registered for the \"{1}\" type."),
+                            filename, type.name()),
+                MessageView::Error);
+        }
+        return targetFileIO;;
+    }
+    
+    ClassInfoPtr& classInfo = p->second;
+    targetFileIO = findMatchedFileIOOfClass(classInfo, filename, format, ioTypeFlag);
+
     if(!targetFileIO){
         if(format.empty()){
             messageView->putln(
@@ -865,6 +905,8 @@ class FileFunctionAdapter : public ItemFileIO
 {
 public:
     std::shared_ptr<ItemManager::FileFunctionBase> fileFunction;
+    ItemManager::PreloadFunction preloadFunction;
+    std::shared_ptr<ItemManager::PreloadedDataFunctionBase> preloadedDataFunction;
     function<Item*()> factory;
     
     FileFunctionAdapter(
@@ -902,8 +944,27 @@ public:
         return nullptr;
     }
 
+    void setPreloadFunctions(
+        ItemManager::PreloadFunction preloadFunction_,
+        std::shared_ptr<ItemManager::PreloadedDataFunctionBase> preloadedDataFunction_)
+    {
+        setApi(api() | Preload);
+        preloadFunction = preloadFunction_;
+        preloadedDataFunction = preloadedDataFunction_;
+    }
+
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override
+    {
+        return preloadFunction ? preloadFunction(filename, os) : nullptr;
+    }
+
     virtual bool load(Item* item, const std::string& filename) override
     {
+        if(preloadedDataFunction){
+            if(auto data = takePreloadedData(filename)){
+                return (*preloadedDataFunction)(item, data, os());
+            }
+        }
         return (*fileFunction)(item, filename, os(), parentItem());
     };
 
@@ -918,10 +979,14 @@ public:
 
 void ItemManager::addLoader_
 (const std::type_info& type, const std::string& caption, const std::string& format,
- const std::string& extensions, std::shared_ptr<FileFunctionBase> function, int usage)
+ const std::string& extensions, std::shared_ptr<FileFunctionBase> function, int usage,
+ PreloadFunction preloadFunction, std::shared_ptr<PreloadedDataFunctionBase> preloadedDataFunction)
 {
     auto adapter = new FileFunctionAdapter(
         ItemFileIO::Load, caption, format, extensions, function, usage);
+    if(preloadFunction && preloadedDataFunction){
+        adapter->setPreloadFunctions(preloadFunction, preloadedDataFunction);
+    }
     auto classInfo = impl->registerFileIO(type, adapter);
     adapter->factory = classInfo->factory;
 }
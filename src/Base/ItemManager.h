@@ -7,6 +7,7 @@
 
 #include "ExtensionManager.h"
 #include "ItemList.h"
+#include <cnoid/Referenced>
 #include <QWidget>
 #include <string>
 #include <typeinfo>
@@ -112,6 +113,27 @@ public:
         Function function;
     };
 
+    typedef std::function<ReferencedPtr(const std::string& filename, std::ostream& os)> PreloadFunction;
+
+    class PreloadedDataFunctionBase
+    {
+    public:
+        virtual ~PreloadedDataFunctionBase() { }
+        virtual bool operator()(Item* item, Referenced* data, std::ostream& os) = 0;
+    };
+
+    template <class ItemType> class PreloadedDataFunction : public PreloadedDataFunctionBase
+    {
+    public:
+        typedef std::function<bool(ItemType* item, Referenced* data, std::ostream& os)> Function;
+        PreloadedDataFunction(Function function) : function(function) { }
+        virtual bool operator()(Item* item, Referenced* data, std::ostream& os){
+            return function(static_cast<ItemType*>(item), data, os);
+        }
+    private:
+        Function function;
+    };
+
     template <class ItemType, class SuperItemType = Item>
     ItemManager& registerClass(const std::string& className) {
         registerClass_(className, typeid(ItemType), typeid(SuperItemType), Factory<ItemType>(), nullptr);
@@ -170,6 +192,15 @@ public:
         const Item* item, std::function<bool(ItemFileIO* fileIO)> pred, bool includeSuperClassIos = false);
     static ItemFileIO* findFileIO(const std::type_info& type, const std::string& format);
 
+    /**
+       This function returns the file IO that is used to load the file into an item of the
+       class specified by the module name and the class name without creating an item instance.
+       Nullptr is returned if the file IO cannot be determined.
+    */
+    static ItemFileIO* findFileIOForLoading(
+        const std::string& moduleName, const std::string& className,
+        const std::string& filename, const std::string& format);
+
     template <class ItemType>
     ItemManager& addLoader(
         const std::string& caption, const std::string& format, const std::string& extensions, 
@@ -180,6 +211,26 @@ public:
         return *this;
     }
 
+    /**
+       The loader added by this function supports the preload API of ItemFileIO.
+       The preload function reads the file into a data object in a worker thread, so it must be
+       thread-safe and must not access any items or GUI objects. The preloaded data function
+       applies the data to the item in the main thread instead of the loader function.
+    */
+    template <class ItemType>
+    ItemManager& addLoader(
+        const std::string& caption, const std::string& format, const std::string& extensions, 
+        typename FileFunction<ItemType>::Function function,
+        PreloadFunction preloadFunction,
+        typename PreloadedDataFunction<ItemType>::Function preloadedDataFunction,
+        int usage = Standard)
+    {
+        addLoader_(typeid(ItemType), caption, format, extensions,
+                   std::make_shared<FileFunction<ItemType>>(function), usage,
+                   preloadFunction, std::make_shared<PreloadedDataFunction<ItemType>>(preloadedDataFunction));
+        return *this;
+    }
+
     template<class ItemType>
     ItemManager& addSaver(
         const std::string& caption, const std::string& format, const std::string& extensions,
@@ -259,7 +310,9 @@ private:
 
     void addLoader_(
         const std::type_info& type, const std::string& caption, const std::string& format,
-        const std::string& extensions, std::shared_ptr<FileFunctionBase> function, int usage);
+        const std::string& extensions, std::shared_ptr<FileFunctionBase> function, int usage,
+        PreloadFunction preloadFunction = nullptr,
+        std::shared_ptr<PreloadedDataFunctionBase> preloadedDataFunction = nullptr);
     void addSaver_(
         const std::type_info& type, const std::string& caption, const std::string& format,
         const std::string& extensions, std::shared_ptr<FileFunctionBase> function, int usage);
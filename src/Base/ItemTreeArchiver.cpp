@@ -5,10 +5,17 @@
 #include "ItemManager.h"
 #include "MessageView.h"
 #include "Archive.h"
+#include "ItemFileIO.h"
 #include <cnoid/YAMLReader>
 #include <cnoid/YAMLWriter>
+#include <cnoid/FilePathVariableProcessor>
+#include <cnoid/ThreadPool>
 #include <list>
 #include <set>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
 #include <fmt/format.h>
 #include "gettext.h"
 
@@ -27,6 +34,14 @@ public:
     int numRestoredItems;
     const std::set<std::string>* pOptionalPlugins;
     bool isTemporaryItemSaveEnabled;
+    bool isParallelPreloadEnabled;
+
+    struct PreloadTask
+    {
+        ItemFileIOPtr fileIO;
+        string filename;
+    };
+    vector<PreloadTask> preloadTasks;
 
     Impl();
     ArchivePtr store(Archive& parentArchive, Item* item);
@@ -36,6 +51,9 @@ public:
     bool checkSubTreeTemporality(Item* item);
     void storeAddons(Archive& archive, Item* item);
     ItemList<> restore(Archive& archive, Item* parentItem, const std::set<std::string>& optionalPlugins);
+    void collectPreloadTasksIter(Archive& archive, set<pair<ItemFileIO*, string>>& collected);
+    void preloadFiles();
+    void clearPreloadedData();
     void restoreItemIter(Archive& archive, Item* parentItem, ItemList<>& io_topLevelItems, int level);
     ItemPtr restoreItem(
         Archive& archive, Item* parentItem, string& itemName, string& classame,
@@ -74,6 +92,7 @@ void ItemTreeArchiver::reset()
     impl->numRestoredItems = 0;
     impl->pOptionalPlugins = nullptr;
     impl->isTemporaryItemSaveEnabled = false;
+    impl->isParallelPreloadEnabled = true;
 }
 
 
@@ -89,6 +108,18 @@ bool ItemTreeArchiver::isTemporaryItemSaveEnabled() const
 }
 
 
+void ItemTreeArchiver::setParallelPreloadEnabled(bool on)
+{
+    impl->isParallelPreloadEnabled = on;
+}
+
+
+bool ItemTreeArchiver::isParallelPreloadEnabled() const
+{
+    return impl->isParallelPreloadEnabled;
+}
+
+
 int ItemTreeArchiver::numArchivedItems() const
 {
     return impl->numArchivedItems;
@@ -312,17 +343,142 @@ ItemList<> ItemTreeArchiver::Impl::restore
     ItemList<> topLevelItems;
 
     archive.setCurrentParentItem(nullptr);
+    if(isParallelPreloadEnabled){
+        set<pair<ItemFileIO*, string>> collected;
+        try {
+            collectPreloadTasksIter(archive, collected);
+        } catch (const ValueNode::Exception&){
+            // The error is reported when the broken archive is restored
+        }
+        preloadFiles();
+    }
     try {
         restoreItemIter(archive, parentItem, topLevelItems, 0);
     } catch (const ValueNode::Exception& ex){
         mv->putln(ex.message(), MessageView::Error);
     }
+    clearPreloadedData();
     archive.setCurrentParentItem(nullptr);
 
     return topLevelItems;
 }
 
 
+/**
+   The file paths are resolved in the main thread in the same way as Archive::loadFileTo and
+   ItemFileIO::loadItem so that the preloaded data can be found with the path given to the
+   load function of the file IO.
+*/
+void ItemTreeArchiver::Impl::collectPreloadTasksIter
+(Archive& archive, set<pair<ItemFileIO*, string>>& collected)
+{
+    string pluginName, className;
+    if(!archive.get({ "is_sub_item", "isSubItem" }, false) &&
+       archive.read("plugin", pluginName) && archive.read("class", className)){
+
+        auto dataNode = archive.find("data");
+        if(dataNode->isValid() && dataNode->isMapping()){
+            Archive* dataArchive = static_cast<Archive*>(dataNode->toMapping());
+            dataArchive->inheritSharedInfoFrom(archive);
+            string file;
+            if(dataArchive->read({ "file", "filename" }, file)){
+                file = dataArchive->resolveRelocatablePath(file);
+                if(!file.empty()){
+                    file = FilePathVariableProcessor::currentInstance()->expand(file, true);
+                }
+                if(!file.empty()){
+                    string format;
+                    dataArchive->read("format", format);
+                    auto fileIO = ItemManager::findFileIOForLoading(pluginName, className, file, format);
+                    if(fileIO && fileIO->hasApi(ItemFileIO::Preload)){
+                        if(collected.insert(make_pair(fileIO, file)).second){
+                            preloadTasks.push_back({ fileIO, file });
+                        }
+                    }
+                }
+            }
+        }
+    }
+
+    ListingPtr children = archive.findListing("children");
+    if(children->isValid()){
+        for(int i=0; i < children->size(); ++i){
+            if(auto childArchive = dynamic_cast<Archive*>(children->at(i)->toMapping())){
+                childArchive->inheritSharedInfoFrom(archive);
+                collectPreloadTasksIter(*childArchive, collected);
+            }
+        }
+    }
+}
+
+
+void ItemTreeArchiver::Impl::preloadFiles()
+{
+    // Preloading a single file in a worker thread does not reduce the loading time
+    if(preloadTasks.size() < 2){
+        preloadTasks.clear();
+        return;
+    }
+    int numThreads = std::min(
+        static_cast<int>(preloadTasks.size()),
+        std::max(1, static_cast<int>(std::thread::hardware_concurrency())));
+
+    mv->putln(format(_("Preloading {0} files with {1} threads ..."), preloadTasks.size(), numThreads));
+    mv->flush();
+
+    /*
+      The progress is put to the message view in the main thread when each file has been
+      preloaded because the message view cannot be accessed from the worker threads.
+    */
+    mutex finishMutex;
+    condition_variable finishCondition;
+    vector<int> finishedTaskIndices;
+
+    ThreadPool threadPool(numThreads);
+    const int numTasks = preloadTasks.size();
+    for(int i=0; i < numTasks; ++i){
+        auto fileIO = preloadTasks[i].fileIO.get();
+        auto& filename = preloadTasks[i].filename;
+        threadPool.start(
+            [fileIO, &filename, i, &finishMutex, &finishCondition, &finishedTaskIndices](){
+                fileIO->preloadFile(filename);
+                {
+                    lock_guard<mutex> lock(finishMutex);
+                    finishedTaskIndices.push_back(i);
+                }
+                finishCondition.notify_one();
+            });
+    }
+
+    int numFinishedTasks = 0;
+    vector<int> indices;
+    while(numFinishedTasks < numTasks){
+        {
+            unique_lock<mutex> lock(finishMutex);
+            finishCondition.wait(lock, [&finishedTaskIndices](){ return !finishedTaskIndices.empty(); });
+            indices.swap(finishedTaskIndices);
+        }
+        for(auto& index : indices){
+            ++numFinishedTasks;
+            mv->putln(format(_(" ({0}/{1}) {2}"), numFinishedTasks, numTasks, preloadTasks[index].filename));
+        }
+        indices.clear();
+        mv->flush();
+    }
+    threadPool.wait();
+}
+
+
+void ItemTreeArchiver::Impl::clearPreloadedData()
+{
+    // Release the data that have not been taken by the file IOs
+    for(auto& task : preloadTasks){
+        task.fileIO->clearPreloadedData();
+    }
+    preloadTasks.clear();
+}
+
+
 void ItemTreeArchiver::Impl::restoreItemIter
 (Archive& archive, Item* parentItem, ItemList<>& io_topLevelItems, int level)
 {
@@ -18,6 +18,13 @@ public:
     void reset();
     void setTemporaryItemSaveEnabled(bool on);
     bool isTemporaryItemSaveEnabled() const;
+
+    /**
+       When this is enabled, the files of the items that support the preload API of ItemFileIO
+       are read in parallel by worker threads before the item tree is restored in order.
+    */
+    void setParallelPreloadEnabled(bool on);
+    bool isParallelPreloadEnabled() const;
     ArchivePtr store(Archive* parentArchive, Item* topItem);
 
     /**
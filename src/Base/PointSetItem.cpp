@@ -119,6 +119,39 @@ static bool loadPCD(PointSetItem* item, const std::string& filename, std::ostrea
 }
 
 
+/**
+   This function reads the file into a new point set without accessing the item
+   because it is executed in a worker thread.
+*/
+static ReferencedPtr preloadPCD(const std::string& filename, std::ostream& os)
+{
+    try {
+        SgPointSetPtr pointSet = new SgPointSet;
+        cnoid::loadPCD(pointSet, filename);
+        return pointSet;
+    } catch (boost::exception& ex) {
+        if(std::string const * message = boost::get_error_info<error_info_message>(ex)){
+            os << *message;
+        }
+    }
+    return nullptr;
+}
+
+
+static bool loadPreloadedPCD(PointSetItem* item, SgPointSet* preloaded, std::ostream& os)
+{
+    auto pointSet = item->pointSet();
+    pointSet->setVertices(preloaded->vertices());
+    pointSet->setNormals(preloaded->normals());
+    pointSet->normalIndices().clear();
+    pointSet->setColors(preloaded->colors());
+    pointSet->colorIndices().clear();
+    os << pointSet->vertices()->size() << " points have been loaded.";
+    pointSet->notifyUpdate();
+    return true;
+}
+
+
 static bool saveAsPCD(PointSetItem* item, const std::string& filename, std::ostream& os)
 {
     try {
@@ -140,10 +173,17 @@ void PointSetItem::initializeClass(ExtensionManager* ext)
         ItemManager& im = ext->itemManager();
         im.registerClass<PointSetItem>(N_("PointSetItem"));
         im.addCreationPanel<PointSetItem>();
-        im.addLoaderAndSaver<PointSetItem>(
+        im.addLoader<PointSetItem>(
             _("Point Cloud (PCD)"), "PCD-FILE", "pcd",
             [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
                 return ::loadPCD(item, filename, os); },
+            [](const std::string& filename, std::ostream& os){
+                return ::preloadPCD(filename, os); },
+            [](PointSetItem* item, Referenced* data, std::ostream& os){
+                return ::loadPreloadedPCD(item, static_cast<SgPointSet*>(data), os); },
+            ItemManager::PRIORITY_CONVERSION);
+        im.addSaver<PointSetItem>(
+            _("Point Cloud (PCD)"), "PCD-FILE", "pcd",
             [](PointSetItem* item, const std::string& filename, std::ostream& os, Item*){
                 return ::saveAsPCD(item, filename, os); },
             ItemManager::PRIORITY_CONVERSION);
@@ -20,10 +20,16 @@ public:
     int numVertices;
     int numNormals;
     int numTriangles;
+    int numGroups;
+    int maxNumGroupChildren;
 
     SceneCounter() {
         setFunction<SgGroup>(
             [&](SgGroup* group){
+                ++numGroups;
+                if(group->numChildren() > maxNumGroupChildren){
+                    maxNumGroupChildren = group->numChildren();
+                }
                 for(auto child : *group){
                     dispatch(child);
                 }
@@ -57,6 +63,8 @@ public:
         numVertices = 0;
         numNormals = 0;
         numTriangles = 0;
+        numGroups = 0;
+        maxNumGroupChildren = 0;
         dispatch(node);
     }
 };
@@ -82,7 +90,9 @@ void cnoid::putRenderableItemSceneStatistics()
                 counter.count(scene);
                 os << format(_("  Vertices: {}\n"), counter.numVertices);
                 os << format(_("  Normals: {}\n"), counter.numNormals);
-                os << format(_("  Triangles: {}"), counter.numTriangles) << endl;
+                os << format(_("  Triangles: {}\n"), counter.numTriangles);
+                os << format(_("  Groups: {} (max {} children)"),
+                             counter.numGroups, counter.maxNumGroupChildren) << endl;
                 totalNumVertics += counter.numVertices;
                 totalNumNormals += counter.numNormals;
                 totalNumTriangles += counter.numTriangles;
@@ -99,4 +109,10 @@ void cnoid::putRenderableItemSceneStatistics()
         os << format(_(" Normals: {}\n"), totalNumNormals);
         os << format(_(" Triangles: {}"), totalNumTriangles) << endl;
     }
+
+    auto bboxStatistics = SgGroup::boundingBoxStatistics();
+    os << _("Bounding box updates of the groups:\n");
+    os << format(_(" Full updates: {}\n"), bboxStatistics.numFullUpdates);
+    os << format(_(" Incremental updates: {}\n"), bboxStatistics.numIncrementalUpdates);
+    os << format(_(" Visited children: {}"), bboxStatistics.numVisitedChildren) << endl;
 }
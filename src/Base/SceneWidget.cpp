@@ -150,6 +150,7 @@ public:
     bool isCameraRollRistricted;
     int verticalAxis;
     Timer timerToRenderNormallyAfterInteractiveCameraPositionChange;
+    Timer timerToContinueMeshPreparation;
 
     Signal<void()> sigStateChanged;
     LazyCaller emitSigStateChangedLater;
@@ -474,6 +475,7 @@ SceneWidget::Impl::Impl(SceneWidget* self)
         
     renderer->setOutputStream(MessageView::instance()->cout(false));
     renderer->enableUnusedResourceCheck(true);
+    renderer->setBackgroundMeshPreparationEnabled(true);
     renderer->sigCurrentCameraChanged().connect([&](){ onCurrentCameraChanged(); });
     renderer->setCurrentCameraAutoRestorationMode(true);
     self->sigObjectNameChanged().connect([this](string name){ renderer->setName(name); });
@@ -550,6 +552,11 @@ SceneWidget::Impl::Impl(SceneWidget* self)
     timerToRenderNormallyAfterInteractiveCameraPositionChange.sigTimeout().connect(
         [&](){ tryToResumeNormalRendering(); });
 
+    // The rendering is repeated until the meshes prepared in the background are uploaded
+    timerToContinueMeshPreparation.setSingleShot(true);
+    timerToContinueMeshPreparation.setInterval(10);
+    timerToContinueMeshPreparation.sigTimeout().connect([&](){ update(); });
+
     collisionLineVisibility = false;
 
     coordinateAxesOverlay = new CoordinateAxesOverlay;
@@ -907,6 +914,10 @@ void SceneWidget::Impl::paintGL()
     renderer->render();
     isRendering = false;
 
+    if(renderer->hasPendingMeshPreparation() && !timerToContinueMeshPreparation.isActive()){
+        timerToContinueMeshPreparation.start();
+    }
+
     if(fpsTimer.isActive()){
         renderFps();
     }
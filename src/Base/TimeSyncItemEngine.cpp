@@ -6,6 +6,7 @@
 #include "ExtensionManager.h"
 #include "LazyCaller.h"
 #include <cnoid/ConnectionSet>
+#include <cnoid/SceneGraph>
 #include <memory>
 #include <unordered_map>
 #include <map>
@@ -323,6 +324,7 @@ int TimeSyncItemEngineManager::Impl::createEngines(Item* item, std::vector<TimeS
 void TimeSyncItemEngineManager::Impl::refreshActiveItems()
 {
     if(!isDoingPlayback){
+        SgUpdateBatch sgUpdateBatch;
         for(auto& info : activeItemInfos){
             for(auto& engine : info->activeEngines){
                 engine->onTimeChanged(currentTime);
@@ -371,6 +373,9 @@ bool TimeSyncItemEngineManager::Impl::onTimeChanged(double time)
     bool isActive = false;
     currentTime = time;
 
+    // The scene graph updates of all the engines are coalesced into one notification per node
+    SgUpdateBatch sgUpdateBatch;
+
     auto it1 = activeItemInfos.begin();
     while(it1 != activeItemInfos.end()){
         bool doErase = false;
@@ -38,6 +38,12 @@ void AbstractBodyLoader::setShapeLoadingEnabled(bool /* on */)
 }
 
 
+void AbstractBodyLoader::setLazyVisualShapeLoadingEnabled(bool /* on */)
+{
+
+}
+
+
 void AbstractBodyLoader::setDefaultDivisionNumber(int /* n */)
 {
 
@@ -23,6 +23,13 @@ public:
     virtual void setMessageSink(std::ostream& os);
     virtual void setVerbose(bool on);
     virtual void setShapeLoadingEnabled(bool on);
+
+    /**
+       When this is enabled, the loader may record the visual-only mesh resources as
+       placeholder nodes (SgDeferredGroup) that load the meshes when they are materialized.
+       Collision shapes are always loaded immediately.
+    */
+    virtual void setLazyVisualShapeLoadingEnabled(bool on);
     virtual void setDefaultDivisionNumber(int n);
     virtual void setDefaultCreaseAngle(double theta);
     virtual bool load(Body* body, const std::string& filename) = 0;
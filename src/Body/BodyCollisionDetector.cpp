@@ -267,6 +267,55 @@ void BodyCollisionDetector::detectCollisions
 }
 
 
+bool BodyCollisionDetector::isDistanceDetectionAvailable() const
+{
+    return dynamic_cast<CollisionDetectorDistanceAPI*>(impl->collisionDetector.get()) != nullptr;
+}
+
+
+bool BodyCollisionDetector::detectDistances(double maxDistance, DistanceCallback callback)
+{
+    if(auto api = dynamic_cast<CollisionDetectorDistanceAPI*>(impl->collisionDetector.get())){
+        return api->detectDistances(maxDistance, callback);
+    }
+    return false;
+}
+
+
+bool BodyCollisionDetector::detectDistances(Link* link, double maxDistance, DistanceCallback callback)
+{
+    if(auto api = dynamic_cast<CollisionDetectorDistanceAPI*>(impl->collisionDetector.get())){
+        if(auto handle = findGeometryHandle(link)){
+            return api->detectDistances(*handle, maxDistance, callback);
+        }
+        return true;
+    }
+    return false;
+}
+
+
+bool BodyCollisionDetector::isContinuousCollisionDetectionAvailable() const
+{
+    return !impl->hasCustomObjectsAssociatedWithLinks &&
+        dynamic_cast<CollisionDetectorContinuousDetectionAPI*>(impl->collisionDetector.get());
+}
+
+
+bool BodyCollisionDetector::detectContinuousCollisions
+(std::function<void(const CollisionPair& collisionPair, double time)> callback)
+{
+    if(!isContinuousCollisionDetectionAvailable()){
+        return false;
+    }
+    auto api = dynamic_cast<CollisionDetectorContinuousDetectionAPI*>(impl->collisionDetector.get());
+    api->detectContinuousCollisions(
+        [](Referenced* object, Isometry3*& out_position){
+            out_position = &(static_cast<Link*>(object)->position()); },
+        callback);
+    return true;
+}
+
+
 void BodyCollisionDetector::Impl::onBodyExistenceChanged(Body* body, bool on)
 {
     for(auto& link : body->links()){
@@ -58,6 +58,33 @@ public:
     //! \note Geometry handle map must be enabled to use this function
     void detectCollisions(Link* link, std::function<void(const CollisionPair& collisionPair)> callback);
 
+    typedef std::function<void(const CollisionPair& collisionPair, double distance,
+                               const Vector3& point1, const Vector3& point2)> DistanceCallback;
+
+    bool isDistanceDetectionAvailable() const;
+
+    /**
+       This function detects the distances of the link pairs closer than maxDistance at once.
+       The closest features found in the previous detection are reused to make the detection faster.
+       \return false if the collision detector does not support the distance detection.
+    */
+    bool detectDistances(double maxDistance, DistanceCallback callback);
+
+    //! \note Geometry handle map must be enabled to use this function
+    bool detectDistances(Link* link, double maxDistance, DistanceCallback callback);
+
+    bool isContinuousCollisionDetectionAvailable() const;
+
+    /**
+       This function detects the collisions of the links moving from the positions given by the
+       last position update to the current link positions. The contact time normalized to [0, 1]
+       is given to the callback. Call updatePositions after this function to make the current
+       positions the start positions of the next detection.
+       \return false if the collision detector does not support the continuous collision detection.
+    */
+    bool detectContinuousCollisions(
+        std::function<void(const CollisionPair& collisionPair, double time)> callback);
+
     [[deprecated("Use setGeometryHandleMapEnabled.")]]
     void enableGeometryHandleMap(bool on);
 
@@ -158,6 +158,7 @@ public:
     shared_ptr<SceneLoaderAdapter> loaderAdapter;
     bool isVerbose;
     bool isShapeLoadingEnabled;
+    bool isLazyVisualShapeLoadingEnabled;
     int defaultDivisionNumber;
     double defaultCreaseAngle;
     BodyLoader::LengthUnit lengthUnitHint;
@@ -183,6 +184,7 @@ BodyLoader::Impl::Impl()
     os = &nullout();
     isVerbose = false;
     isShapeLoadingEnabled = true;
+    isLazyVisualShapeLoadingEnabled = false;
     defaultDivisionNumber = -1;
     defaultCreaseAngle = -1.0;
 }
@@ -218,6 +220,12 @@ void BodyLoader::setShapeLoadingEnabled(bool on)
 }
     
 
+void BodyLoader::setLazyVisualShapeLoadingEnabled(bool on)
+{
+    impl->isLazyVisualShapeLoadingEnabled = on;
+}
+
+
 void BodyLoader::setDefaultDivisionNumber(int n)
 {
     impl->defaultDivisionNumber = n;
@@ -289,6 +297,7 @@ bool BodyLoader::Impl::load(Body* body, const std::string& filename)
     actualLoader->setMessageSink(*os);
     actualLoader->setVerbose(isVerbose);
     actualLoader->setShapeLoadingEnabled(isShapeLoadingEnabled);
+    actualLoader->setLazyVisualShapeLoadingEnabled(isLazyVisualShapeLoadingEnabled);
     actualLoader->setDefaultDivisionNumber(defaultDivisionNumber);
     actualLoader->setDefaultCreaseAngle(defaultCreaseAngle);
 
@@ -75,6 +75,20 @@ BodyMotion& BodyMotion::operator=(const BodyMotion& rhs)
 }
 
 
+BodyMotion& BodyMotion::operator=(BodyMotion&& rhs)
+{
+    if(this != &rhs){
+        AbstractSeq::operator=(rhs);
+        // The position sequence object itself is kept because it may be shared with other objects
+        *positionSeq_ = std::move(*rhs.positionSeq_);
+        extraSeqs = std::move(rhs.extraSeqs);
+        rhs.extraSeqs.clear();
+        sigExtraSeqsChanged_();
+    }
+    return *this;
+}
+
+
 std::shared_ptr<AbstractSeq> BodyMotion::cloneSeq() const
 {
     return std::make_shared<BodyMotion>(*this);
@@ -21,6 +21,8 @@ public:
 
     using AbstractSeq::operator=;
     BodyMotion& operator=(const BodyMotion& rhs);
+    //! The sequences of rhs are moved without copying the frames
+    BodyMotion& operator=(BodyMotion&& rhs);
     virtual std::shared_ptr<AbstractSeq> cloneSeq() const override;
 
     double frameRate() const { return positionSeq_->frameRate(); }
@@ -0,0 +1,219 @@
+#include "BodyMotionDynamicsEvaluator.h"
+#include "Body.h"
+#include "BodyMotion.h"
+#include "ZMPSeq.h"
+#include "InverseDynamics.h"
+#include <cnoid/EigenUtil>
+#include <cnoid/ThreadPool>
+#include <atomic>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int FrameChunkSize = 256;
+
+/*
+  The ZMP is not defined when the vertical force is less than this ratio to the weight,
+  and the projection of the center of mass is used instead.
+*/
+constexpr double MinVerticalForceRatio = 1.0e-3;
+
+}
+
+
+BodyMotionDynamicsEvaluator::BodyMotionDynamicsEvaluator()
+{
+    numThreads = 0;
+    isJointEffortOutputEnabled = true;
+    isZmpOutputEnabled = true;
+    zmpHeight = 0.0;
+    gravity << 0.0, 0.0, -9.8;
+}
+
+
+void BodyMotionDynamicsEvaluator::setNumThreads(int n)
+{
+    numThreads = std::max(0, n);
+}
+
+
+void BodyMotionDynamicsEvaluator::setJointEffortOutputEnabled(bool on)
+{
+    isJointEffortOutputEnabled = on;
+}
+
+
+void BodyMotionDynamicsEvaluator::setZmpOutputEnabled(bool on)
+{
+    isZmpOutputEnabled = on;
+}
+
+
+void BodyMotionDynamicsEvaluator::setZmpHeight(double height)
+{
+    zmpHeight = height;
+}
+
+
+void BodyMotionDynamicsEvaluator::setGravity(const Vector3& g)
+{
+    gravity = g;
+}
+
+
+bool BodyMotionDynamicsEvaluator::evaluate(Body* body, BodyMotion& motion)
+{
+    const int numFrames = motion.numFrames();
+    if(numFrames == 0 || (!isJointEffortOutputEnabled && !isZmpOutputEnabled)){
+        return false;
+    }
+    auto pseq = motion.positionSeq();
+    const double dt = motion.timeStep();
+    const int numJoints = body->numJoints();
+
+    shared_ptr<MultiValueSeq> effortSeq;
+    if(isJointEffortOutputEnabled){
+        effortSeq = motion.getOrCreateExtraSeq<MultiValueSeq>(BodyMotion::jointEffortContentName());
+        effortSeq->setFrameRate(motion.frameRate());
+        effortSeq->setOffsetTime(motion.offsetTime());
+        effortSeq->setDimension(numFrames, numJoints);
+    }
+    shared_ptr<ZMPSeq> zmpSeq;
+    if(isZmpOutputEnabled){
+        zmpSeq = getOrCreateZMPSeq(motion);
+        zmpSeq->setFrameRate(motion.frameRate());
+        zmpSeq->setOffsetTime(motion.offsetTime());
+        zmpSeq->setNumFrames(numFrames);
+        zmpSeq->setRootRelative(false);
+    }
+
+    const int numChunks = (numFrames + FrameChunkSize - 1) / FrameChunkSize;
+    int n = (numThreads > 0) ? numThreads : static_cast<int>(std::thread::hardware_concurrency());
+    n = std::max(1, std::min(numChunks, n));
+
+    vector<BodyPtr> workerBodies(n);
+    for(int i=0; i < n; ++i){
+        workerBodies[i] = body->clone();
+        workerBodies[i]->clearExternalForces();
+    }
+
+    std::atomic<int> nextChunkIndex(0);
+    ThreadPool threadPool(n);
+
+    for(int i=0; i < n; ++i){
+        Body* workerBody = workerBodies[i];
+
+        threadPool.start([&, workerBody](){
+            Link* rootLink = workerBody->rootLink();
+            const double mass = workerBody->mass();
+            const double minVerticalForce = MinVerticalForceRatio * mass * gravity.norm();
+
+            while(true){
+                const int chunkIndex = nextChunkIndex++;
+                if(chunkIndex >= numChunks){
+                    break;
+                }
+                const int beginningFrame = chunkIndex * FrameChunkSize;
+                const int endingFrame = std::min(beginningFrame + FrameChunkSize, numFrames);
+
+                for(int frame = beginningFrame; frame < endingFrame; ++frame){
+                    /*
+                      The velocities are given by the differences between the previous and next frames,
+                      and the accelerations at the first and last frames are the values of the adjacent frames.
+                    */
+                    const int prev = std::max(frame - 1, 0);
+                    const int next = std::min(frame + 1, numFrames - 1);
+                    const double vdt = (next - prev) * dt;
+                    const bool isAccelerationValid = (numFrames >= 3);
+                    const int center = isAccelerationValid ? std::max(1, std::min(frame, numFrames - 2)) : frame;
+
+                    pseq->frame(frame) >> *workerBody;
+
+                    auto block0 = pseq->frame(prev).firstBlock();
+                    auto block2 = pseq->frame(next).firstBlock();
+                    auto center0 = isAccelerationValid ? pseq->frame(center - 1).firstBlock() : block0;
+                    auto center1 = pseq->frame(center).firstBlock();
+                    auto center2 = isAccelerationValid ? pseq->frame(center + 1).firstBlock() : block2;
+
+                    int nj = std::min(numJoints, block0.numJointDisplacements());
+                    nj = std::min(nj, block2.numJointDisplacements());
+                    if(isAccelerationValid){
+                        nj = std::min(nj, center0.numJointDisplacements());
+                        nj = std::min(nj, center1.numJointDisplacements());
+                        nj = std::min(nj, center2.numJointDisplacements());
+                    }
+                    for(int j=0; j < numJoints; ++j){
+                        Link* joint = workerBody->joint(j);
+                        if(j < nj && vdt > 0.0){
+                            joint->dq() = (block2.jointDisplacement(j) - block0.jointDisplacement(j)) / vdt;
+                        } else {
+                            joint->dq() = 0.0;
+                        }
+                        if(j < nj && isAccelerationValid){
+                            joint->ddq() =
+                                (center2.jointDisplacement(j) - 2.0 * center1.jointDisplacement(j) +
+                                 center0.jointDisplacement(j)) / (dt * dt);
+                        } else {
+                            joint->ddq() = 0.0;
+                        }
+                    }
+
+                    rootLink->v().setZero();
+                    rootLink->w().setZero();
+                    rootLink->dv().setZero();
+                    rootLink->dw().setZero();
+                    if(block0.numLinkPositions() > 0 && block2.numLinkPositions() > 0 && vdt > 0.0){
+                        const Isometry3 T0 = block0.linkPosition(0).T();
+                        const Isometry3 T2 = block2.linkPosition(0).T();
+                        rootLink->v() = (T2.translation() - T0.translation()) / vdt;
+                        rootLink->w() = omegaFromRot(T2.linear() * T0.linear().transpose()) / vdt;
+                    }
+                    if(isAccelerationValid && center0.numLinkPositions() > 0 &&
+                       center1.numLinkPositions() > 0 && center2.numLinkPositions() > 0){
+                        const Isometry3 T0 = center0.linkPosition(0).T();
+                        const Isometry3 T1 = center1.linkPosition(0).T();
+                        const Isometry3 T2 = center2.linkPosition(0).T();
+                        rootLink->dv() = (T2.translation() - 2.0 * T1.translation() + T0.translation()) / (dt * dt);
+                        const Vector3 w0 = omegaFromRot(T1.linear() * T0.linear().transpose()) / dt;
+                        const Vector3 w1 = omegaFromRot(T2.linear() * T1.linear().transpose()) / dt;
+                        rootLink->dw() = (w1 - w0) / dt;
+                    }
+
+                    // The gravity is given as the acceleration of the root link in the opposite direction
+                    rootLink->dv() -= gravity;
+
+                    workerBody->calcForwardKinematics(true, true);
+                    const Vector6 f = calcInverseDynamics(rootLink);
+
+                    if(effortSeq){
+                        for(int j=0; j < numJoints; ++j){
+                            effortSeq->at(frame, j) = workerBody->joint(j)->u();
+                        }
+                    }
+                    if(zmpSeq){
+                        // f is the force and the moment around the origin that the floor must give
+                        const Vector3 force = f.head<3>();
+                        const Vector3 moment = f.tail<3>();
+                        Vector3& zmp = zmpSeq->at(frame);
+                        if(force.z() > minVerticalForce){
+                            zmp.x() = (zmpHeight * force.x() - moment.y()) / force.z();
+                            zmp.y() = (zmpHeight * force.y() + moment.x()) / force.z();
+                        } else {
+                            const Vector3& c = workerBody->calcCenterOfMass();
+                            zmp.x() = c.x();
+                            zmp.y() = c.y();
+                        }
+                        zmp.z() = zmpHeight;
+                    }
+                }
+            }
+        });
+    }
+
+    threadPool.wait();
+
+    return true;
+}
@@ -0,0 +1,49 @@
+#ifndef CNOID_BODY_BODY_MOTION_DYNAMICS_EVALUATOR_H
+#define CNOID_BODY_BODY_MOTION_DYNAMICS_EVALUATOR_H
+
+#include <cnoid/EigenTypes>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class BodyMotion;
+
+/**
+   This class calculates the joint torques and the ZMP required to realize a body motion
+   by the inverse dynamics of all the frames, and writes them to the joint effort sequence
+   and the ZMP sequence of the motion. The velocities and accelerations of the root link and
+   the joints are obtained by the central differences of the positions.
+
+   The frames are divided into chunks, which are evaluated in parallel by worker threads
+   with the clones of the body, so the given body is not modified.
+*/
+class CNOID_EXPORT BodyMotionDynamicsEvaluator
+{
+public:
+    BodyMotionDynamicsEvaluator();
+
+    //! Zero means the number of the hardware threads.
+    void setNumThreads(int n);
+    void setJointEffortOutputEnabled(bool on);
+    void setZmpOutputEnabled(bool on);
+
+    //! The ZMP is calculated on the horizontal plane at this height.
+    void setZmpHeight(double height);
+
+    //! The default value is (0, 0, -9.8).
+    void setGravity(const Vector3& g);
+
+    bool evaluate(Body* body, BodyMotion& motion);
+
+private:
+    int numThreads;
+    bool isJointEffortOutputEnabled;
+    bool isZmpOutputEnabled;
+    double zmpHeight;
+    Vector3 gravity;
+};
+
+}
+
+#endif
@@ -0,0 +1,226 @@
+#include "BodyPositionPrefetcher.h"
+#include "Body.h"
+#include "BodyPositionSeq.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <map>
+#include <deque>
+#include <vector>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace cnoid {
+
+class BodyPositionPrefetcher::Impl
+{
+public:
+    BodyPtr body;
+
+    struct Entry
+    {
+        vector<double> blockData;
+        vector<Isometry3, Eigen::aligned_allocator<Isometry3>> positions;
+        // This is used to check if the entry has been replaced while the positions are being calculated
+        int stamp;
+        bool isReady;
+    };
+    map<int, Entry> entries;
+    deque<int> pendingFrames;
+    int maxNumCachedFrames;
+    int stampCounter;
+
+    thread worker;
+    mutex entryMutex;
+    condition_variable requestCondition;
+    bool isWorkerRunning;
+    bool isStopRequested;
+
+    Impl(Body* body);
+    ~Impl();
+    void request(int frameIndex, const BodyPositionSeqFrameBlock& block);
+    bool fetch(int frameIndex, const BodyPositionSeqFrameBlock& block, Body* body);
+    void run();
+    void calcLinkPositions(const vector<double>& blockData);
+};
+
+}
+
+
+BodyPositionPrefetcher::BodyPositionPrefetcher(Body* body)
+{
+    impl = new Impl(body);
+}
+
+
+BodyPositionPrefetcher::Impl::Impl(Body* body)
+    : body(body->clone())
+{
+    maxNumCachedFrames = 1000;
+    stampCounter = 0;
+    isWorkerRunning = false;
+    isStopRequested = false;
+}
+
+
+BodyPositionPrefetcher::~BodyPositionPrefetcher()
+{
+    delete impl;
+}
+
+
+BodyPositionPrefetcher::Impl::~Impl()
+{
+    if(isWorkerRunning){
+        {
+            lock_guard<mutex> lock(entryMutex);
+            isStopRequested = true;
+        }
+        requestCondition.notify_all();
+        worker.join();
+    }
+}
+
+
+void BodyPositionPrefetcher::setMaxNumCachedFrames(int n)
+{
+    lock_guard<mutex> lock(impl->entryMutex);
+    impl->maxNumCachedFrames = std::max(1, n);
+}
+
+
+void BodyPositionPrefetcher::request(int frameIndex, const BodyPositionSeqFrameBlock& block)
+{
+    impl->request(frameIndex, block);
+}
+
+
+void BodyPositionPrefetcher::Impl::request(int frameIndex, const BodyPositionSeqFrameBlock& block)
+{
+    if(block.numLinkPositions() == 0){
+        return;
+    }
+    const double* data = block.blockData();
+    const int size = block.blockDataSize();
+    {
+        lock_guard<mutex> lock(entryMutex);
+
+        auto& entry = entries[frameIndex];
+        if(entry.blockData.size() == static_cast<size_t>(size) &&
+           std::equal(data, data + size, entry.blockData.begin())){
+            return;
+        }
+        entry.blockData.assign(data, data + size);
+        entry.stamp = ++stampCounter;
+        entry.isReady = false;
+        pendingFrames.push_back(frameIndex);
+
+        while(entries.size() > static_cast<size_t>(maxNumCachedFrames)){
+            entries.erase(entries.begin());
+        }
+        if(!isWorkerRunning){
+            worker = thread([this](){ run(); });
+            isWorkerRunning = true;
+        }
+    }
+    requestCondition.notify_one();
+}
+
+
+bool BodyPositionPrefetcher::fetch(int frameIndex, const BodyPositionSeqFrameBlock& block, Body* body)
+{
+    return impl->fetch(frameIndex, block, body);
+}
+
+
+bool BodyPositionPrefetcher::Impl::fetch(int frameIndex, const BodyPositionSeqFrameBlock& block, Body* body)
+{
+    lock_guard<mutex> lock(entryMutex);
+
+    entries.erase(entries.begin(), entries.lower_bound(frameIndex));
+
+    auto p = entries.find(frameIndex);
+    if(p == entries.end()){
+        return false;
+    }
+    auto& entry = p->second;
+    const double* data = block.blockData();
+    const int size = block.blockDataSize();
+    if(!entry.isReady || entry.blockData.size() != static_cast<size_t>(size) ||
+       !std::equal(data, data + size, entry.blockData.begin())){
+        return false;
+    }
+    const int n = std::min(body->numLinks(), static_cast<int>(entry.positions.size()));
+    for(int i=0; i < n; ++i){
+        body->link(i)->setPosition(entry.positions[i]);
+    }
+    return true;
+}
+
+
+void BodyPositionPrefetcher::clear()
+{
+    lock_guard<mutex> lock(impl->entryMutex);
+    impl->entries.clear();
+    impl->pendingFrames.clear();
+}
+
+
+void BodyPositionPrefetcher::Impl::run()
+{
+    vector<double> blockData;
+
+    unique_lock<mutex> lock(entryMutex);
+
+    while(true){
+        requestCondition.wait(lock, [this](){ return isStopRequested || !pendingFrames.empty(); });
+        if(isStopRequested){
+            break;
+        }
+        const int frameIndex = pendingFrames.front();
+        pendingFrames.pop_front();
+
+        auto p = entries.find(frameIndex);
+        if(p == entries.end() || p->second.isReady){
+            continue;
+        }
+        blockData = p->second.blockData;
+        const int stamp = p->second.stamp;
+
+        lock.unlock();
+        calcLinkPositions(blockData);
+        lock.lock();
+
+        p = entries.find(frameIndex);
+        if(p != entries.end() && p->second.stamp == stamp){
+            auto& entry = p->second;
+            const int n = body->numLinks();
+            entry.positions.resize(n);
+            for(int i=0; i < n; ++i){
+                entry.positions[i] = body->link(i)->position();
+            }
+            entry.isReady = true;
+        }
+    }
+}
+
+
+void BodyPositionPrefetcher::Impl::calcLinkPositions(const vector<double>& blockData)
+{
+    const BodyPositionSeqFrameBlock block(const_cast<double*>(blockData.data()));
+
+    auto rootLink = body->rootLink();
+    auto rootPosition = block.linkPosition(0);
+    rootLink->setTranslation(rootPosition.translation());
+    rootLink->setRotation(rootPosition.rotation());
+
+    const int numJoints = std::min(body->numAllJoints(), block.numJointDisplacements());
+    auto displacements = block.jointDisplacements();
+    for(int i=0; i < numJoints; ++i){
+        body->joint(i)->q() = displacements[i];
+    }
+
+    body->calcForwardKinematics();
+}
@@ -0,0 +1,52 @@
+#ifndef CNOID_BODY_BODY_POSITION_PREFETCHER_H
+#define CNOID_BODY_BODY_POSITION_PREFETCHER_H
+
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class Body;
+class BodyPositionSeqFrameBlock;
+
+/**
+   This class calculates the positions of all the links for the frames of a body position sequence
+   in a background thread so that the frames can be applied to the body without the forward kinematics.
+   The frames are given by the request function, which copies the frame data, so the sequence can be
+   modified while the calculation is being executed. The fetch function only uses the result whose
+   frame data is the same as the given one.
+
+   The positions are calculated in the same way as the case where the position of the root link and
+   the joint displacements are applied to the body and Body::calcForwardKinematics is executed.
+*/
+class CNOID_EXPORT BodyPositionPrefetcher
+{
+public:
+    //! The body is cloned for the calculation in the background thread
+    BodyPositionPrefetcher(Body* body);
+    ~BodyPositionPrefetcher();
+
+    BodyPositionPrefetcher(const BodyPositionPrefetcher& org) = delete;
+    BodyPositionPrefetcher& operator=(const BodyPositionPrefetcher& rhs) = delete;
+
+    //! The results of the oldest frames are discarded when the number of the frames exceeds this value.
+    void setMaxNumCachedFrames(int n);
+
+    void request(int frameIndex, const BodyPositionSeqFrameBlock& block);
+
+    /**
+       The results of the frames before the given frame are discarded.
+       \return true if the link positions of the frame have been calculated and applied to the body.
+       Note that the joint displacements are not applied by this function.
+    */
+    bool fetch(int frameIndex, const BodyPositionSeqFrameBlock& block, Body* body);
+
+    void clear();
+
+private:
+    class Impl;
+    Impl* impl;
+};
+
+}
+
+#endif
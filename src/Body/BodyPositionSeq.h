@@ -27,6 +27,13 @@ public:
         return pdata ? pdata[static_cast<int>(pdata[0]) * LinkPositionSize + 1] : 0;
     }
 
+    //! The number of the elements of the block including the numbers of the links and joints
+    int blockDataSize() const {
+        return pdata ? numLinkPositions() * LinkPositionSize + numJointDisplacements() + 2 : 0;
+    }
+
+    const double* blockData() const { return pdata; }
+
     // The order of the link position elements is x, y, z, qx, qy, qz, qw
     class LinkPosition {
     public:
@@ -160,7 +167,7 @@ public:
     }
     
     BodyPositionSeqFrameBlock nextBlockOf(const BodyPositionSeqFrameBlock& block){
-        double* nextData = block.pdata + block.numLinkPositions() * LinkPositionSize + block.numJointDisplacements() + 2;
+        double* nextData = block.pdata + block.blockDataSize();
         if(nextData >= data.data() + data.size()){
             nextData = nullptr;
         }
@@ -197,6 +204,8 @@ class CNOID_EXPORT BodyPositionSeq : public Seq<BodyPositionSeqFrame>
 public:
     BodyPositionSeq(int numFrames = 0);
     BodyPositionSeq(const BodyPositionSeq& org);
+    BodyPositionSeq& operator=(const BodyPositionSeq& rhs) = default;
+    BodyPositionSeq& operator=(BodyPositionSeq&& rhs) = default;
 
     virtual std::shared_ptr<AbstractSeq> cloneSeq() const override;
 
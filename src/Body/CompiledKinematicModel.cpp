@@ -0,0 +1,371 @@
+#include "CompiledKinematicModel.h"
+#include "Link.h"
+#include <cnoid/EigenUtil>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+/**
+   The configurations are processed in blocks of this size so that the values
+   of the parent links are still in the cache when the child links are processed.
+*/
+constexpr int BlockSize = 64;
+
+constexpr int NumWorkColumns = 14;
+
+typedef Eigen::Map<Eigen::ArrayXd> ArrayMap;
+
+/**
+   This function calculates the sines and cosines of the elements with the operations that
+   are vectorized by Eigen. The argument is reduced to [-pi/4, pi/4] with the two-part
+   representation of pi/2 and the Taylor polynomials are evaluated in the reduced range.
+   The results are then rotated by the quadrant without branches or selections.
+   The error is comparable to that of std::sin and std::cos unless the argument is extremely large.
+*/
+template<class ArgType, class ResultType>
+void calcSinCos
+(const ArgType& x, ResultType& out_sin, ResultType& out_cos,
+ ResultType& buf1, ResultType& buf2, ResultType& buf3, ResultType& buf4)
+{
+#if defined(__FAST_MATH__) || defined(_M_FP_FAST)
+    // The rounding by the magic number below is not preserved by the fast math optimization
+    out_sin = x.sin();
+    out_cos = x.cos();
+#else
+    static const double TwoOverPi = 6.36619772367581382433e-01;
+    static const double PiOver2_1 = 1.57079632673412561417e+00; // the first 33 bits of pi/2
+    static const double PiOver2_1t = 6.07710050650619224932e-11; // pi/2 - PiOver2_1
+    static const double M = 6755399441055744.0; // 1.5 * 2^52 to round to the nearest integer
+
+    auto& k = buf1;
+    auto& r = buf2;
+    auto& s = buf3;
+    auto& c = buf4;
+
+    k = (x * TwoOverPi + M) - M;
+    r = (x - k * PiOver2_1) - k * PiOver2_1t;
+    s = r + r * (r * r) * (-1.0 / 6.0 + (r * r) * (1.0 / 120.0 + (r * r) * (-1.0 / 5040.0 + (r * r) * (
+        1.0 / 362880.0 + (r * r) * (-1.0 / 39916800.0 + (r * r) * (1.0 / 6227020800.0 + (r * r) * (
+            -1.0 / 1307674368000.0)))))));
+    c = 1.0 + (r * r) * (-0.5 + (r * r) * (1.0 / 24.0 + (r * r) * (-1.0 / 720.0 + (r * r) * (
+        1.0 / 40320.0 + (r * r) * (-1.0 / 3628800.0 + (r * r) * (1.0 / 479001600.0 + (r * r) * (
+            -1.0 / 87178291200.0 + (r * r) * (1.0 / 20922789888000.0))))))));
+
+    // quadrant = k mod 4
+    auto& quadrant = buf2;
+    quadrant = k - 4.0 * (((k * 0.25 - 0.375) + M) - M);
+    // These are exactly cos(quadrant * pi / 2) and sin(quadrant * pi / 2) for the quadrants 0 to 3
+    auto cq = (quadrant - 1.0) * (quadrant - 3.0) * (quadrant + 1.0) * (1.0 / 3.0);
+    auto sq = quadrant * (quadrant - 2.0) * (quadrant - 4.0) * (1.0 / 3.0);
+    out_sin = s * cq + c * sq;
+    out_cos = c * cq - s * sq;
+#endif
+}
+
+}
+
+
+CompiledKinematicModel::CompiledKinematicModel()
+{
+    numJoints_ = 0;
+    batchSize_ = 0;
+    jacobianLinkIndex = -1;
+}
+
+
+CompiledKinematicModel::CompiledKinematicModel(Body* body)
+    : CompiledKinematicModel()
+{
+    compile(body);
+}
+
+
+void CompiledKinematicModel::compile(Body* body)
+{
+    body_ = body;
+    numJoints_ = body->numJoints();
+
+    const int numLinks = body->numLinks();
+    links_.resize(numLinks);
+
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        auto& compiled = links_[i];
+        compiled.parentIndex = (i == 0) ? -1 : link->parent()->index();
+        compiled.Rb = link->Rb();
+        compiled.b = link->b();
+        compiled.axis = link->a();
+        compiled.Rb_axis = link->Rb() * link->a();
+        compiled.hasActualJoint = link->hasActualJoint();
+
+        const int id = link->jointId();
+        const bool hasJointId = (id >= 0 && id < numJoints_ && body->joint(id) == link);
+        compiled.jointId = hasJointId ? id : -1;
+
+        if(i == 0){
+            compiled.jointType = Link::FixedJoint;
+
+        } else if(link->isRevoluteJoint()){
+            if(hasJointId){
+                compiled.jointType = Link::RevoluteJoint;
+                const Vector3& a = link->a();
+                const Matrix3 aa = a * a.transpose();
+                compiled.K0.noalias() = link->Rb() * aa;
+                compiled.K1 = link->Rb() - compiled.K0;
+                compiled.K2.noalias() = link->Rb() * hat(a);
+            } else {
+                compiled.jointType = Link::FixedJoint;
+                compiled.Rb = link->Rb() * AngleAxisd(link->q(), link->a());
+            }
+        } else if(link->isPrismaticJoint()){
+            if(hasJointId){
+                compiled.jointType = Link::PrismaticJoint;
+            } else {
+                compiled.jointType = Link::FixedJoint;
+                compiled.b += compiled.Rb_axis * link->q();
+            }
+        } else {
+            compiled.jointType = Link::FixedJoint;
+        }
+    }
+
+    jacobianJointIds_.clear();
+    jacobianJointLinkIndices.clear();
+    jacobianLinkIndex = -1;
+
+    setBatchSize(batchSize_);
+}
+
+
+void CompiledKinematicModel::setBatchSize(int n)
+{
+    batchSize_ = n;
+    Q.resize(n, numJoints_);
+    X.resize(n, 12 * links_.size());
+    work.resize(std::min(n, BlockSize), NumWorkColumns);
+    J.resize(0, 0);
+    jacobianLinkIndex = -1;
+
+    if(body_){
+        for(int i=0; i < n; ++i){
+            setConfiguration(i, body_);
+        }
+    }
+}
+
+
+void CompiledKinematicModel::setRootLinkPosition(int index, const Isometry3& T)
+{
+    for(int c=0; c < 3; ++c){
+        for(int r=0; r < 3; ++r){
+            X(index, 3 * c + r) = T.linear()(r, c);
+        }
+        X(index, 9 + c) = T.translation()[c];
+    }
+}
+
+
+void CompiledKinematicModel::setConfiguration(int index, const Body* body)
+{
+    setRootLinkPosition(index, body->rootLink()->T());
+    for(int i=0; i < numJoints_; ++i){
+        Q(index, i) = body->joint(i)->q();
+    }
+}
+
+
+void CompiledKinematicModel::calcForwardKinematics()
+{
+    const int numLinks = links_.size();
+    for(int top = 0; top < batchSize_; top += BlockSize){
+        const int n = std::min(BlockSize, batchSize_ - top);
+        for(int i=1; i < numLinks; ++i){
+            calcLinkPositions(i, top, n);
+        }
+    }
+    jacobianLinkIndex = -1;
+}
+
+
+void CompiledKinematicModel::calcLinkPositions(int linkIndex, int top, int n)
+{
+    const auto& link = links_[linkIndex];
+    const int pc = link.parentIndex * 12;
+    const int c = linkIndex * 12;
+
+    auto x = [&](int column){ return ArrayMap(X.col(column).data() + top, n); };
+    // parent rotation element (row, col)
+    auto R = [&](int row, int col){ return ArrayMap(X.col(pc + 3 * col + row).data() + top, n); };
+    auto w = [&](int column){ return ArrayMap(work.col(column).data(), n); };
+
+    switch(link.jointType){
+
+    case Link::RevoluteJoint:
+    {
+        auto q = ArrayMap(Q.col(link.jointId).data() + top, n);
+        auto C = w(0);
+        auto S = w(1);
+        auto buf1 = w(2);
+        auto buf2 = w(3);
+        auto buf3 = w(4);
+        auto buf4 = w(5);
+        calcSinCos(q, S, C, buf1, buf2, buf3, buf4);
+        // local rotation element (row, col)
+        auto L = [&](int row, int col){ return w(2 + 3 * col + row); };
+        for(int col=0; col < 3; ++col){
+            for(int row=0; row < 3; ++row){
+                L(row, col) = link.K0(row, col) + C * link.K1(row, col) + S * link.K2(row, col);
+            }
+        }
+        for(int col=0; col < 3; ++col){
+            for(int row=0; row < 3; ++row){
+                x(c + 3 * col + row) = R(row, 0) * L(0, col) + R(row, 1) * L(1, col) + R(row, 2) * L(2, col);
+            }
+        }
+        const Vector3& b = link.b;
+        for(int row=0; row < 3; ++row){
+            x(c + 9 + row) = x(pc + 9 + row) + R(row, 0) * b[0] + R(row, 1) * b[1] + R(row, 2) * b[2];
+        }
+        break;
+    }
+
+    case Link::PrismaticJoint:
+    {
+        const Matrix3& Rb = link.Rb;
+        for(int col=0; col < 3; ++col){
+            for(int row=0; row < 3; ++row){
+                x(c + 3 * col + row) = R(row, 0) * Rb(0, col) + R(row, 1) * Rb(1, col) + R(row, 2) * Rb(2, col);
+            }
+        }
+        auto q = ArrayMap(Q.col(link.jointId).data() + top, n);
+        auto offset = [&](int i){ return w(11 + i); };
+        for(int i=0; i < 3; ++i){
+            offset(i) = link.b[i] + q * link.Rb_axis[i];
+        }
+        for(int row=0; row < 3; ++row){
+            x(c + 9 + row) = x(pc + 9 + row) + R(row, 0) * offset(0) + R(row, 1) * offset(1) + R(row, 2) * offset(2);
+        }
+        break;
+    }
+
+    case Link::FixedJoint:
+    default:
+    {
+        const Matrix3& Rb = link.Rb;
+        for(int col=0; col < 3; ++col){
+            for(int row=0; row < 3; ++row){
+                x(c + 3 * col + row) = R(row, 0) * Rb(0, col) + R(row, 1) * Rb(1, col) + R(row, 2) * Rb(2, col);
+            }
+        }
+        const Vector3& b = link.b;
+        for(int row=0; row < 3; ++row){
+            x(c + 9 + row) = x(pc + 9 + row) + R(row, 0) * b[0] + R(row, 1) * b[1] + R(row, 2) * b[2];
+        }
+        break;
+    }
+    }
+}
+
+
+Matrix3 CompiledKinematicModel::linkRotation(int linkIndex, int index) const
+{
+    const int c = linkIndex * 12;
+    Matrix3 R;
+    for(int col=0; col < 3; ++col){
+        for(int row=0; row < 3; ++row){
+            R(row, col) = X(index, c + 3 * col + row);
+        }
+    }
+    return R;
+}
+
+
+Isometry3 CompiledKinematicModel::linkPosition(int linkIndex, int index) const
+{
+    Isometry3 T;
+    T.linear() = linkRotation(linkIndex, index);
+    T.translation() = linkTranslation(linkIndex, index);
+    return T;
+}
+
+
+int CompiledKinematicModel::calcJacobians(int linkIndex)
+{
+    if(linkIndex != jacobianLinkIndex){
+        jacobianJointIds_.clear();
+        jacobianJointLinkIndices.clear();
+        for(int i = linkIndex; i > 0; i = links_[i].parentIndex){
+            if(links_[i].hasActualJoint){
+                jacobianJointIds_.push_back(links_[i].jointId);
+                jacobianJointLinkIndices.push_back(i);
+            }
+        }
+        std::reverse(jacobianJointIds_.begin(), jacobianJointIds_.end());
+        std::reverse(jacobianJointLinkIndices.begin(), jacobianJointLinkIndices.end());
+        jacobianLinkIndex = linkIndex;
+    }
+
+    const int m = jacobianJointLinkIndices.size();
+    J.resize(batchSize_, 6 * m);
+    const int ec = linkIndex * 12;
+
+    for(int k=0; k < m; ++k){
+        const int jointLinkIndex = jacobianJointLinkIndices[k];
+        const auto& link = links_[jointLinkIndex];
+        const int jc = jointLinkIndex * 12;
+        // axis = R * a
+        auto axis = [&](int row){
+            return X.col(jc + row) * link.axis[0] + X.col(jc + 3 + row) * link.axis[1] + X.col(jc + 6 + row) * link.axis[2];
+        };
+        if(link.jointType == Link::RevoluteJoint){
+            for(int row=0; row < 3; ++row){
+                J.col(6 * k + 3 + row) = axis(row);
+            }
+            auto w = [&](int row){ return J.col(6 * k + 3 + row); };
+            auto arm = [&](int row){ return X.col(ec + 9 + row) - X.col(jc + 9 + row); };
+            J.col(6 * k)     = w(1) * arm(2) - w(2) * arm(1);
+            J.col(6 * k + 1) = w(2) * arm(0) - w(0) * arm(2);
+            J.col(6 * k + 2) = w(0) * arm(1) - w(1) * arm(0);
+
+        } else if(link.jointType == Link::PrismaticJoint){
+            for(int row=0; row < 3; ++row){
+                J.col(6 * k + row) = axis(row);
+                J.col(6 * k + 3 + row).setZero();
+            }
+        } else {
+            J.middleCols(6 * k, 6).setZero();
+        }
+    }
+
+    return m;
+}
+
+
+void CompiledKinematicModel::getJacobian(int index, MatrixXd& out_J) const
+{
+    const int m = jacobianJointLinkIndices.size();
+    out_J.resize(6, m);
+    for(int k=0; k < m; ++k){
+        for(int row=0; row < 6; ++row){
+            out_J(row, k) = J(index, 6 * k + row);
+        }
+    }
+}
+
+
+void CompiledKinematicModel::copyConfigurationToBody(int index, Body* body) const
+{
+    if(!body){
+        body = body_;
+    }
+    for(int i=0; i < numJoints_; ++i){
+        body->joint(i)->q() = Q(index, i);
+    }
+    const int numLinks = links_.size();
+    for(int i=0; i < numLinks; ++i){
+        body->link(i)->setPosition(linkPosition(i, index));
+    }
+}
@@ -0,0 +1,114 @@
+#ifndef CNOID_BODY_COMPILED_KINEMATIC_MODEL_H
+#define CNOID_BODY_COMPILED_KINEMATIC_MODEL_H
+
+#include "Body.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class holds the kinematic structure of a body as flat arrays sorted in the topological
+   order of the links, and calculates the forward kinematics and the Jacobians for a batch of
+   configurations at once. The values of the configurations are stored in the structure of arrays
+   where each column contains an element for all the configurations so that the calculations are
+   vectorized over the configurations. The Link objects of the body are not accessed in the
+   calculations, and they are only updated by calling the copyConfigurationToBody function.
+
+   The joints that do not have joint ids are fixed at their displacements when the model is compiled.
+*/
+class CNOID_EXPORT CompiledKinematicModel
+{
+public:
+    CompiledKinematicModel();
+    CompiledKinematicModel(Body* body);
+
+    //! The model must be compiled again when the link tree of the body is changed.
+    void compile(Body* body);
+
+    Body* body() { return body_; }
+    int numLinks() const { return static_cast<int>(links_.size()); }
+    int numJoints() const { return numJoints_; }
+    int parentIndex(int linkIndex) const { return links_[linkIndex].parentIndex; }
+
+    /**
+       The configurations are initialized with the current root link position and the
+       current joint displacements of the body.
+    */
+    void setBatchSize(int n);
+    int batchSize() const { return batchSize_; }
+
+    //! The rows correspond to the configurations and the columns correspond to the joint ids.
+    Eigen::ArrayXXd& jointDisplacements() { return Q; }
+    const Eigen::ArrayXXd& jointDisplacements() const { return Q; }
+    double& q(int jointId, int index) { return Q(index, jointId); }
+    double q(int jointId, int index) const { return Q(index, jointId); }
+
+    void setRootLinkPosition(int index, const Isometry3& T);
+
+    //! The root link position and the joint displacements of the body are copied to the configuration.
+    void setConfiguration(int index, const Body* body);
+
+    void calcForwardKinematics();
+
+    Vector3 linkTranslation(int linkIndex, int index) const {
+        const int c = linkIndex * 12 + 9;
+        return Vector3(X(index, c), X(index, c + 1), X(index, c + 2));
+    }
+    Matrix3 linkRotation(int linkIndex, int index) const;
+    Isometry3 linkPosition(int linkIndex, int index) const;
+
+    /**
+       This function calculates the Jacobians of the origin of a link for all the configurations.
+       The joints of the Jacobians are the joints from the root link to the link, which are the
+       same as those of JointPath(rootLink, link). The function must be called after the
+       calcForwardKinematics function.
+       \return The number of the columns of each Jacobian
+    */
+    int calcJacobians(int linkIndex);
+    const std::vector<int>& jacobianJointIds() const { return jacobianJointIds_; }
+    void getJacobian(int index, MatrixXd& out_J) const;
+
+    /**
+       The joint displacements and the link positions of a configuration are written to the
+       links of the body. The body must be the compiled body or a clone of it.
+    */
+    void copyConfigurationToBody(int index, Body* body = nullptr) const;
+
+private:
+    struct CompiledLink
+    {
+        int parentIndex;
+        int jointId;
+        int jointType;
+        bool hasActualJoint;
+        Matrix3 Rb;
+        Vector3 b;
+        Vector3 axis;
+        Vector3 Rb_axis; // Rb * d for a prismatic joint
+        // The local rotation of a revolute joint is K0 + cos(q) * K1 + sin(q) * K2
+        Matrix3 K0;
+        Matrix3 K1;
+        Matrix3 K2;
+    };
+
+    BodyPtr body_;
+    std::vector<CompiledLink> links_;
+    int numJoints_;
+    int batchSize_;
+
+    Eigen::ArrayXXd Q;
+    // Each link has 12 columns: the rotation matrix in the column-major order and the translation
+    Eigen::ArrayXXd X;
+    Eigen::ArrayXXd J;
+    Eigen::ArrayXXd work;
+    std::vector<int> jacobianJointIds_;
+    std::vector<int> jacobianJointLinkIndices;
+    int jacobianLinkIndex;
+
+    void calcLinkPositions(int linkIndex, int top, int n);
+};
+
+}
+
+#endif
@@ -2,24 +2,60 @@
 #include "Body.h"
 #include "Link.h"
 #include "JointPath.h"
+#include <cnoid/ThreadPool>
+#include <chrono>
 
 using namespace std;
 using namespace cnoid;
 
+namespace cnoid {
+
+class CompositeIK::ParallelSolver
+{
+public:
+    struct Worker
+    {
+        BodyPtr body;
+        shared_ptr<JointPath> orgPath;
+        // The path of the clone body corresponding to orgPath
+        shared_ptr<JointPath> path;
+        bool solved;
+    };
+    // The worker for the first path is not used because the path is solved with the original body
+    vector<Worker> workers;
+    unique_ptr<ThreadPool> threadPool;
+    bool arePathsIndependent;
+
+    ParallelSolver(CompositeIK* ik);
+    bool solve(CompositeIK* ik, const Isometry3& T);
+};
+
+}
+
 
 CompositeIK::CompositeIK()
 {
     targetLink_ = nullptr;
     hasCustomIK_ = false;
+    isParallelSolvingEnabled_ = false;
+    maxIkError = -1.0;
+    lastSolvingTime_ = 0.0;
 }
 
 
 CompositeIK::CompositeIK(Body* body, Link* targetLink)
+    : CompositeIK()
 {
     reset(body, targetLink);
 }
 
 
+CompositeIK::~CompositeIK()
+{
+
+}
+
+
 void CompositeIK::reset(Body* body, Link* targetLink)
 {
     body_ = body;
@@ -27,8 +63,9 @@ void CompositeIK::reset(Body* body, Link* targetLink)
     hasCustomIK_ = false;
     paths.clear();
     remainingLinkTraverse.reset();
+    parallelSolver.reset();
 }
-   
+
 
 bool CompositeIK::addBaseLink(Link* baseLink)
 {
@@ -38,6 +75,7 @@ bool CompositeIK::addBaseLink(Link* baseLink)
             hasCustomIK_ = paths.empty() ? path->hasCustomIK() : (hasCustomIK_ && path->hasCustomIK());
             paths.push_back(path);
             remainingLinkTraverse.reset();
+            parallelSolver.reset();
             return true;
         }
     }
@@ -56,11 +94,24 @@ void CompositeIK::setMaxIkError(double e)
     for(size_t i=0; i < paths.size(); ++i){
         paths[i]->setNumericalIkMaxIkError(e);
     }
+    maxIkError = e;
+    parallelSolver.reset();
+}
+
+
+void CompositeIK::setParallelSolvingEnabled(bool on)
+{
+    isParallelSolvingEnabled_ = on;
+    if(!on){
+        parallelSolver.reset();
+    }
 }
 
 
 bool CompositeIK::calcInverseKinematics(const Isometry3& T)
 {
+    auto startTime = std::chrono::steady_clock::now();
+
     const int n = body_->numJoints();
 
     Isometry3 T0 = targetLink_->T();
@@ -69,6 +120,46 @@ bool CompositeIK::calcInverseKinematics(const Isometry3& T)
         q0[i] = body_->joint(i)->q();
     }
 
+    bool solved = false;
+    bool isSolvedInParallel = false;
+    size_t numProcessedPaths = 0;
+
+    if(isParallelSolvingEnabled_ && paths.size() >= 2){
+        if(!parallelSolver){
+            parallelSolver.reset(new ParallelSolver(this));
+        }
+        if(parallelSolver->arePathsIndependent){
+            solved = parallelSolver->solve(this, T);
+            numProcessedPaths = paths.size();
+            isSolvedInParallel = true;
+        }
+    }
+    if(!isSolvedInParallel){
+        solved = solveSequentially(T, T0, numProcessedPaths);
+    }
+
+    if(solved){
+        targetLink_->setPosition(T);
+
+    } else {
+        targetLink_->setPosition(T0);
+        for(int i=0; i < n; ++i){
+            body_->joint(i)->q() = q0[i];
+        }
+        for(size_t i=0; i < numProcessedPaths; ++i){
+            paths[i]->calcForwardKinematics();
+        }
+    }
+
+    lastSolvingTime_ =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
+    return solved;
+}
+
+
+bool CompositeIK::solveSequentially(const Isometry3& T, const Isometry3& T0, size_t& out_numProcessedPaths)
+{
     bool solved = true;
     size_t pathIndex = 0;
     while(true){
@@ -84,17 +175,85 @@ bool CompositeIK::calcInverseKinematics(const Isometry3& T)
             break;
         }
     }
+    out_numProcessedPaths = std::min(pathIndex + 1, paths.size());
+    return solved;
+}
 
-    if(solved){
-        targetLink_->setPosition(T);
 
-    } else {
-        targetLink_->setPosition(T0);
-        for(int i=0; i < n; ++i){
-            body_->joint(i)->q() = q0[i];
+CompositeIK::ParallelSolver::ParallelSolver(CompositeIK* ik)
+{
+    auto& paths = ik->paths;
+
+    /*
+      The paths can be solved independently when no link except the target link is included in
+      more than one path. Note that a base link moved by another path also breaks the independence.
+    */
+    arePathsIndependent = true;
+    vector<int> pathIndices(ik->body_->numLinks(), -1);
+    for(size_t i=0; i < paths.size() && arePathsIndependent; ++i){
+        auto& linkPath = paths[i]->linkPath();
+        int n = linkPath.numLinks() - 1; // Exclude the end link (target link)
+        for(int j=0; j < n; ++j){
+            int& index = pathIndices[linkPath[j]->index()];
+            if(index >= 0 && index != static_cast<int>(i)){
+                arePathsIndependent = false;
+                break;
+            }
+            index = i;
         }
-        for(size_t i=0; i <= pathIndex; ++i){
-            paths[i]->calcForwardKinematics();
+    }
+    if(!arePathsIndependent){
+        return;
+    }
+
+    workers.resize(paths.size());
+    for(size_t i=1; i < paths.size(); ++i){
+        auto& worker = workers[i];
+        auto& orgPath = paths[i];
+        worker.body = ik->body_->clone();
+        worker.orgPath = orgPath;
+        worker.path = JointPath::getCustomPath(
+            worker.body->link(orgPath->baseLink()->index()),
+            worker.body->link(orgPath->endLink()->index()));
+        if(ik->maxIkError >= 0.0){
+            worker.path->setNumericalIkMaxIkError(ik->maxIkError);
+        }
+        worker.path->setCustomIkDisabled(orgPath->isCustomIkDisabled());
+        worker.path->setBestEffortIkMode(orgPath->isBestEffortIkMode());
+    }
+    threadPool.reset(new ThreadPool(paths.size() - 1));
+}
+
+
+bool CompositeIK::ParallelSolver::solve(CompositeIK* ik, const Isometry3& T)
+{
+    for(size_t i=1; i < workers.size(); ++i){
+        auto& worker = workers[i];
+        auto& orgPath = *worker.orgPath;
+        auto& path = *worker.path;
+        path.baseLink()->setPosition(orgPath.baseLink()->T());
+        for(int j=0; j < orgPath.numJoints(); ++j){
+            path.joint(j)->q() = orgPath.joint(j)->q();
+        }
+        path.calcForwardKinematics();
+        threadPool->start([&worker, &T](){ worker.solved = worker.path->calcInverseKinematics(T); });
+    }
+
+    bool solved = ik->paths[0]->calcInverseKinematics(T);
+
+    threadPool->wait();
+
+    for(size_t i=1; i < workers.size(); ++i){
+        auto& worker = workers[i];
+        if(!worker.solved){
+            solved = false;
+        } else if(solved){
+            auto& orgPath = *worker.orgPath;
+            auto& path = *worker.path;
+            for(int j=0; j < orgPath.numJoints(); ++j){
+                orgPath.joint(j)->q() = path.joint(j)->q();
+            }
+            orgPath.calcForwardKinematics();
         }
     }
 
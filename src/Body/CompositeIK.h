@@ -19,6 +19,7 @@ class CNOID_EXPORT CompositeIK : public InverseKinematics
 public:
     CompositeIK();
     CompositeIK(Body* body, Link* targetLink);
+    ~CompositeIK();
 
     void reset(Body* body, Link* targetLink);
     bool addBaseLink(Link* link);
@@ -32,6 +33,18 @@ public:
     void setMaxIkError(double e);
     bool hasCustomIK() const { return hasCustomIK_; }
 
+    /**
+       When this mode is enabled and the joint paths share no links except the target link,
+       the paths are solved concurrently. Each path except the first one is solved with a clone
+       of the body, and the numerical IK settings of the clone paths are only given by
+       setMaxIkError. The paths are solved sequentially when they are not independent.
+    */
+    void setParallelSolvingEnabled(bool on);
+    bool isParallelSolvingEnabled() const { return isParallelSolvingEnabled_; }
+
+    //! The time in seconds taken by the last calcInverseKinematics call
+    double lastSolvingTime() const { return lastSolvingTime_; }
+
     virtual bool calcInverseKinematics(const Isometry3& T) override;
     virtual bool calcRemainingPartForwardKinematicsForInverseKinematics() override;
 
@@ -45,12 +58,20 @@ public:
     bool hasAnalyticalIK() const { return hasCustomIK(); }
 
 private:
+    class ParallelSolver;
+    
+    bool solveSequentially(const Isometry3& T, const Isometry3& T0, size_t& out_numProcessedPaths);
+    
     ref_ptr<Body> body_;
     Link* targetLink_;
     std::vector<std::shared_ptr<JointPath>> paths;
     std::vector<double> q0;
     std::shared_ptr<LinkTraverse> remainingLinkTraverse;
     bool hasCustomIK_;
+    bool isParallelSolvingEnabled_;
+    double maxIkError;
+    double lastSolvingTime_;
+    std::unique_ptr<ParallelSolver> parallelSolver;
 };
 
 }
@@ -39,11 +39,41 @@ void ForwardDynamicsABM::initialize()
     root->uu() = 0.0;
     root->dd() = 0.0;
 
+    compileLinks();
     initializeSensors();
     calcABMFirstHalf();
 }
 
 
+void ForwardDynamicsABM::compileLinks()
+{
+    const int n = subBody->numLinks();
+    compiledLinks.resize(n);
+
+    for(int i=0; i < n; ++i){
+        auto link = subBody->link(i);
+        auto& compiled = compiledLinks[i];
+        compiled.link = link;
+        compiled.parent = (i == 0) ? nullptr : link->parent();
+        compiled.hasRb = (link->Rb() != Matrix3::Identity());
+        switch(link->jointType()){
+        case Link::RevoluteJoint:
+            compiled.jointType = Link::RevoluteJoint;
+            compiled.axis = link->Rb() * link->a();
+            break;
+        case Link::PrismaticJoint:
+            compiled.jointType = Link::PrismaticJoint;
+            compiled.axis = link->Rb() * link->d();
+            break;
+        default:
+            compiled.jointType = Link::FixedJoint;
+            compiled.axis.setZero();
+            break;
+        }
+    }
+}
+
+
 inline void ForwardDynamicsABM::calcABMFirstHalf()
 {
     calcABMPhase1(true);
@@ -218,27 +248,24 @@ void ForwardDynamicsABM::calcMotionWithRungeKuttaMethod()
 */
 void ForwardDynamicsABM::calcABMPhase1(bool updateNonSpatialVariables)
 {
-    const int n = subBody->numLinks();
-
-    for(int i=0; i < n; ++i){
-        auto link = subBody->link(i);
-        DyLink* parent;
-        if(i == 0 && link->isFreeJoint()){
-            parent = nullptr;
-        } else {
-            parent = link->parent();
-        }
+    for(auto& compiled : compiledLinks){
+        DyLink* link = compiled.link;
+        DyLink* parent = compiled.parent;
 
         if(parent){
             
-            switch(link->jointType()){
+            switch(compiled.jointType){
                 
             case Link::RevoluteJoint:
             {
                 const Vector3 arm = parent->R() * link->b();
-                link->R().noalias() = parent->R() * link->Rb() * AngleAxisd(link->q(), link->a());
+                if(compiled.hasRb){
+                    link->R().noalias() = parent->R() * link->Rb() * AngleAxisd(link->q(), link->a());
+                } else {
+                    link->R().noalias() = parent->R() * AngleAxisd(link->q(), link->a());
+                }
                 link->p().noalias() = arm + parent->p();
-                link->sw().noalias() = parent->R() * (link->Rb() * link->a());
+                link->sw().noalias() = parent->R() * compiled.axis;
                 link->sv().noalias() = link->p().cross(link->sw());
                 link->w().noalias() = link->dq() * link->sw() + parent->w();
                 if(updateNonSpatialVariables){
@@ -251,10 +278,14 @@ void ForwardDynamicsABM::calcABMPhase1(bool updateNonSpatialVariables)
             }
                 
             case Link::PrismaticJoint:
-                link->p().noalias() = parent->R() * (link->b() + link->Rb() * (link->q() * link->d())) + parent->p();
-                link->R().noalias() = parent->R() * link->Rb();
+                link->p().noalias() = parent->R() * (link->b() + link->q() * compiled.axis) + parent->p();
+                if(compiled.hasRb){
+                    link->R().noalias() = parent->R() * link->Rb();
+                } else {
+                    link->R() = parent->R();
+                }
                 link->sw().setZero();
-                link->sv().noalias() = parent->R() * (link->Rb() * link->d());
+                link->sv().noalias() = parent->R() * compiled.axis;
                 link->w() = parent->w();
                 if(updateNonSpatialVariables){
                     link->dw() = parent->dw();
@@ -268,7 +299,11 @@ void ForwardDynamicsABM::calcABMPhase1(bool updateNonSpatialVariables)
             case Link::FixedJoint:
             default:
                 link->p().noalias() = parent->R() * link->b() + parent->p();
-                link->R().noalias() = parent->R() * link->Rb();
+                if(compiled.hasRb){
+                    link->R().noalias() = parent->R() * link->Rb();
+                } else {
+                    link->R() = parent->R();
+                }
                 link->w() = parent->w();
                 link->vo() = parent->vo();
                 link->sw().setZero();
@@ -332,52 +367,51 @@ COMMON_CALCS_FOR_ALL_JOINT_TYPES:
 
 void ForwardDynamicsABM::calcABMPhase2()
 {
-    const int n = subBody->numLinks();
+    const int n = compiledLinks.size();
 
     for(int i = n-1; i >= 0; --i){
-        auto link = subBody->link(i);
+        auto& compiled = compiledLinks[i];
+        DyLink* link = compiled.link;
 
         link->pf()   -= link->f_ext();
         link->ptau() -= link->tau_ext();
 
-        // compute articulated inertia (Eq.(6.48) of Kajita's textbook)
-        for(DyLink* child = link->child(); child; child = child->sibling()){
-            if(child->isFreeJoint()){
-                continue;
-            } else if(child->isFixedJoint()){
-                link->Ivv() += child->Ivv();
-                link->Iwv() += child->Iwv();
-                link->Iww() += child->Iww();
-
-            } else {
-                const Vector3 hhv_dd = child->hhv() / child->dd();
-                link->Ivv().noalias() += child->Ivv() - child->hhv() * hhv_dd.transpose();
-                link->Iwv().noalias() += child->Iwv() - child->hhw() * hhv_dd.transpose();
-                link->Iww().noalias() += child->Iww() - child->hhw() * (child->hhw() / child->dd()).transpose();
-            }
-            link->pf()  .noalias() += child->Ivv() * child->cv() + child->Iwv().transpose() * child->cw() + child->pf();
-            link->ptau().noalias() += child->Iwv() * child->cv() + child->Iww() * child->cw() + child->ptau();
-
-            if(!child->isFixedJoint()){
-                const double uu_dd = child->uu() / child->dd();
-                link->pf()   += uu_dd * child->hhv();
-                link->ptau() += uu_dd * child->hhw();
-            }
+        // The articulated inertia and the bias force of the link have been completed by its child links
+        DyLink* parent = compiled.parent;
+        if(!parent){
+            continue;
         }
 
-        if(i > 0){
-            if(!link->isFixedJoint()){
-                // hh = Ia * s
-                link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
-                link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
-                // dd = Ia * s * s^T
-                link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
-                // uu = u - hh^T*c + s^T*pp
-                link->uu() =
-                    stdx::clamp(link->u(), link->u_lower(), link->u_upper()) -
-                    (link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()) +
-                     link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
-            }
+        // compute articulated inertia (Eq.(6.48) of Kajita's textbook)
+        if(compiled.jointType == Link::FixedJoint){
+            parent->Ivv() += link->Ivv();
+            parent->Iwv() += link->Iwv();
+            parent->Iww() += link->Iww();
+            parent->pf()   += link->pf();
+            parent->ptau() += link->ptau();
+
+        } else {
+            // hh = Ia * s
+            link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
+            link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
+            // dd = Ia * s * s^T
+            link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
+            // uu = u - hh^T*c + s^T*pp
+            link->uu() =
+                stdx::clamp(link->u(), link->u_lower(), link->u_upper()) -
+                (link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()) +
+                 link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
+
+            const Vector3 hhv_dd = link->hhv() / link->dd();
+            parent->Ivv().noalias() += link->Ivv() - link->hhv() * hhv_dd.transpose();
+            parent->Iwv().noalias() += link->Iwv() - link->hhw() * hhv_dd.transpose();
+            parent->Iww().noalias() += link->Iww() - link->hhw() * (link->hhw() / link->dd()).transpose();
+
+            const double uu_dd = link->uu() / link->dd();
+            parent->pf().noalias() +=
+                link->Ivv() * link->cv() + link->Iwv().transpose() * link->cw() + link->pf() + uu_dd * link->hhv();
+            parent->ptau().noalias() +=
+                link->Iwv() * link->cv() + link->Iww() * link->cw() + link->ptau() + uu_dd * link->hhw();
         }
     }
 }
@@ -386,34 +420,30 @@ void ForwardDynamicsABM::calcABMPhase2()
 // A part of phase 2 (inbound loop) that can be calculated before external forces are given
 void ForwardDynamicsABM::calcABMPhase2Part1()
 {
-    const int n = subBody->numLinks();
+    const int n = compiledLinks.size();
 
-    for(int i = n-1; i >= 0; --i){
-        auto link = subBody->link(i);
-        for(DyLink* child = link->child(); child; child = child->sibling()){
-            if(child->isFreeJoint()){
-                continue;
-            } else if(child->isFixedJoint()){
-                link->Ivv() += child->Ivv();
-                link->Iwv() += child->Iwv();
-                link->Iww() += child->Iww();
-            } else {
-                const Vector3 hhv_dd = child->hhv() / child->dd();
-                link->Ivv().noalias() += child->Ivv() - child->hhv() * hhv_dd.transpose();
-                link->Iwv().noalias() += child->Iwv() - child->hhw() * hhv_dd.transpose();
-                link->Iww().noalias() += child->Iww() - child->hhw() * (child->hhw() / child->dd()).transpose();
-            }
-            link->pf()  .noalias() += child->Ivv() * child->cv() + child->Iwv().transpose() * child->cw();
-            link->ptau().noalias() += child->Iwv() * child->cv() + child->Iww() * child->cw();
-        }
+    for(int i = n-1; i > 0; --i){
+        auto& compiled = compiledLinks[i];
+        DyLink* link = compiled.link;
+        DyLink* parent = compiled.parent;
 
-        if(i > 0){
-            if(!link->isFixedJoint()){
-                link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
-                link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
-                link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
-                link->uu() = -(link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()));
-            }
+        if(compiled.jointType == Link::FixedJoint){
+            parent->Ivv() += link->Ivv();
+            parent->Iwv() += link->Iwv();
+            parent->Iww() += link->Iww();
+        } else {
+            link->hhv().noalias() = link->Ivv() * link->sv() + link->Iwv().transpose() * link->sw();
+            link->hhw().noalias() = link->Iwv() * link->sv() + link->Iww() * link->sw();
+            link->dd() = link->sv().dot(link->hhv()) + link->sw().dot(link->hhw()) + link->Jm2();
+            link->uu() = -(link->hhv().dot(link->cv()) + link->hhw().dot(link->cw()));
+
+            const Vector3 hhv_dd = link->hhv() / link->dd();
+            parent->Ivv().noalias() += link->Ivv() - link->hhv() * hhv_dd.transpose();
+            parent->Iwv().noalias() += link->Iwv() - link->hhw() * hhv_dd.transpose();
+            parent->Iww().noalias() += link->Iww() - link->hhw() * (link->hhw() / link->dd()).transpose();
+
+            parent->pf()  .noalias() += link->Ivv() * link->cv() + link->Iwv().transpose() * link->cw();
+            parent->ptau().noalias() += link->Iwv() * link->cv() + link->Iww() * link->cw();
         }
     }
 }
@@ -422,34 +452,31 @@ void ForwardDynamicsABM::calcABMPhase2Part1()
 // A remaining part of phase 2 that requires external forces
 void ForwardDynamicsABM::calcABMPhase2Part2()
 {
-    const int n = subBody->numLinks();
+    const int n = compiledLinks.size();
 
     for(int i = n-1; i >= 0; --i){
-        auto link = subBody->link(i);
+        auto& compiled = compiledLinks[i];
+        DyLink* link = compiled.link;
 
         link->pf()   -= link->f_ext();
         link->ptau() -= link->tau_ext();
 
-        for(DyLink* child = link->child(); child; child = child->sibling()){
-            if(child->isFreeJoint()){
-                continue;
-            }
-            link->pf()   += child->pf();
-            link->ptau() += child->ptau();
-
-            if(!child->isFixedJoint()){
-                const double uu_dd = child->uu() / child->dd();
-                link->pf()   += uu_dd * child->hhv();
-                link->ptau() += uu_dd * child->hhw();
-            }
+        DyLink* parent = compiled.parent;
+        if(!parent){
+            continue;
         }
 
-        if(i > 0){
-            if(!link->isFixedJoint()){
-                link->uu() +=
-                    stdx::clamp(link->u(), link->u_lower(), link->u_upper())
-                    - (link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
-            }
+        parent->pf()   += link->pf();
+        parent->ptau() += link->ptau();
+
+        if(compiled.jointType != Link::FixedJoint){
+            link->uu() +=
+                stdx::clamp(link->u(), link->u_lower(), link->u_upper())
+                - (link->sv().dot(link->pf()) + link->sw().dot(link->ptau()));
+
+            const double uu_dd = link->uu() / link->dd();
+            parent->pf()   += uu_dd * link->hhv();
+            parent->ptau() += uu_dd * link->hhw();
         }
     }
 }
@@ -474,17 +501,29 @@ void ForwardDynamicsABM::calcABMPhase3()
             root->ptau();
         f *= -1.0;
 
-        Eigen::Matrix<double, 6, 1> a(M.colPivHouseholderQr().solve(f));
+        /*
+          The articulated inertia of the root link is symmetric positive definite unless the mass
+          properties are degenerate, so the Cholesky decomposition is used, which is much faster
+          than the QR decomposition for a body with few links.
+        */
+        Eigen::Matrix<double, 6, 1> a;
+        Eigen::LLT<Eigen::Matrix<double, 6, 6>> llt(M);
+        if(llt.info() == Eigen::Success){
+            a = llt.solve(f);
+        } else {
+            a = M.colPivHouseholderQr().solve(f);
+        }
 
         root->dvo() = a.head<3>();
         root->dw() = a.tail<3>();
     }
 
-    const int n = subBody->numLinks();
+    const int n = compiledLinks.size();
     for(int i=1; i < n; ++i){
-        auto link = subBody->link(i);
-        auto parent = link->parent();
-        if(link->isFixedJoint()){
+        auto& compiled = compiledLinks[i];
+        DyLink* link = compiled.link;
+        DyLink* parent = compiled.parent;
+        if(compiled.jointType == Link::FixedJoint){
             link->ddq() = 0.0;
             link->dvo() = parent->dvo();
             link->dw()  = parent->dw(); 
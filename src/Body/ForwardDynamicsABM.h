@@ -2,10 +2,13 @@
 #define CNOID_BODY_FORWARD_DYNAMICS_ABM_H
 
 #include "ForwardDynamics.h"
+#include <vector>
 #include "exportdecl.h"
 
 namespace cnoid
 {
+class DyLink;
+
 /**
    Forward dynamics calculation using Featherstone's Articulated Body Method (ABM)
 */
@@ -49,6 +52,28 @@ private:
 
     void updateForceSensors();
 
+    void compileLinks();
+
+    /**
+       The link tree of the sub-body and the joint axes in the parent link frames are compiled
+       into this array in the order of the links by the initialize function so that the link
+       tree is not traversed and the model constants are not recalculated in each step.
+       A link always precedes its child links, and the contributions of a link to the articulated
+       inertia and the bias force of its parent link are added by the inbound loops in reverse order.
+    */
+    struct CompiledLink
+    {
+        DyLink* link;
+        // nullptr for the root link of the sub-body
+        DyLink* parent;
+        // RevoluteJoint, PrismaticJoint or FixedJoint, which includes the other joint types
+        int jointType;
+        bool hasRb;
+        // Rb * a for a revolute joint, Rb * d for a prismatic joint
+        Vector3 axis;
+    };
+    std::vector<CompiledLink> compiledLinks;
+
     // Buffers for the Runge Kutta Method
     Isometry3 T0;
     Vector3 vo0;
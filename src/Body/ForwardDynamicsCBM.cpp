@@ -39,7 +39,10 @@ static void putVector(TVector& M, char* name)
 ForwardDynamicsCBM::ForwardDynamicsCBM(DySubBody* subBody) :
     ForwardDynamics(subBody)
 {
-
+    isCompositeRigidBodyMethodEnabled_ = true;
+    isLtdlFactorizationEnabled_ = true;
+    isM11Factorized = false;
+    isM11LtdlFactorizationValid = false;
 }
 
 
@@ -49,6 +52,18 @@ ForwardDynamicsCBM::~ForwardDynamicsCBM()
 }
 
 
+void ForwardDynamicsCBM::setCompositeRigidBodyMethodEnabled(bool on)
+{
+    isCompositeRigidBodyMethodEnabled_ = on;
+}
+
+
+void ForwardDynamicsCBM::setLtdlFactorizationEnabled(bool on)
+{
+    isLtdlFactorizationEnabled_ = on;
+}
+
+
 void ForwardDynamicsCBM::initialize()
 {
     auto root = subBody->rootLink();
@@ -82,6 +97,7 @@ void ForwardDynamicsCBM::initialize()
     b1. resize(n, 1);
     c1. resize(n);
     d1. resize(n);
+    a1. resize(n);
 
     qGiven.  resize(m);
     dqGiven. resize(m);
@@ -93,6 +109,8 @@ void ForwardDynamicsCBM::initialize()
     ddqorg.resize(numLinks);
     uorg.  resize(numLinks);
 
+    initializeCompositeRigidBodyMethod();
+
     calcPositionAndVelocityFK();
 
     if(!isNoUnknownAccelMode){
@@ -436,11 +454,6 @@ COMMON_CALCS_FOR_ALL_JOINT_TYPES:
 }
 
 
-/**
-   calculate the mass matrix using the unit vector method
-   \todo replace the unit vector method here with
-   a more efficient method that only requires O(n) computation time
-*/
 void ForwardDynamicsCBM::calcMassMatrix()
 {
     auto root = subBody->rootLink();
@@ -462,6 +475,34 @@ void ForwardDynamicsCBM::calcMassMatrix()
 	
     setColumnOfMassMatrix(b1, 0);
 
+    if(isCompositeRigidBodyMethodEnabled_){
+        calcMassMatrixWithCompositeRigidBodyMethod();
+    } else {
+        calcMassMatrixWithUnitVectorMethod();
+    }
+
+    for(int i=1; i < numLinks; ++i){
+        DyLink* link = subBody->link(i);
+        link->ddq() = ddqorg[i];
+        link->u()   = uorg  [i];
+    }
+    root->dvo() = dvoorg;
+    root->dw()  = dworg;
+
+    accelSolverInitialized = false;
+    isM11Factorized = false;
+}
+
+
+/**
+   calculate the mass matrix using the unit vector method.
+   This function must be called after the constant term b1 is calculated
+   with the state where all the accelerations are cleared.
+*/
+void ForwardDynamicsCBM::calcMassMatrixWithUnitVectorMethod()
+{
+    auto root = subBody->rootLink();
+
     if(unknown_rootDof){
         for(int i=0; i < 3; ++i){
             root->dvo()[i] += 1.0;
@@ -516,16 +557,6 @@ void ForwardDynamicsCBM::calcMassMatrix()
     for(int i=0; i < M12.cols(); ++i){
         M12.col(i) -= b1;
     }
-
-    for(int i=1; i < numLinks; ++i){
-        DyLink* link = subBody->link(i);
-        link->ddq() = ddqorg[i];
-        link->u()   = uorg  [i];
-    }
-    root->dvo() = dvoorg;
-    root->dw()  = dworg;
-
-    accelSolverInitialized = false;
 }
 
 
@@ -553,6 +584,153 @@ void ForwardDynamicsCBM::setColumnOfMassMatrix(MatrixXd& M, int column)
 }
 
 
+void ForwardDynamicsCBM::initializeCompositeRigidBodyMethod()
+{
+    const int numLinks = subBody->numLinks();
+    auto body = subBody->rootLink()->body();
+
+    std::vector<int> linkIndexToSubBodyLinkIndex(body->numLinks(), -1);
+    for(int i=0; i < numLinks; ++i){
+        linkIndexToSubBodyLinkIndex[subBody->link(i)->index()] = i;
+    }
+    parentIndices.assign(numLinks, -1);
+    for(int i=1; i < numLinks; ++i){
+        parentIndices[i] = linkIndexToSubBodyLinkIndex[subBody->link(i)->parent()->index()];
+    }
+
+    unknownAccelIndices.assign(numLinks, -1);
+    givenAccelIndices.assign(numLinks, -1);
+    for(size_t i=0; i < torqueModeJoints.size(); ++i){
+        unknownAccelIndices[linkIndexToSubBodyLinkIndex[torqueModeJoints[i]->index()]] = i + unknown_rootDof;
+    }
+    for(size_t i=0; i < highGainModeJoints.size(); ++i){
+        givenAccelIndices[linkIndexToSubBodyLinkIndex[highGainModeJoints[i]->index()]] = i + given_rootDof;
+    }
+
+    compositeMasses.resize(numLinks);
+    compositeMassMoments.resize(numLinks);
+    compositeInertias.resize(numLinks);
+
+    /*
+      The parent of each element of M11 in the LTDL factorization is the nearest ancestor
+      that has an unknown acceleration. The root link elements form a chain.
+    */
+    ltdlParents.resize(unknown_rootDof + torqueModeJoints.size());
+    for(int i=0; i < unknown_rootDof; ++i){
+        ltdlParents[i] = i - 1;
+    }
+    for(size_t i=0; i < torqueModeJoints.size(); ++i){
+        int parent = unknown_rootDof - 1;
+        int j = parentIndices[linkIndexToSubBodyLinkIndex[torqueModeJoints[i]->index()]];
+        while(j > 0){
+            if(unknownAccelIndices[j] >= 0){
+                parent = unknownAccelIndices[j];
+                break;
+            }
+            j = parentIndices[j];
+        }
+        ltdlParents[i + unknown_rootDof] = parent;
+    }
+
+    isM11Factorized = false;
+}
+
+
+/**
+   calculate the mass matrix using the composite rigid body method.
+   The spatial quantities are expressed in the world coordinate so that the inertia of a
+   composite rigid body is given by the simple sum of the inertias of the links.
+*/
+void ForwardDynamicsCBM::calcMassMatrixWithCompositeRigidBodyMethod()
+{
+    auto root = subBody->rootLink();
+    const int numLinks = subBody->numLinks();
+
+    for(int i=0; i < numLinks; ++i){
+        auto link = subBody->link(i);
+        compositeMasses[i] = link->m();
+        compositeMassMoments[i].noalias() = link->m() * link->wc();
+        compositeInertias[i] = link->Iww();
+    }
+
+    M11.setZero();
+    M12.setZero();
+
+    // The links are sorted so that each parent link precedes its child links
+    for(int i = numLinks - 1; i > 0; --i){
+        auto link = subBody->link(i);
+        const double m = compositeMasses[i];
+        const Vector3& h = compositeMassMoments[i];
+        const Matrix3& I = compositeInertias[i];
+        const int row = unknownAccelIndices[i];
+        const int col = givenAccelIndices[i];
+
+        if(row >= 0 || col >= 0){
+            // spatial force to accelerate the composite rigid body with the unit joint acceleration
+            const Vector3& sv = link->sv();
+            const Vector3& sw = link->sw();
+            const Vector3 f = m * sv + sw.cross(h);
+            Vector3 tau = h.cross(sv) + I * sw;
+
+            if(row >= 0){
+                M11(row, row) = sv.dot(f) + sw.dot(tau) + link->Jm2(); // with motor inertia
+            }
+            for(int j = parentIndices[i]; j > 0; j = parentIndices[j]){
+                const int row2 = unknownAccelIndices[j];
+                const int col2 = givenAccelIndices[j];
+                if(row2 >= 0 || (row >= 0 && col2 >= 0)){
+                    auto ancestor = subBody->link(j);
+                    const double Mij = ancestor->sv().dot(f) + ancestor->sw().dot(tau);
+                    if(row < 0){
+                        M12(row2, col) = Mij;
+                    } else if(row2 >= 0){
+                        M11(row, row2) = Mij;
+                        M11(row2, row) = Mij;
+                    } else {
+                        M12(row, col2) = Mij;
+                    }
+                }
+            }
+            if(unknown_rootDof || given_rootDof){
+                tau -= root->p().cross(f);
+                if(unknown_rootDof){
+                    if(row >= 0){
+                        M11.block<3, 1>(0, row) = f;
+                        M11.block<3, 1>(3, row) = tau;
+                        M11.block<1, 3>(row, 0) = f.transpose();
+                        M11.block<1, 3>(row, 3) = tau.transpose();
+                    } else {
+                        M12.block<3, 1>(0, col) = f;
+                        M12.block<3, 1>(3, col) = tau;
+                    }
+                } else if(row >= 0){
+                    M12.block<1, 3>(row, 0) = f.transpose();
+                    M12.block<1, 3>(row, 3) = tau.transpose();
+                }
+            }
+        }
+
+        const int parent = parentIndices[i];
+        compositeMasses[parent] += m;
+        compositeMassMoments[parent] += h;
+        compositeInertias[parent] += I;
+    }
+
+    if(unknown_rootDof){
+        // The columns correspond to (dv, dw) and the rows correspond to (f, tau - p x f)
+        const double m = compositeMasses[0];
+        const Vector3& h = compositeMassMoments[0];
+        const Vector3& p = root->p();
+        const Matrix3 d_hat = hat(h - m * p);
+        const Matrix3 p_hat = hat(p);
+        M11.block<3, 3>(0, 0) = m * Matrix3::Identity();
+        M11.block<3, 3>(3, 0) = d_hat;
+        M11.block<3, 3>(0, 3) = d_hat.transpose();
+        M11.block<3, 3>(3, 3).noalias() = compositeInertias[0] + hat(h) * p_hat + p_hat * d_hat;
+    }
+}
+
+
 void ForwardDynamicsCBM::calcInverseDynamics(DyLink* link, Vector3& out_f, Vector3& out_tau, bool isSubBodyRoot)
 {
     if(!isSubBodyRoot){
@@ -710,6 +888,60 @@ bool ForwardDynamicsCBM::solveUnknownAccels
     return true;
 }
 
+/**
+   The mass matrix M11 is factorized into L^T D L in place of M11_LTDL, where L is a unit lower
+   triangular matrix and D is a diagonal matrix. The elements that are not zero in L are
+   limited to the pairs of an element and its ancestors, and only they are processed.
+   See R. Featherstone, Rigid Body Dynamics Algorithms, Section 6.3.
+*/
+void ForwardDynamicsCBM::factorizeM11()
+{
+    M11_LTDL = M11;
+    auto& H = M11_LTDL;
+    const int n = H.rows();
+    isM11LtdlFactorizationValid = true;
+
+    for(int k = n - 1; k >= 0; --k){
+        const double d = H(k, k);
+        if(!(d > 1.0e-12)){
+            // The matrix is not positive definite due to a massless link, for example
+            isM11LtdlFactorizationValid = false;
+            break;
+        }
+        for(int i = ltdlParents[k]; i >= 0; i = ltdlParents[i]){
+            const double a = H(k, i) / d;
+            for(int j = i; j >= 0; j = ltdlParents[j]){
+                H(i, j) -= a * H(k, j);
+            }
+            H(k, i) = a;
+        }
+    }
+
+    isM11Factorized = true;
+}
+
+
+void ForwardDynamicsCBM::solveM11WithLtdlFactorization(VectorXd& x)
+{
+    const auto& H = M11_LTDL;
+    const int n = H.rows();
+
+    for(int i = n - 1; i >= 0; --i){
+        for(int j = ltdlParents[i]; j >= 0; j = ltdlParents[j]){
+            x[j] -= H(i, j) * x[i];
+        }
+    }
+    for(int i=0; i < n; ++i){
+        x[i] /= H(i, i);
+    }
+    for(int i=0; i < n; ++i){
+        for(int j = ltdlParents[i]; j >= 0; j = ltdlParents[j]){
+            x[i] -= H(i, j) * x[j];
+        }
+    }
+}
+
+
 void ForwardDynamicsCBM::solveUnknownAccels(const Vector3& fext, const Vector3& tauext)
 {
     if(unknown_rootDof){
@@ -724,17 +956,25 @@ void ForwardDynamicsCBM::solveUnknownAccels(const Vector3& fext, const Vector3&
     c1 -= d1;
     c1 -= b1.col(0);
 
-    const VectorXd a(M11.colPivHouseholderQr().solve(c1));
+    if(isLtdlFactorizationEnabled_ && !isM11Factorized){
+        factorizeM11();
+    }
+    if(isLtdlFactorizationEnabled_ && isM11LtdlFactorizationValid){
+        a1 = c1;
+        solveM11WithLtdlFactorization(a1);
+    } else {
+        a1 = M11.colPivHouseholderQr().solve(c1);
+    }
     
     if(unknown_rootDof){
         auto root = subBody->rootLink();
-        root->dw() = a.segment(3, 3);
-        const Vector3 dv = a.head(3);
+        root->dw() = a1.segment(3, 3);
+        const Vector3 dv = a1.head(3);
         root->dvo() = dv - root->dw().cross(root->p()) - root_w_x_v;
     }
 
     for(size_t i=0; i < torqueModeJoints.size(); ++i){
-        torqueModeJoints[i]->ddq() = a(i + unknown_rootDof);
+        torqueModeJoints[i]->ddq() = a1(i + unknown_rootDof);
     }
 }
 
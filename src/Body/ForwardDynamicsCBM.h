@@ -37,6 +37,22 @@ public:
     bool solveUnknownAccels(
         DyLink* link, const Vector3& fext, const Vector3& tauext, const Vector3& rootfext, const Vector3& roottauext);
 
+    /**
+       The mass matrix is calculated with the composite rigid body method by default.
+       The unit vector method, which requires O(n^2) computation time, is used when this is disabled.
+    */
+    void setCompositeRigidBodyMethodEnabled(bool on);
+    bool isCompositeRigidBodyMethodEnabled() const { return isCompositeRigidBodyMethodEnabled_; }
+
+    /**
+       The unknown accelerations are solved with the LTDL factorization, which exploits
+       the sparsity of the mass matrix given by the link tree, by default. The factorization
+       is reused until the mass matrix is updated. The QR decomposition of the whole mass
+       matrix is used when this is disabled.
+    */
+    void setLtdlFactorizationEnabled(bool on);
+    bool isLtdlFactorizationEnabled() const { return isLtdlFactorizationEnabled_; }
+
 private:
         
     /*
@@ -59,6 +75,7 @@ private:
     MatrixXd b1;
     VectorXd d1;
     VectorXd c1;
+    VectorXd a1; // solved unknown accelerations
 
     std::vector<DyLink*> torqueModeJoints;
     std::vector<DyLink*> highGainModeJoints;
@@ -98,6 +115,22 @@ private:
     Vector3 dvoorg;
     Vector3 dworg;
 
+    // buffers for the composite rigid body method
+    bool isCompositeRigidBodyMethodEnabled_;
+    std::vector<int> parentIndices;
+    std::vector<int> unknownAccelIndices; // row index of M11 or -1
+    std::vector<int> givenAccelIndices; // column index of M12 or -1
+    std::vector<double> compositeMasses;
+    std::vector<Vector3> compositeMassMoments; // m * c about the origin
+    std::vector<Matrix3> compositeInertias; // about the origin
+
+    // buffers for the LTDL factorization
+    bool isLtdlFactorizationEnabled_;
+    bool isM11Factorized;
+    bool isM11LtdlFactorizationValid;
+    MatrixXd M11_LTDL;
+    std::vector<int> ltdlParents;
+
     // Buffers for the Runge Kutta Method
     Isometry3 T0;
     Vector3 vo0;
@@ -120,7 +153,12 @@ private:
     void preserveHighGainModeJointState();
     void calcPositionAndVelocityFK();
     void calcMassMatrix();
+    void calcMassMatrixWithUnitVectorMethod();
     void setColumnOfMassMatrix(MatrixXd& M, int column);
+    void calcMassMatrixWithCompositeRigidBodyMethod();
+    void initializeCompositeRigidBodyMethod();
+    void factorizeM11();
+    void solveM11WithLtdlFactorization(VectorXd& x);
     void calcInverseDynamics(DyLink* link, Vector3& out_f, Vector3& out_tau, bool isSubBodyRoot);
     void calcd1(DyLink* link, Vector3& out_f, Vector3& out_tau, bool isSubBodyRoot);
     inline void calcAccelFKandForceSensorValues();
@@ -3,6 +3,7 @@
 #include "Link.h"
 #include "JointPath.h"
 #include <iostream>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
@@ -32,95 +33,244 @@ struct SubMass
     }
 };
 
-void calcSubMass(Link* link, vector<SubMass>& subMasses, bool calcIw)
+/**
+   The position and the mass properties of a link when its sub-mass was calculated.
+   The sub-mass is updated when any of them is changed.
+*/
+struct LinkMassState
 {
-    Matrix3d R = link->R();
-    SubMass& sub = subMasses[link->index()];
-    sub.m = link->m();
-    sub.mwc = link->m() * link->wc();
+    double m;
+    Vector3 wc;
+    Matrix3 R;
+    Matrix3 I;
 
-    for(Link* child = link->child(); child; child = child->sibling()){
-        calcSubMass(child, subMasses, calcIw);
-        SubMass& childSub = subMasses[child->index()];
-        sub.m += childSub.m;
-        sub.mwc += childSub.mwc;
+    bool update(Link* link){
+        if(link->m() == m && link->wc() == wc && link->R() == R && link->I() == I){
+            return false;
+        }
+        m = link->m();
+        wc = link->wc();
+        R = link->R();
+        I = link->I();
+        return true;
+    }
+};
+
+}
+
+namespace cnoid {
+
+class MomentumJacobianCalculator::Impl
+{
+public:
+    BodyPtr body;
+    Link* base;
+    // The sub-masses of the subtrees with the root link as the root of the tree
+    vector<SubMass> treeSubMasses;
+    // The sub-masses used for the Jacobians, which are modified for the path to the base link
+    vector<SubMass> subMasses;
+    vector<LinkMassState> massStates;
+    vector<char> isSubMassUpdated;
+    bool isIwAvailable;
+    // The links in the path from the root link to the base link excluding the root link
+    vector<Link*> pathLinks;
+    vector<int> sgn;
+    MatrixXd M;
+
+    Impl();
+    void setBody(Body* body, Link* base);
+    void invalidateSubMasses();
+    void updateTreeSubMasses(bool calcIw);
+    const vector<SubMass>& updateSubMasses(bool calcIw);
+    void calcCMJacobian(MatrixXd& J, bool calcIw);
+    void calcAngularMomentumJacobian(MatrixXd& H);
+};
+
+}
+
+
+MomentumJacobianCalculator::MomentumJacobianCalculator()
+{
+    impl = new Impl;
+}
+
+
+MomentumJacobianCalculator::MomentumJacobianCalculator(Body* body, Link* base)
+    : MomentumJacobianCalculator()
+{
+    impl->setBody(body, base);
+}
+
+
+MomentumJacobianCalculator::Impl::Impl()
+{
+    base = nullptr;
+    isIwAvailable = false;
+}
+
+
+MomentumJacobianCalculator::~MomentumJacobianCalculator()
+{
+    delete impl;
+}
+
+
+void MomentumJacobianCalculator::setBody(Body* body, Link* base)
+{
+    impl->setBody(body, base);
+}
+
+
+void MomentumJacobianCalculator::Impl::setBody(Body* body, Link* base)
+{
+    this->body = body;
+    this->base = base;
+
+    const int numLinks = body->numLinks();
+    treeSubMasses.resize(numLinks);
+    subMasses.resize(numLinks);
+    massStates.resize(numLinks);
+    isSubMassUpdated.resize(numLinks);
+
+    const int nj = body->numJoints();
+    sgn.assign(nj, 1);
+    pathLinks.clear();
+    if(base){
+        JointPath path(body->rootLink(), base);
+        for(int i=0; i < path.numJoints(); ++i){
+            Link* joint = path.joint(i);
+            pathLinks.push_back(joint);
+            sgn[joint->jointId()] = -1;
+        }
     }
     
-    if(calcIw){
-        if(sub.m != 0.0){
-            sub.Iw = R * link->I() * R.transpose() + link->m() * D(link->wc() - sub.mwc/sub.m);
-        } else {
-            sub.Iw = R * link->I() * R.transpose();
+    M.resize(3, base ? nj : nj + 6);
+
+    invalidateSubMasses();
+}
+
+
+void MomentumJacobianCalculator::invalidateSubMasses()
+{
+    impl->invalidateSubMasses();
+}
+
+
+void MomentumJacobianCalculator::Impl::invalidateSubMasses()
+{
+    // NaN never equals the current mass so that the sub-masses of all the links are updated
+    for(auto& state : massStates){
+        state.m = std::numeric_limits<double>::quiet_NaN();
+    }
+    isIwAvailable = false;
+}
+
+
+void MomentumJacobianCalculator::Impl::updateTreeSubMasses(bool calcIw)
+{
+    const bool updateAll = calcIw && !isIwAvailable;
+    const int numLinks = body->numLinks();
+    bool isAnyUpdated = false;
+
+    for(int i=0; i < numLinks; ++i){
+        isSubMassUpdated[i] = massStates[i].update(body->link(i)) || updateAll;
+    }
+
+    // The links are sorted so that each parent link precedes its child links
+    for(int i = numLinks - 1; i >= 0; --i){
+        if(!isSubMassUpdated[i]){
+            continue;
         }
+        Link* link = body->link(i);
+        SubMass& sub = treeSubMasses[i];
+        sub.m = link->m();
+        sub.mwc = link->m() * link->wc();
         for(Link* child = link->child(); child; child = child->sibling()){
-            SubMass& childSub = subMasses[child->index()];
-            if(sub.m != 0.0 && childSub.m != 0.0){
-                sub.Iw += childSub.Iw + childSub.m * D(childSub.mwc/childSub.m - sub.mwc/sub.m);
+            const SubMass& childSub = treeSubMasses[child->index()];
+            sub.m += childSub.m;
+            sub.mwc += childSub.mwc;
+        }
+        if(calcIw){
+            const Matrix3& R = link->R();
+            if(sub.m != 0.0){
+                sub.Iw = R * link->I() * R.transpose() + link->m() * D(link->wc() - sub.mwc/sub.m);
             } else {
-                sub.Iw += childSub.Iw;
+                sub.Iw = R * link->I() * R.transpose();
             }
+            for(Link* child = link->child(); child; child = child->sibling()){
+                const SubMass& childSub = treeSubMasses[child->index()];
+                if(sub.m != 0.0 && childSub.m != 0.0){
+                    sub.Iw += childSub.Iw + childSub.m * D(childSub.mwc/childSub.m - sub.mwc/sub.m);
+                } else {
+                    sub.Iw += childSub.Iw;
+                }
+            }
+        }
+        if(Link* parent = link->parent()){
+            isSubMassUpdated[parent->index()] = true;
         }
+        isAnyUpdated = true;
     }
-}
 
+    if(calcIw){
+        isIwAvailable = true;
+    } else if(isAnyUpdated){
+        isIwAvailable = false;
+    }
 }
 
-namespace cnoid {
 
-/**
-   @brief compute CoM Jacobian
-   @param base link fixed to the environment
-   @param J CoM Jacobian
-   @note Link::wc must be computed by calcCM() before calling
-*/
-void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J)
+const vector<SubMass>& MomentumJacobianCalculator::Impl::updateSubMasses(bool calcIw)
 {
-    // prepare subm, submwc
+    updateTreeSubMasses(calcIw);
+
+    if(!base || pathLinks.empty()){
+        return treeSubMasses;
+    }
+
+    subMasses = treeSubMasses;
 
-    const int nj = body->numJoints();
-    vector<SubMass> subMasses(body->numLinks());
     Link* rootLink = body->rootLink();
-    std::vector<int> sgn(nj, 1);
-        
-    if(!base){
-        calcSubMass(rootLink, subMasses, false);
-        J.resize(3, nj + 6);
-
-    } else {
-        JointPath path(rootLink, base);
-        Link* skip = path.joint(0);
-        SubMass& sub = subMasses[skip->index()];
-        sub.m = rootLink->m();
-        sub.mwc = rootLink->m() * rootLink->wc();
-            
-        for(Link* child = rootLink->child(); child; child = child->sibling()){
-            if(child != skip){
-                calcSubMass(child, subMasses, false);
-                const SubMass& c = subMasses[child->index()];
-                sub.m += c.m;
-                sub.mwc += c.mwc;
-            }
-        }
-            
-        // assuming there is no branch between base and root
-        for(int i=1; i < path.numJoints(); i++){
-            Link* joint = path.joint(i);
-            const Link* parent = joint->parent();
-            SubMass& sub = subMasses[joint->index()];
-            sub.m = parent->m();
-            sub.mwc = parent->m() * parent->wc();
-            const SubMass& p = subMasses[parent->index()];
-            sub.m += p.m;
-            sub.mwc += p.mwc;
-        }
-            
-        J.resize(3, nj);
+    Link* skip = pathLinks.front();
+    SubMass& sub = subMasses[skip->index()];
+    sub.m = rootLink->m();
+    sub.mwc = rootLink->m() * rootLink->wc();
+    sub.Iw.setZero();
 
-        for(int i=0; i < path.numJoints(); i++){
-            sgn[path.joint(i)->jointId()] = -1;
+    for(Link* child = rootLink->child(); child; child = child->sibling()){
+        if(child != skip){
+            sub += subMasses[child->index()];
         }
     }
-        
+
+    // assuming there is no branch between base and root
+    for(size_t i=1; i < pathLinks.size(); ++i){
+        Link* joint = pathLinks[i];
+        const Link* parent = joint->parent();
+        SubMass& sub = subMasses[joint->index()];
+        sub.m = parent->m();
+        sub.mwc = parent->m() * parent->wc();
+        sub.Iw.setZero();
+        sub += subMasses[parent->index()];
+    }
+
+    return subMasses;
+}
+
+
+void MomentumJacobianCalculator::calcCMJacobian(Eigen::MatrixXd& out_J)
+{
+    impl->calcCMJacobian(out_J, false);
+}
+
+
+void MomentumJacobianCalculator::Impl::calcCMJacobian(MatrixXd& J, bool calcIw)
+{
+    const auto& subMasses = updateSubMasses(calcIw);
+
+    const int nj = body->numJoints();
+    J.resize(3, base ? nj : nj + 6);
+
     // compute Jacobian
     for(int i=0; i < nj; i++){
         Link* joint = body->joint(i);
@@ -140,7 +290,7 @@ void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J)
         const int c = nj;
         J.block(0, c, 3, 3).setIdentity();
 
-        const Vector3 dp = subMasses[0].mwc / body->mass() - rootLink->p();
+        const Vector3 dp = subMasses[0].mwc / body->mass() - body->rootLink()->p();
 
         J.block(0, c + 3, 3, 3) <<
             0.0,  dp(2), -dp(1),
@@ -149,61 +299,23 @@ void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J)
     }
 }
 
-/**
-   @brief compute Angular Momentum Jacobian
-   @param base link fixed to the environment
-   @param H Angular Momentum Jacobian
-   @note Link::wc must be computed by calcCM() before calling
-*/
-void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H)
+
+void MomentumJacobianCalculator::calcAngularMomentumJacobian(Eigen::MatrixXd& out_H)
 {
+    impl->calcAngularMomentumJacobian(out_H);
+}
 
-    // prepare subm, submwc
 
-    const int nj = body->numJoints();
-    std::vector<SubMass> subMasses(body->numLinks());
-    Link* rootLink = body->rootLink();
-    std::vector<int> sgn(nj, 1);
+void MomentumJacobianCalculator::Impl::calcAngularMomentumJacobian(MatrixXd& H)
+{
+    calcCMJacobian(M, true);
+    const auto& subMasses = (!base || pathLinks.empty()) ? treeSubMasses : this->subMasses;
 
-    MatrixXd M;
-    calcCMJacobian( body, base, M );
-    M.conservativeResize(3, nj);
-    M *= body->mass();
+    const int nj = body->numJoints();
+    auto Mj = M.leftCols(nj);
+    Mj *= body->mass();
 
-    if(!base){
-        calcSubMass(rootLink, subMasses, true);
-        H.resize(3, nj + 6);
-
-    } else {
-        JointPath path(rootLink, base);
-        Link* skip = path.joint(0);
-        SubMass& sub = subMasses[skip->index()];
-        sub.m = rootLink->m();
-        sub.mwc = rootLink->m() * rootLink->wc();
-            
-        for(Link* child = rootLink->child(); child; child = child->sibling()){
-            if(child != skip){
-                calcSubMass(child, subMasses, true);
-                sub += subMasses[child->index()];
-            }
-        }
-            
-        // assuming there is no branch between base and root
-        for(int i=1; i < path.numJoints(); i++){
-            Link* joint = path.joint(i);
-            const Link* parent = joint->parent();
-            SubMass& sub = subMasses[joint->index()];
-            sub.m = parent->m();
-            sub.mwc = parent->m() * parent->wc();
-            sub += subMasses[parent->index()];
-        }
-            
-        H.resize(3, nj);
-
-        for(int i=0; i < path.numJoints(); i++){
-            sgn[path.joint(i)->jointId()] = -1;
-        }
-    }
+    H.resize(3, base ? nj : nj + 6);
 
     // compute Jacobian
     for(int i=0; i < nj; ++i){
@@ -211,7 +323,7 @@ void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H)
         if(joint->isRevoluteJoint()){
             const Vector3 omega = sgn[joint->jointId()] * joint->R() * joint->a();
             const SubMass& sub = subMasses[joint->index()];
-            const Vector3 Mcol = M.col(joint->jointId());
+            const Vector3 Mcol = Mj.col(joint->jointId());
             Vector3 dp;
             if(sub.m != 0.0){
                 dp = (sub.mwc/sub.m).cross(Mcol) + sub.Iw * omega;
@@ -225,22 +337,47 @@ void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H)
         }
     }
 
-
     if(!base){
         const int c = nj;
+        const SubMass& sub = subMasses[body->rootLink()->index()];
         H.block(0, c, 3, 3).setZero();
-        H.block(0, c+3, 3, 3) = subMasses[rootLink->index()].Iw;
+        H.block(0, c+3, 3, 3) = sub.Iw;
 
-        Vector3 cm = body->calcCenterOfMass();
+        const Vector3 cm = sub.mwc / sub.m;
         Matrix3d cm_cross;
         cm_cross <<
             0.0,  -cm(2), cm(1),
             cm(2),    0.0,  -cm(0),
             -cm(1), cm(0),    0.0;
-        H.block(0,0,3,c) -= cm_cross * M;
-
+        H.block(0,0,3,c).noalias() -= cm_cross * Mj;
     }
-    
+}
+
+
+namespace cnoid {
+
+/**
+   @brief compute CoM Jacobian
+   @param base link fixed to the environment
+   @param J CoM Jacobian
+   @note Link::wc must be computed by calcCM() before calling
+*/
+void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J)
+{
+    MomentumJacobianCalculator calculator(body, base);
+    calculator.calcCMJacobian(J);
+}
+
+/**
+   @brief compute Angular Momentum Jacobian
+   @param base link fixed to the environment
+   @param H Angular Momentum Jacobian
+   @note Link::wc must be computed by calcCM() before calling
+*/
+void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H)
+{
+    MomentumJacobianCalculator calculator(body, base);
+    calculator.calcAngularMomentumJacobian(H);
 }
 
 }
@@ -12,6 +12,37 @@ CNOID_EXPORT void calcCMJacobian(Body* body, Link* base, Eigen::MatrixXd& J);
 
 CNOID_EXPORT void calcAngularMomentumJacobian(Body* body, Link* base, Eigen::MatrixXd& H);
 
+/**
+   This class calculates the CoM Jacobian and the angular momentum Jacobian with the buffers
+   kept in the object so that no memory is allocated in a control loop. The sub-masses of the
+   links are also kept, and only the sub-masses of the links whose positions or mass properties
+   have been changed since the previous calculation and those of their ancestors are updated.
+   Link::wc must be computed by Body::calcCenterOfMass before calling the calculation functions.
+*/
+class CNOID_EXPORT MomentumJacobianCalculator
+{
+public:
+    MomentumJacobianCalculator();
+    MomentumJacobianCalculator(Body* body, Link* base = nullptr);
+    MomentumJacobianCalculator(const MomentumJacobianCalculator& org) = delete;
+    MomentumJacobianCalculator& operator=(const MomentumJacobianCalculator& rhs) = delete;
+    ~MomentumJacobianCalculator();
+
+    //! \param base link fixed to the environment
+    void setBody(Body* body, Link* base = nullptr);
+
+    //! The next calculation updates the sub-masses of all the links.
+    void invalidateSubMasses();
+    
+    void calcCMJacobian(Eigen::MatrixXd& out_J);
+    void calcAngularMomentumJacobian(Eigen::MatrixXd& out_H);
+
+    class Impl;
+
+private:
+    Impl* impl;
+};
+
 template<int elementMask, int rowOffset, int colOffset, bool useTargetLinkLocalPos>
 void setJacobian(const JointPath& path, Link* targetLink, const Vector3& targetLinkLocalPos,
                  MatrixXd& out_J) {
@@ -106,6 +137,113 @@ void setJacobian(const JointPath& path, Link* targetLink, MatrixXd& out_J) {
         path, targetLink, targetLinkLocalPos, out_J);
 }
 
+/**
+   This function sets the time derivative of the Jacobian given by setJacobian with the same template arguments.
+   The velocities of the links must be calculated by the forward kinematics before calling this function.
+*/
+template<int elementMask, int rowOffset, int colOffset, bool useTargetLinkLocalPos>
+void setJacobianDot(const JointPath& path, Link* targetLink, const Vector3& targetLinkLocalPos,
+                    MatrixXd& out_dJ) {
+
+    const bool isTranslationValid = static_cast<bool>(elementMask & 0x7);
+
+    Vector3 target_p;
+    Vector3 target_v;
+    if(isTranslationValid){
+        if(useTargetLinkLocalPos){
+            const Vector3 localArm = targetLink->R() * targetLinkLocalPos;
+            target_p = targetLink->p() + localArm;
+            target_v = targetLink->v() + targetLink->w().cross(localArm);
+        } else {
+            target_p = targetLink->p();
+            target_v = targetLink->v();
+        }
+    }
+
+    int n = path.numJoints();
+    int i = 0;
+    while(i < n){
+
+        Link* link = path.joint(i);
+        int row = rowOffset;
+
+        MatrixXd::ColXpr dJi = out_dJ.col(i + colOffset);
+
+        switch(link->jointType()){
+
+        case Link::RevoluteJoint:
+        {
+            Vector3 omega = link->R() * link->a();
+            if(!path.isJointDownward(i)){
+                omega = -omega;
+            }
+            const Vector3 domega = link->w().cross(omega);
+            if(isTranslationValid){
+                const Vector3 ddp = domega.cross(target_p - link->p()) + omega.cross(target_v - link->v());
+                if(elementMask & 0x1) dJi(row++) = ddp.x();
+                if(elementMask & 0x2) dJi(row++) = ddp.y();
+                if(elementMask & 0x4) dJi(row++) = ddp.z();
+            }
+            if(elementMask & 0x8)  dJi(row++) = domega.x();
+            if(elementMask & 0x10) dJi(row++) = domega.y();
+            if(elementMask & 0x20) dJi(row  ) = domega.z();
+        }
+        break;
+
+        case Link::PrismaticJoint:
+        {
+            if(isTranslationValid){
+                Vector3 dp = link->R() * link->d();
+                if(!path.isJointDownward(i)){
+                    dp = -dp;
+                }
+                const Vector3 ddp = link->w().cross(dp);
+                if(elementMask & 0x1) dJi(row++) = ddp.x();
+                if(elementMask & 0x2) dJi(row++) = ddp.y();
+                if(elementMask & 0x4) dJi(row++) = ddp.z();
+            }
+            if(elementMask & 0x8)  dJi(row++) = 0.0;
+            if(elementMask & 0x10) dJi(row++) = 0.0;
+            if(elementMask & 0x20) dJi(row  ) = 0.0;
+        }
+        break;
+
+        default:
+            if(elementMask & 0x1)  dJi(row++) = 0.0;
+            if(elementMask & 0x2)  dJi(row++) = 0.0;
+            if(elementMask & 0x4)  dJi(row++) = 0.0;
+            if(elementMask & 0x8)  dJi(row++) = 0.0;
+            if(elementMask & 0x10) dJi(row++) = 0.0;
+            if(elementMask & 0x20) dJi(row  ) = 0.0;
+        }
+
+        ++i;
+
+        if(link == targetLink){
+            break;
+        }
+    }
+
+    while(i < n){
+        MatrixXd::ColXpr dJi = out_dJ.col(i + colOffset);
+        int row = rowOffset;
+        if(elementMask & 0x1)  dJi(row++) = 0.0;
+        if(elementMask & 0x2)  dJi(row++) = 0.0;
+        if(elementMask & 0x4)  dJi(row++) = 0.0;
+        if(elementMask & 0x8)  dJi(row++) = 0.0;
+        if(elementMask & 0x10) dJi(row++) = 0.0;
+        if(elementMask & 0x20) dJi(row  ) = 0.0;
+        ++i;
+    }
+}
+
+template<int elementMask, int rowOffset, int colOffset>
+void setJacobianDot(const JointPath& path, Link* targetLink, MatrixXd& out_dJ) {
+    static const Vector3 targetLinkLocalPos(Vector3::Zero());
+    setJacobianDot<elementMask, rowOffset, colOffset, false>(
+        path, targetLink, targetLinkLocalPos, out_dJ);
+}
+
 }
 
 #endif
@@ -55,6 +55,7 @@ public:
     VectorXd dTask;
     VectorXd dq;
     MatrixXd JJ;
+    VectorXd JJinv_dTask;
     Eigen::ColPivHouseholderQR<MatrixXd> QR;
     TruncatedSVD<MatrixXd> svd;
     std::function<double(VectorXd& out_error)> errorFunc;
@@ -75,6 +76,8 @@ public:
     void resize(int numJoints){
         J.resize(dTask.size(), numJoints);
         dq.resize(numJoints);
+        JJ.resize(dTask.size(), dTask.size());
+        JJinv_dTask.resize(dTask.size());
     }
 };
 
@@ -405,8 +408,11 @@ bool JointPath::calcInverseKinematics(const Isometry3& T)
                 nuIK->svd.compute(nuIK->J).solve(nuIK->dTask, nuIK->dq);
             } else {
                 // The damped least squares (singurality robust inverse) method
-                nuIK->JJ = nuIK->J * nuIK->J.transpose() + nuIK->dampingConstantSqr * MatrixXd::Identity(nuIK->J.rows(), nuIK->J.rows());
-                nuIK->dq = nuIK->J.transpose() * nuIK->QR.compute(nuIK->JJ).solve(nuIK->dTask);
+                // The products are evaluated into the buffers to avoid allocating temporaries in the loop
+                nuIK->JJ.noalias() = nuIK->J * nuIK->J.transpose();
+                nuIK->JJ.diagonal().array() += nuIK->dampingConstantSqr;
+                nuIK->JJinv_dTask = nuIK->QR.compute(nuIK->JJ).solve(nuIK->dTask);
+                nuIK->dq.noalias() = nuIK->J.transpose() * nuIK->JJinv_dTask;
             }
         }
 
@@ -5,6 +5,8 @@
 #include "MassMatrix.h"
 #include "Link.h"
 #include "InverseDynamics.h"
+#include <cnoid/EigenUtil>
+#include <vector>
 
 using namespace cnoid;
 
@@ -30,20 +32,155 @@ void setColumnOfMassMatrix(Body* body, Eigen::MatrixBase<Derived>& out_M, int co
     }
 }
 
+
+void setColumnsOfMassMatrixWithUnitVectorMethod(Body* body, MatrixXd& out_M)
+{
+    Link* rootLink = body->rootLink();
+
+    if(!rootLink->isFixedJoint()){
+        for(int i=0; i < 3; ++i){
+            rootLink->dv()[i] += 1.0;
+            setColumnOfMassMatrix(body, out_M, i);
+            rootLink->dv()[i] -= 1.0;
+        }
+        for(int i=0; i < 3; ++i){
+            rootLink->dw()[i] = 1.0;
+            setColumnOfMassMatrix(body, out_M, i + 3);
+            rootLink->dw()[i] = 0.0;
+        }
+    }
+
+    const int nj = body->numJoints();
+    const int offset = rootLink->isFixedJoint() ? 0 : 6;
+    for(int i = 0; i < nj; ++i){
+        Link* joint = body->joint(i);
+        joint->ddq() = 1.0;
+        const int j = i + offset;
+        setColumnOfMassMatrix(body, out_M, j);
+
+        // Note that the following operation is not necessary because the motor inertia is
+        // added in the setColumnOfMassMatrix function.
+        // out_M(j, j) += joint->Jm2(); // motor inertia
+
+        joint->ddq() = 0.0;
+    }
 }
 
-namespace cnoid {
 
 /**
-   calculate the mass matrix using the unit vector method
-   \todo replace the unit vector method here with a more efficient method
-
-   The motion equation (dv != dvo)
-   |       |   | dv  |   |   |   | fext      |
-   | out_M | * | dw  | + | b | = | tauext    |
-   |       |   | ddq |   |   |   | u         |
+   The inertia of a composite rigid body about the world origin.
+   The composite inertia of a subtree is the simple sum of the inertias of its links
+   because all the spatial quantities are expressed in the world coordinate.
 */
-void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, VectorXd& out_b)
+struct CompositeInertia
+{
+    double m;
+    Vector3 h;  // m * c
+    Matrix3 I;  // rotational inertia about the origin
+
+    void add(const CompositeInertia& inertia){
+        m += inertia.m;
+        h += inertia.h;
+        I += inertia.I;
+    }
+
+    // spatial force (f, tau) to produce the spatial acceleration (dvo, dw)
+    void calcForce(const Vector3& dvo, const Vector3& dw, Vector3& out_f, Vector3& out_tau) const {
+        out_f.noalias() = m * dvo + dw.cross(h);
+        out_tau.noalias() = h.cross(dvo) + I * dw;
+    }
+};
+
+
+void setElementsOfMassMatrixWithCompositeRigidBodyMethod(Body* body, MatrixXd& out_M)
+{
+    const int numLinks = body->numLinks();
+    const int nj = body->numJoints();
+    Link* rootLink = body->rootLink();
+    const int offset = rootLink->isFixedJoint() ? 0 : 6;
+
+    std::vector<CompositeInertia> inertias(numLinks);
+    std::vector<Vector3> sv(numLinks);
+    std::vector<Vector3> sw(numLinks);
+    std::vector<int> rows(numLinks, -1);
+
+    for(int i=0; i < numLinks; ++i){
+        Link* link = body->link(i);
+        auto& inertia = inertias[i];
+        const Vector3 c = link->R() * link->c() + link->p();
+        const Matrix3 c_hat = hat(c);
+        inertia.m = link->m();
+        inertia.h = link->m() * c;
+        inertia.I.noalias() = link->R() * link->I() * link->R().transpose();
+        inertia.I.noalias() += link->m() * c_hat * c_hat.transpose();
+
+        const int id = link->jointId();
+        if(i > 0 && id >= 0 && id < nj && body->joint(id) == link){
+            rows[i] = id + offset;
+            switch(link->jointType()){
+            case Link::RevoluteJoint:
+                sw[i].noalias() = link->R() * link->a();
+                sv[i].noalias() = link->p().cross(sw[i]);
+                break;
+            case Link::PrismaticJoint:
+                sw[i].setZero();
+                sv[i].noalias() = link->R() * link->d();
+                break;
+            default:
+                sw[i].setZero();
+                sv[i].setZero();
+                break;
+            }
+        }
+    }
+
+    out_M.setZero();
+
+    // The links are sorted so that each parent link precedes its child links
+    for(int i = numLinks - 1; i > 0; --i){
+        Link* link = body->link(i);
+        const auto& inertia = inertias[i];
+        const int row = rows[i];
+        if(row >= 0){
+            Vector3 f, tau;
+            inertia.calcForce(sv[i], sw[i], f, tau);
+            out_M(row, row) = sv[i].dot(f) + sw[i].dot(tau) + link->Jm2();
+
+            Link* ancestor = link->parent();
+            while(ancestor->parent()){
+                const int j = ancestor->index();
+                const int row2 = rows[j];
+                if(row2 >= 0){
+                    out_M(row, row2) = out_M(row2, row) = sv[j].dot(f) + sw[j].dot(tau);
+                }
+                ancestor = ancestor->parent();
+            }
+            if(offset){
+                tau -= rootLink->p().cross(f);
+                out_M.block<3, 1>(0, row) = f;
+                out_M.block<3, 1>(3, row) = tau;
+                out_M.block<1, 3>(row, 0) = f.transpose();
+                out_M.block<1, 3>(row, 3) = tau.transpose();
+            }
+        }
+        inertias[link->parent()->index()].add(inertia);
+    }
+
+    if(offset){
+        // The columns correspond to (dv, dw) and the rows correspond to (f, tau - p x f)
+        const auto& inertia = inertias[0];
+        const Vector3& p = rootLink->p();
+        const Matrix3 d_hat = hat(inertia.h - inertia.m * p);
+        const Matrix3 p_hat = hat(p);
+        out_M.block<3, 3>(0, 0) = inertia.m * Matrix3::Identity();
+        out_M.block<3, 3>(3, 0) = d_hat;
+        out_M.block<3, 3>(0, 3) = d_hat.transpose();
+        out_M.block<3, 3>(3, 3).noalias() = inertia.I + hat(inertia.h) * p_hat + p_hat * d_hat;
+    }
+}
+
+
+void calcMassMatrixSub(Body* body, const Vector3& g, MatrixXd& out_M, VectorXd& out_b, bool isUnitVectorMethod)
 {
     const int nj = body->numJoints();
     Link* rootLink = body->rootLink();
@@ -71,36 +208,14 @@ void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, Vector
     out_b.resize(totaldof);
     setColumnOfMassMatrix(body, out_b, 0);
 
-    if(!rootLink->isFixedJoint()){
-        for(int i=0; i < 3; ++i){
-            rootLink->dv()[i] += 1.0;
-            setColumnOfMassMatrix(body, out_M, i);
-            rootLink->dv()[i] -= 1.0;
+    if(isUnitVectorMethod){
+        setColumnsOfMassMatrixWithUnitVectorMethod(body, out_M);
+        // subtract the constant term
+        for(int i = 0; i < out_M.cols(); ++i){
+            out_M.col(i) -= out_b;
         }
-        for(int i=0; i < 3; ++i){
-            rootLink->dw()[i] = 1.0;
-            setColumnOfMassMatrix(body, out_M, i + 3);
-            rootLink->dw()[i] = 0.0;
-        }
-    }
-
-    const int offset = rootLink->isFixedJoint() ? 0 : 6;
-    for(int i = 0; i < nj; ++i){
-        Link* joint = body->joint(i);
-        joint->ddq() = 1.0;
-        const int j = i + offset;
-        setColumnOfMassMatrix(body, out_M, j);
-        
-        // Note that the following operation is not necessary because the motor inertia is
-        // added in the setColumnOfMassMatrix function.
-        // out_M(j, j) += joint->Jm2(); // motor inertia
-        
-        joint->ddq() = 0.0;
-    }
-
-    // subtract the constant term
-    for(int i = 0; i < out_M.cols(); ++i){
-        out_M.col(i) -= out_b;
+    } else {
+        setElementsOfMassMatrixWithCompositeRigidBodyMethod(body, out_M);
     }
 
     // recover state
@@ -113,6 +228,30 @@ void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, Vector
     rootLink->dw() = dworg;
 }
 
+}
+
+namespace cnoid {
+
+/**
+   calculate the mass matrix using the composite rigid body method
+
+   The motion equation (dv != dvo)
+   |       |   | dv  |   |   |   | fext      |
+   | out_M | * | dw  | + | b | = | tauext    |
+   |       |   | ddq |   |   |   | u         |
+*/
+void calcMassMatrix(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, VectorXd& out_b)
+{
+    calcMassMatrixSub(body, g, out_M, out_b, false);
+}
+
+
+void calcMassMatrixWithUnitVectorMethod(Body* body, const Vector3& g, Eigen::MatrixXd& out_M, VectorXd& out_b)
+{
+    calcMassMatrixSub(body, g, out_M, out_b, true);
+}
+
+
 void calcMassMatrix(Body* body, MatrixXd& out_M)
 {
     VectorXd b;
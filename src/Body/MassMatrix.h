@@ -10,9 +10,20 @@
 
 namespace cnoid {
 
+/**
+   These functions calculate the mass matrix with the composite rigid body method,
+   which requires O(nd) computation time where d is the depth of the link tree.
+*/
 CNOID_EXPORT void calcMassMatrix(Body* body, MatrixXd& out_M);
 CNOID_EXPORT void calcMassMatrix(Body* body, const Vector3& g, MatrixXd& out_M, VectorXd& out_b);
 
+/**
+   This function calculates the mass matrix with the unit vector method, which
+   requires O(n^2) computation time. The result is the same as that of calcMassMatrix.
+*/
+CNOID_EXPORT void calcMassMatrixWithUnitVectorMethod(
+    Body* body, const Vector3& g, MatrixXd& out_M, VectorXd& out_b);
+
 }
 
 #endif
@@ -1,5 +1,6 @@
 #include "PenetrationBlocker.h"
 #include <cnoid/SceneGraph>
+#include <limits>
 
 using namespace std;
 using namespace cnoid;
@@ -8,6 +9,14 @@ namespace {
 
 const bool TRACE_FUNCTIONS = false;
 
+/**
+   The distance within which the distance between the target link and the opponent links is detected.
+   The distance detection is not executed while the target link moves within this distance from the
+   position where the previous detection was executed because the collision detection is faster than
+   the distance detection when the target link is close to the opponent links.
+*/
+const double SeparationCheckDistance = 0.01;
+
 typedef CollisionDetector::GeometryHandle GeometryHandle;
 
 }
@@ -18,18 +27,33 @@ class PenetrationBlockerImpl
 {
 public:
     CollisionDetectorPtr collisionDetector;
+    CollisionDetectorDistanceAPI* distanceAPI;
     bool isCollisionDetectorReady;
 
     Link* targetLink;
     stdx::optional<GeometryHandle> targetLinkGeometry;
+    // The radius of the sphere that encloses the target link shape with the center at the link origin
+    double targetLinkRadius;
 
     struct LinkInfo {
         Link* link;
         GeometryHandle geometry;
+        Vector3 separationTranslation;
+        Matrix3 separationRotation;
         LinkInfo(Link* link, GeometryHandle geometry)
-            : link(link), geometry(geometry) { }
+            : link(link), geometry(geometry),
+              separationTranslation(link->p()), separationRotation(link->R()) { }
     };
     vector<LinkInfo> opponentLinkInfos;
+
+    /*
+      The target link is guaranteed to be apart from the opponent links while it moves less than
+      separationDistance from the position where the distance was detected.
+    */
+    bool isSeparationInfoValid;
+    double separationDistance;
+    Vector3 separationTranslation;
+    Matrix3 separationRotation;
         
     double targetDepth;
     Vector3 pPrevGiven;
@@ -45,6 +69,8 @@ public:
     void addOpponentLink(Link* link);
     void start();
     bool adjust(Isometry3& io_T, const Vector3& pushDirection);
+    double calcMotionFromSeparationPosition(const Isometry3& T);
+    bool updateSeparationDistance(const Isometry3& T);
     void onCollisionDetected(const CollisionPair& collisionPair);
 };
 }
@@ -60,9 +86,24 @@ PenetrationBlockerImpl::PenetrationBlockerImpl(CollisionDetectorPtr& collisionDe
     : collisionDetector(collisionDetector),
       targetLink(targetLink)
 {
+    distanceAPI = dynamic_cast<CollisionDetectorDistanceAPI*>(collisionDetector.get());
     collisionDetector->clearGeometries();
     targetLinkGeometry = collisionDetector->addGeometry(targetLink->collisionShape());
     isCollisionDetectorReady = false;
+
+    targetLinkRadius = 0.0;
+    if(auto shape = targetLink->collisionShape()){
+        const BoundingBox& bbox = shape->boundingBox();
+        if(!bbox.empty()){
+            const Vector3& min = bbox.min();
+            const Vector3& max = bbox.max();
+            for(int i=0; i < 8; ++i){
+                Vector3 corner((i & 1) ? max.x() : min.x(), (i & 2) ? max.y() : min.y(), (i & 4) ? max.z() : min.z());
+                targetLinkRadius = std::max(targetLinkRadius, corner.norm());
+            }
+        }
+    }
+    isSeparationInfoValid = false;
     pPrevGiven = targetLink->p();
     targetDepth = 0.001;
     isPrevBlocked = false;
@@ -113,6 +154,7 @@ void PenetrationBlockerImpl::start()
         }
     }
     isPrevBlocked = false;
+    isSeparationInfoValid = false;
 }
 
 
@@ -135,6 +177,18 @@ bool PenetrationBlockerImpl::adjust(Isometry3& io_T, const Vector3& pushDirectio
         }
     }
 
+    bool doDistanceDetection = (distanceAPI != nullptr);
+    if(isSeparationInfoValid){
+        double motion = calcMotionFromSeparationPosition(io_T);
+        if(motion < separationDistance){
+            isPrevBlocked = false;
+            return false;
+        }
+        if(motion < SeparationCheckDistance){
+            doDistanceDetection = false;
+        }
+    }
+
     bool blocked = false;
     s = pushDirection.normalized();
     
@@ -149,6 +203,10 @@ bool PenetrationBlockerImpl::adjust(Isometry3& io_T, const Vector3& pushDirectio
 
         collisionDetector->updatePosition(*targetLinkGeometry, io_T);
 
+        if(loop == 0 && doDistanceDetection && updateSeparationDistance(io_T)){
+            break;
+        }
+
         maxsdepth = 0.0;
         maxdepth = 0.0;
 
@@ -171,6 +229,55 @@ bool PenetrationBlockerImpl::adjust(Isometry3& io_T, const Vector3& pushDirectio
 }
 
 
+/**
+   \return The upper bound of the distance moved by any point of the target link
+*/
+double PenetrationBlockerImpl::calcMotionFromSeparationPosition(const Isometry3& T)
+{
+    for(auto& info : opponentLinkInfos){
+        if(info.link->p() != info.separationTranslation || info.link->R() != info.separationRotation){
+            return std::numeric_limits<double>::max();
+        }
+    }
+    return (T.translation() - separationTranslation).norm() +
+        AngleAxis(separationRotation.transpose() * T.linear()).angle() * targetLinkRadius;
+}
+
+
+/**
+   The distance detection with the temporal coherence is used to confirm that the target link is
+   apart from the opponent links. The distance is also used to skip the detection in the following
+   calls while the target link moves a little, which is usual when it is being dragged.
+   \return true if the target link is apart from the opponent links
+*/
+bool PenetrationBlockerImpl::updateSeparationDistance(const Isometry3& T)
+{
+    separationDistance = SeparationCheckDistance;
+    bool isDetected = distanceAPI->detectDistances(
+        *targetLinkGeometry, SeparationCheckDistance,
+        [&](const CollisionPair&, double distance, const Vector3&, const Vector3&){
+            if(distance < separationDistance){
+                separationDistance = distance;
+            }
+        });
+    if(!isDetected){
+        // The collision detector does not provide the distances of the target geometry pairs
+        distanceAPI = nullptr;
+        return false;
+    }
+
+    isSeparationInfoValid = true;
+    separationTranslation = T.translation();
+    separationRotation = T.linear();
+    for(auto& info : opponentLinkInfos){
+        info.separationTranslation = info.link->p();
+        info.separationRotation = info.link->R();
+    }
+
+    return separationDistance > 0.0;
+}
+
+
 void PenetrationBlockerImpl::onCollisionDetected(const CollisionPair& collisionPair)
 {
     double normalSign = (collisionPair.geometry(0) == *targetLinkGeometry) ? -1.0 : 1.0;
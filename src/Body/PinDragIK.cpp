@@ -8,6 +8,7 @@
 #include "JointPath.h"
 #include <cnoid/EigenUtil>
 #include <map>
+#include <chrono>
 #include <iostream>
 #include <algorithm>
 
@@ -18,15 +19,32 @@ namespace {
 
 const bool SOLVE_CONSTRAINTS_BY_SR_INVERSE = false;
 const bool SOLVE_CONSTRAINTS_BY_SVD = !SOLVE_CONSTRAINTS_BY_SR_INVERSE;
+
+/**
+   The buffers used to invert matrices by the LU decomposition.
+   They are kept in the IK object so that no memory is allocated in each step.
+*/
+struct LUWorkspace
+{
+    vector<int> pivots; // row exchange index
+    vector<double> weights;
+    VectorXd unitVector;
+    void resize(int n){
+        pivots.resize(n);
+        weights.resize(n);
+        unitVector.resize(n);
+    }
+};
     
-double calcLU(int n, MatrixXd& a, vector<int>& pivots);
+double calcLU(int n, MatrixXd& a, LUWorkspace& lu);
 void solveByLU(int n, MatrixXd& a, vector<int>& pivots, const MatrixXd::ColXpr& x, const VectorXd& b);
-bool makeInverseMatrix(int n, MatrixXd& org, MatrixXd& inv, double minValidDet);
-bool makePseudoInverseType1(int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJinv, double minValidDet);
+bool makeInverseMatrix(int n, MatrixXd& org, MatrixXd& inv, double minValidDet, LUWorkspace& lu);
+bool makePseudoInverseType1(int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJinv,
+                            double minValidDet, LUWorkspace& lu);
 bool makePseudoInverseType2(int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJinv,
-                            const VectorXd& weights, double minValidDet);
+                            const VectorXd& weights, double minValidDet, LUWorkspace& lu);
 bool makeSRInverseMatrix(int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJ2, MatrixXd& JJinv,
-                         vector<int>& pivots, double srk0, double srw0);
+                         LUWorkspace& lu, double srk0, double srw0);
 }
 
 
@@ -83,7 +101,13 @@ public:
     MatrixXd S;        // (C x N)
     MatrixXd Sinv;    
             
-    MatrixXd JJ2;    
+    // The matrices used to solve the constraints, which are separated from JJ and JJinv
+    // so that the buffer sizes are not changed in each step
+    MatrixXd SS;      // (S * S^T) (C x C)
+    MatrixXd SS2;
+    MatrixXd SSinv;   // SS^-1
+
+    Eigen::JacobiSVD<MatrixXd> svd;
             
     // Joint space vector to solve (size N)
     // This vector includes elements of 6-DOF root joint (dx, dy, dz, OmegaX, OmegaY, OmegaZ)
@@ -96,7 +120,7 @@ public:
             
     VectorXd y;   // size N
             
-    vector<int> pivots;
+    LUWorkspace lu;
             
     bool isBaseLinkFreeMode;
     bool isTargetAttitudeEnabled;
@@ -133,6 +157,8 @@ public:
     double srk0; // k of the singular point
     double srw0; // threshold value to calc k
 
+    double lastSolvingTime;
+
     enum IKStepResult { ERROR, PINS_NOT_CONVERGED, PINS_CONVERGED };
 
     void setBaseLink(Link* baseLink);
@@ -153,6 +179,7 @@ public:
     void setJacobianForOnePath(MatrixXd& J, int row, JointPath& jointPath, int axes);
     void setJacobianForFreeRoot(MatrixXd& J, int row, JointPath& jointPath, int axes);
     void addPinConstraints();
+    void updateJointRangeConstraints();
     void addJointRangeConstraints();
     int solveLinearEquationWithSVD(MatrixXd& A, VectorXd& b, VectorXd& x, double sv_ratio);
 };
@@ -189,6 +216,8 @@ PinDragIKImpl::PinDragIKImpl(Body* body)
     setIKErrorThresh(1.0e-5);
     setSRInverseParameters(0.1, 0.001);
 
+    lastSolvingTime = 0.0;
+
     //enableJointRangeConstraints(true);
     enableJointRangeConstraints(false);
 }
@@ -439,20 +468,19 @@ bool PinDragIKImpl::initialize()
 
     dPaux.resize(C);
 
-    int JJsize;
-    if(C <= N && M <= N){
-        JJsize = C > M ? C : M;
-    } else {
-        JJsize = N;
-    }
-
+    int JJsize = (N >= M) ? M : N;
     JJ.resize(JJsize, JJsize);
-    JJ2.resize(JJsize, JJsize);
     JJinv.resize(JJsize, JJsize);
 
+    SS.resize(C, C);
+    SS2.resize(C, C);
+    SSinv.resize(C, C);
+
     W.resize(N, N);
-  
-    pivots.resize(C);  
+
+    // The joint range constraints may increase the size
+    lu.resize(std::max(JJsize, C));
+    jointConstraints.reserve(NJ);
 
     fkTraverse.find(baseLink, true, true);
 
@@ -466,8 +494,16 @@ bool PinDragIK::calcInverseKinematics(const Isometry3& T)
 }
 
 
+double PinDragIK::lastSolvingTime() const
+{
+    return impl->lastSolvingTime;
+}
+
+
 bool PinDragIKImpl::calcInverseKinematics(const Isometry3& T)
 {
+    auto startTime = std::chrono::steady_clock::now();
+    
     for(int i=0; i < NJ; i++){
         q_org[i] = body_->joint(i)->q();
     }
@@ -512,6 +548,9 @@ bool PinDragIKImpl::calcInverseKinematics(const Isometry3& T)
         }
     }
 
+    lastSolvingTime =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+
     return (result != ERROR);
 }
 
@@ -530,9 +569,9 @@ PinDragIKImpl::IKStepResult PinDragIKImpl::calcOneStep(const Vector3& v, const V
 
     bool isOk;
     if(N >= M){
-        isOk = makePseudoInverseType2(M, N, J, Jinv, JJ, JJinv, qWeights, minValidDet);
+        isOk = makePseudoInverseType2(M, N, J, Jinv, JJ, JJinv, qWeights, minValidDet, lu);
     } else {
-        isOk = makePseudoInverseType1(M, N, J, Jinv, JJ, JJinv, minValidDet);
+        isOk = makePseudoInverseType1(M, N, J, Jinv, JJ, JJinv, minValidDet, lu);
     }
     if(!isOk){
         return ERROR;
@@ -605,7 +644,8 @@ PinDragIKImpl::IKStepResult PinDragIKImpl::calcOneStep(const Vector3& v, const V
 void PinDragIKImpl::solveConstraints()
 {
     // W = (E - J# J)  (size N x N)
-    W.noalias() = MatrixXd::Identity(N, N) - Jinv * J;
+    W.setIdentity();
+    W.noalias() -= Jinv * J;
     
     // normalize W for weighted theta
     /*
@@ -624,6 +664,18 @@ void PinDragIKImpl::solveConstraints()
       }
     */
 
+    int numConstraints = C;
+    if(isJointRangeConstraintsEnabled){
+        updateJointRangeConstraints();
+        numConstraints += jointConstraints.size();
+    }
+    if(Jaux.rows() != numConstraints){
+        // The elements which are not set by addPinConstraints must be zero
+        Jaux.resize(numConstraints, N);
+        Jaux.setZero();
+        dPaux.resize(numConstraints);
+    }
+
     addPinConstraints();
 
     if(isJointRangeConstraintsEnabled){
@@ -648,11 +700,13 @@ void PinDragIKImpl::solveConstraints()
     */
 
     if(SOLVE_CONSTRAINTS_BY_SR_INVERSE){
-        makeSRInverseMatrix(C, N, S, Sinv, JJ, JJ2, JJinv, pivots, srk0, srw0);
+        makeSRInverseMatrix(numConstraints, N, S, Sinv, SS, SS2, SSinv, lu, srk0, srw0);
         y.noalias() = Sinv * deltaPaux;
 
     } else if(SOLVE_CONSTRAINTS_BY_SVD){
-        y = Eigen::JacobiSVD<MatrixXd>(S, Eigen::ComputeThinU | Eigen::ComputeThinV).solve(deltaPaux);
+        // The buffers of the decomposition are reused while the size of S is not changed
+        svd.compute(S, Eigen::ComputeThinU | Eigen::ComputeThinV);
+        y = svd.solve(deltaPaux);
     }
 
     // dq = dq0 + W y
@@ -761,7 +815,7 @@ void PinDragIKImpl::addPinConstraints()
 }
 
 
-void PinDragIKImpl::addJointRangeConstraints()
+void PinDragIKImpl::updateJointRangeConstraints()
 {
     jointConstraints.clear();
     
@@ -773,12 +827,12 @@ void PinDragIKImpl::addJointRangeConstraints()
             jointConstraints.push_back(JointConstrain(i, link->q_upper() - link->q()));
         }
     }
+}
 
-    const int C2 = jointConstraints.size();
 
-    Jaux.conservativeResize(C + C2, N);
-    dPaux.conservativeResize(C + C2);
-    S.resize(C + C2, N);
+void PinDragIKImpl::addJointRangeConstraints()
+{
+    const int C2 = jointConstraints.size();
 
     for(int i=0; i < C2; ++i){
         int r = C + i;
@@ -795,12 +849,16 @@ void PinDragIKImpl::addJointRangeConstraints()
 namespace {
 
 /**
-   \param pivots row exchange index in LU decomposition (size = n)
+   \param lu.pivots row exchange index in LU decomposition (size = n)
 */
-double calcLU(int n, MatrixXd& a, vector<int>& pivots)
+double calcLU(int n, MatrixXd& a, LUWorkspace& lu)
 {
+    if(static_cast<int>(lu.pivots.size()) < n){
+        lu.resize(n);
+    }
+    vector<int>& pivots = lu.pivots;
+    vector<double>& weight = lu.weights;
     double det = 1.0; 
-    vector<double> weight(n);    
         
     // get the max element and a scaling value in each row 
     double v, max;
@@ -879,17 +937,16 @@ void solveByLU(int n, MatrixXd& a, vector<int>& pivots, const MatrixXd::ColXpr&
 }
 
 
-bool makeInverseMatrix(int n, MatrixXd& org, MatrixXd& inv, double minValidDet)
+bool makeInverseMatrix(int n, MatrixXd& org, MatrixXd& inv, double minValidDet, LUWorkspace& lu)
 {
-    vector<int> pivots(n);
-    VectorXd unitVector(n);
+    VectorXd& unitVector = lu.unitVector;
     unitVector.setZero();
 
-    double det = calcLU(n, org, pivots);
+    double det = calcLU(n, org, lu);
     if(det > minValidDet || det < -minValidDet){
         for(int i=0; i < n; i++){
             unitVector[i] = 1.0;
-            solveByLU(n, org, pivots, inv.col(i), unitVector);
+            solveByLU(n, org, lu.pivots, inv.col(i), unitVector);
             unitVector[i] = 0.0;
         }
         return true;
@@ -901,13 +958,14 @@ bool makeInverseMatrix(int n, MatrixXd& org, MatrixXd& inv, double minValidDet)
 
 // N < M
 bool makePseudoInverseType1
-(int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJinv, double minValidDet)
+(int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJinv,
+ double minValidDet, LUWorkspace& lu)
 {
     // JJ = J^T * J
     JJ.noalias() = J.transpose() * J;
 
     // Jinv = (J^T * J)^-1 * J^T
-    if(makeInverseMatrix(n, JJ, JJinv, minValidDet)){
+    if(makeInverseMatrix(n, JJ, JJinv, minValidDet, lu)){
         Jinv.noalias() = JJinv * J.transpose();
         return true;
     }
@@ -919,7 +977,7 @@ bool makePseudoInverseType1
 // N > M
 bool makePseudoInverseType2
 (int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJinv,
- const VectorXd& weights, double minValidDet)
+ const VectorXd& weights, double minValidDet, LUWorkspace& lu)
 {
     // JJ = J * W^-1 * J^T
     for(int i=0; i < m; i++){
@@ -932,7 +990,7 @@ bool makePseudoInverseType2
     }
 
     // Jinv = W^-1 * J^T * (J * W^-1 * J^T)^-1
-    if(makeInverseMatrix(m, JJ, JJinv, minValidDet)){
+    if(makeInverseMatrix(m, JJ, JJinv, minValidDet, lu)){
         for(int i=0; i < n; i++){
             for(int j=0; j < m; j++){
                 Jinv(i,j) = 0.0;
@@ -952,13 +1010,13 @@ bool makePseudoInverseType2
 // calculate J^T(J J^T + kI)^-1
 bool makeSRInverseMatrix
 (int m, int n, const MatrixXd& J, MatrixXd& Jinv, MatrixXd& JJ, MatrixXd& JJ2, MatrixXd& JJinv,
- vector<int>& pivots, double srk0, double srw0)
+ LUWorkspace& lu, double srk0, double srw0)
 {
     // JJ = J J^T
     JJ.noalias() = J * J.transpose();
 
     JJ2 = JJ;
-    double det = calcLU(m, JJ2, pivots);
+    double det = calcLU(m, JJ2, lu);
     double w = sqrt(det);
     
     double k;
@@ -977,7 +1035,8 @@ bool makeSRInverseMatrix
     }
 
     // J^T JJ'^-1
-    if(makeInverseMatrix(m, JJ, JJinv, 0.0)){
+    JJinv.resize(m, m);
+    if(makeInverseMatrix(m, JJ, JJinv, 0.0, lu)){
         Jinv.noalias() = J.transpose() * JJinv;
         return true;
     }
@@ -48,6 +48,9 @@ public:
 
     virtual bool calcInverseKinematics(const Isometry3& T) override;
 
+    //! The time in seconds taken by the last calcInverseKinematics call
+    double lastSolvingTime() const;
+
 private:
     PinDragIKImpl* impl;
 };
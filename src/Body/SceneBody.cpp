@@ -475,8 +475,35 @@ void SceneBody::cloneShapes(CloneMap& cloneMap)
 }
 
 
+int SceneBody::materializeDeferredShapes(SgUpdateRef update)
+{
+    int numMaterialized = 0;
+    for(auto& sceneLink : sceneLinks_){
+        if(auto shape = sceneLink->visualShape()){
+            numMaterialized += SgDeferredGroup::materializeSubTree(shape, update);
+        }
+    }
+    return numMaterialized;
+}
+
+
+bool SceneBody::hasDeferredShapes() const
+{
+    for(auto& sceneLink : sceneLinks_){
+        auto shape = static_cast<const SceneLink*>(sceneLink.get())->visualShape();
+        if(shape && SgDeferredGroup::hasDeferredNodes(shape)){
+            return true;
+        }
+    }
+    return false;
+}
+
+
 void SceneBody::updateLinkPositions(SgUpdateRef update)
 {
+    // The notifications from the links are coalesced into one notification per ancestor node
+    SgUpdateBatch batch(static_cast<bool>(update));
+    
     // Main body
     impl->updateLinkPositions(body_, sceneLinks_, update);
 
@@ -72,6 +72,14 @@ public:
 
     void cloneShapes(CloneMap& cloneMap);
 
+    /**
+       The visual shapes loaded with the lazy visual shape loading mode of the body loader
+       contain placeholder nodes. This function loads the actual shapes of them.
+       \return The number of the materialized nodes
+    */
+    int materializeDeferredShapes(SgUpdateRef update = nullptr);
+    bool hasDeferredShapes() const;
+
     int numSceneLinks() const { return sceneLinks_.size(); }
     SceneLink* sceneLink(int index) { return sceneLinks_[index]; }
     const SceneLink* sceneLink(int index) const { return sceneLinks_[index]; }
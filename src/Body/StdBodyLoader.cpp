@@ -208,6 +208,7 @@ public:
     double defaultCreaseAngle;
     bool isVerbose;
     bool isShapeLoadingEnabled;
+    bool isLazyVisualShapeLoadingEnabled;
 
     BodyHandlerManager bodyHandlerManager;
 
@@ -250,6 +251,7 @@ public:
     bool readVisualOrCollision(Mapping* node, bool isVisual);
     bool readVisualOrCollisionContents(Mapping* node);
     bool readResource(Mapping* node);
+    bool readNodeAsDeferredVisualNode(Mapping* node, const string& type);
     bool readDevice(Device* device, const Mapping* node);
     void readContinuousTrackNode(Mapping* linkNode);
     void addTrackLink(int index, LinkPtr link, Mapping* node, string& io_parent, double initialAngle);
@@ -450,6 +452,7 @@ StdBodyLoader::Impl::Impl(StdBodyLoader* self)
     os_ = &cout;
     isVerbose = false;
     isShapeLoadingEnabled = true;
+    isLazyVisualShapeLoadingEnabled = false;
     defaultDivisionNumber = -1;
     defaultCreaseAngle = -1.0;
 }
@@ -487,6 +490,12 @@ void StdBodyLoader::setShapeLoadingEnabled(bool on)
 }
 
 
+void StdBodyLoader::setLazyVisualShapeLoadingEnabled(bool on)
+{
+    impl->isLazyVisualShapeLoadingEnabled = on;
+}
+
+
 void StdBodyLoader::setDefaultDivisionNumber(int n)
 {
     impl->defaultDivisionNumber = n;
@@ -728,6 +737,7 @@ bool StdBodyLoader::Impl::loadAnotherFormatBodyFile(Mapping* topNode)
     bodyLoader->setMessageSink(os());
     bodyLoader->setVerbose(isVerbose);
     bodyLoader->setShapeLoadingEnabled(isShapeLoadingEnabled);
+    bodyLoader->setLazyVisualShapeLoadingEnabled(isLazyVisualShapeLoadingEnabled);
     bodyLoader->setDefaultCreaseAngle(defaultCreaseAngle);
 
     int dn = defaultDivisionNumber;
@@ -1478,7 +1488,9 @@ bool StdBodyLoader::Impl::readNode(Mapping* node, const string& type)
         nameStack.pop_back();
         
     } else if(isShapeLoadingEnabled){
-        if(auto scene = sceneReader.readNode(node, type)){
+        if(readNodeAsDeferredVisualNode(node, type)){
+            isSceneNodeAdded = true;
+        } else if(auto scene = sceneReader.readNode(node, type)){
             addScene(scene);
             isSceneNodeAdded = true;
         }
@@ -1671,7 +1683,9 @@ bool StdBodyLoader::Impl::readVisualOrCollisionContents(Mapping* node)
         }
         auto shape = node->findMapping("shape");
         if(shape->isValid()){
-            if(auto scene = sceneReader.readNode(shape, "Shape")){
+            if(readNodeAsDeferredVisualNode(shape, "Shape")){
+                isSceneNodeAdded = true;
+            } else if(auto scene = sceneReader.readNode(shape, "Shape")){
                 addScene(scene);
                 isSceneNodeAdded = true;
             }
@@ -1685,6 +1699,10 @@ bool StdBodyLoader::Impl::readVisualOrCollisionContents(Mapping* node)
 bool StdBodyLoader::Impl::readResource(Mapping* node)
 {
     bool isSceneNodeAdded = false;
+
+    if(readNodeAsDeferredVisualNode(node, "Resource")){
+        return true;
+    }
     
     auto resource = sceneReader.readResourceNode(node);
 
@@ -1710,6 +1728,18 @@ bool StdBodyLoader::Impl::readResource(Mapping* node)
 }
         
 
+bool StdBodyLoader::Impl::readNodeAsDeferredVisualNode(Mapping* node, const string& type)
+{
+    if(isLazyVisualShapeLoadingEnabled && currentModelType == VISUAL){
+        if(auto deferred = sceneReader.readNodeAsDeferred(node, type)){
+            addScene(deferred);
+            return true;
+        }
+    }
+    return false;
+}
+
+
 bool StdBodyLoader::readDevice(Device* device, const Mapping* info)
 {
     return impl->readDevice(device, info);
@@ -1829,6 +1859,7 @@ void StdBodyLoader::Impl::readSubBodyNode(Mapping* node)
                 subLoader->impl->isSubLoader = true;
             }
             subLoader->setDefaultDivisionNumber(sceneReader.defaultDivisionNumber());
+            subLoader->setLazyVisualShapeLoadingEnabled(isLazyVisualShapeLoadingEnabled);
                 
             subBody = new Body;
             if(subLoader->load(subBody, filename)){
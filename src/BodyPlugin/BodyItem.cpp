@@ -534,6 +534,16 @@ void BodyItem::cloneShapes(CloneMap& cloneMap)
 }
 
 
+void BodyItem::materializeDeferredShapes()
+{
+    for(auto& link : impl->body->links()){
+        if(auto shape = link->visualShape()){
+            SgDeferredGroup::materializeSubTree(shape, true);
+        }
+    }
+}
+
+
 SignalProxy<void()> BodyItem::sigKinematicStateChanged()
 {
     return impl->sigKinematicStateChanged.signal();
@@ -1008,6 +1018,8 @@ void BodyItem::Impl::emitSigKinematicStateChanged()
         }
     }
 
+    // Scene graph updates caused by the handlers are notified at once after the emission
+    SgUpdateBatch sgUpdateBatch;
     sigKinematicStateChanged.signal()();
 }
 
@@ -2041,6 +2053,7 @@ void BodyItem::getDependentFiles(std::vector<std::string>& out_files)
     if(!fp.empty()){
         out_files.push_back(fp);
 
+        materializeDeferredShapes();
         auto util = impl->getOrCreateRenderableItemUtil();
         for(auto& link : impl->body->links()){
             util->getSceneFilesForArchiving(link->shape(), out_files);
@@ -2055,6 +2068,7 @@ void BodyItem::getDependentFiles(std::vector<std::string>& out_files)
 void BodyItem::relocateDependentFiles
 (std::function<std::string(const std::string& path)> getRelocatedFilePath)
 {
+    materializeDeferredShapes();
     auto util = impl->getOrCreateRenderableItemUtil();
     util->initializeSceneObjectUrlRelocation();
     for(auto& link : impl->body->links()){
@@ -54,6 +54,12 @@ public:
     bool isSharingShapes() const;
     void cloneShapes(CloneMap& cloneMap);
 
+    /**
+       This function loads the visual shapes deferred by the lazy visual shape loading.
+       Note that each deferred shape is loaded automatically when it is actually rendered.
+    */
+    void materializeDeferredShapes();
+
     // API for a composite body
     // The following body and link pair is basically determined by
     // the parent-child relationship in the item tree
@@ -7,6 +7,7 @@
 #include <cnoid/StdSceneWriter>
 #include <cnoid/ObjSceneWriter>
 #include <cnoid/ItemManager>
+#include <cnoid/AppConfig>
 #include <cnoid/SceneGraph>
 #include <QLabel>
 #include <QSpinBox>
@@ -153,7 +154,7 @@ void BodyItemFileIoBase::addTransformIntegrationCheck(QBoxLayout* box)
 
 
 BodyItemBodyFileIO::BodyItemBodyFileIO()
-    : BodyItemFileIoBase("CHOREONOID-BODY", Load | Save | Options | OptionPanelForSaving)
+    : BodyItemFileIoBase("CHOREONOID-BODY", Load | Save | Options | OptionPanelForSaving | Preload)
 {
     setCaption(_("Body"));
     setExtensionsForLoading({ "body", "yaml", "yml", "wrl" });
@@ -163,6 +164,9 @@ BodyItemBodyFileIO::BodyItemBodyFileIO()
 
     bodyLoader_ = nullptr;
     bodyWriter_ = nullptr;
+
+    isLazyVisualShapeLoadingEnabled_ =
+        AppConfig::archive()->findMapping("BodyItem")->get("lazy_visual_shape_loading", false);
 }
 
 
@@ -177,21 +181,51 @@ BodyItemBodyFileIO::~BodyItemBodyFileIO()
 }
 
 
+void BodyItemBodyFileIO::setLazyVisualShapeLoadingEnabled(bool on)
+{
+    isLazyVisualShapeLoadingEnabled_ = on;
+    if(bodyLoader_){
+        bodyLoader_->setLazyVisualShapeLoadingEnabled(on);
+    }
+}
+
+
 BodyLoader* BodyItemBodyFileIO::ensureBodyLoader()
 {
     if(!bodyLoader_){
         bodyLoader_ = new BodyLoader;
         bodyLoader_->setMessageSink(os());
+        bodyLoader_->setLazyVisualShapeLoadingEnabled(isLazyVisualShapeLoadingEnabled_);
     }
     return bodyLoader_;
 }
 
 
-bool BodyItemBodyFileIO::load(BodyItem* item, const std::string& filename)
+/**
+   A loader instance is created for each call because this function may be executed
+   by multiple worker threads at the same time.
+*/
+ReferencedPtr BodyItemBodyFileIO::preload(const std::string& filename, std::ostream& os)
 {
+    BodyLoader loader;
+    loader.setMessageSink(os);
+    loader.setLazyVisualShapeLoadingEnabled(isLazyVisualShapeLoadingEnabled_);
     BodyPtr newBody = new Body;
-    if(!ensureBodyLoader()->load(newBody, filename)){
-        return false;
+    if(!loader.load(newBody, filename)){
+        return nullptr;
+    }
+    return newBody;
+}
+
+
+bool BodyItemBodyFileIO::load(BodyItem* item, const std::string& filename)
+{
+    BodyPtr newBody = dynamic_pointer_cast<Body>(takePreloadedData(filename));
+    if(!newBody){
+        newBody = new Body;
+        if(!ensureBodyLoader()->load(newBody, filename)){
+            return false;
+        }
     }
     item->setBody(newBody);
     
@@ -235,6 +269,7 @@ void BodyItemBodyFileIO::fetchOptionPanelForSaving()
 
 bool BodyItemBodyFileIO::save(BodyItem* item, const std::string& filename)
 {
+    item->materializeDeferredShapes();
     if(ensureBodyWriter()->writeBody(item->body(), filename)){
         if(auto overwriteAddon = item->findAddon<BodyOverwriteAddon>()){
             overwriteAddon->removeOverwriteItems(false);
@@ -293,7 +328,8 @@ SceneFileExporterBase::SceneFileExporterBase(const char* caption, const char* fo
 bool SceneFileExporterBase::save(BodyItem* item, const std::string& filename)
 {
     bool saved = false;
-    
+
+    item->materializeDeferredShapes();
     auto body = item->body();
     int numLinks = body->numLinks();
     vector<SgNode*> nodesToClearName;
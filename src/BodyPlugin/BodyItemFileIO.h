@@ -40,10 +40,20 @@ public:
 
     StdBodyWriter* bodyWriter(){ return ensureBodyWriter(); }
 
+    /**
+       When this is enabled, the visual-only mesh resources of loaded bodies are not loaded until
+       the scene of the body item is requested or the body is used by a vision sensor simulation.
+       The mode can also be enabled with the "lazy_visual_shape_loading" key of the "BodyItem"
+       section in the configuration file.
+    */
+    void setLazyVisualShapeLoadingEnabled(bool on);
+    bool isLazyVisualShapeLoadingEnabled() const { return isLazyVisualShapeLoadingEnabled_; }
+
 protected:
     BodyLoader* ensureBodyLoader();
     StdBodyWriter* ensureBodyWriter();
 
+    virtual ReferencedPtr preload(const std::string& filename, std::ostream& os) override;
     virtual bool load(BodyItem* item, const std::string& filename) override;
     virtual void createOptionPanelForSaving() override;
     virtual void fetchOptionPanelForSaving() override;
@@ -52,6 +62,7 @@ protected:
 private:
     BodyLoader* bodyLoader_;
     StdBodyWriter* bodyWriter_;
+    bool isLazyVisualShapeLoadingEnabled_;
 };
 
 }
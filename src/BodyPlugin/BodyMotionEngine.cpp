@@ -15,6 +15,14 @@ typedef std::function<TimeSyncItemEngine*(BodyItem* bodyItem, AbstractSeqItem* s
 typedef map<string, ExtraSeqEngineFactory> ExtraSeqEngineFactoryMap;
 ExtraSeqEngineFactoryMap extraSeqEngineFactories;
 
+// The link positions of the frames in this period ahead of the current time are calculated in advance
+constexpr double PrefetchDuration = 0.5;
+
+int numFramesToPrefetch(double frameRate)
+{
+    return std::max(1, static_cast<int>(PrefetchDuration * frameRate));
+}
+
 }
 
 
@@ -36,29 +44,29 @@ void BodyMotionEngineCore::updateBodyPosition(const BodyPositionSeqFrame& frame)
 
 bool BodyMotionEngineCore::updateBodyPosition_(Body* body, const BodyPositionSeqFrame& frame)
 {
-    bool needFk = false;
+    bool needFk = updateSingleBodyPosition(body, frame.firstBlock(), true);
+    updateMultiplexBodyPositions(body, frame);
+    return needFk;
+}
 
-    // Main body
-    auto frameBlock = frame.firstBlock();
-    if(updateSingleBodyPosition(body, frameBlock, true)){
-        needFk = true;
-    }
 
-    // Multiplex bodies
-    frameBlock = frame.nextBlockOf(frameBlock);
+/**
+   \return true if the multiplex bodies exist or have been cleared
+*/
+bool BodyMotionEngineCore::updateMultiplexBodyPositions(Body* body, const BodyPositionSeqFrame& frame)
+{
+    auto frameBlock = frame.nextBlockOf(frame.firstBlock());
     if(!frameBlock){
-        body->clearMultiplexBodies();
-    } else {
-        Body* multiplexBody = body;
-        while(frameBlock){
-            multiplexBody = multiplexBody->getOrCreateNextMultiplexBody();
-            updateSingleBodyPosition(multiplexBody, frameBlock, false);
-            frameBlock = frame.nextBlockOf(frameBlock);
-        }
-        multiplexBody->clearMultiplexBodies();
+        return body->clearMultiplexBodies();
     }
-
-    return needFk;
+    Body* multiplexBody = body;
+    while(frameBlock){
+        multiplexBody = multiplexBody->getOrCreateNextMultiplexBody();
+        updateSingleBodyPosition(multiplexBody, frameBlock, false);
+        frameBlock = frame.nextBlockOf(frameBlock);
+    }
+    multiplexBody->clearMultiplexBodies();
+    return true;
 }
 
 
@@ -101,6 +109,108 @@ bool BodyMotionEngineCore::updateSingleBodyPosition(Body* body, BodyPositionSeqF
 }
 
 
+/**
+   This function only updates the joint displacements and the link positions that differ from the
+   current ones, and the forward kinematics is only executed for the links below them. The result
+   is the same as the one of updateSingleBodyPosition and Body::calcForwardKinematics.
+   \return true if the state of the body is changed
+*/
+bool BodyMotionEngineCore::updateMainBodyPositionIncrementally
+(Body* body, BodyPositionSeqFrameBlock frameBlock, BodyPositionPrefetcher* prefetcher, int frameIndex)
+{
+    bool isChanged = false;
+
+    const int numAllLinks = body->numLinks();
+    const int numLinkPositions = std::min(numAllLinks, frameBlock.numLinkPositions());
+    if(numLinkPositions == 0){
+        if(body->existence()){
+            body->setExistence(false);
+            isChanged = true;
+        }
+    } else if(!body->existence()){
+        body->setExistence(true);
+        isChanged = true;
+    }
+
+    linkUpdateFlags.assign(numAllLinks, false);
+
+    const int numJoints = std::min(body->numAllJoints(), frameBlock.numJointDisplacements());
+    if(numJoints > 0){
+        auto displacements = frameBlock.jointDisplacements();
+        for(int i=0; i < numJoints; ++i){
+            auto joint = body->joint(i);
+            if(joint->q() != displacements[i]){
+                joint->q() = displacements[i];
+                linkUpdateFlags[joint->index()] = true;
+                isChanged = true;
+            }
+        }
+    }
+
+    /*
+      When the positions of some links are not given, the positions of all the links except
+      the root link are given by the forward kinematics as well as updateSingleBodyPosition.
+    */
+    const bool needFk = (numLinkPositions > 0 && numLinkPositions < numAllLinks);
+    const int numGivenLinkPositions = needFk ? 1 : numLinkPositions;
+    for(int i=0; i < numGivenLinkPositions; ++i){
+        auto link = body->link(i);
+        auto linkPosition = frameBlock.linkPosition(i);
+        const Matrix3 R = linkPosition.rotation().toRotationMatrix();
+        if(link->translation() != linkPosition.translation() || link->rotation() != R){
+            link->setTranslation(linkPosition.translation());
+            link->setRotation(R);
+            linkUpdateFlags[i] = true;
+            isChanged = true;
+        }
+    }
+
+    if(needFk && isChanged){
+        if(!prefetcher || !prefetcher->fetch(frameIndex, frameBlock, body)){
+            calcForwardKinematicsOfUpdatedLinks(body);
+        }
+    }
+
+    return isChanged;
+}
+
+
+/**
+   The links are sorted so that the parent of a link precedes the link,
+   so the flags can be propagated to the descendant links in a single loop.
+*/
+void BodyMotionEngineCore::calcForwardKinematicsOfUpdatedLinks(Body* body)
+{
+    Vector3 arm;
+    const int numLinks = body->numLinks();
+    for(int i=1; i < numLinks; ++i){
+        Link* link = body->link(i);
+        const Link* parent = link->parent();
+        if(!linkUpdateFlags[parent->index()] && !linkUpdateFlags[i]){
+            continue;
+        }
+        linkUpdateFlags[i] = true;
+
+        switch(link->jointType()){
+        case Link::RevoluteJoint:
+            link->R().noalias() = parent->R() * link->Rb() * AngleAxisd(link->q(), link->a());
+            arm.noalias() = parent->R() * link->b();
+            break;
+        case Link::PrismaticJoint:
+            link->R().noalias() = parent->R() * link->Rb();
+            arm.noalias() = parent->R() * (link->b() + link->Rb() * (link->q() * link->d()));
+            break;
+        case Link::FixedJoint:
+        default:
+            link->R().noalias() = parent->R() * link->Rb();
+            arm.noalias() = parent->R() * link->b();
+            break;
+        }
+        link->p().noalias() = parent->p() + arm;
+    }
+}
+
+
 // Note that updating velocities are only supported for the main body
 void BodyMotionEngineCore::updateBodyVelocity(Body* body, const BodyPositionSeqFrame& prevFrame, double timeStep)
 {
@@ -164,6 +274,7 @@ BodyMotionEngine::BodyMotionEngine(BodyItem* bodyItem, BodyMotionItem* motionIte
 {
     auto motion = motionItem->motion();
     positionSeq = motion->positionSeq();
+    lastRequestedFrameIndex = -1;
     
     updateExtraSeqEngines();
     
@@ -200,6 +311,19 @@ void BodyMotionEngine::onPlaybackStarted(double time)
 {
     if(auto bodyItem_ = core.bodyItemRef.lock()){
         bodyItem_->notifyKinematicStateUpdate(false);
+
+        /*
+          The link positions are calculated in advance when they are not stored in the motion
+          and the forward kinematics is required for each frame.
+        */
+        auto body = bodyItem_->body();
+        int numLinkPositions = positionSeq->numLinkPositionsHint();
+        if(numLinkPositions > 0 && numLinkPositions < body->numLinks() &&
+           !motionItem_->isBodyJointVelocityUpdateEnabled()){
+            prefetcher = std::make_unique<BodyPositionPrefetcher>(body);
+            prefetcher->setMaxNumCachedFrames(2 * numFramesToPrefetch(positionSeq->frameRate()));
+            lastRequestedFrameIndex = -1;
+        }
     }
 }
 
@@ -213,21 +337,33 @@ bool BodyMotionEngine::onTimeChanged(double time)
         return false;
     }
 
+    bool isBodyChanged = false;
+
     if(!positionSeq->empty()){
         auto body = bodyItem_->body();
         int prevNumMultiplexBodies = body->numMultiplexBodies();
         int frameIndex = positionSeq->clampFrameIndex(positionSeq->frameOfTime(time), isActive);
-
-        bool needFk = core.updateBodyPosition_(body, positionSeq->frame(frameIndex));
+        auto& frame = positionSeq->frame(frameIndex);
 
         bool doUpdateVelocities = motionItem_->isBodyJointVelocityUpdateEnabled();
         if(doUpdateVelocities){
+            bool needFk = core.updateSingleBodyPosition(body, frame.firstBlock(), true);
             auto& prevFrame = positionSeq->frame((frameIndex == 0) ? 0 : (frameIndex -1));
             core.updateBodyVelocity(body, prevFrame, positionSeq->timeStep());
+            if(needFk){
+                body->calcForwardKinematics(true);
+            }
+            isBodyChanged = true;
+        } else {
+            isBodyChanged = core.updateMainBodyPositionIncrementally(
+                body, frame.firstBlock(), prefetcher.get(), frameIndex);
         }
-                
-        if(needFk){
-            body->calcForwardKinematics(doUpdateVelocities);
+        if(prefetcher){
+            requestFramesToPrefetch(frameIndex);
+        }
+
+        if(core.updateMultiplexBodyPositions(body, frame)){
+            isBodyChanged = true;
         }
         
         if(body->numMultiplexBodies() != prevNumMultiplexBodies){
@@ -241,17 +377,38 @@ bool BodyMotionEngine::onTimeChanged(double time)
             isActive = true;
         }
     }
-    
-    bodyItem_->notifyKinematicStateChange();
+
+    // The notification is skipped when the frame does not change the body state
+    if(isBodyChanged || !extraSeqEngines.empty()){
+        bodyItem_->notifyKinematicStateChange();
+    }
 
     return isActive;
 }
 
 
+void BodyMotionEngine::requestFramesToPrefetch(int frameIndex)
+{
+    if(frameIndex < lastRequestedFrameIndex - numFramesToPrefetch(positionSeq->frameRate())){
+        // The time has been moved backward
+        lastRequestedFrameIndex = frameIndex;
+    }
+    int beginningFrame = std::max(frameIndex, lastRequestedFrameIndex) + 1;
+    int endingFrame = std::min(
+        frameIndex + numFramesToPrefetch(positionSeq->frameRate()) + 1, positionSeq->numFrames());
+    for(int i = beginningFrame; i < endingFrame; ++i){
+        prefetcher->request(i, positionSeq->frameBlock(i));
+        lastRequestedFrameIndex = i;
+    }
+}
+
+
 double BodyMotionEngine::onPlaybackStopped(double time, bool isStoppedManually)
 {
     double lastValidTime = -1.0;
 
+    prefetcher.reset();
+
     if(auto bodyItem_ = core.bodyItemRef.lock()){
 
         bodyItem_->notifyKinematicStateUpdate(false);
@@ -5,6 +5,7 @@
 #include <cnoid/BodyItem>
 #include <cnoid/BodyMotionItem>
 #include <cnoid/BodyPositionSeq>
+#include <cnoid/BodyPositionPrefetcher>
 #include <cnoid/ConnectionSet>
 #include <memory>
 #include <vector>
@@ -23,9 +24,14 @@ public:
 
 private:
     weak_ref_ptr<BodyItem> bodyItemRef;
+    std::vector<bool> linkUpdateFlags;
 
     bool updateBodyPosition_(Body* body, const BodyPositionSeqFrame& frame);
     bool updateSingleBodyPosition(Body* body, BodyPositionSeqFrameBlock frameBlock, bool isMainBody);
+    bool updateMainBodyPositionIncrementally(
+        Body* body, BodyPositionSeqFrameBlock frameBlock, BodyPositionPrefetcher* prefetcher, int frameIndex);
+    bool updateMultiplexBodyPositions(Body* body, const BodyPositionSeqFrame& frame);
+    void calcForwardKinematicsOfUpdatedLinks(Body* body);
     void updateBodyVelocity(Body* body, const BodyPositionSeqFrame& prevFrame, double timeStep);
     friend class BodyMotionEngine;
 };
@@ -54,10 +60,13 @@ private:
     BodyMotionEngineCore core;
     BodyMotionItem* motionItem_;
     std::shared_ptr<BodyPositionSeq> positionSeq;
+    std::unique_ptr<BodyPositionPrefetcher> prefetcher;
+    int lastRequestedFrameIndex;
     std::vector<TimeSyncItemEnginePtr> extraSeqEngines;
     ScopedConnectionSet connections;
 
     void updateExtraSeqEngines();
+    void requestFramesToPrefetch(int frameIndex);
 };
 
 typedef ref_ptr<BodyMotionEngine> BodyMotionEnginePtr;
@@ -38,6 +38,12 @@ struct ExtraSeqItemInfo : public Referenced
 };
 
 typedef ref_ptr<ExtraSeqItemInfo> ExtraSeqItemInfoPtr;
+
+class PreloadedBodyMotion : public Referenced
+{
+public:
+    BodyMotion motion;
+};
     
 typedef std::map<std::string, ExtraSeqItemInfoPtr> ExtraSeqItemInfoMap;
 
@@ -131,11 +137,25 @@ void BodyMotionItem::initializeClass(ExtensionManager* ext)
 
     im.addCreationPanel<BodyMotionItem>(new BodyMotionItemCreationPanel);
 
-    im.addLoaderAndSaver<BodyMotionItem>(
+    im.addLoader<BodyMotionItem>(
         _("Body Motion"), "BODY-MOTION-YAML", "seq;yaml",
         [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
             return item->motion()->load(filename, os);
         },
+        [](const std::string& filename, std::ostream& os) -> ReferencedPtr {
+            ref_ptr<PreloadedBodyMotion> preloaded = new PreloadedBodyMotion;
+            if(!preloaded->motion.load(filename, os)){
+                return nullptr;
+            }
+            return preloaded;
+        },
+        [](BodyMotionItem* item, Referenced* data, std::ostream& /* os */){
+            *item->motion() = std::move(static_cast<PreloadedBodyMotion*>(data)->motion);
+            return true;
+        });
+
+    im.addSaver<BodyMotionItem>(
+        _("Body Motion"), "BODY-MOTION-YAML", "seq;yaml",
         [](BodyMotionItem* item, const std::string& filename, std::ostream& os, Item* /* parentItem */){
             return item->motion()->save(filename, os);
         });
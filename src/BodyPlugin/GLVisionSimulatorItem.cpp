@@ -272,6 +272,7 @@ public:
     double maxLatency;
     CloneMap cloneMap;
     bool isAntiAliasingEnabled;
+    int maxLodLevel;
         
     Impl(GLVisionSimulatorItem* self);
     Impl(GLVisionSimulatorItem* self, const Impl& org);
@@ -335,6 +336,7 @@ GLVisionSimulatorItem::Impl::Impl(GLVisionSimulatorItem* self)
     threadMode.select(GLVisionSimulatorItem::SENSOR_THREAD_MODE);
 
     isAntiAliasingEnabled = false;
+    maxLodLevel = 0;
 }
 
 
@@ -366,6 +368,7 @@ GLVisionSimulatorItem::Impl::Impl(GLVisionSimulatorItem* self, const Impl& org)
     maxFrameRate = org.maxFrameRate;
     maxLatency = org.maxLatency;
     isAntiAliasingEnabled = org.isAntiAliasingEnabled;
+    maxLodLevel = org.maxLodLevel;
 }
 
 
@@ -464,6 +467,12 @@ void GLVisionSimulatorItem::setAdditionalLightsEnabled(bool on)
 }
 
 
+void GLVisionSimulatorItem::setMaxLodLevel(int level)
+{
+    impl->setProperty(impl->maxLodLevel, level);
+}
+
+
 bool GLVisionSimulatorItem::initializeSimulation(SimulatorItem* simulatorItem)
 {
     return impl->initializeSimulation(simulatorItem);
@@ -1003,6 +1012,7 @@ bool SensorScreenRenderer::initializeGL(SgCamera* sceneCamera)
     flagToUpdatePreprocessedNodeTree = true;
     renderer->extractPreprocessedNodes();
     renderer->setCurrentCamera(sceneCamera);
+    renderer->setMaxLodLevel(simImpl->maxLodLevel);
 
     if(rangeSensorForRendering){
         renderer->setLightingMode(GLSceneRenderer::NoLighting);
@@ -1901,6 +1911,7 @@ void GLVisionSimulatorItem::Impl::doPutProperties(PutPropertyFunction& putProper
     putProperty(_("Head light"), isHeadLightEnabled, changeProperty(isHeadLightEnabled));
     putProperty(_("Additional lights"), areAdditionalLightsEnabled, changeProperty(areAdditionalLightsEnabled));
     putProperty(_("Anti-aliasing"), isAntiAliasingEnabled, changeProperty(isAntiAliasingEnabled));
+    putProperty.min(0)(_("Max LOD level"), maxLodLevel, changeProperty(maxLodLevel));
 }
 
 
@@ -1926,6 +1937,7 @@ bool GLVisionSimulatorItem::Impl::store(Archive& archive)
     archive.write("enable_head_light", isHeadLightEnabled);    
     archive.write("enable_additional_lights", areAdditionalLightsEnabled);
     archive.write("antialiasing", isAntiAliasingEnabled);
+    archive.write("max_lod_level", maxLodLevel);
     return true;
 }
 
@@ -1954,6 +1966,7 @@ bool GLVisionSimulatorItem::Impl::restore(const Archive& archive)
     archive.read({ "enable_head_light", "enableHeadLight" }, isHeadLightEnabled);
     archive.read({ "enable_additional_lights", "enableAdditionalLights" }, areAdditionalLightsEnabled);
     archive.read({ "antialiasing", "antiAliasing" }, isAntiAliasingEnabled);
+    archive.read("max_lod_level", maxLodLevel);
 
     string symbol;
     if(archive.read({ "thread_mode", "threadMode" }, symbol)){
@@ -29,6 +29,12 @@ public:
     void setHeadLightEnabled(bool on);
     void setAdditionalLightsEnabled(bool on);
 
+    /**
+       The level of detail of the meshes rendered for the sensors is limited to this level.
+       The default value 0 means that the original meshes are always used.
+    */
+    void setMaxLodLevel(int level);
+
     virtual bool initializeSimulation(SimulatorItem* simulatorItem) override;
     virtual void finalizeSimulation() override;
 
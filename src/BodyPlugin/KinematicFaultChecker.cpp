@@ -20,13 +20,17 @@
 #include <cnoid/BodyCollisionDetector>
 #include <cnoid/AISTCollisionDetector>
 #include <cnoid/IdPair>
+#include <cnoid/ThreadPool>
 #include <QButtonGroup>
 #include <QDialogButtonBox>
 #include <QBoxLayout>
 #include <QFrame>
 #include <QLabel>
+#include <QProgressDialog>
 #include <fmt/format.h>
 #include <map>
+#include <atomic>
+#include <chrono>
 #include "gettext.h"
 
 using namespace std;
@@ -37,6 +41,9 @@ namespace {
 
 bool USE_DUPLICATED_BODY = false;
 
+//! The number of the frames processed at a time by a worker thread of the self-collision check
+constexpr int CollisionCheckChunkSize = 256;
+
 KinematicFaultChecker* checkerInstance = nullptr;
 
 #if defined(_MSC_VER) && _MSC_VER < 1800
@@ -67,16 +74,38 @@ public:
         
     DoubleSpinBox velocityLimitRatioSpin;
     CheckBox collisionCheck;
+    CheckBox continuousCollisionCheck;
 
     CheckBox onlyTimeBarRangeCheck;
 
     int numFaults;
     vector<int> lastPosFaultFrames;
     vector<int> lastVelFaultFrames;
-    typedef IdPair<CollisionDetector::GeometryHandle> GeometryPair;
-    typedef std::map<GeometryPair, int> LastCollisionFrameMap;
+    typedef std::map<IdPair<int>, int> LastCollisionFrameMap;
     LastCollisionFrameMap lastCollisionFrames;
 
+    struct SelfCollision
+    {
+        int linkIndex1;
+        int linkIndex2;
+        // The first contact time normalized by the frame interval
+        double time;
+        SelfCollision(int linkIndex1, int linkIndex2, double time)
+            : linkIndex1(linkIndex1), linkIndex2(linkIndex2), time(time) { }
+    };
+    
+    struct CollisionCheckChunk
+    {
+        int beginningFrame;
+        int endingFrame;
+        // The collisions of the frame are stored in [collisionOffsets[i], collisionOffsets[i + 1]) of collisions
+        // where i is the frame index relative to beginningFrame
+        vector<int> collisionOffsets;
+        vector<SelfCollision> collisions;
+        bool isCompleted;
+    };
+    vector<CollisionCheckChunk> collisionCheckChunks;
+
     double frameRate;
     double angleMargin;
     double translationMargin;
@@ -88,11 +117,13 @@ public:
     void apply();
     int checkFaults(
         BodyItem* bodyItem, BodyMotionItem* motionItem,
-        bool checkPosition, bool checkVelocity, bool checkCollision,
+        bool checkPosition, bool checkVelocity, bool checkCollision, bool checkCollisionContinuously,
         vector<bool> linkSelection, double beginningTime, double endingTime);
+    bool detectSelfCollisions(
+        BodyItem* bodyItem, BodyMotion* motion, int beginningFrame, int& io_endingFrame, bool isContinuous);
     void putJointPositionFault(int frame, Link* joint);
     void putJointVelocityFault(int frame, Link* joint);
-    void putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair);
+    void putSelfCollision(Body* body, int frame, const SelfCollision& collision);
 };
 
 }
@@ -206,6 +237,13 @@ KinematicFaultChecker::Impl::Impl()
     collisionCheck.setText(_("Self-collision check"));
     collisionCheck.setChecked(true);
     hbox->addWidget(&collisionCheck);
+    hbox->addSpacing(10);
+
+    continuousCollisionCheck.setText(_("Check between frames"));
+    continuousCollisionCheck.setChecked(false);
+    continuousCollisionCheck.setToolTip(
+        _("Detect the collisions that occur while the links move between adjacent frames"));
+    hbox->addWidget(&continuousCollisionCheck);
 
     hbox->addStretch();
     vbox->addLayout(hbox);
@@ -242,6 +280,7 @@ bool KinematicFaultChecker::Impl::store(Archive& archive)
                   (allJointsRadio.isChecked() ? "all" :
                    (selectedJointsRadio.isChecked() ? "selected" : "non-selected")));
     archive.write("checkSelfCollisions", collisionCheck.isChecked());
+    archive.write("checkSelfCollisionsBetweenFrames", continuousCollisionCheck.isChecked());
     archive.write("onlyTimeBarRange", onlyTimeBarRangeCheck.isChecked());
     return true;
 }
@@ -265,6 +304,8 @@ void KinematicFaultChecker::Impl::restore(const Archive& archive)
         }
     }
     collisionCheck.setChecked(archive.get("checkSelfCollisions", collisionCheck.isChecked()));
+    continuousCollisionCheck.setChecked(
+        archive.get("checkSelfCollisionsBetweenFrames", continuousCollisionCheck.isChecked()));
     onlyTimeBarRangeCheck.setChecked(archive.get("onlyTimeBarRange", onlyTimeBarRangeCheck.isChecked()));
 }
 
@@ -307,6 +348,7 @@ void KinematicFaultChecker::Impl::apply()
                                     positionCheck.isChecked(),
                                     velocityCheck.isChecked(),
                                     collisionCheck.isChecked(),
+                                    continuousCollisionCheck.isChecked(),
                                     linkSelection,
                                     beginningTime, endingTime);
                 
@@ -333,14 +375,14 @@ int KinematicFaultChecker::checkFaults
 {
     vector<bool> linkSelection(bodyItem->body()->numLinks(), true);
     return impl->checkFaults(
-        bodyItem, motionItem, true, true, true, linkSelection, beginningTime, endingTime);
+        bodyItem, motionItem, true, true, true, false, linkSelection, beginningTime, endingTime);
 }
 
 
 int KinematicFaultChecker::Impl::checkFaults
 (BodyItem* bodyItem, BodyMotionItem* motionItem,
- bool checkPosition, bool checkVelocity, bool checkCollision, vector<bool> linkSelection,
- double beginningTime, double endingTime)
+ bool checkPosition, bool checkVelocity, bool checkCollision, bool checkCollisionContinuously,
+ vector<bool> linkSelection, double beginningTime, double endingTime)
 {
     numFaults = 0;
 
@@ -354,6 +396,21 @@ int KinematicFaultChecker::Impl::checkFaults
         return numFaults;
     }
 
+    frameRate = motion->frameRate();
+    double stepRatio2 = 2.0 / frameRate;
+    angleMargin = radian(angleMarginSpin.value());
+    translationMargin = translationMarginSpin.value();
+    velocityLimitRatio = velocityLimitRatioSpin.value() / 100.0;
+
+    int beginningFrame = std::max(0, (int)(beginningTime * frameRate));
+    int endingFrame = std::min((motion->numFrames() - 1), (int)lround(endingTime * frameRate));
+
+    bool isCanceled = false;
+    if(checkCollision && beginningFrame <= endingFrame){
+        isCanceled = !detectSelfCollisions(
+            bodyItem, motion.get(), beginningFrame, endingFrame, checkCollisionContinuously);
+    }
+
     BodyState orgKinematicState;
     
     if(USE_DUPLICATED_BODY){
@@ -362,28 +419,7 @@ int KinematicFaultChecker::Impl::checkFaults
         bodyItem->storeKinematicState(orgKinematicState);
     }
 
-    BodyCollisionDetector bodyCollisionDetector;
-    WorldItem* worldItem = bodyItem->findOwnerItem<WorldItem>();
-    if(worldItem){
-        bodyCollisionDetector.setCollisionDetector(worldItem->collisionDetector()->clone());
-    } else {
-        bodyCollisionDetector.setCollisionDetector(new AISTCollisionDetector);
-    }
-
-    bodyCollisionDetector.addBody(body, true);
-    bodyCollisionDetector.makeReady();
-
     const int numJoints = std::min(body->numJoints(), qseq->numParts());
-    const int numLinks = std::min(body->numLinks(), pseq->numParts());
-
-    frameRate = motion->frameRate();
-    double stepRatio2 = 2.0 / frameRate;
-    angleMargin = radian(angleMarginSpin.value());
-    translationMargin = translationMarginSpin.value();
-    velocityLimitRatio = velocityLimitRatioSpin.value() / 100.0;
-
-    int beginningFrame = std::max(0, (int)(beginningTime * frameRate));
-    int endingFrame = std::min((motion->numFrames() - 1), (int)lround(endingTime * frameRate));
 
     lastPosFaultFrames.clear();
     lastPosFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
@@ -391,12 +427,6 @@ int KinematicFaultChecker::Impl::checkFaults
     lastVelFaultFrames.resize(numJoints, std::numeric_limits<int>::min());
     lastCollisionFrames.clear();
 
-    if(checkCollision){
-        Link* root = body->rootLink();
-        root->p().setZero();
-        root->R().setIdentity();
-    }
-        
     for(int frame = beginningFrame; frame <= endingFrame; ++frame){
 
         int prevFrame = (frame == beginningFrame) ? beginningFrame : frame - 1;
@@ -429,39 +459,21 @@ int KinematicFaultChecker::Impl::checkFaults
         }
 
         if(checkCollision){
-
-            Link* link = body->link(0);
-            if(!pseq->empty())
-            {
-                const SE3& p = pseq->at(frame, 0);
-                link->p() = p.translation();
-                link->R() = p.rotation().toRotationMatrix();
-            }
-            else
-            {
-                link->p() = Vector3d(0., 0., 0.);
-                link->R() = Matrix3d::Identity();
-            }
-
-            body->calcForwardKinematics();
-
-            for(int i=1; i < numLinks; ++i){
-                link = body->link(i);
-                if(!pseq->empty())
-                {
-                    const SE3& p = pseq->at(frame, i);
-                    link->p() = p.translation();
-                    link->R() = p.rotation().toRotationMatrix();
-                }
+            auto& chunk = collisionCheckChunks[(frame - beginningFrame) / CollisionCheckChunkSize];
+            const int localFrame = frame - chunk.beginningFrame;
+            const int collisionEnd = chunk.collisionOffsets[localFrame + 1];
+            for(int i = chunk.collisionOffsets[localFrame]; i < collisionEnd; ++i){
+                putSelfCollision(body, frame, chunk.collisions[i]);
             }
+        }
+    }
 
-            bodyCollisionDetector.updatePositions();
+    if(checkCollision){
+        collisionCheckChunks.clear();
+    }
 
-            bodyCollisionDetector.detectCollisions(
-                [&](const CollisionPair& collisionPair){
-                    putSelfCollision(body, frame, collisionPair);
-                });
-        }
+    if(isCanceled){
+        os << format(_("The check has been canceled at {0:.3f} [s]."), (endingFrame + 1) / frameRate) << endl;
     }
 
     if(!USE_DUPLICATED_BODY){
@@ -472,6 +484,178 @@ int KinematicFaultChecker::Impl::checkFaults
 }
 
 
+/**
+   The self-collisions of the frames are detected in advance by worker threads, each of which
+   has its own copies of the body and the collision detector. The results are stored for each
+   chunk of the frames so that they can be output in the order of the frames.
+   When isContinuous is true, the interval from each frame to the next frame is checked by the
+   continuous collision detection if the collision detector supports it.
+   \return false if the detection is canceled. In that case io_endingFrame is set to the last
+   frame up to which all the frames have been checked.
+*/
+bool KinematicFaultChecker::Impl::detectSelfCollisions
+(BodyItem* bodyItem, BodyMotion* motion, int beginningFrame, int& io_endingFrame, bool isContinuous)
+{
+    const int endingFrame = io_endingFrame;
+    auto body = bodyItem->body();
+    auto qseq = motion->jointPosSeq();
+    auto pseq = motion->linkPosSeq();
+    const int numJoints = std::min(body->numJoints(), qseq->numParts());
+    const int numLinks = std::min(body->numLinks(), pseq->numParts());
+    const int numFrames = endingFrame - beginningFrame + 1;
+
+    collisionCheckChunks.clear();
+    for(int frame = beginningFrame; frame <= endingFrame; frame += CollisionCheckChunkSize){
+        collisionCheckChunks.emplace_back();
+        auto& chunk = collisionCheckChunks.back();
+        chunk.beginningFrame = frame;
+        chunk.endingFrame = std::min(frame + CollisionCheckChunkSize - 1, endingFrame);
+        chunk.isCompleted = false;
+    }
+    const int numChunks = collisionCheckChunks.size();
+    const int numThreads =
+        std::max(1, std::min(numChunks, static_cast<int>(std::thread::hardware_concurrency())));
+
+    WorldItem* worldItem = bodyItem->findOwnerItem<WorldItem>();
+    vector<BodyPtr> workerBodies(numThreads);
+    vector<unique_ptr<BodyCollisionDetector>> workerDetectors(numThreads);
+    for(int i=0; i < numThreads; ++i){
+        workerBodies[i] = body->clone();
+        auto detector = new BodyCollisionDetector;
+        if(worldItem){
+            detector->setCollisionDetector(worldItem->collisionDetector()->clone());
+        } else {
+            detector->setCollisionDetector(new AISTCollisionDetector);
+        }
+        detector->addBody(workerBodies[i], true);
+        detector->makeReady();
+        workerDetectors[i].reset(detector);
+    }
+
+    if(isContinuous && !workerDetectors[0]->isContinuousCollisionDetectionAvailable()){
+        os << format(_("The collision detector \"{0}\" does not support the collision check between frames. "
+                       "Only the frames are checked."),
+                     workerDetectors[0]->collisionDetector()->name()) << endl;
+        isContinuous = false;
+    }
+
+    std::atomic<int> nextChunkIndex(0);
+    std::atomic<int> numProcessedFrames(0);
+    std::atomic<bool> isCanceled(false);
+
+    ThreadPool threadPool(numThreads);
+    
+    for(int i=0; i < numThreads; ++i){
+        Body* workerBody = workerBodies[i];
+        BodyCollisionDetector* detector = workerDetectors[i].get();
+        
+        threadPool.start([&, workerBody, detector](){
+            Link* root = workerBody->rootLink();
+
+            auto setBodyPosition = [&](int frame){
+                for(int j=0; j < numJoints; ++j){
+                    workerBody->joint(j)->q() = qseq->at(frame, j);
+                }
+                if(!pseq->empty()){
+                    const SE3& p = pseq->at(frame, 0);
+                    root->p() = p.translation();
+                    root->R() = p.rotation().toRotationMatrix();
+                } else {
+                    root->p().setZero();
+                    root->R().setIdentity();
+                }
+                workerBody->calcForwardKinematics();
+                if(!pseq->empty()){
+                    for(int j=1; j < numLinks; ++j){
+                        Link* link = workerBody->link(j);
+                        const SE3& p = pseq->at(frame, j);
+                        link->p() = p.translation();
+                        link->R() = p.rotation().toRotationMatrix();
+                    }
+                }
+            };
+            
+            while(!isCanceled){
+                const int chunkIndex = nextChunkIndex++;
+                if(chunkIndex >= numChunks){
+                    break;
+                }
+                auto& chunk = collisionCheckChunks[chunkIndex];
+                chunk.collisionOffsets.reserve(chunk.endingFrame - chunk.beginningFrame + 2);
+
+                if(isContinuous){
+                    setBodyPosition(chunk.beginningFrame);
+                    detector->updatePositions();
+                }
+                
+                for(int frame = chunk.beginningFrame; frame <= chunk.endingFrame; ++frame){
+                    if(isCanceled){
+                        return;
+                    }
+                    chunk.collisionOffsets.push_back(chunk.collisions.size());
+
+                    if(isContinuous && frame < endingFrame){
+                        // The link positions of the frame have been given to the detector as the start positions
+                        setBodyPosition(frame + 1);
+                        detector->detectContinuousCollisions(
+                            [&](const CollisionPair& collisionPair, double time){
+                                chunk.collisions.emplace_back(
+                                    static_cast<Link*>(collisionPair.object(0))->index(),
+                                    static_cast<Link*>(collisionPair.object(1))->index(),
+                                    time);
+                            });
+                        detector->updatePositions();
+                        
+                    } else {
+                        if(!isContinuous){
+                            setBodyPosition(frame);
+                            detector->updatePositions();
+                        }
+                        detector->detectCollisions(
+                            [&](const CollisionPair& collisionPair){
+                                chunk.collisions.emplace_back(
+                                    static_cast<Link*>(collisionPair.object(0))->index(),
+                                    static_cast<Link*>(collisionPair.object(1))->index(),
+                                    0.0);
+                            });
+                    }
+                    
+                    ++numProcessedFrames;
+                }
+                chunk.collisionOffsets.push_back(chunk.collisions.size());
+                chunk.isCompleted = true;
+            }
+        });
+    }
+
+    QProgressDialog progress(
+        _("Checking self-collisions..."), _("Cancel"), 0, numFrames, MainWindow::instance());
+    progress.setWindowTitle(_("Kinematic Fault Checker"));
+    progress.setWindowModality(Qt::WindowModal);
+    while(true){
+        const int n = numProcessedFrames;
+        progress.setValue(n);
+        if(progress.wasCanceled()){
+            isCanceled = true;
+            break;
+        }
+        if(n >= numFrames){
+            break;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    threadPool.wait();
+
+    for(auto& chunk : collisionCheckChunks){
+        if(!chunk.isCompleted){
+            io_endingFrame = chunk.beginningFrame - 1;
+            return false;
+        }
+    }
+    return true;
+}
+
+
 void KinematicFaultChecker::Impl::putJointPositionFault(int frame, Link* joint)
 {
     if(frame > lastPosFaultFrames[joint->jointId()] + 1){
@@ -528,14 +712,14 @@ void KinematicFaultChecker::Impl::putJointVelocityFault(int frame, Link* joint)
 }
 
 
-void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const CollisionPair& collisionPair)
+void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const SelfCollision& collision)
 {
     bool putMessage = false;
-    GeometryPair gPair(collisionPair.geometries());
-    auto p = lastCollisionFrames.find(gPair);
+    IdPair<int> linkPair(collision.linkIndex1, collision.linkIndex2);
+    auto p = lastCollisionFrames.find(linkPair);
     if(p == lastCollisionFrames.end()){
         putMessage = true;
-        lastCollisionFrames[gPair] = frame;
+        lastCollisionFrames[linkPair] = frame;
     } else {
         if(frame > p->second + 1){
             putMessage = true;
@@ -544,10 +728,10 @@ void KinematicFaultChecker::Impl::putSelfCollision(Body* body, int frame, const
     }
 
     if(putMessage){
-        Link* link0 = static_cast<Link*>(collisionPair.object(0));
-        Link* link1 = static_cast<Link*>(collisionPair.object(1));
+        Link* link0 = body->link(collision.linkIndex1);
+        Link* link1 = body->link(collision.linkIndex2);
         os << format(_("{0:7.3f} [s]: Collision between {1} and {2}"),
-                     (frame / frameRate), link0->name(), link1->name()) << endl;
+                     ((frame + collision.time) / frameRate), link0->name(), link1->name()) << endl;
         numFaults++;
     }
 }
@@ -11,14 +11,23 @@
 #include <cnoid/SceneLights>
 #include <cnoid/SceneEffects>
 #include <cnoid/EigenUtil>
+#include <cnoid/MeshBVH>
+#include <cnoid/MeshLodChain>
+#include <cnoid/ThreadPool>
 #include <cnoid/NullOut>
 #include <fmt/format.h>
 #include <GL/glu.h>
 #include <unordered_map>
 #include <unordered_set>
 #include <deque>
+#include <tuple>
+#include <algorithm>
 #include <mutex>
+#include <atomic>
+#include <thread>
+#include <chrono>
 #include <regex>
+#include <cassert>
 #include <stdexcept>
 #include <iostream>
 #include "gettext.h"
@@ -30,6 +39,9 @@ using fmt::format;
 namespace {
 
 const float MinLineWidthForPicking = 4.0f;
+
+// The half size in pixels of the view frustum used to limit the sub trees traversed in picking
+constexpr double PickingFrustumMargin = 16.0;
 const bool USE_GL_FLOAT_FOR_NORMALS = false;
 
 // This does not seem to be necessary
@@ -39,8 +51,36 @@ constexpr int DepthTextureUnit = 0;
 constexpr int ImageTextureUnit = 1;
 constexpr int ShadowMapTextureUnit = 2;
 
+// Consecutive shapes sharing a mesh are drawn by an instanced draw call if there are at least this number of them
+constexpr int MinNumInstancesForInstancedDrawing = 4;
+constexpr int InstanceModelMatrixAttributeLocation = 4;
+constexpr int InstanceNormalMatrixAttributeLocation = 8;
+
+// The level of detail is only applied to the meshes with at least this number of triangles
+constexpr int MinNumTrianglesForLevelOfDetail = 4096;
+// A simplified mesh is used if its error projected on the screen is within this number of pixels
+constexpr double MaxPixelErrorOfLevelOfDetail = 1.0;
+
+constexpr int DefaultNumShadowMapCascades = 3;
+// The weight of the logarithmic split in the practical split scheme of the shadow map cascades
+constexpr double CascadeSplitLambda = 0.75;
+// A shadow caster is regarded as a static one if it has not been updated for this number of frames
+constexpr unsigned int NumFramesToBecomeStaticShadowCaster = 60;
+
+// The vertices of a mesh with at least this number of triangles are packed in a background thread
+constexpr int MinNumTrianglesForBackgroundMeshPreparation = 16384;
+// The packed vertex data is uploaded in the chunks of this size within the time limit of each frame
+constexpr int MeshUploadChunkSize = 1024 * 1024;
+constexpr double MaxMeshUploadTimePerFrame = 0.005;
+
 typedef vector<Affine3, Eigen::aligned_allocator<Affine3>> Affine3Array;
 
+// The value is rounded up to a power of 2^(1/4)
+double quantizeUpwardByPowerOfTwo(double x)
+{
+    return std::pow(2.0, std::ceil(std::log2(x) * 4.0) / 4.0);
+}
+
 std::mutex extensionMutex;
 set<GLSLSceneRenderer*> renderers;
 vector<std::function<void(GLSLSceneRenderer* renderer)>> extendFunctions;
@@ -80,6 +120,166 @@ struct SgObjectPtrHash {
 
 typedef std::unordered_map<SgObjectPtr, GLResourcePtr, SgObjectPtrHash> GLResourceMap;
 
+/**
+   The vertex attribute arrays converted into the formats of the vertex buffer objects.
+   The data can be created in any thread because it does not depend on the OpenGL context.
+*/
+class PackedVertexData : public Referenced
+{
+public:
+    EIGEN_MAKE_ALIGNED_OPERATOR_NEW
+
+    class Attribute
+    {
+    public:
+        GLuint location;
+        GLint size;
+        GLenum type;
+        GLboolean normalized;
+        virtual ~Attribute() { }
+        virtual const void* data() const = 0;
+        virtual GLsizeiptr dataSize() const = 0;
+    };
+
+    template<class ArrayType>
+    class AttributeArray : public Attribute
+    {
+    public:
+        ArrayType array;
+        AttributeArray(ArrayType&& array) : array(std::move(array)) { }
+        virtual const void* data() const override { return array.data(); }
+        virtual GLsizeiptr dataSize() const override {
+            return array.size() * sizeof(typename ArrayType::value_type);
+        }
+    };
+
+    GLsizei numVertices;
+    vector<unique_ptr<Attribute>> attributes;
+    bool hasLocalTransform;
+    Matrix4 localTransform;
+    SgLineSetPtr normalVisualization;
+
+    // This is set to true when the data is packed in a background thread
+    std::atomic<bool> isReady;
+    int numUploadedAttributes;
+    GLsizeiptr uploadedDataSize;
+
+    PackedVertexData()
+        : numVertices(0),
+          hasLocalTransform(false),
+          isReady(false),
+          numUploadedAttributes(0),
+          uploadedDataSize(0)
+    { }
+
+    template<class ArrayType>
+    void addAttribute(GLuint location, GLint size, GLenum type, GLboolean normalized, ArrayType& array){
+        auto attribute = new AttributeArray<ArrayType>(std::move(array));
+        attribute->location = location;
+        attribute->size = size;
+        attribute->type = type;
+        attribute->normalized = normalized;
+        attributes.emplace_back(attribute);
+    }
+};
+
+typedef ref_ptr<PackedVertexData> PackedVertexDataPtr;
+
+/**
+   This class converts the vertex attributes of a mesh into the packed vertex data.
+   The options are copied from the renderer so that the packing can be done without
+   accessing the renderer in a background thread.
+*/
+class VertexPacker
+{
+public:
+    bool isLowMemoryConsumptionFormatEnabled;
+    bool isSmoothShadingEnabled;
+    bool isNormalVisualizationEnabled;
+    float normalVisualizationLength;
+    bool isTexCoordEnabled;
+    bool hasTexCoordTransform;
+    Eigen::Affine2f texCoordTransform;
+
+    void pack(SgMesh* mesh, PackedVertexData* data);
+
+private:
+    PackedVertexData* data;
+
+    template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
+    void writeMeshVerticesSub(SgMesh* mesh, VertexArrayWrapper& vertices);
+    void writeMeshVerticesFloat(SgMesh* mesh);
+    void writeMeshVerticesNormalizedShort(SgMesh* mesh);
+    template<typename value_type, GLenum gltype, GLint glsize, GLboolean normalized, class NormalArrayWrapper>
+    bool writeMeshNormalsSub(SgMesh* mesh, NormalArrayWrapper& normals);
+    void writeMeshNormalsFloat(SgMesh* mesh);
+    void writeMeshNormalsShort(SgMesh* mesh);
+    void writeMeshNormalsByte(SgMesh* mesh);
+    void writeMeshNormalsPacked(SgMesh* mesh);
+    template<typename value_type, GLenum gltype, GLboolean normalized, class TexCoordArrayWrapper>
+    void writeMeshTexCoordsSub(SgMesh* mesh, TexCoordArrayWrapper& texCoords);
+    void writeMeshTexCoordsFloat(SgMesh* mesh);
+    void writeMeshTexCoordsHalfFloat(SgMesh* mesh);
+    void writeMeshTexCoordsUnsignedShort(SgMesh* mesh);
+    void writeMeshColors(SgMesh* mesh);
+};
+
+class BackgroundVertexPacker
+{
+public:
+    std::atomic<bool> isExiting;
+    unique_ptr<ThreadPool> threadPool;
+
+    BackgroundVertexPacker() : isExiting(false) { }
+
+    ~BackgroundVertexPacker(){
+        // The packing requests that have not been started are skipped at exit
+        isExiting = true;
+        threadPool.reset();
+    }
+
+    void request(const VertexPacker& packer, SgMeshPtr mesh, PackedVertexDataPtr data){
+        if(!threadPool){
+            int numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+            threadPool.reset(new ThreadPool(numThreads));
+        }
+        threadPool->start(
+            [this, packer, mesh, data](){
+                if(!isExiting){
+                    VertexPacker(packer).pack(mesh, data);
+                    data->isReady = true;
+                }
+            });
+    }
+};
+
+BackgroundVertexPacker backgroundVertexPacker;
+
+/**
+   The data of the mesh is copied so that the vertices can be packed in a background thread
+   while the original mesh is being used or modified in the main thread.
+*/
+SgMesh* copyMeshDataForVertexPacking(SgMesh* mesh, const VertexPacker& packer)
+{
+    auto copy = new SgMesh;
+    copy->setVertices(new SgVertexArray(*mesh->vertices()));
+    copy->triangleVertices() = mesh->triangleVertices();
+    copy->setBoundingBox(mesh->boundingBox());
+    if(packer.isSmoothShadingEnabled && mesh->hasNormals()){
+        copy->setNormals(new SgNormalArray(*mesh->normals()));
+        copy->normalIndices() = mesh->normalIndices();
+    }
+    if(mesh->hasColors()){
+        copy->setColors(new SgColorArray(*mesh->colors()));
+        copy->colorIndices() = mesh->colorIndices();
+    }
+    if(packer.isTexCoordEnabled){
+        copy->setTexCoords(new SgTexCoordArray(*mesh->texCoords()));
+        copy->texCoordIndices() = mesh->texCoordIndices();
+    }
+    return copy;
+}
+
 class VertexResource : public GLResource
 {
 public:
@@ -95,6 +295,8 @@ public:
     Matrix4 localTransform;
     SgLineSetPtr boundingBoxLines;
     SgLineSetPtr normalVisualization;
+    // The data being packed or uploaded to the buffers incrementally
+    PackedVertexDataPtr pendingData;
     ScopedConnection connection;
 
     VertexResource(const VertexResource&) = delete;
@@ -108,7 +310,10 @@ public:
 
         connection =
             obj->sigUpdated().connect(
-                [this](const SgUpdate&){ numVertices = 0; });
+                [this](const SgUpdate&){
+                    numVertices = 0;
+                    pendingData.reset();
+                });
     }
 
     void clearHandles(){
@@ -120,18 +325,24 @@ public:
         numVertices = 0;
     }
 
-    virtual void discard() override { clearHandles(); }
+    virtual void discard() override {
+        clearHandles();
+        pendingData.reset();
+    }
+
+    bool isReferencedOnlyOnce() const { return refCount() == 1; }
 
     bool isValid(){
         if(numVertices > 0){
             return true;
-        } else if(numBuffers > 0){
+        } else if(numBuffers > 0 && !pendingData){
             deleteBuffers();
         }
         return false;
     }
 
     GLuint newBuffer(){
+        assert(numBuffers < MAX_NUM_BUFFERS);
         GLuint buffer;
         glGenBuffers(1, &buffer);
         vbos[numBuffers++] = buffer;
@@ -361,6 +572,95 @@ public:
     bool isBoundingBoxRenderingMode;
     bool isBoundingBoxRenderingForLightweightRenderingGroupEnabled;
 
+    /*
+      View frustum culling uses the bounding boxes cached in the scene graph nodes
+      as a bounding volume hierarchy. The frustum planes are given in the world
+      coordinate. Each bit of the plane mask corresponds to a plane that still has
+      to be tested for the current sub tree.
+    */
+    bool isFrustumCullingEnabled;
+    Vector4 frustumPlanes[6];
+    int frustumPlaneMask;
+    /*
+      The number of nodes that may be rendered outside the bounding box of their
+      parent group. A group that contains such a node is not culled.
+    */
+    int numCullingBlockers;
+    struct GroupCullability {
+        bool isCullable;
+        // The frame in which the group was visited last
+        unsigned int frameId;
+    };
+    /*
+      The groups are not referenced by the map so that the removed groups are released.
+      The entries of the groups that are not visited in the frame are removed in the
+      unused resource check.
+    */
+    std::unordered_map<SgGroup*, GroupCullability> groupCullabilityMap;
+    unsigned int cullingInfoRevision;
+
+    /*
+      In the ray cast picking, the ray through the picked pixel is tested against the
+      scene graph on the CPU. The sub trees are culled by the view frustum around the
+      pixel, and the triangles of each mesh are tested using the shared MeshBVH.
+      The picking image is rendered by the GPU only if the ray cast cannot determine
+      the result because of the objects that are drawn by the shader programs directly.
+    */
+    bool isRayCastPickingEnabled;
+    bool isRayCasting;
+    bool isRayCastUndetermined;
+    // The ray is given in the world coordinate from the near clip plane to the far clip plane
+    Vector3 rayOrigin;
+    Vector3 rayDirection;
+    Vector2 rayPixelPosition;
+    double rayHitDistance;
+    SgNodePath rayHitNodePath;
+
+    /*
+      The shape with a large mesh is rendered with a simplified mesh of the MeshLodChain
+      when the error of the simplified mesh is within a pixel on the screen. The chain is
+      generated in a background thread, and the original mesh is rendered until it is ready.
+    */
+    bool isLevelOfDetailEnabled;
+    int maxLodLevel;
+
+    /*
+      The shadow map of a directional light is divided into the cascades fitted to the
+      consecutive depth ranges of the view frustum. The shadow casters are classified into
+      the static ones and the dynamic ones by the update notifications of the scene graph.
+      The depth images of the static shadow casters are cached, and only the dynamic ones are
+      rendered into the shadow maps as long as the cached images are valid.
+    */
+    int numShadowMapCascades;
+    bool isShadowMapCacheEnabled;
+    enum ShadowCasterFilter { AllShadowCasters, StaticShadowCasters, DynamicShadowCasters };
+    ShadowCasterFilter shadowCasterFilter;
+    SgOrthographicCameraPtr cascadeShadowMapCamera;
+    Matrix4 mainProjectionMatrix;
+    Isometry3 mainViewTransform;
+    bool isShadowCasterClassificationActive;
+    // The value is true if the node is only an ancestor of the updated node
+    unordered_map<SgNode*, bool> updatedShadowCasters;
+    // The values are the shadow frame counts at the last updates
+    unordered_map<SgNode*, unsigned int> dynamicShadowCasters;
+    unordered_map<SgNode*, unsigned int> dynamicShadowCasterAncestors;
+    unordered_set<SgNodePtr> invisibleNodeSetForStaticShadowCasters;
+    unsigned int shadowFrameCount;
+    unsigned int staticShadowCasterRevision;
+
+    // The update notifications of the scene root are used for the opaque shape orders and the shadow casters
+    ScopedConnection sceneRootConnection;
+    std::mutex sceneRootUpdateMutex;
+
+    /*
+      The vertices of a large mesh are packed in a background thread when the renderer first
+      encounters the mesh, and the packed data is uploaded to the buffer objects over several
+      frames within the time limit of each frame. The mesh is not rendered until the upload
+      is completed.
+    */
+    bool isBackgroundMeshPreparationEnabled;
+    vector<VertexResourcePtr> pendingVertexResources;
+
     Affine3Array modelMatrixStack; // stack of the model matrices
     Affine3Array modelMatrixBuffer; // Model matrices used later are stored in this buffer
     Isometry3 viewTransform;
@@ -379,6 +679,52 @@ public:
     };
     vector<DispatchedNodeInfo> pureWireframeRenderingNodes;
     vector<DispatchedNodeInfo> vertexRenderingNodes;
+
+    /*
+      Opaque shapes in the main rendering pass are not drawn immediately but stored
+      in this queue, and they are drawn in the order sorted by the material and texture
+      to reduce the state changes. The queue is flushed when the shader program or the
+      other rendering states that affect the shapes are changed, so the shapes in the
+      queue always share the same program.
+    */
+    struct OpaqueShapeInfo
+    {
+        SgShape* shape;
+        // This is the simplified mesh when the level of detail is applied
+        SgMesh* mesh;
+        VertexResource* resource;
+        SgTexture* texture;
+        const SgMaterial* material;
+        int modelMatrixIndex;
+        bool isSolid;
+    };
+    vector<OpaqueShapeInfo> opaqueShapeQueue;
+    vector<OpaqueShapeInfo> sortedOpaqueShapeQueue;
+
+    /*
+      The sorted order of each flush in a frame is retained and reused in the next frame
+      as long as the same shapes are queued in the same order. The retained orders are
+      discarded when the scene graph is updated except for the transform changes.
+    */
+    struct OpaqueShapeOrder
+    {
+        vector<OpaqueShapeInfo> shapes;
+        vector<int> sortedIndices;
+    };
+    vector<OpaqueShapeOrder> opaqueShapeOrders;
+    int opaqueShapeQueueFlushCount;
+    bool isOpaqueShapeOrderValid;
+    
+    bool isOpaqueShapeQueueEnabled;
+    bool isOpaqueShapeQueueActive;
+
+    // Shapes sharing the same mesh and material in the queue are drawn by instanced drawing
+    bool isInstancedDrawingEnabled;
+    GLuint instanceModelMatrixBuffer;
+    vector<Matrix4f, Eigen::aligned_allocator<Matrix4f>> instanceModelMatrices;
+    // The inverse transpose matrices of the model matrices to transform the normals
+    GLuint instanceNormalMatrixBuffer;
+    vector<Matrix3f> instanceNormalMatrices;
         
     deque<function<void()>> transparentRenderingQueue;
     deque<function<void()>> overlayRenderingQueue;
@@ -481,9 +827,27 @@ public:
     void doRender();
     void setupFullLightingRendering();
     bool doPick(int x, int y);
+    bool doRayCastPicking(int x, int y);
+    void setRayHit(SgNode* node, double distance);
+    bool isOutsidePickingFrustum(const BoundingBox& bbox, double tolerance);
+    bool projectToViewport(const Matrix4& M, const Vector3& p, Vector3& out_position);
+    void rayCastShape(SgShape* shape);
+    void rayCastPointSet(SgPointSet* pointSet);
+    void rayCastLineSet(SgLineSet* lineSet);
     bool renderShadowMap(int lightIndex);
     bool renderShadowMap(SgLight* light, const Isometry3& T);
+    void renderCascadedShadowMap(SgDirectionalLight* light, const Isometry3& T);
+    void renderShadowCasters();
+    void connectToSceneRoot();
+    void onSceneRootUpdated(const SgUpdate& update);
+    void updateShadowCasterClassification();
+    void clearShadowCasterClassification();
     void renderCamera(SgCamera* camera, const Isometry3& cameraPosition);
+    void updateFrustumPlanes();
+    void setFrustumPlanes(const Matrix4& M);
+    bool isOutsideFrustum(const BoundingBox& bbox, const Affine3& T, int& planeMask);
+    void keepResourcesInSubTree(SgObject* object);
+    bool& getGroupCullability(SgGroup* group);
     void beginRendering();
     void endRendering();
     void setupNodeVisibilities();
@@ -506,7 +870,11 @@ public:
     void dispatchRenderingFunction(SgNode* node);
     void renderChildNodes(SgGroup* group);
     void renderChildNodesWithNodeDecorationCheck(SgGroup* group);
+    void renderChildNodeWithNodeDecorationCheck(SgGroup* group, SgNode* node);
+    void renderChildNodesWithShadowCasterFilter(SgGroup* group);
     void renderGroup(SgGroup* group);
+    void renderCullableGroup(SgGroup* group);
+    void renderDeferredGroup(SgDeferredGroup* group);
     void renderTransform(SgTransform* transform);
     void renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup);
     void renderSwitchableGroup(SgSwitchableGroup* group);
@@ -517,7 +885,13 @@ public:
     void drawVertexResource(VertexResource* resource, GLenum primitiveMode, const Affine3& modelTransform);
     void drawBoundingBox(VertexResource* resource, const BoundingBox& bbox);
     void renderShape(SgShape* shape);
-    void renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex);
+    SgMesh* selectLodMesh(SgMesh* mesh);
+    void renderShapeMain(SgShape* shape, SgMesh* mesh, const Affine3& modelTransform, int pickIndex);
+    void queueOpaqueShape(SgShape* shape, SgMesh* mesh);
+    void flushOpaqueShapeQueue();
+    void sortOpaqueShapeQueue();
+    int getNumInstancesInOpaqueShapeQueue(int index);
+    void drawInstancedOpaqueShapes(int index, int numInstances);
     void applyCullingMode(SgMesh* mesh);
     void renderShapeVertices(SgShape* shape);
     void renderPlot(
@@ -543,25 +917,13 @@ public:
     void renderMaterial(const SgMaterial* material);
     bool renderTexture(SgTexture* texture);
     bool loadTextureImage(TextureResource* resource, const Image& image);
-    void makeVertexBufferObjects(SgShape* shape, VertexResource* resource);
-    void writeMeshVertices(SgMesh* mesh, VertexResource* resource, SgTexture* texResource);
-    template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
-    void writeMeshVerticesSub(SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& normals);
-    void writeMeshVerticesFloat(SgMesh* mesh, VertexResource* resource);
-    void writeMeshVerticesNormalizedShort(SgMesh* mesh, VertexResource* resource);
-    template<typename value_type, GLenum gltype, GLint glsize, GLboolean normalized, class NormalArrayWrapper>
-    bool writeMeshNormalsSub(SgMesh* mesh, VertexResource* resource, NormalArrayWrapper& normals);
-    void writeMeshNormalsFloat(SgMesh* mesh, VertexResource* resource);
-    void writeMeshNormalsShort(SgMesh* mesh, VertexResource* resource);
-    void writeMeshNormalsByte(SgMesh* mesh, VertexResource* resource);
-    void writeMeshNormalsPacked(SgMesh* mesh, VertexResource* resource);
-    template<typename value_type, GLenum gltype, GLboolean normalized, class TexCoordArrayWrapper>
-    void writeMeshTexCoordsSub(
-        SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords);
-    void writeMeshTexCoordsFloat(SgMesh* mesh, SgTexture* texture, VertexResource* resource);
-    void writeMeshTexCoordsHalfFloat(SgMesh* mesh, SgTexture* texture, VertexResource* resource);
-    void writeMeshTexCoordsUnsignedShort(SgMesh* mesh, SgTexture* texture, VertexResource* resource);
-    void writeMeshColors(SgMesh* mesh, VertexResource* resource);
+    bool prepareVertexBufferObjects(SgShape* shape, SgMesh* mesh, VertexResource* resource);
+    void makeVertexBufferObjects(SgShape* shape, SgMesh* mesh, VertexResource* resource);
+    void setupVertexPacker(SgShape* shape, SgMesh* mesh, VertexPacker& packer);
+    bool uploadPackedVertexData(
+        VertexResource* resource, PackedVertexData* data,
+        const std::chrono::steady_clock::time_point* deadline);
+    void uploadPendingVertexData();
     void clearGLState();
     void setPointSize(float size);
     void setGlLineWidth(float width);
@@ -659,7 +1021,7 @@ void GLSLSceneRenderer::Impl::initialize()
     os_ = &nullout();
 
     normalRenderingFunctions.setFunction<SgGroup>(
-        [&](SgGroup* node){ renderGroup(node); });
+        [&](SgGroup* node){ renderCullableGroup(node); });
     normalRenderingFunctions.setFunction<SgTransform>(
         [&](SgTransform* node){ renderTransform(node); });
     normalRenderingFunctions.setFunction<SgFixedPixelSizeGroup>(
@@ -692,6 +1054,9 @@ void GLSLSceneRenderer::Impl::initialize()
         [&](SgLightweightRenderingGroup* node){ renderLightweightRenderingGroup(node); });
 
     self->applyExtensions();
+    // This overrides the default function set by SceneRenderer::applyExtensions
+    normalRenderingFunctions.setFunction<SgDeferredGroup>(
+        [&](SgDeferredGroup* node){ renderDeferredGroup(node); });
     normalRenderingFunctions.updateDispatchTable();
 
     renderingFrameId = 1;
@@ -708,6 +1073,34 @@ void GLSLSceneRenderer::Impl::initialize()
     isBoundingBoxRenderingMode = false;
     isBoundingBoxRenderingForLightweightRenderingGroupEnabled = false;
 
+    isOpaqueShapeQueueEnabled = true;
+    isOpaqueShapeQueueActive = false;
+    opaqueShapeQueueFlushCount = 0;
+    isOpaqueShapeOrderValid = false;
+    isInstancedDrawingEnabled = true;
+
+    isFrustumCullingEnabled = true;
+    frustumPlaneMask = 0;
+    numCullingBlockers = 0;
+    cullingInfoRevision = 0;
+
+    isRayCastPickingEnabled = true;
+    isRayCasting = false;
+    isRayCastUndetermined = false;
+
+    isLevelOfDetailEnabled = true;
+    maxLodLevel = std::numeric_limits<int>::max();
+
+    numShadowMapCascades = DefaultNumShadowMapCascades;
+    isShadowMapCacheEnabled = true;
+    shadowCasterFilter = AllShadowCasters;
+    cascadeShadowMapCamera = new SgOrthographicCamera;
+    isShadowCasterClassificationActive = false;
+    shadowFrameCount = 0;
+    staticShadowCasterRevision = 0;
+
+    isBackgroundMeshPreparationEnabled = false;
+
     defaultFBO = 0;
     
     lightingMode = NormalLighting;
@@ -848,6 +1241,9 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
                 resource->discard();
             }
         }
+        for(auto& resource : pendingVertexResources){
+            resource->discard();
+        }
     }
 
     if(!isCalledFromDestructor){
@@ -883,6 +1279,12 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
         if(depthBufferForOverlay){
             glDeleteRenderbuffers(1, &depthBufferForOverlay);
         }
+        if(instanceModelMatrixBuffer){
+            glDeleteBuffers(1, &instanceModelMatrixBuffer);
+        }
+        if(instanceNormalMatrixBuffer){
+            glDeleteBuffers(1, &instanceNormalMatrixBuffer);
+        }
     }
 
     if(!isCalledFromDestructor){
@@ -908,6 +1310,8 @@ void GLSLSceneRenderer::Impl::clearGL(bool isGLContextActive, bool isCalledFromC
         colorBufferForPicking = 0;
         depthBufferForPicking = 0;
         depthBufferForOverlay = 0;
+        instanceModelMatrixBuffer = 0;
+        instanceNormalMatrixBuffer = 0;
         pickingImageWidth = 0;
         pickingImageHeight = 0;
         needToUpdateOverlayDepthBufferSize = true;
@@ -927,6 +1331,7 @@ void GLSLSceneRenderer::Impl::clearResourceMap()
     hasValidNextResourceMap = false;
     isCheckingUnusedResources = false;
     isResourceClearRequested = false;
+    pendingVertexResources.clear();
     currentResourceMap = &resourceMaps[0];
     nextResourceMap = &resourceMaps[1];
 }
@@ -1160,6 +1565,8 @@ ScopedShaderProgramActivator::ScopedShaderProgramActivator
     if(program == renderer->currentProgram){
         changed = false;
     } else {
+        renderer->flushOpaqueShapeQueue();
+        
         if(renderer->currentProgram){
             renderer->currentProgram->deactivate();
         }
@@ -1196,6 +1603,7 @@ ScopedShaderProgramActivator::ScopedShaderProgramActivator(ScopedShaderProgramAc
 ScopedShaderProgramActivator::~ScopedShaderProgramActivator()
 {
     if(changed){
+        renderer->flushOpaqueShapeQueue();
         renderer->currentProgram->deactivate();
         if(prevProgram){
             prevProgram->activate();
@@ -1226,6 +1634,10 @@ void GLSLSceneRenderer::Impl::pushProgram(unique_ptr<ShaderProgramType>& program
 
 void GLSLSceneRenderer::pushShaderProgram(ShaderProgram* program)
 {
+    if(impl->isRayCasting){
+        // The objects drawn by a custom shader program cannot be tested by the ray
+        impl->isRayCastUndetermined = true;
+    }
     impl->programStack.emplace_back(program, impl);
 }
 
@@ -1263,6 +1675,10 @@ void GLSLSceneRenderer::Impl::doRender()
 
     beginRendering();
 
+    if(!pendingVertexResources.empty()){
+        uploadPendingVertexData();
+    }
+
     isLightweightRenderingBeingProcessed = false;
     isLowMemoryConsumptionRenderingBeingProcessed = isLowMemoryConsumptionMode;
     isTextureBeingRendered = false;
@@ -1305,7 +1721,19 @@ void GLSLSceneRenderer::Impl::doRender()
 
         glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
 
+        isOpaqueShapeQueueActive = isOpaqueShapeQueueEnabled;
+        if(isOpaqueShapeQueueActive){
+            connectToSceneRoot();
+            std::lock_guard<std::mutex> lock(sceneRootUpdateMutex);
+            if(!isOpaqueShapeOrderValid){
+                opaqueShapeOrders.clear();
+                isOpaqueShapeOrderValid = true;
+            }
+            opaqueShapeQueueFlushCount = 0;
+        }
         renderChildNodes(self->sceneRoot());
+        flushOpaqueShapeQueue();
+        isOpaqueShapeQueueActive = false;
         
         /*
           \todo Render transparent objects directly
@@ -1345,6 +1773,15 @@ void GLSLSceneRenderer::Impl::setupFullLightingRendering()
         isRenderingVisibleImage = false;
         isRenderingShadowMap = true;
 
+        if(isShadowMapCacheEnabled){
+            updateShadowCasterClassification();
+        }
+
+        // The view frustum of the main camera is used to fit the shadow map cascades
+        renderCamera(self->currentCamera(), self->currentCameraPosition());
+        mainProjectionMatrix = projectionMatrix;
+        mainViewTransform = viewTransform;
+
         int w, h;
         program->getShadowMapSize(w, h);
         auto vp0 = self->viewport(); // preserve the original viewport size
@@ -1377,6 +1814,10 @@ void GLSLSceneRenderer::Impl::setupFullLightingRendering()
         self->GLSceneRenderer::updateViewportInformation(0, 0, vp0.w, vp0.h);
     }
         
+    if(shadowMapIndex == 0){
+        clearShadowCasterClassification();
+    }
+        
     pushProgram(program);
     program->setNumShadows(shadowMapIndex);
     program->activateMainRenderingPass();
@@ -1394,6 +1835,12 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
     if(isGLCleared){
         initializeGLForRendering();
     }
+
+    if(isRayCastPickingEnabled && !isPickingImageOutputEnabled){
+        if(doRayCastPicking(x, y)){
+            return !pickedNodePath.empty();
+        }
+    }
     
     auto& vp = self->viewport();
 
@@ -1507,6 +1954,265 @@ bool GLSLSceneRenderer::Impl::doPick(int x, int y)
 }
 
 
+bool GLSLSceneRenderer::Impl::doRayCastPicking(int x, int y)
+{
+    auto camera = self->currentCamera();
+    if(!camera){
+        pickedNodePath.clear();
+        return true;
+    }
+
+    isRenderingPickingImage = true;
+    isRenderingVisibleImage = false;
+    isRayCasting = true;
+    isRayCastUndetermined = false;
+    beginRendering();
+
+    pushProgram(solidColorProgram);
+    currentNodePath.clear();
+    pickingNodePathList.clear();
+    rayHitNodePath.clear();
+
+    renderCamera(camera, self->currentCameraPosition());
+
+    // The ray passes through the center of the pixel
+    auto& vp = self->viewport();
+    rayPixelPosition << x + 0.5, y + 0.5;
+    const double nx = 2.0 * (rayPixelPosition.x() - vp.x) / vp.w - 1.0;
+    const double ny = 2.0 * (rayPixelPosition.y() - vp.y) / vp.h - 1.0;
+    const Matrix4 PVinv = PV.inverse();
+    const Vector4 p0 = PVinv * Vector4(nx, ny, -1.0, 1.0);
+    const Vector4 p1 = PVinv * Vector4(nx, ny, 1.0, 1.0);
+    rayOrigin = p0.head<3>() / p0[3];
+    rayDirection = p1.head<3>() / p1[3] - rayOrigin;
+
+    // Only the sub trees around the pixel are traversed
+    Matrix4 P = Matrix4::Identity();
+    const double w = 2.0 * PickingFrustumMargin;
+    P(0, 0) = vp.w / w;
+    P(1, 1) = vp.h / w;
+    P(0, 3) = (vp.w - 2.0 * (rayPixelPosition.x() - vp.x)) / w;
+    P(1, 3) = (vp.h - 2.0 * (rayPixelPosition.y() - vp.y)) / w;
+    setFrustumPlanes(P * PV);
+
+    transparentRenderingQueue.clear();
+    overlayRenderingQueue.clear();
+    rayHitDistance = 1.0;
+
+    renderChildNodes(self->sceneRoot());
+
+    if(!isRayCastUndetermined && !overlayRenderingQueue.empty()){
+        // The overlay objects take priority over the other objects as in the picking image
+        SgNodePath sceneHitNodePath;
+        sceneHitNodePath.swap(rayHitNodePath);
+        const double sceneHitDistance = rayHitDistance;
+        rayHitDistance = 1.0;
+        while(!overlayRenderingQueue.empty()){
+            auto& func = overlayRenderingQueue.front();
+            func();
+            overlayRenderingQueue.pop_front();
+        }
+        if(rayHitNodePath.empty()){
+            rayHitNodePath.swap(sceneHitNodePath);
+            rayHitDistance = sceneHitDistance;
+        }
+    }
+    transparentRenderingQueue.clear();
+    overlayRenderingQueue.clear();
+
+    popProgram();
+    isRayCasting = false;
+    isRenderingPickingImage = false;
+
+    endRendering();
+
+    if(isRayCastUndetermined){
+        return false;
+    }
+
+    pickedNodePath.clear();
+    if(!rayHitNodePath.empty()){
+        pickedNodePath.swap(rayHitNodePath);
+        pickedPoint = rayOrigin + rayHitDistance * rayDirection;
+    }
+
+    return true;
+}
+
+
+void GLSLSceneRenderer::Impl::setRayHit(SgNode* node, double distance)
+{
+    rayHitDistance = distance;
+    rayHitNodePath = currentNodePath;
+    rayHitNodePath.push_back(node);
+}
+
+
+/**
+   \param tolerance The size in pixels by which the object may be drawn outside the bounding box
+*/
+bool GLSLSceneRenderer::Impl::isOutsidePickingFrustum(const BoundingBox& bbox, double tolerance)
+{
+    int planeMask = frustumPlaneMask;
+    if(planeMask && tolerance <= PickingFrustumMargin){
+        return isOutsideFrustum(bbox, modelMatrixStack.back(), planeMask);
+    }
+    return false;
+}
+
+
+bool GLSLSceneRenderer::Impl::projectToViewport(const Matrix4& M, const Vector3& p, Vector3& out_position)
+{
+    const Vector4 q = M * Vector4(p.x(), p.y(), p.z(), 1.0);
+    if(q[3] <= 0.0 || q.z() < -q[3] || q.z() > q[3]){
+        return false;
+    }
+    auto& vp = self->viewport();
+    out_position.x() = (q.x() / q[3] + 1.0) / 2.0 * vp.w + vp.x;
+    out_position.y() = (q.y() / q[3] + 1.0) / 2.0 * vp.h + vp.y;
+    out_position.z() = q.z() / q[3];
+    return true;
+}
+
+
+void GLSLSceneRenderer::Impl::rayCastShape(SgShape* shape)
+{
+    if(isBoundingBoxRenderingMode){
+        isRayCastUndetermined = true;
+        return;
+    }
+    auto mesh = shape->mesh();
+    const Affine3& T = modelMatrixStack.back();
+    const double det = T.linear().determinant();
+    if(det == 0.0){
+        return;
+    }
+    const Matrix3 Rinv = T.linear().inverse();
+    const Vector3f origin = (Rinv * (rayOrigin - T.translation())).cast<float>();
+    const Vector3f direction = (Rinv * rayDirection).cast<float>();
+
+    int faceCulling = MeshBVH::NoFaceCulling;
+    if(backFaceCullingMode == FORCE_BACK_FACE_CULLING ||
+       (backFaceCullingMode == ENABLE_BACK_FACE_CULLING && mesh->isSolid())){
+        // The front face is flipped by the mirror transform as in the GPU rendering
+        faceCulling = (det > 0.0) ? MeshBVH::BackFaceCulling : MeshBVH::FrontFaceCulling;
+    }
+
+    float distance;
+    int triangleIndex;
+    if(MeshBVH::getOrCreate(mesh)->intersect(
+           origin, direction, rayHitDistance, faceCulling, distance, triangleIndex)){
+        setRayHit(shape, distance);
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::rayCastPointSet(SgPointSet* pointSet)
+{
+    double size = pointSet->pointSize();
+    if(size <= 0.0){
+        size = defaultPointSize;
+    }
+    const double r = std::max(size, static_cast<double>(MinLineWidthForPicking)) / 2.0;
+    if(isOutsidePickingFrustum(pointSet->boundingBox(), r)){
+        return;
+    }
+
+    const Affine3& T = modelMatrixStack.back();
+    const Matrix4 M = PV * T.matrix();
+    const double dd = rayDirection.squaredNorm();
+    Vector3 q;
+
+    for(auto& v : *pointSet->vertices()){
+        const Vector3 p = v.cast<double>();
+        if(projectToViewport(M, p, q)){
+            if(fabs(q.x() - rayPixelPosition.x()) <= r && fabs(q.y() - rayPixelPosition.y()) <= r){
+                double distance = (T * p - rayOrigin).dot(rayDirection) / dd;
+                if(distance >= 0.0 && distance < rayHitDistance){
+                    setRayHit(pointSet, distance);
+                }
+            }
+        }
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::rayCastLineSet(SgLineSet* lineSet)
+{
+    float width = lineSet->lineWidth();
+    if(width < MinLineWidthForPicking){
+        width = MinLineWidthForPicking;
+    }
+    const double r = width / 2.0;
+    if(isOutsidePickingFrustum(lineSet->boundingBox(), r)){
+        return;
+    }
+
+    const Affine3& T = modelMatrixStack.back();
+    const Matrix4 M = PV * T.matrix();
+    const double dd = rayDirection.squaredNorm();
+    const auto& vertices = *lineSet->vertices();
+    const int numVertices = vertices.size();
+    const int numLines = lineSet->numLines();
+
+    for(int i=0; i < numLines; ++i){
+        auto line = lineSet->line(i);
+        if(line[0] < 0 || line[0] >= numVertices || line[1] < 0 || line[1] >= numVertices){
+            continue;
+        }
+        Vector3 a = vertices[line[0]].cast<double>();
+        Vector3 b = vertices[line[1]].cast<double>();
+        Vector4 ca = M * Vector4(a.x(), a.y(), a.z(), 1.0);
+        Vector4 cb = M * Vector4(b.x(), b.y(), b.z(), 1.0);
+
+        // Clip the segment by the near and far planes in the homogeneous coordinate
+        bool isClipped = false;
+        for(int j=0; j < 2; ++j){
+            const double sign = (j == 0) ? 1.0 : -1.0;
+            const double da = ca[3] + sign * ca.z();
+            const double db = cb[3] + sign * cb.z();
+            if(da < 0.0 && db < 0.0){
+                isClipped = true;
+                break;
+            }
+            if(da < 0.0 || db < 0.0){
+                const double s = da / (da - db);
+                if(da < 0.0){
+                    ca += s * (cb - ca);
+                    a += s * (b - a);
+                } else {
+                    cb = ca + s * (cb - ca);
+                    b = a + s * (b - a);
+                }
+            }
+        }
+        if(isClipped || ca[3] <= 0.0 || cb[3] <= 0.0){
+            continue;
+        }
+
+        auto& vp = self->viewport();
+        const Vector2 pa((ca.x() / ca[3] + 1.0) / 2.0 * vp.w + vp.x, (ca.y() / ca[3] + 1.0) / 2.0 * vp.h + vp.y);
+        const Vector2 pb((cb.x() / cb[3] + 1.0) / 2.0 * vp.w + vp.x, (cb.y() / cb[3] + 1.0) / 2.0 * vp.h + vp.y);
+        const Vector2 e = pb - pa;
+        const double ee = e.squaredNorm();
+        double s = (ee > 0.0) ? (rayPixelPosition - pa).dot(e) / ee : 0.0;
+        s = std::max(0.0, std::min(1.0, s));
+        if((pa + s * e - rayPixelPosition).norm() > r){
+            continue;
+        }
+        // Perspective correct interpolation of the position on the segment
+        const double sa = (1.0 - s) / ca[3];
+        const double sb = s / cb[3];
+        const double s3 = sb / (sa + sb);
+        const Vector3 p = T * (a + s3 * (b - a));
+        double distance = (p - rayOrigin).dot(rayDirection) / dd;
+        if(distance >= 0.0 && distance < rayHitDistance){
+            setRayHit(lineSet, distance);
+        }
+    }
+}
+
+
 void GLSLSceneRenderer::setPickingImageOutputEnabled(bool on)
 {
     impl->isPickingImageOutputEnabled = on;
@@ -1550,60 +2256,390 @@ bool GLSLSceneRenderer::Impl::renderShadowMap(int lightIndex)
 bool GLSLSceneRenderer::Impl::renderShadowMap(SgLight* light, const Isometry3& T)
 {
     if(light->on()){
-        Isometry3 Tc = T;
-        SgCamera* shadowMapCamera = fullLightingProgram->getShadowMapCamera(light, Tc);
-        if(shadowMapCamera){
+        if(auto directional = dynamic_cast<SgDirectionalLight*>(light)){
+            renderCascadedShadowMap(directional, T);
+        } else {
+            Isometry3 Tc = T;
+            SgCamera* shadowMapCamera = fullLightingProgram->getShadowMapCamera(light, Tc);
+            if(!shadowMapCamera){
+                return false;
+            }
             renderCamera(shadowMapCamera, Tc);
             fullLightingProgram->setShadowMapViewProjection(PV);
             fullLightingProgram->shadowMapProgram()->initializeShadowMapBuffer();
-            renderChildNodes(self->sceneRoot());
-
-            if(USE_GL_FLUSH_FUNCTION_IN_SHADOW_MAP_RENDERING){
-                glFlush();
-            }
-            
-            return true;
+            renderShadowCasters();
+        }
+        if(USE_GL_FLUSH_FUNCTION_IN_SHADOW_MAP_RENDERING){
+            glFlush();
         }
+        return true;
     }
     return false;
 }
 
 
-void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& cameraPosition)
-{
-    if(SgPerspectiveCamera* pers = dynamic_cast<SgPerspectiveCamera*>(camera)){
-        double aspectRatio = self->aspectRatio();
-        self->getPerspectiveProjectionMatrix(
-            pers->fovy(aspectRatio), aspectRatio, pers->nearClipDistance(), pers->farClipDistance(),
-            projectionMatrix);
-        
-    } else if(SgOrthographicCamera* ortho = dynamic_cast<SgOrthographicCamera*>(camera)){
-        GLfloat left, right, bottom, top;
-        self->getViewVolume(ortho, left, right, bottom, top);
-        self->getOrthographicProjectionMatrix(
-            left, right, bottom, top, ortho->nearClipDistance(), ortho->farClipDistance(),
-            projectionMatrix);
+/**
+   The cascades are fitted so that they do not change as long as the camera moves within
+   a certain range, which is necessary to make the cached depth images of the static shadow
+   casters valid. Each cascade is fitted to the bounding sphere of the corresponding part of
+   the view frustum, the radius of which is invariant to the camera rotation, and the center
+   of the cascade is snapped to a coarse grid in the light coordinate.
+*/
+void GLSLSceneRenderer::Impl::renderCascadedShadowMap(SgDirectionalLight* light, const Isometry3& T)
+{
+    Isometry3 Tc = T;
+    fullLightingProgram->getShadowMapCamera(light, Tc);
+    const Matrix3 R = Tc.linear();
+    const Matrix3 Rt = R.transpose();
+
+    BoundingBox bbox = self->sceneRoot()->boundingBox();
+    if(bbox.empty()){
+        bbox.set(Vector3(-1.0, -1.0, -1.0), Vector3(1.0, 1.0, 1.0));
+    }
+    const Vector3& bmin = bbox.min();
+    const Vector3& bmax = bbox.max();
+
+    // The depth ranges of the scene in the view coordinate and the light coordinate
+    double minViewDepth = std::numeric_limits<double>::max();
+    double maxViewDepth = -std::numeric_limits<double>::max();
+    double minLightZ = std::numeric_limits<double>::max();
+    double maxLightZ = -std::numeric_limits<double>::max();
+    for(int i=0; i < 8; ++i){
+        const Vector3 p((i & 1) ? bmax.x() : bmin.x(), (i & 2) ? bmax.y() : bmin.y(), (i & 4) ? bmax.z() : bmin.z());
+        const double viewDepth = -(mainViewTransform * p).z();
+        minViewDepth = std::min(minViewDepth, viewDepth);
+        maxViewDepth = std::max(maxViewDepth, viewDepth);
+        const double z = Rt.row(2).dot(p);
+        minLightZ = std::min(minLightZ, z);
+        maxLightZ = std::max(maxLightZ, z);
+    }
+
+    // The corners of the view frustum on the near clip plane and the far clip plane
+    const Matrix4 Pinv = mainProjectionMatrix.inverse();
+    Vector3 nearCorners[4];
+    Vector3 farCorners[4];
+    for(int i=0; i < 4; ++i){
+        const double x = (i & 1) ? 1.0 : -1.0;
+        const double y = (i & 2) ? 1.0 : -1.0;
+        const Vector4 pn = Pinv * Vector4(x, y, -1.0, 1.0);
+        const Vector4 pf = Pinv * Vector4(x, y, 1.0, 1.0);
+        nearCorners[i] = pn.head<3>() / pn.w();
+        farCorners[i] = pf.head<3>() / pf.w();
+    }
+    const double nearDepth = -nearCorners[0].z();
+    const double farDepth = -farCorners[0].z();
+
+    double n = std::max(std::max(nearDepth, minViewDepth), 1.0e-3);
+    double f = std::min(farDepth, maxViewDepth);
+    // The range is quantized not to change the cascades by a small movement
+    n = std::max(nearDepth, 1.0 / quantizeUpwardByPowerOfTwo(1.0 / n));
+    f = std::max(quantizeUpwardByPowerOfTwo(std::max(f, n)), n * 1.01);
+
+    const int numCascades = numShadowMapCascades;
+    double splitDepths[5];
+    splitDepths[0] = n;
+    for(int i=1; i < numCascades; ++i){
+        const double r = static_cast<double>(i) / numCascades;
+        const double logSplit = n * std::pow(f / n, r);
+        const double uniformSplit = n + (f - n) * r;
+        splitDepths[i] = CascadeSplitLambda * logSplit + (1.0 - CascadeSplitLambda) * uniformSplit;
+    }
+    splitDepths[numCascades] = f;
+
+    // The range of the light coordinate z is also quantized
+    const double zStep = std::pow(2.0, std::ceil(std::log2(std::max(maxLightZ - minLightZ, 1.0e-3)))) / 8.0;
+    const double zTop = (std::ceil(maxLightZ / zStep) + 1.0) * zStep;
+    const double zBottom = (std::floor(minLightZ / zStep) - 1.0) * zStep;
+
+    const Isometry3 mainCameraPosition = mainViewTransform.inverse(Eigen::Isometry);
+
+    fullLightingProgram->setNumShadowMapCascades(numCascades);
+
+    for(int i=0; i < numCascades; ++i){
+        Vector3 corners[8];
+        Vector3 center = Vector3::Zero();
+        for(int j=0; j < 4; ++j){
+            for(int k=0; k < 2; ++k){
+                const double d = splitDepths[i + k];
+                const double t = (d - nearDepth) / (farDepth - nearDepth);
+                const Vector3 p = nearCorners[j] + (farCorners[j] - nearCorners[j]) * t;
+                const Vector3 q = Rt * (mainCameraPosition * p);
+                corners[j * 2 + k] = q;
+                center += q;
+            }
+        }
+        center /= 8.0;
+        double radius = 0.0;
+        for(int j=0; j < 8; ++j){
+            radius = std::max(radius, (corners[j] - center).norm());
+        }
+        radius = quantizeUpwardByPowerOfTwo(std::max(radius, 1.0e-3));
+
+        /*
+          The half width is extended so that the cascade still covers the bounding sphere
+          after the center is snapped to the grid. The grid interval corresponds to 1/16 of
+          the shadow map size so that the grid is aligned with the texels.
+        */
+        const double halfWidth = radius * 9.0 / 8.0;
+        const double step = halfWidth / 8.0;
+        const double cx = std::round(center.x() / step) * step;
+        const double cy = std::round(center.y() / step) * step;
+
+        Isometry3 Tcascade;
+        Tcascade.linear() = R;
+        Tcascade.translation() = R * Vector3(cx, cy, zTop);
+        cascadeShadowMapCamera->setHeight(2.0 * halfWidth);
+        cascadeShadowMapCamera->setNearClipDistance(0.0);
+        cascadeShadowMapCamera->setFarClipDistance(zTop - zBottom);
         
-    } else {
-        self->getPerspectiveProjectionMatrix(
-            radian(40.0), self->aspectRatio(), 0.01, 1.0e4,
-            projectionMatrix);
+        renderCamera(cascadeShadowMapCamera, Tcascade);
+        fullLightingProgram->setShadowMapCascade(i, PV, splitDepths[i + 1]);
+        fullLightingProgram->shadowMapProgram()->initializeShadowMapBuffer(i);
+        renderShadowCasters();
     }
+}
 
-    if(isUpsideDownEnabled){
-        Isometry3 T = cameraPosition * AngleAxis(PI, Vector3(0.0, 0.0, 1.0));
-        viewTransform = T.inverse(Eigen::Isometry);
-    } else {
-        viewTransform = cameraPosition.inverse(Eigen::Isometry);
+
+void GLSLSceneRenderer::Impl::renderShadowCasters()
+{
+    if(!isShadowMapCacheEnabled){
+        renderChildNodes(self->sceneRoot());
+        return;
+    }
+    
+    auto shadowMapProgram = fullLightingProgram->shadowMapProgram();
+    if(!shadowMapProgram->restoreStaticShadowMap(staticShadowCasterRevision)){
+        shadowCasterFilter = StaticShadowCasters;
+        renderChildNodes(self->sceneRoot());
+        shadowMapProgram->storeStaticShadowMap(staticShadowCasterRevision);
+    }
+    if(!dynamicShadowCasters.empty()){
+        shadowCasterFilter = DynamicShadowCasters;
+        renderChildNodes(self->sceneRoot());
+    }
+    shadowCasterFilter = AllShadowCasters;
+}
+
+
+void GLSLSceneRenderer::Impl::connectToSceneRoot()
+{
+    if(!sceneRootConnection.connected()){
+        sceneRootConnection =
+            self->sceneRoot()->sigUpdated().connect(
+                [this](const SgUpdate& update){ onSceneRootUpdated(update); });
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::onSceneRootUpdated(const SgUpdate& update)
+{
+    std::lock_guard<std::mutex> lock(sceneRootUpdateMutex);
+
+    if(isOpaqueShapeOrderValid){
+        auto& path = update.path();
+        if(update.hasAction(SgUpdate::Added | SgUpdate::Removed) || path.empty() ||
+           !path.front()->isNode() || !static_cast<SgNode*>(path.front())->isTransformNode()){
+            isOpaqueShapeOrderValid = false;
+        }
+    }
+    
+    if(!isShadowCasterClassificationActive ||
+       !update.hasAction(SgUpdate::GeometryModified | SgUpdate::Added | SgUpdate::Removed)){
+        return;
+    }
+    bool isAncestor = false;
+    for(auto& object : update.path()){
+        if(object->isNode()){
+            auto inserted = updatedShadowCasters.emplace(static_cast<SgNode*>(object), isAncestor);
+            if(!isAncestor){
+                inserted.first->second = false;
+            }
+            isAncestor = true;
+        }
+    }
+}
+
+
+/**
+   A node that notified a geometry update is regarded as a dynamic shadow caster, and it
+   becomes a static one again when it has not been updated for a certain number of frames.
+   The revision of the static shadow casters is incremented when the set of the dynamic
+   shadow casters is changed so that the cached depth images are rendered again.
+*/
+void GLSLSceneRenderer::Impl::updateShadowCasterClassification()
+{
+    connectToSceneRoot();
+    
+    ++shadowFrameCount;
+    bool isStaticShadowCasterSetChanged = false;
+    {
+        std::lock_guard<std::mutex> lock(sceneRootUpdateMutex);
+        if(!isShadowCasterClassificationActive){
+            isShadowCasterClassificationActive = true;
+            ++staticShadowCasterRevision;
+        }
+        for(auto& kv : updatedShadowCasters){
+            if(kv.second){
+                dynamicShadowCasterAncestors[kv.first] = shadowFrameCount;
+            } else {
+                auto inserted = dynamicShadowCasters.emplace(kv.first, shadowFrameCount);
+                if(inserted.second){
+                    isStaticShadowCasterSetChanged = true;
+                } else {
+                    inserted.first->second = shadowFrameCount;
+                }
+            }
+        }
+        updatedShadowCasters.clear();
+    }
+
+    auto p = dynamicShadowCasters.begin();
+    while(p != dynamicShadowCasters.end()){
+        if(shadowFrameCount - p->second > NumFramesToBecomeStaticShadowCaster){
+            p = dynamicShadowCasters.erase(p);
+            isStaticShadowCasterSetChanged = true;
+        } else {
+            ++p;
+        }
+    }
+    auto q = dynamicShadowCasterAncestors.begin();
+    while(q != dynamicShadowCasterAncestors.end()){
+        if(shadowFrameCount - q->second > NumFramesToBecomeStaticShadowCaster){
+            q = dynamicShadowCasterAncestors.erase(q);
+        } else {
+            ++q;
+        }
+    }
+
+    if(invisibleNodeSet != invisibleNodeSetForStaticShadowCasters){
+        invisibleNodeSetForStaticShadowCasters = invisibleNodeSet;
+        isStaticShadowCasterSetChanged = true;
+    }
+    
+    if(isStaticShadowCasterSetChanged){
+        ++staticShadowCasterRevision;
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::clearShadowCasterClassification()
+{
+    if(isShadowCasterClassificationActive){
+        {
+            std::lock_guard<std::mutex> lock(sceneRootUpdateMutex);
+            isShadowCasterClassificationActive = false;
+            updatedShadowCasters.clear();
+        }
+        dynamicShadowCasters.clear();
+        dynamicShadowCasterAncestors.clear();
+        invisibleNodeSetForStaticShadowCasters.clear();
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderCamera(SgCamera* camera, const Isometry3& cameraPosition)
+{
+    if(SgPerspectiveCamera* pers = dynamic_cast<SgPerspectiveCamera*>(camera)){
+        double aspectRatio = self->aspectRatio();
+        self->getPerspectiveProjectionMatrix(
+            pers->fovy(aspectRatio), aspectRatio, pers->nearClipDistance(), pers->farClipDistance(),
+            projectionMatrix);
+        
+    } else if(SgOrthographicCamera* ortho = dynamic_cast<SgOrthographicCamera*>(camera)){
+        GLfloat left, right, bottom, top;
+        self->getViewVolume(ortho, left, right, bottom, top);
+        self->getOrthographicProjectionMatrix(
+            left, right, bottom, top, ortho->nearClipDistance(), ortho->farClipDistance(),
+            projectionMatrix);
+        
+    } else {
+        self->getPerspectiveProjectionMatrix(
+            radian(40.0), self->aspectRatio(), 0.01, 1.0e4,
+            projectionMatrix);
+    }
+
+    if(isUpsideDownEnabled){
+        Isometry3 T = cameraPosition * AngleAxis(PI, Vector3(0.0, 0.0, 1.0));
+        viewTransform = T.inverse(Eigen::Isometry);
+    } else {
+        viewTransform = cameraPosition.inverse(Eigen::Isometry);
     }
     PV = projectionMatrix * viewTransform.matrix();
 
+    updateFrustumPlanes();
+
     modelMatrixStack.clear();
     modelMatrixStack.push_back(Affine3::Identity());
     modelMatrixBuffer.clear();
 }
 
 
+void GLSLSceneRenderer::Impl::updateFrustumPlanes()
+{
+    if(!isFrustumCullingEnabled){
+        frustumPlaneMask = 0;
+        return;
+    }
+    setFrustumPlanes(PV);
+}
+
+
+void GLSLSceneRenderer::Impl::setFrustumPlanes(const Matrix4& M)
+{
+    // Extract the planes from the rows of the projection-view matrix (Gribb-Hartmann method)
+    for(int i=0; i < 3; ++i){
+        frustumPlanes[i * 2] = (M.row(3) + M.row(i)).transpose();
+        frustumPlanes[i * 2 + 1] = (M.row(3) - M.row(i)).transpose();
+    }
+    frustumPlaneMask = 0x3f;
+}
+
+
+/**
+   This function returns true if the bounding box transformed by T is completely outside
+   one of the frustum planes specified by planeMask. The bits of the planes that the box
+   is completely inside are cleared from planeMask so that the descendants can skip them.
+*/
+bool GLSLSceneRenderer::Impl::isOutsideFrustum(const BoundingBox& bbox, const Affine3& T, int& planeMask)
+{
+    if(bbox.empty()){
+        return false;
+    }
+    const Vector3 c = T * bbox.center();
+    const Vector3 e = T.linear().cwiseAbs() * (0.5 * bbox.size());
+
+    for(int i=0; i < 6; ++i){
+        const int bit = 1 << i;
+        if(planeMask & bit){
+            auto& plane = frustumPlanes[i];
+            const Vector3 n = plane.head<3>();
+            double s = n.dot(c) + plane[3];
+            double r = n.cwiseAbs().dot(e);
+            if(s + r < 0.0){
+                return true;
+            }
+            if(s - r >= 0.0){
+                planeMask &= ~bit;
+            }
+        }
+    }
+    return false;
+}
+
+
+void GLSLSceneRenderer::Impl::keepResourcesInSubTree(SgObject* object)
+{
+    auto p = currentResourceMap->find(object);
+    if(p != currentResourceMap->end()){
+        nextResourceMap->insert(*p);
+    }
+    int n = object->numChildObjects();
+    for(int i=0; i < n; ++i){
+        keepResourcesInSubTree(object->childObject(i));
+    }
+}
+
+
 void GLSLSceneRenderer::Impl::beginRendering()
 {
     ++renderingFrameId;
@@ -1613,6 +2649,13 @@ void GLSLSceneRenderer::Impl::beginRendering()
     
     self->extractPreprocessedNodes();
 
+    auto revision = self->preprocessedNodeTreeRevision();
+    if(revision != cullingInfoRevision){
+        groupCullabilityMap.clear();
+        cullingInfoRevision = revision;
+    }
+    numCullingBlockers = 0;
+
     isCheckingUnusedResources = isRenderingPickingImage ? false : doUnusedResourceCheck;
 
     if(isResourceClearRequested){
@@ -1634,10 +2677,27 @@ void GLSLSceneRenderer::Impl::endRendering()
     if(isCheckingUnusedResources){
         currentResourceMap->clear();
         hasValidNextResourceMap = true;
+
+        auto p = groupCullabilityMap.begin();
+        while(p != groupCullabilityMap.end()){
+            if(p->second.frameId != renderingFrameId){
+                p = groupCullabilityMap.erase(p);
+            } else {
+                ++p;
+            }
+        }
     }
 }
 
 
+bool& GLSLSceneRenderer::Impl::getGroupCullability(SgGroup* group)
+{
+    auto& cullability = groupCullabilityMap[group];
+    cullability.frameId = renderingFrameId;
+    return cullability.isCullable;
+}
+
+
 void GLSLSceneRenderer::Impl::setupNodeVisibilities()
 {
     /**
@@ -1813,6 +2873,10 @@ void GLSLSceneRenderer::dispatchToTransparentPhase
 (ReferencedPtr object, int id,
  const std::function<void(Referenced* object, const Affine3& modelTransform, int id)>& renderingFunction)
 {
+    if(impl->isRayCasting){
+        impl->isRayCastUndetermined = true;
+        return;
+    }
     if(!impl->isRenderingShadowMap){
         int matrixIndex = impl->modelMatrixBuffer.size();
         impl->modelMatrixBuffer.push_back(impl->modelMatrixStack.back());
@@ -2024,6 +3088,14 @@ void GLSLSceneRenderer::Impl::dispatchRenderingFunction(SgNode* node)
             return;
         }
     }
+    if(node->hasAttribute(SgNode::Marker)){
+        // The bounding box of a group does not include marker nodes
+        ++numCullingBlockers;
+    } else if(!node->isGroupNode() && node->boundingBox().empty()){
+        if(!dynamic_cast<SgPreprocessed*>(node)){
+            ++numCullingBlockers;
+        }
+    }
     renderingFunctions->dispatch(node);
 }
 
@@ -2036,7 +3108,9 @@ void GLSLSceneRenderer::renderNode(SgNode* node)
 
 void GLSLSceneRenderer::Impl::renderChildNodes(SgGroup* group)
 {
-    if(nodeDecorationInfoArrayMap.empty()){
+    if(shadowCasterFilter != AllShadowCasters){
+        renderChildNodesWithShadowCasterFilter(group);
+    } else if(nodeDecorationInfoArrayMap.empty()){
         for(auto p = group->cbegin(); p != group->cend(); ++p){
             dispatchRenderingFunction(*p);
         }
@@ -2049,23 +3123,53 @@ void GLSLSceneRenderer::Impl::renderChildNodes(SgGroup* group)
 void GLSLSceneRenderer::Impl::renderChildNodesWithNodeDecorationCheck(SgGroup* group)
 {
     for(auto p = group->cbegin(); p != group->cend(); ++p){
-        auto node = *p;
-        if(!node->isDecoratedSomewhere() ||
-           group->hasAttribute(SgNode::NodeDecorationGroup)){
+        renderChildNodeWithNodeDecorationCheck(group, *p);
+    }
+}
+
+
+void GLSLSceneRenderer::Impl::renderChildNodeWithNodeDecorationCheck(SgGroup* group, SgNode* node)
+{
+    if(!node->isDecoratedSomewhere() ||
+       group->hasAttribute(SgNode::NodeDecorationGroup)){
+        dispatchRenderingFunction(node);
+    } else {
+        auto q = nodeDecorationInfoArrayMap.find(node);
+        if(q == nodeDecorationInfoArrayMap.end()){
             dispatchRenderingFunction(node);
         } else {
-            auto q = nodeDecorationInfoArrayMap.find(node);
-            if(q == nodeDecorationInfoArrayMap.end()){
-                dispatchRenderingFunction(node);
-            } else {
-                SgNodePtr node2 = node;
-                auto& nodeDecorationInfos = *q->second;
-                for(auto& info : nodeDecorationInfos){
-                    node2 = info.func(node2);
-                    node2->setAttribute(SgNode::NodeDecorationGroup);
-                }
-                dispatchRenderingFunction(node2);
+            SgNodePtr node2 = node;
+            auto& nodeDecorationInfos = *q->second;
+            for(auto& info : nodeDecorationInfos){
+                node2 = info.func(node2);
+                node2->setAttribute(SgNode::NodeDecorationGroup);
             }
+            dispatchRenderingFunction(node2);
+        }
+    }
+}
+
+
+/**
+   The static shadow casters are the nodes that are not dynamic shadow casters. In rendering
+   the dynamic shadow casters, the sub trees of them are rendered entirely and only the
+   ancestors of them are traversed in the other part of the scene graph.
+*/
+void GLSLSceneRenderer::Impl::renderChildNodesWithShadowCasterFilter(SgGroup* group)
+{
+    for(auto p = group->cbegin(); p != group->cend(); ++p){
+        SgNode* node = *p;
+        const bool isDynamic = dynamicShadowCasters.find(node) != dynamicShadowCasters.end();
+        if(shadowCasterFilter == StaticShadowCasters){
+            if(!isDynamic){
+                renderChildNodeWithNodeDecorationCheck(group, node);
+            }
+        } else if(isDynamic){
+            shadowCasterFilter = AllShadowCasters;
+            renderChildNodeWithNodeDecorationCheck(group, node);
+            shadowCasterFilter = DynamicShadowCasters;
+        } else if(dynamicShadowCasterAncestors.find(node) != dynamicShadowCasterAncestors.end()){
+            renderChildNodeWithNodeDecorationCheck(group, node);
         }
     }
 }
@@ -2079,6 +3183,54 @@ void GLSLSceneRenderer::Impl::renderGroup(SgGroup* group)
 }
 
 
+void GLSLSceneRenderer::Impl::renderCullableGroup(SgGroup* group)
+{
+    const int planeMask0 = frustumPlaneMask;
+    auto& isCullable = getGroupCullability(group);
+    if(isCullable && frustumPlaneMask){
+        if(isOutsideFrustum(group->boundingBox(), modelMatrixStack.back(), frustumPlaneMask)){
+            if(isCheckingUnusedResources){
+                keepResourcesInSubTree(group);
+            }
+            frustumPlaneMask = planeMask0;
+            return;
+        }
+    }
+    const int numCullingBlockers0 = numCullingBlockers;
+    renderGroup(group);
+    // The culling blockers are not counted for the sub trees skipped by the shadow caster filter
+    if(shadowCasterFilter == AllShadowCasters){
+        isCullable = (numCullingBlockers == numCullingBlockers0);
+    }
+    frustumPlaneMask = planeMask0;
+}
+
+
+/**
+   A deferred group is only materialized when it is in the view frustum in the rendering of the
+   visible image. A group without the bounding box cannot be culled, so it is materialized when
+   it is visited in the rendering.
+*/
+void GLSLSceneRenderer::Impl::renderDeferredGroup(SgDeferredGroup* group)
+{
+    if(group->isMaterialized()){
+        renderCullableGroup(group);
+
+    } else if(isRenderingVisibleImage){
+        const BoundingBox& bbox = group->boundingBox();
+        bool isVisible = true;
+        if(!bbox.empty() && frustumPlaneMask){
+            const int planeMask0 = frustumPlaneMask;
+            isVisible = !isOutsideFrustum(bbox, modelMatrixStack.back(), frustumPlaneMask);
+            frustumPlaneMask = planeMask0;
+        }
+        if(isVisible){
+            self->requestDeferredGroupMaterialization(group);
+        }
+    }
+}
+
+
 void GLSLSceneRenderer::renderCustomGroup(SgGroup* group, std::function<void()> traverseFunction)
 {
     impl->pushPickNode(group);
@@ -2109,11 +3261,32 @@ void GLSLSceneRenderer::Impl::renderTransform(SgTransform* transform)
         Affine3 T;
         transform->getTransform(T);
         modelMatrixStack.push_back(modelMatrixStack.back() * T);
+
+        const int planeMask0 = frustumPlaneMask;
+        auto& isCullable = getGroupCullability(transform);
+        if(isCullable && frustumPlaneMask){
+            if(isOutsideFrustum(
+                   transform->untransformedBoundingBox(), modelMatrixStack.back(), frustumPlaneMask)){
+                if(isCheckingUnusedResources){
+                    keepResourcesInSubTree(transform);
+                }
+                frustumPlaneMask = planeMask0;
+                modelMatrixStack.pop_back();
+                return;
+            }
+        }
+        const int numCullingBlockers0 = numCullingBlockers;
+        
         pushPickNode(transform);
 
         renderChildNodes(transform);
 
         popPickNode();
+
+        if(shadowCasterFilter == AllShadowCasters){
+            isCullable = (numCullingBlockers == numCullingBlockers0);
+        }
+        frustumPlaneMask = planeMask0;
         modelMatrixStack.pop_back();
     }
 }
@@ -2135,6 +3308,9 @@ void GLSLSceneRenderer::renderCustomTransform(SgTransform* transform, std::funct
 
 void GLSLSceneRenderer::Impl::renderFixedPixelSizeGroup(SgFixedPixelSizeGroup* fixedPixelSizeGroup)
 {
+    // The scaled sub tree may exceed the bounding box seen from the parent group
+    ++numCullingBlockers;
+    
     double r = self->projectedPixelSizeRatio(modelMatrixStack.back().translation());
 
     if(r > 0.0){
@@ -2221,6 +3397,22 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 {
     SgMesh* mesh = shape->mesh();
     if(mesh && mesh->hasVertices()){
+        if(frustumPlaneMask){
+            int planeMask = frustumPlaneMask;
+            if(isOutsideFrustum(mesh->boundingBox(), modelMatrixStack.back(), planeMask)){
+                if(isCheckingUnusedResources){
+                    keepResourcesInSubTree(shape);
+                }
+                return;
+            }
+        }
+        if(isRayCasting){
+            rayCastShape(shape);
+            return;
+        }
+        if(isLevelOfDetailEnabled && !isRenderingPickingImage){
+            mesh = selectLodMesh(mesh);
+        }
         SgMaterial* material = shape->material();
         bool isTransparent = false;
         if(currentProgram->hasCapability(ShaderProgram::Transparency)){
@@ -2229,18 +3421,24 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
             }
         }
         if(!isTransparent){
-            auto pickIndex = pushPickEndNode(shape, false);
-            renderShapeMain(shape, modelMatrixStack.back(), pickIndex);
-            popPickNode();
+            // The normal visualization is rendered with another program, which flushes the queue
+            if(isOpaqueShapeQueueActive && !isBoundingBoxRenderingMode && !isNormalVisualizationEnabled){
+                queueOpaqueShape(shape, mesh);
+            } else {
+                auto pickIndex = pushPickEndNode(shape, false);
+                renderShapeMain(shape, mesh, modelMatrixStack.back(), pickIndex);
+                popPickNode();
+            }
         } else {
             if(!isRenderingShadowMap){
                 SgShapePtr shapePtr = shape;
+                SgMeshPtr meshPtr = mesh;
                 int matrixIndex = modelMatrixBuffer.size();
                 modelMatrixBuffer.push_back(modelMatrixStack.back());
                 auto pickIndex = pushPickEndNode(shape, false);
                 transparentRenderingQueue.emplace_back(
-                    [this, shapePtr, matrixIndex, pickIndex](){
-                        renderShapeMain(shapePtr, modelMatrixBuffer[matrixIndex], pickIndex); });
+                    [this, shapePtr, meshPtr, matrixIndex, pickIndex](){
+                        renderShapeMain(shapePtr, meshPtr, modelMatrixBuffer[matrixIndex], pickIndex); });
                 popPickNode();
             }
         }
@@ -2248,10 +3446,54 @@ void GLSLSceneRenderer::Impl::renderShape(SgShape* shape)
 }
 
 
-void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& modelTransform, int pickIndex)
+SgMesh* GLSLSceneRenderer::Impl::selectLodMesh(SgMesh* mesh)
 {
-    auto mesh = shape->mesh();
-    
+    if(maxLodLevel <= 0 || mesh->numTriangles() < MinNumTrianglesForLevelOfDetail){
+        return mesh;
+    }
+    auto chain = MeshLodChain::findOrRequest(mesh);
+    if(!chain || chain->numLevels() <= 1){
+        return mesh;
+    }
+
+    // The error is evaluated at the nearest depth of the bounding box in the view coordinate
+    auto& bbox = mesh->boundingBox();
+    if(bbox.empty()){
+        return mesh;
+    }
+    const Affine3& T = modelMatrixStack.back();
+    const Vector3 c = T * bbox.center();
+    const Vector3 e = T.linear().cwiseAbs() * (0.5 * bbox.size());
+    const Vector3 vc = viewTransform * c;
+    const double nearestDepth = vc.z() + viewTransform.linear().row(2).cwiseAbs().dot(e);
+    const bool isPerspective = (projectionMatrix(3, 3) == 0.0);
+    if(isPerspective && nearestDepth >= 0.0){
+        // The camera is inside the bounding box
+        return mesh;
+    }
+    const Vector3 p = c + viewTransform.linear().transpose() * Vector3(0.0, 0.0, nearestDepth - vc.z());
+    const double scale = T.linear().colwise().norm().maxCoeff();
+    const double pixelSizeRatio = self->projectedPixelSizeRatio(p) * scale;
+
+    const int maxLevel = std::min(chain->numLevels() - 1, maxLodLevel);
+    int level = 0;
+    while(level < maxLevel && chain->error(level + 1) * pixelSizeRatio <= MaxPixelErrorOfLevelOfDetail){
+        ++level;
+    }
+    return (level == 0) ? mesh : chain->simplifiedMesh(level);
+}
+
+
+void GLSLSceneRenderer::Impl::renderShapeMain
+(SgShape* shape, SgMesh* mesh, const Affine3& modelTransform, int pickIndex)
+{
+    VertexResource* resource = getOrCreateVertexResource(mesh);
+    if(!resource->isValid()){
+        if(!prepareVertexBufferObjects(shape, mesh, resource)){
+            return;
+        }
+    }
+
     if(isRenderingPickingImage){
         setPickColor(pickIndex);
     } else {
@@ -2271,10 +3513,6 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
         }
     }
 
-    VertexResource* resource = getOrCreateVertexResource(mesh);
-    if(!resource->isValid()){
-        makeVertexBufferObjects(shape, resource);
-    }
     if(isBoundingBoxRenderingMode){
         drawBoundingBox(resource, mesh->boundingBox());
     } else {
@@ -2290,6 +3528,233 @@ void GLSLSceneRenderer::Impl::renderShapeMain(SgShape* shape, const Affine3& mod
 }
 
 
+void GLSLSceneRenderer::Impl::queueOpaqueShape(SgShape* shape, SgMesh* mesh)
+{
+    VertexResource* resource = getOrCreateVertexResource(mesh);
+    if(!resource->isValid()){
+        if(!prepareVertexBufferObjects(shape, mesh, resource)){
+            return;
+        }
+    }
+
+    opaqueShapeQueue.emplace_back();
+    auto& info = opaqueShapeQueue.back();
+    info.shape = shape;
+    info.mesh = mesh;
+    info.resource = resource;
+    info.texture = nullptr;
+    if(currentMaterialLightingProgram && isTextureBeingRendered){
+        info.texture = shape->texture();
+    }
+    info.material = shape->material();
+    info.modelMatrixIndex = modelMatrixBuffer.size();
+    modelMatrixBuffer.push_back(modelMatrixStack.back());
+    info.isSolid = mesh->isSolid();
+}
+
+
+void GLSLSceneRenderer::Impl::flushOpaqueShapeQueue()
+{
+    if(opaqueShapeQueue.empty()){
+        return;
+    }
+
+    sortOpaqueShapeQueue();
+
+    const bool isInstancedDrawingAvailable =
+        isInstancedDrawingEnabled && currentProgram == fullLightingProgram.get();
+
+    SgTexture* prevTexture = nullptr;
+    bool isTextureValid = false;
+
+    const int n = opaqueShapeQueue.size();
+    int numInstances = 1;
+    for(int i=0; i < n; i += numInstances){
+        auto& info = opaqueShapeQueue[i];
+        auto mesh = info.mesh;
+        renderMaterial(info.material);
+        if(mesh->hasColors()){
+            currentProgram->setVertexColorEnabled(true);
+        }
+        if(currentMaterialLightingProgram){
+            if(info.texture != prevTexture){
+                isTextureValid = info.texture ? renderTexture(info.texture) : false;
+                prevTexture = info.texture;
+            }
+            currentMaterialLightingProgram->setTextureEnabled(isTextureValid);
+        }
+        applyCullingMode(mesh);
+
+        numInstances = isInstancedDrawingAvailable ? getNumInstancesInOpaqueShapeQueue(i) : 1;
+        if(numInstances >= MinNumInstancesForInstancedDrawing){
+            drawInstancedOpaqueShapes(i, numInstances);
+        } else {
+            numInstances = 1;
+            drawVertexResource(info.resource, GL_TRIANGLES, modelMatrixBuffer[info.modelMatrixIndex]);
+        }
+    }
+
+    opaqueShapeQueue.clear();
+}
+
+
+/**
+   The shapes are sorted by the material, the texture and the vertex resource. The shapes
+   sharing the same vertex resource are put together for instanced drawing. Each of them is
+   identified by the order of its first appearance in the queue, so the sorted order does
+   not depend on the memory addresses and it is stable for the same queue.
+*/
+void GLSLSceneRenderer::Impl::sortOpaqueShapeQueue()
+{
+    if(opaqueShapeQueueFlushCount >= static_cast<int>(opaqueShapeOrders.size())){
+        opaqueShapeOrders.resize(opaqueShapeQueueFlushCount + 1);
+    }
+    auto& order = opaqueShapeOrders[opaqueShapeQueueFlushCount++];
+    
+    const int n = opaqueShapeQueue.size();
+    bool isOrderValid = (static_cast<int>(order.shapes.size()) == n);
+    if(isOrderValid){
+        for(int i=0; i < n; ++i){
+            auto& info1 = opaqueShapeQueue[i];
+            auto& info2 = order.shapes[i];
+            if(info1.shape != info2.shape || info1.mesh != info2.mesh || info1.resource != info2.resource ||
+               info1.texture != info2.texture || info1.material != info2.material){
+                isOrderValid = false;
+                break;
+            }
+        }
+    }
+
+    if(!isOrderValid){
+        order.shapes = opaqueShapeQueue;
+        unordered_map<const void*, int> materialIds;
+        unordered_map<const void*, int> textureIds;
+        unordered_map<const void*, int> resourceIds;
+        auto getId = [](unordered_map<const void*, int>& ids, const void* object){
+            return ids.emplace(object, static_cast<int>(ids.size())).first->second;
+        };
+        vector<std::tuple<int, int, int, int>> keys(n);
+        for(int i=0; i < n; ++i){
+            auto& info = opaqueShapeQueue[i];
+            keys[i] = std::make_tuple(
+                getId(materialIds, info.material), getId(textureIds, info.texture),
+                getId(resourceIds, info.resource), i);
+        }
+        std::sort(keys.begin(), keys.end());
+        order.sortedIndices.resize(n);
+        for(int i=0; i < n; ++i){
+            order.sortedIndices[i] = std::get<3>(keys[i]);
+        }
+    }
+
+    sortedOpaqueShapeQueue.resize(n);
+    for(int i=0; i < n; ++i){
+        sortedOpaqueShapeQueue[i] = opaqueShapeQueue[order.sortedIndices[i]];
+    }
+    opaqueShapeQueue.swap(sortedOpaqueShapeQueue);
+}
+
+
+static bool isSameMaterial(const SgMaterial* m1, const SgMaterial* m2)
+{
+    if(m1 == m2){
+        return true;
+    }
+    if(!m1 || !m2){
+        return false;
+    }
+    return (m1->diffuseColor() == m2->diffuseColor() &&
+            m1->emissiveColor() == m2->emissiveColor() &&
+            m1->specularColor() == m2->specularColor() &&
+            m1->ambientIntensity() == m2->ambientIntensity() &&
+            m1->specularExponent() == m2->specularExponent() &&
+            m1->transparency() == m2->transparency());
+}
+
+
+int GLSLSceneRenderer::Impl::getNumInstancesInOpaqueShapeQueue(int index)
+{
+    auto& info0 = opaqueShapeQueue[index];
+    const int n = opaqueShapeQueue.size();
+    int i = index + 1;
+    while(i < n){
+        auto& info = opaqueShapeQueue[i];
+        if(info.resource != info0.resource || info.texture != info0.texture ||
+           !isSameMaterial(info.material, info0.material)){
+            break;
+        }
+        ++i;
+    }
+    return i - index;
+}
+
+
+void GLSLSceneRenderer::Impl::drawInstancedOpaqueShapes(int index, int numInstances)
+{
+    auto resource = opaqueShapeQueue[index].resource;
+    
+    instanceModelMatrices.resize(numInstances);
+    instanceNormalMatrices.resize(numInstances);
+    for(int i=0; i < numInstances; ++i){
+        const Affine3& M = modelMatrixBuffer[opaqueShapeQueue[index + i].modelMatrixIndex];
+        if(resource->pLocalTransform){
+            instanceModelMatrices[i] = (M.matrix() * (*resource->pLocalTransform)).cast<float>();
+        } else {
+            instanceModelMatrices[i] = M.matrix().cast<float>();
+        }
+        // The local transform is not applied to the normals because it only scales the packed positions
+        instanceNormalMatrices[i] = M.linear().inverse().transpose().cast<float>();
+    }
+
+    // The model matrices are given by the instance attributes
+    currentProgram->setTransform(PV, viewTransform, Affine3::Identity(), nullptr);
+    fullLightingProgram->setInstancingEnabled(true);
+
+    {
+        LockVertexArrayAPI lock;
+        glBindVertexArray(resource->vao);
+        if(!instanceModelMatrixBuffer){
+            glGenBuffers(1, &instanceModelMatrixBuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceModelMatrixBuffer);
+        glBufferData(
+            GL_ARRAY_BUFFER, numInstances * sizeof(Matrix4f), instanceModelMatrices.front().data(), GL_STREAM_DRAW);
+        // A mat4 attribute consists of four column vectors
+        for(int i=0; i < 4; ++i){
+            GLuint location = InstanceModelMatrixAttributeLocation + i;
+            glVertexAttribPointer(
+                location, 4, GL_FLOAT, GL_FALSE, sizeof(Matrix4f), ((GLubyte*)NULL + (i * 4 * sizeof(GLfloat))));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+        if(!instanceNormalMatrixBuffer){
+            glGenBuffers(1, &instanceNormalMatrixBuffer);
+        }
+        glBindBuffer(GL_ARRAY_BUFFER, instanceNormalMatrixBuffer);
+        glBufferData(
+            GL_ARRAY_BUFFER, numInstances * sizeof(Matrix3f), instanceNormalMatrices.front().data(), GL_STREAM_DRAW);
+        // A mat3 attribute consists of three column vectors
+        for(int i=0; i < 3; ++i){
+            GLuint location = InstanceNormalMatrixAttributeLocation + i;
+            glVertexAttribPointer(
+                location, 3, GL_FLOAT, GL_FALSE, sizeof(Matrix3f), ((GLubyte*)NULL + (i * 3 * sizeof(GLfloat))));
+            glVertexAttribDivisor(location, 1);
+            glEnableVertexAttribArray(location);
+        }
+    }
+
+    glDrawArraysInstanced(GL_TRIANGLES, 0, resource->numVertices, numInstances);
+
+    for(int i=0; i < 4; ++i){
+        glDisableVertexAttribArray(InstanceModelMatrixAttributeLocation + i);
+    }
+    for(int i=0; i < 3; ++i){
+        glDisableVertexAttribArray(InstanceNormalMatrixAttributeLocation + i);
+    }
+    fullLightingProgram->setInstancingEnabled(false);
+}
+
+
 void GLSLSceneRenderer::Impl::applyCullingMode(SgMesh* mesh)
 {
     if(!stateFlag[CULL_FACE]){
@@ -2425,49 +3890,205 @@ bool GLSLSceneRenderer::Impl::loadTextureImage(TextureResource* resource, const
 }
 
 
-void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, VertexResource* resource)
+/**
+   \return true if the buffer objects are ready. false is returned when the vertices
+   are being prepared in the background.
+*/
+bool GLSLSceneRenderer::Impl::prepareVertexBufferObjects(SgShape* shape, SgMesh* mesh, VertexResource* resource)
 {
-    auto mesh = shape->mesh();
+    if(resource->pendingData){
+        return false;
+    }
+    if(!isBackgroundMeshPreparationEnabled ||
+       mesh->numTriangles() < MinNumTrianglesForBackgroundMeshPreparation){
+        makeVertexBufferObjects(shape, mesh, resource);
+        return true;
+    }
+
+    VertexPacker packer;
+    setupVertexPacker(shape, mesh, packer);
+    SgMeshPtr meshData = copyMeshDataForVertexPacking(mesh, packer);
+    resource->pendingData = new PackedVertexData;
+    backgroundVertexPacker.request(packer, meshData, resource->pendingData);
+    pendingVertexResources.push_back(resource);
+
+    return false;
+}
+
+
+void GLSLSceneRenderer::Impl::makeVertexBufferObjects(SgShape* shape, SgMesh* mesh, VertexResource* resource)
+{
+    VertexPacker packer;
+    setupVertexPacker(shape, mesh, packer);
+    PackedVertexDataPtr data = new PackedVertexData;
+    packer.pack(mesh, data);
+    uploadPackedVertexData(resource, data, nullptr);
+}
+
+
+void GLSLSceneRenderer::Impl::setupVertexPacker(SgShape* shape, SgMesh* mesh, VertexPacker& packer)
+{
+    packer.isLowMemoryConsumptionFormatEnabled = isLowMemoryConsumptionRenderingBeingProcessed;
+    packer.isSmoothShadingEnabled = defaultSmoothShading;
+    packer.isNormalVisualizationEnabled = isNormalVisualizationEnabled;
+    packer.normalVisualizationLength = normalVisualizationLength;
+    packer.isTexCoordEnabled = false;
+    packer.hasTexCoordTransform = false;
+
+    auto texture = shape->texture();
+    if(texture && mesh->hasTexCoords() && isTextureBeingRendered){
+        packer.isTexCoordEnabled = true;
+        if(auto tt = texture->textureTransform()){
+            Eigen::Rotation2Df R(tt->rotation());
+            const auto& c = tt->center();
+            Eigen::Translation<float, 2> C(c.x(), c.y());
+            const auto& t = tt->translation();
+            Eigen::Translation<float, 2> T(t.x(), t.y());
+            const auto s = tt->scale().cast<float>();
+            packer.texCoordTransform = T * C * R * Eigen::Scaling(s.x(), s.y()) * C.inverse();
+            packer.hasTexCoordTransform = true;
+        }
+    }
+}
+
+
+/**
+   \param deadline The upload is suspended when the time reaches the deadline, and it is
+   resumed from the suspended point in the next call. All the data is uploaded at once if
+   the deadline is not given.
+   \return true if the upload is completed.
+*/
+bool GLSLSceneRenderer::Impl::uploadPackedVertexData
+(VertexResource* resource, PackedVertexData* data, const std::chrono::steady_clock::time_point* deadline)
+{
+    auto& attributes = data->attributes;
+    
+    while(data->numUploadedAttributes < static_cast<int>(attributes.size())){
+        auto& attribute = *attributes[data->numUploadedAttributes];
+        const GLsizeiptr size = attribute.dataSize();
+        // The buffer of each attribute is only created once even if the upload is suspended and resumed
+        if(resource->numBuffers <= data->numUploadedAttributes){
+            if(deadline && std::chrono::steady_clock::now() >= *deadline){
+                return false;
+            }
+            {
+                LockVertexArrayAPI lock;
+                glBindVertexArray(resource->vao);
+                glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
+                glVertexAttribPointer(
+                    attribute.location, attribute.size, attribute.type, attribute.normalized, 0,
+                    ((GLubyte*)NULL + (0)));
+            }
+            if(!deadline){
+                glBufferData(GL_ARRAY_BUFFER, size, attribute.data(), GL_STATIC_DRAW);
+                data->uploadedDataSize = size;
+            } else {
+                glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STATIC_DRAW);
+            }
+            glEnableVertexAttribArray(attribute.location);
+        } else {
+            glBindBuffer(GL_ARRAY_BUFFER, resource->vbo(data->numUploadedAttributes));
+        }
+        while(data->uploadedDataSize < size){
+            if(std::chrono::steady_clock::now() >= *deadline){
+                return false;
+            }
+            GLsizeiptr chunkSize = std::min(static_cast<GLsizeiptr>(MeshUploadChunkSize), size - data->uploadedDataSize);
+            glBufferSubData(
+                GL_ARRAY_BUFFER, data->uploadedDataSize, chunkSize,
+                static_cast<const GLubyte*>(attribute.data()) + data->uploadedDataSize);
+            data->uploadedDataSize += chunkSize;
+        }
+        ++data->numUploadedAttributes;
+        data->uploadedDataSize = 0;
+    }
+
+    resource->numVertices = data->numVertices;
+    if(data->hasLocalTransform){
+        resource->localTransform = data->localTransform;
+        resource->pLocalTransform = &resource->localTransform;
+    } else {
+        resource->pLocalTransform = nullptr;
+    }
+    if(data->normalVisualization){
+        data->normalVisualization->setMaterial(normalVisualizationMaterial);
+    }
+    resource->normalVisualization = data->normalVisualization;
+    
+    return true;
+}
+
+
+void GLSLSceneRenderer::Impl::uploadPendingVertexData()
+{
+    const auto deadline =
+        std::chrono::steady_clock::now() +
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(MaxMeshUploadTimePerFrame));
+
+    auto p = pendingVertexResources.begin();
+    while(p != pendingVertexResources.end()){
+        VertexResource* resource = *p;
+        auto& data = resource->pendingData;
+        // The resource is only owned by this list if it is not used by the renderer any more
+        if(!data || resource->isReferencedOnlyOnce()){
+            p = pendingVertexResources.erase(p);
+            continue;
+        }
+        if(data->isReady){
+            if(!uploadPackedVertexData(resource, data, &deadline)){
+                break;
+            }
+            data.reset();
+            p = pendingVertexResources.erase(p);
+        } else {
+            ++p;
+        }
+    }
+}
 
-    if(isLowMemoryConsumptionRenderingBeingProcessed){
-        writeMeshVerticesNormalizedShort(mesh, resource);
+
+void VertexPacker::pack(SgMesh* mesh, PackedVertexData* data)
+{
+    this->data = data;
+    
+    if(isLowMemoryConsumptionFormatEnabled){
+        writeMeshVerticesNormalizedShort(mesh);
     } else {
-        writeMeshVerticesFloat(mesh, resource);
+        writeMeshVerticesFloat(mesh);
     }
 
-    if(isLowMemoryConsumptionRenderingBeingProcessed){
-        writeMeshNormalsByte(mesh, resource);
-        //writeMeshNormalsPacked(mesh, resource);
+    if(isLowMemoryConsumptionFormatEnabled){
+        writeMeshNormalsByte(mesh);
+        //writeMeshNormalsPacked(mesh);
     } else if(USE_GL_FLOAT_FOR_NORMALS){
-        writeMeshNormalsFloat(mesh, resource);
+        writeMeshNormalsFloat(mesh);
     } else {
-        writeMeshNormalsShort(mesh, resource);
+        writeMeshNormalsShort(mesh);
     } 
 
-    auto texture = shape->texture();
-    if(texture && mesh->hasTexCoords() && isTextureBeingRendered){
-        if(isLowMemoryConsumptionRenderingBeingProcessed){
-            writeMeshTexCoordsHalfFloat(mesh, texture, resource);
+    if(isTexCoordEnabled){
+        if(isLowMemoryConsumptionFormatEnabled){
+            writeMeshTexCoordsHalfFloat(mesh);
         } else {
-            writeMeshTexCoordsFloat(mesh, texture, resource);
+            writeMeshTexCoordsFloat(mesh);
         }
     }
     
     if(mesh->hasColors()){
-        writeMeshColors(mesh, resource);
+        writeMeshColors(mesh);
     }
 }
 
 
 template<typename value_type, GLenum gltype, GLboolean normalized, class VertexArrayWrapper>
-void GLSLSceneRenderer::Impl::writeMeshVerticesSub
-(SgMesh* mesh, VertexResource* resource, VertexArrayWrapper& vertices)
+void VertexPacker::writeMeshVerticesSub(SgMesh* mesh, VertexArrayWrapper& vertices)
 {
     const auto& orgVertices = *mesh->vertices();
     auto& triangleVertices = mesh->triangleVertices();
     const int totalNumVertices = triangleVertices.size();
     const int numTriangles = mesh->numTriangles();
-    resource->numVertices = totalNumVertices;
+    data->numVertices = totalNumVertices;
 
     int faceVertexIndex = 0;
     
@@ -2480,30 +4101,22 @@ void GLSLSceneRenderer::Impl::writeMeshVerticesSub
         }
     }
 
-    {
-        LockVertexArrayAPI lock;
-        glBindVertexArray(resource->vao);
-        glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
-        glVertexAttribPointer((GLuint)0, 3, gltype, normalized, 0, ((GLubyte*)NULL + (0)));
-    }
-    auto size = vertices.array.size() * sizeof(value_type);
-    glBufferData(GL_ARRAY_BUFFER, size, vertices.array.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(0);
+    data->addAttribute(0, 3, gltype, normalized, vertices.array);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshVerticesFloat(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshVerticesFloat(SgMesh* mesh)
 {
     struct VertexArrayWrapper {
-        SgVertexArray array;
+        vector<Vector3f> array;
         void append(const Vector3f& v){ array.push_back(v); }
     } vertices;
 
-    writeMeshVerticesSub<Vector3f, GL_FLOAT, GL_FALSE>(mesh, resource, vertices);
+    writeMeshVerticesSub<Vector3f, GL_FLOAT, GL_FALSE>(mesh, vertices);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshVerticesNormalizedShort(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshVerticesNormalizedShort(SgMesh* mesh)
 {
     /**
        GLshort type is used for storing vertex positions.
@@ -2535,23 +4148,22 @@ void GLSLSceneRenderer::Impl::writeMeshVerticesNormalizedShort(SgMesh* mesh, Ver
     const Vector3 c = bbox.center();
     const Vector3 hs =  0.5 * bbox.size();
 
-    resource->localTransform <<
+    data->localTransform <<
         hs.x(), 0.0,    0.0,    c.x(),
         0.0,    hs.y(), 0.0,    c.y(),
         0.0,    0.0,    hs.z(), c.z(),
         0.0,    0.0,    0.0,    1.0;
-    resource->pLocalTransform = &resource->localTransform;
+    data->hasLocalTransform = true;
 
     Vector3f ratio(32767.0 / hs.x(), 32767.0 / hs.y(), 32767.0 / hs.z());
     VertexArrayWrapper vertices(ratio, c.cast<float>());
 
-    writeMeshVerticesSub<Vector3s, GL_SHORT, GL_TRUE>(mesh, resource, vertices);
+    writeMeshVerticesSub<Vector3s, GL_SHORT, GL_TRUE>(mesh, vertices);
 }
 
 
 template<typename value_type, GLenum gltype, GLint glsize, GLboolean normalized, class NormalArrayWrapper>
-bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
-(SgMesh* mesh, VertexResource* resource, NormalArrayWrapper& normals)
+bool VertexPacker::writeMeshNormalsSub(SgMesh* mesh, NormalArrayWrapper& normals)
 {
     bool ready = false;
     
@@ -2561,7 +4173,7 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
     
     normals.array.reserve(totalNumVertices);
 
-    if(!defaultSmoothShading){
+    if(!isSmoothShadingEnabled){
         // flat shading
         const auto& orgVertices = *mesh->vertices();
         for(int i=0; i < numTriangles; ++i){
@@ -2597,17 +4209,7 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
         ready = true;
     }
 
-    if(ready){
-        {
-            LockVertexArrayAPI lock;
-            glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
-            glVertexAttribPointer((GLuint)1, glsize, gltype, normalized, 0, ((GLubyte*)NULL + (0)));
-        }
-        glBufferData(GL_ARRAY_BUFFER, normals.array.size() * sizeof(value_type), normals.array.data(), GL_STATIC_DRAW);
-        glEnableVertexAttribArray(1);
-    }
-    
-    if(isNormalVisualizationEnabled){
+    if(ready && isNormalVisualizationEnabled){
         auto lines = new SgLineSet;
         auto lineVertices = lines->getOrCreateVertices();
         const auto& orgVertices = *mesh->vertices();
@@ -2622,27 +4224,30 @@ bool GLSLSceneRenderer::Impl::writeMeshNormalsSub
                 ++vertexIndex;
             }
         }
-        lines->setMaterial(normalVisualizationMaterial);
-        resource->normalVisualization = lines;
+        data->normalVisualization = lines;
+    }
+
+    if(ready){
+        data->addAttribute(1, glsize, gltype, normalized, normals.array);
     }
 
     return ready;
 }    
     
 
-void GLSLSceneRenderer::Impl::writeMeshNormalsFloat(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshNormalsFloat(SgMesh* mesh)
 {
     struct NormalArrayWrapper {
-        SgNormalArray array;
+        vector<Vector3f> array;
         void append(const Vector3f& n){ array.push_back(n); }
         Vector3f get(int index){ return array[index]; }
     } normals;
             
-    writeMeshNormalsSub<Vector3f, GL_FLOAT, 3, GL_FALSE>(mesh, resource, normals);
+    writeMeshNormalsSub<Vector3f, GL_FLOAT, 3, GL_FALSE>(mesh, normals);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshNormalsShort(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshNormalsShort(SgMesh* mesh)
 {
     typedef Eigen::Matrix<GLshort,3,1> Vector3s;
 
@@ -2656,11 +4261,11 @@ void GLSLSceneRenderer::Impl::writeMeshNormalsShort(SgMesh* mesh, VertexResource
         }
     } normals;
             
-    writeMeshNormalsSub<Vector3s, GL_SHORT, 3, GL_TRUE>(mesh, resource, normals);
+    writeMeshNormalsSub<Vector3s, GL_SHORT, 3, GL_TRUE>(mesh, normals);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshNormalsByte(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshNormalsByte(SgMesh* mesh)
 {
     typedef Eigen::Matrix<GLbyte,3,1> Vector3b;
 
@@ -2674,7 +4279,7 @@ void GLSLSceneRenderer::Impl::writeMeshNormalsByte(SgMesh* mesh, VertexResource*
         }
     } normals;
             
-    writeMeshNormalsSub<Vector3b, GL_BYTE, 3, GL_TRUE>(mesh, resource, normals);
+    writeMeshNormalsSub<Vector3b, GL_BYTE, 3, GL_TRUE>(mesh, normals);
 }
 
 
@@ -2683,7 +4288,7 @@ void GLSLSceneRenderer::Impl::writeMeshNormalsByte(SgMesh* mesh, VertexResource*
    the code is compiled by VC++2017 with the AVX2 option.
    VC++2015 and GCC do not cause such a problem.
 */
-void GLSLSceneRenderer::Impl::writeMeshNormalsPacked(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshNormalsPacked(SgMesh* mesh)
 {
     struct NormalArrayWrapper {
         vector<uint32_t> array;
@@ -2712,31 +4317,22 @@ void GLSLSceneRenderer::Impl::writeMeshNormalsPacked(SgMesh* mesh, VertexResourc
         }
     } normals;
             
-    writeMeshNormalsSub<uint32_t, GL_INT_2_10_10_10_REV, 4, GL_TRUE>(mesh, resource, normals);
+    writeMeshNormalsSub<uint32_t, GL_INT_2_10_10_10_REV, 4, GL_TRUE>(mesh, normals);
 }
 
 
 template<typename value_type, GLenum gltype, GLboolean normalized, class TexCoordArrayWrapper>
-void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
-(SgMesh* mesh, SgTexture* texture, VertexResource* resource, TexCoordArrayWrapper& texCoords)
+void VertexPacker::writeMeshTexCoordsSub(SgMesh* mesh, TexCoordArrayWrapper& texCoords)
 {
     auto& triangleVertices = mesh->triangleVertices();
     const int totalNumVertices = triangleVertices.size();
     SgTexCoordArrayPtr pOrgTexCoords;
     const auto& texCoordIndices = mesh->texCoordIndices();
 
-    auto tt = texture->textureTransform();
-    if(!tt){
+    if(!hasTexCoordTransform){
         pOrgTexCoords = mesh->texCoords();
     } else {
-        Eigen::Rotation2Df R(tt->rotation());
-        const auto& c = tt->center();
-        Eigen::Translation<float, 2> C(c.x(), c.y());
-        const auto& t = tt->translation();
-        Eigen::Translation<float, 2> T(t.x(), t.y());
-        const auto s = tt->scale().cast<float>();
-        Eigen::Affine2f M = T * C * R * Eigen::Scaling(s.x(), s.y()) * C.inverse();
-
+        const Eigen::Affine2f& M = texCoordTransform;
         const auto& orgTexCoords = *mesh->texCoords();
         const size_t n = orgTexCoords.size();
         pOrgTexCoords = new SgTexCoordArray(n);
@@ -2764,33 +4360,24 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsSub
             }
         }
     }
-    {
-        LockVertexArrayAPI lock;
-        glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
-        glVertexAttribPointer((GLuint)2, 2, gltype, normalized, 0, 0);
-    }
-    auto size = texCoords.array.size() * sizeof(value_type);
-    glBufferData(GL_ARRAY_BUFFER, size, texCoords.array.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(2);
+    data->addAttribute(2, 2, gltype, normalized, texCoords.array);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshTexCoordsFloat
-(SgMesh* mesh, SgTexture* texture, VertexResource* resource)
+void VertexPacker::writeMeshTexCoordsFloat(SgMesh* mesh)
 {
     struct TexCoordArrayWrapper {
-        SgTexCoordArray array;
+        vector<Vector2f> array;
         void append(const Vector2f& uv){
             array.push_back(uv);
         }
     } texCoords;
 
-    writeMeshTexCoordsSub<Vector2f, GL_FLOAT, GL_FALSE>(mesh, texture, resource, texCoords);
+    writeMeshTexCoordsSub<Vector2f, GL_FLOAT, GL_FALSE>(mesh, texCoords);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshTexCoordsHalfFloat
-(SgMesh* mesh, SgTexture* texture, VertexResource* resource)
+void VertexPacker::writeMeshTexCoordsHalfFloat(SgMesh* mesh)
 {
     typedef Eigen::Matrix<GLhalf,2,1> Vector2h;
 
@@ -2816,7 +4403,7 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsHalfFloat
         }
     } texCoords;
 
-    writeMeshTexCoordsSub<Vector2h, GL_HALF_FLOAT, GL_FALSE>(mesh, texture, resource, texCoords);
+    writeMeshTexCoordsSub<Vector2h, GL_HALF_FLOAT, GL_FALSE>(mesh, texCoords);
 }
 
 
@@ -2827,8 +4414,7 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsHalfFloat
    values is common, and such data cannot be rendererd correctly with this implementation.
    As an alternative of lightweight implementation, writeMeshTexCoordsHalfFloat is available.
 */
-void GLSLSceneRenderer::Impl::writeMeshTexCoordsUnsignedShort
-(SgMesh* mesh, SgTexture* texture, VertexResource* resource)
+void VertexPacker::writeMeshTexCoordsUnsignedShort(SgMesh* mesh)
 {
     typedef Eigen::Matrix<GLushort,2,1> Vector2us;
     
@@ -2847,11 +4433,11 @@ void GLSLSceneRenderer::Impl::writeMeshTexCoordsUnsignedShort
         }
     } texCoords;
 
-    writeMeshTexCoordsSub<Vector2us, GL_UNSIGNED_SHORT, GL_TRUE>(mesh, texture, resource, texCoords);
+    writeMeshTexCoordsSub<Vector2us, GL_UNSIGNED_SHORT, GL_TRUE>(mesh, texCoords);
 }
 
 
-void GLSLSceneRenderer::Impl::writeMeshColors(SgMesh* mesh, VertexResource* resource)
+void VertexPacker::writeMeshColors(SgMesh* mesh)
 {
     auto& triangleVertices = mesh->triangleVertices();
     const int totalNumVertices = triangleVertices.size();
@@ -2883,13 +4469,7 @@ void GLSLSceneRenderer::Impl::writeMeshColors(SgMesh* mesh, VertexResource* reso
         }
     }
 
-    {
-        LockVertexArrayAPI lock;
-        glBindBuffer(GL_ARRAY_BUFFER, resource->newBuffer());
-        glVertexAttribPointer((GLuint)3, 3, GL_UNSIGNED_BYTE, GL_TRUE, 0, ((GLubyte*)NULL + (0)));
-    }
-    glBufferData(GL_ARRAY_BUFFER, colors.size() * sizeof(Color), colors.data(), GL_STATIC_DRAW);
-    glEnableVertexAttribArray(3);
+    data->addAttribute(3, 3, GL_UNSIGNED_BYTE, GL_TRUE, colors);
 }
     
 
@@ -3032,6 +4612,10 @@ void GLSLSceneRenderer::Impl::renderPlotMain
 void GLSLSceneRenderer::Impl::renderPointSet(SgPointSet* pointSet)
 {
     if(!isRenderingShadowMap && pointSet->hasVertices()){
+        if(isRayCasting){
+            rayCastPointSet(pointSet);
+            return;
+        }
         renderPlot(
             pointSet, GL_POINTS,
             [pointSet]() -> SgVertexArrayPtr { return pointSet->vertices(); },
@@ -3069,6 +4653,10 @@ static SgVertexArrayPtr getLineSetVertices(SgLineSet* lineSet)
 void GLSLSceneRenderer::Impl::renderLineSet(SgLineSet* lineSet)
 {
     if(!isRenderingShadowMap && lineSet->hasVertices() && lineSet->numLines() > 0){
+        if(isRayCasting){
+            rayCastLineSet(lineSet);
+            return;
+        }
         renderPlot(
             lineSet, GL_LINES,
             [lineSet](){ return getLineSetVertices(lineSet); },
@@ -3097,6 +4685,11 @@ void GLSLSceneRenderer::Impl::renderText(SgText* text)
 {
 #ifdef CNOID_ENABLE_FREE_TYPE
 
+    if(isRayCasting){
+        isRayCastUndetermined = true;
+        return;
+    }
+
     auto resource = getOrCreateGLResource<TextResource>(text);
 
     {
@@ -3143,6 +4736,8 @@ void GLSLSceneRenderer::Impl::renderPolygonDrawStyle(SgPolygonDrawStyle* style)
         renderGroup(style);
         return;
     }
+
+    flushOpaqueShapeQueue();
     
     int elements = style->polygonElements();
     int matrixIndex = -1;
@@ -3163,6 +4758,7 @@ void GLSLSceneRenderer::Impl::renderPolygonDrawStyle(SgPolygonDrawStyle* style)
                 solidWireframeStyleStack.push_back(style);
             }
             renderGroup(style);
+            flushOpaqueShapeQueue();
             if(isEdgeEnabled){
                 solidWireframeStyleStack.pop_back();
                 if(solidWireframeStyleStack.empty()){
@@ -3210,6 +4806,7 @@ void GLSLSceneRenderer::Impl::renderTransparentGroup(SgTransparentGroup* transpa
 
 void GLSLSceneRenderer::Impl::renderOverlay(SgOverlay* overlay)
 {
+    ++numCullingBlockers;
     if(isRenderingVisibleImage || isRenderingPickingImage){
         int matrixIndex = modelMatrixBuffer.size();
         modelMatrixBuffer.push_back(modelMatrixStack.back());
@@ -3226,14 +4823,19 @@ void GLSLSceneRenderer::Impl::renderOverlayMain(SgOverlay* overlay, const Affine
     if(isRenderingPickingImage){
         currentNodePath = nodePath;
     }
+    // The overlay objects are not rendered in the view frustum
+    const int planeMask0 = frustumPlaneMask;
+    frustumPlaneMask = 0;
     modelMatrixStack.push_back(T);
     renderGroup(overlay);
     modelMatrixStack.pop_back();
+    frustumPlaneMask = planeMask0;
 }
 
 
 void GLSLSceneRenderer::Impl::renderViewportOverlay(SgViewportOverlay* overlay)
 {
+    ++numCullingBlockers;
     if(isRenderingVisibleImage){
         overlayRenderingQueue.emplace_back(
             [this, overlay](){ renderViewportOverlayMain(overlay); });
@@ -3325,6 +4927,16 @@ void GLSLSceneRenderer::Impl::renderLightweightRenderingGroup(SgLightweightRende
     if(isRenderingShadowMap){
         return;
     }
+    if(isRayCasting){
+        if(isBoundingBoxRenderingForLightweightRenderingGroupEnabled){
+            isRayCastUndetermined = true;
+        } else {
+            renderChildNodes(group);
+        }
+        return;
+    }
+
+    flushOpaqueShapeQueue();
 
     bool wasLightweightRenderingBeingProcessed = isLightweightRenderingBeingProcessed;
     bool wasLowMemoryConsumptionRenderingBeingProcessed = isLowMemoryConsumptionRenderingBeingProcessed;
@@ -3372,6 +4984,8 @@ void GLSLSceneRenderer::Impl::renderLightweightRenderingGroup(SgLightweightRende
 
     isLightweightRenderingBeingProcessed = wasLightweightRenderingBeingProcessed;
     isLowMemoryConsumptionRenderingBeingProcessed = wasLowMemoryConsumptionRenderingBeingProcessed;
+    flushOpaqueShapeQueue();
+
     isTextureBeingRendered = wasTextureBeingRendered;
     isBoundingBoxRenderingMode = wasBoundingBoxRenderingMode;
 }
@@ -3475,6 +5089,54 @@ void GLSLSceneRenderer::setShadowAntiAliasingEnabled(bool on)
 }
 
 
+void GLSLSceneRenderer::setNumShadowMapCascades(int n)
+{
+    impl->numShadowMapCascades =
+        std::max(1, std::min(n, impl->fullLightingProgram->maxNumShadowMapCascades()));
+}
+
+
+int GLSLSceneRenderer::numShadowMapCascades() const
+{
+    return impl->numShadowMapCascades;
+}
+
+
+void GLSLSceneRenderer::setShadowMapCacheEnabled(bool on)
+{
+    if(on != impl->isShadowMapCacheEnabled){
+        impl->isShadowMapCacheEnabled = on;
+        if(!on){
+            impl->clearShadowCasterClassification();
+        }
+    }
+}
+
+
+bool GLSLSceneRenderer::isShadowMapCacheEnabled() const
+{
+    return impl->isShadowMapCacheEnabled;
+}
+
+
+void GLSLSceneRenderer::setBackgroundMeshPreparationEnabled(bool on)
+{
+    impl->isBackgroundMeshPreparationEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isBackgroundMeshPreparationEnabled() const
+{
+    return impl->isBackgroundMeshPreparationEnabled;
+}
+
+
+bool GLSLSceneRenderer::hasPendingMeshPreparation() const
+{
+    return !impl->pendingVertexResources.empty();
+}
+
+
 void GLSLSceneRenderer::Impl::setPointSize(float size)
 {
     if(!stateFlag[POINT_SIZE] || pointSize != size){
@@ -3609,6 +5271,54 @@ void GLSLSceneRenderer::setBoundingBoxRenderingForLightweightRenderingGroupEnabl
 }
 
 
+void GLSLSceneRenderer::setFrustumCullingEnabled(bool on)
+{
+    impl->isFrustumCullingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isFrustumCullingEnabled() const
+{
+    return impl->isFrustumCullingEnabled;
+}
+
+
+void GLSLSceneRenderer::setRayCastPickingEnabled(bool on)
+{
+    impl->isRayCastPickingEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isRayCastPickingEnabled() const
+{
+    return impl->isRayCastPickingEnabled;
+}
+
+
+void GLSLSceneRenderer::setLevelOfDetailEnabled(bool on)
+{
+    impl->isLevelOfDetailEnabled = on;
+}
+
+
+bool GLSLSceneRenderer::isLevelOfDetailEnabled() const
+{
+    return impl->isLevelOfDetailEnabled;
+}
+
+
+void GLSLSceneRenderer::setMaxLodLevel(int level)
+{
+    impl->maxLodLevel = level;
+}
+
+
+int GLSLSceneRenderer::maxLodLevel() const
+{
+    return impl->maxLodLevel;
+}
+
+
 void GLSLSceneRenderer::setLowMemoryConsumptionMode(bool on)
 {
     if(impl->isLowMemoryConsumptionMode != on){
@@ -70,6 +70,13 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual void setAdditionalLightShadowEnabled(int index, bool on = true) override;
     virtual void clearAdditionalLightShadows() override;
     virtual void setShadowAntiAliasingEnabled(bool on) override;
+    virtual void setNumShadowMapCascades(int n) override;
+    int numShadowMapCascades() const;
+    virtual void setShadowMapCacheEnabled(bool on) override;
+    bool isShadowMapCacheEnabled() const;
+    virtual void setBackgroundMeshPreparationEnabled(bool on) override;
+    bool isBackgroundMeshPreparationEnabled() const;
+    virtual bool hasPendingMeshPreparation() const override;
     
     virtual void setDefaultSmoothShading(bool on) override;
     virtual SgMaterial* defaultMaterial() override;
@@ -86,6 +93,14 @@ class CNOID_EXPORT GLSLSceneRenderer : public GLSceneRenderer
     virtual void setBackFaceCullingMode(int mode) override;
     virtual int backFaceCullingMode() const override;
     virtual void setBoundingBoxRenderingForLightweightRenderingGroupEnabled(bool on) override;
+    virtual void setFrustumCullingEnabled(bool on) override;
+    bool isFrustumCullingEnabled() const;
+    virtual void setRayCastPickingEnabled(bool on) override;
+    bool isRayCastPickingEnabled() const;
+    virtual void setLevelOfDetailEnabled(bool on) override;
+    bool isLevelOfDetailEnabled() const;
+    virtual void setMaxLodLevel(int level) override;
+    int maxLodLevel() const;
 
     void setLowMemoryConsumptionMode(bool on);
 
@@ -203,6 +203,30 @@ void GLSceneRenderer::setShadowAntiAliasingEnabled(bool /* on */)
 }
 
 
+void GLSceneRenderer::setNumShadowMapCascades(int /* n */)
+{
+
+}
+
+
+void GLSceneRenderer::setShadowMapCacheEnabled(bool /* on */)
+{
+
+}
+
+
+void GLSceneRenderer::setBackgroundMeshPreparationEnabled(bool /* on */)
+{
+
+}
+
+
+bool GLSceneRenderer::hasPendingMeshPreparation() const
+{
+    return false;
+}
+
+
 void GLSceneRenderer::setUpsideDown(bool /* on */)
 {
 
@@ -215,6 +239,30 @@ void GLSceneRenderer::setBoundingBoxRenderingForLightweightRenderingGroupEnabled
 }
 
 
+void GLSceneRenderer::setFrustumCullingEnabled(bool /* on */)
+{
+
+}
+
+
+void GLSceneRenderer::setRayCastPickingEnabled(bool /* on */)
+{
+
+}
+
+
+void GLSceneRenderer::setLevelOfDetailEnabled(bool /* on */)
+{
+
+}
+
+
+void GLSceneRenderer::setMaxLodLevel(int /* level */)
+{
+
+}
+
+
 void GLSceneRenderer::getPerspectiveProjectionMatrix
 (double fovy, double aspect, double zNear, double zFar, Matrix4& out_matrix)
 {
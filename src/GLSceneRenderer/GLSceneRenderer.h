@@ -92,6 +92,27 @@ public:
     virtual void setAdditionalLightShadowEnabled(int index, bool on = true);
     virtual void clearAdditionalLightShadows();
     virtual void setShadowAntiAliasingEnabled(bool on);
+
+    /**
+       The shadow map of the world light is divided into this number of the cascades
+       that cover the consecutive depth ranges of the view.
+    */
+    virtual void setNumShadowMapCascades(int n);
+
+    /**
+       When this is enabled, the depth images of the shadow casters that have not been updated
+       recently are cached, and only the updated shadow casters are rendered into the shadow maps.
+    */
+    virtual void setShadowMapCacheEnabled(bool on);
+
+    /**
+       When this is enabled, the vertices of a large mesh are prepared in background threads
+       and uploaded to the GPU over several frames so that the rendering is not blocked. The mesh
+       is not rendered until the preparation is completed, and the rendering should be repeated
+       while hasPendingMeshPreparation returns true.
+    */
+    virtual void setBackgroundMeshPreparationEnabled(bool on);
+    virtual bool hasPendingMeshPreparation() const;
     
     virtual void setDefaultSmoothShading(bool on) = 0;
     virtual SgMaterial* defaultMaterial() = 0;
@@ -124,6 +145,15 @@ public:
     virtual int backFaceCullingMode() const = 0;
 
     virtual void setBoundingBoxRenderingForLightweightRenderingGroupEnabled(bool on);
+    virtual void setFrustumCullingEnabled(bool on);
+    virtual void setRayCastPickingEnabled(bool on);
+    virtual void setLevelOfDetailEnabled(bool on);
+
+    /**
+       The simplified meshes whose levels are larger than this value are not used.
+       Level 0 means that the original meshes are always rendered.
+    */
+    virtual void setMaxLodLevel(int level);
 
     virtual void setPickingImageOutputEnabled(bool on);
     virtual bool getPickingImage(Image& out_image);
@@ -6,6 +6,8 @@
 #include <cnoid/SceneEffects>
 #include <cnoid/EigenUtil>
 #include <fmt/format.h>
+#include <limits>
+#include <algorithm>
 #include "gettext.h"
 
 using namespace std;
@@ -199,6 +201,9 @@ public:
     GLint normalMatrixLocation;
     GLint MVPLocation;
 
+    GLint isInstancingEnabledLocation;
+    bool isInstancingEnabled;
+
     // For the wireframe overlay rendering
     int viewportWidth, viewportHeight;
     GLint viewportMatrixLocation;
@@ -224,10 +229,12 @@ public:
     GLint numShadowsLocation;
     GLint isShadowAntiAliasingEnabledLocation;
 
-    // This value must be same as that of shader/phongshadow.[vert/flag]
+    // These values must be same as those of shader/FullLighting.[vert/frag]
     static const int maxNumShadows = 2;
+    static const int maxNumCascades = 4;
     
     int currentShadowIndex;
+    int currentCascadeIndex;
 
     struct ShadowInfo {
         EIGEN_MAKE_ALIGNED_OPERATOR_NEW
@@ -235,9 +242,25 @@ public:
         GLint shadowMatrixLocation;
         GLint lightIndexLocation;
         GLint shadowMapLocation;
+        GLint numCascadesLocation;
+        GLint cascadeFarDepthLocations[maxNumCascades];
+        GLint cascadeScaleLocations[maxNumCascades];
+        GLint cascadeOffsetLocations[maxNumCascades];
+        // The array texture whose layers correspond to the cascades
         GLuint depthTexture;
         GLuint frameBuffer;
-        Matrix4 BPV;
+        int numDepthTextureLayers;
+        int numCascades;
+        Matrix4 BPVs[maxNumCascades];
+        double cascadeFarDepths[maxNumCascades];
+        
+        // For caching the depth images of the static shadow casters
+        GLuint staticDepthTexture;
+        GLuint staticFrameBuffer;
+        int numStaticDepthTextureLayers;
+        Matrix4 staticBPVs[maxNumCascades];
+        unsigned int staticRevisions[maxNumCascades];
+        bool isStaticDepthImageValid[maxNumCascades];
     };
     std::vector<ShadowInfo, Eigen::aligned_allocator<ShadowInfo>> shadowInfos;
 
@@ -246,6 +269,7 @@ public:
     Impl(FullLightingProgram* self);
     void initialize(GLSLProgram& glsl);
     void initializeShadowInfo(GLSLProgram& glsl, int index);
+    void allocateDepthTexture(int shadowIndex, GLuint texture, int numLayers, bool isComparable);
     void activate(GLSLProgram& glsl);
     void updateShaderWireframeState();    
 };
@@ -1161,6 +1185,8 @@ FullLightingProgram::Impl::Impl(FullLightingProgram* self)
 {
     defaultFBO = 0;
 
+    isInstancingEnabled = false;
+
     viewportWidth = 1000;
     viewportHeight = 1000;
     isWireframeEnabled = false;
@@ -1176,6 +1202,7 @@ FullLightingProgram::Impl::Impl(FullLightingProgram* self)
     orthoShadowCamera = new SgOrthographicCamera;
     orthoShadowCamera->setHeight(15.0);
     currentShadowIndex = 0;
+    currentCascadeIndex = 0;
 
     shadowBias <<
         0.5, 0.0, 0.0, 0.5,
@@ -1232,6 +1259,9 @@ void FullLightingProgram::Impl::initialize(GLSLProgram& glsl)
         MVPLocation = glsl.getUniformLocation("MVP");
     }
 
+    isInstancingEnabledLocation = glsl.getUniformLocation("isInstancingEnabled");
+    isInstancingEnabled = false;
+
     viewportMatrixLocation = glsl.getUniformLocation("viewportMatrix");
     isViewportMatrixInvalidated = true;
     isWireframeEnabledLocation = glsl.getUniformLocation("isWireframeEnabled");
@@ -1263,6 +1293,7 @@ void FullLightingProgram::Impl::initialize(GLSLProgram& glsl)
         auto& shadow = shadowInfos[i];
         glUniform1i(shadow.shadowMapLocation, shadowMapTextureTopIndex + i);
     }
+    glUniform1i(isInstancingEnabledLocation, isInstancingEnabled);
 }
 
 
@@ -1275,25 +1306,28 @@ void FullLightingProgram::Impl::initializeShadowInfo(GLSLProgram& glsl, int inde
     string prefix = format("shadows[{}].", index);
     shadow.lightIndexLocation = glsl.getUniformLocation(prefix + "lightIndex");
     shadow.shadowMapLocation = glsl.getUniformLocation(prefix + "shadowMap");
+    shadow.numCascadesLocation = glsl.getUniformLocation(prefix + "numCascades");
+    for(int i=0; i < maxNumCascades; ++i){
+        shadow.cascadeFarDepthLocations[i] = glsl.getUniformLocation(format("{0}cascadeFarDepths[{1}]", prefix, i));
+        shadow.cascadeScaleLocations[i] = glsl.getUniformLocation(format("{0}cascadeScales[{1}]", prefix, i));
+        shadow.cascadeOffsetLocations[i] = glsl.getUniformLocation(format("{0}cascadeOffsets[{1}]", prefix, i));
+    }
+    shadow.numCascades = 1;
+    shadow.staticDepthTexture = 0;
+    shadow.staticFrameBuffer = 0;
+    shadow.numStaticDepthTextureLayers = 0;
+    for(int i=0; i < maxNumCascades; ++i){
+        shadow.isStaticDepthImageValid[i] = false;
+    }
 
     glGenFramebuffers(1, &shadow.frameBuffer);
     glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
 
-    static const GLfloat border[] = { 1.0f, 0.0f, 0.0f, 0.0f };
     glGenTextures(1, &shadow.depthTexture);
-    glActiveTexture(GL_TEXTURE0 + shadowMapTextureTopIndex + index);
-    glBindTexture(GL_TEXTURE_2D, shadow.depthTexture);
-    glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, shadowMapWidth, shadowMapHeight,
-                 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
-    glTexParameterfv(GL_TEXTURE_2D, GL_TEXTURE_BORDER_COLOR, border);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
-    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_COMPARE_FUNC, GL_LESS);
-
-    glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, shadow.depthTexture, 0);
+    allocateDepthTexture(index, shadow.depthTexture, 1, true);
+    shadow.numDepthTextureLayers = 1;
+
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow.depthTexture, 0, 0);
     
     glDrawBuffer(GL_NONE);
     glReadBuffer(GL_NONE);
@@ -1305,12 +1339,43 @@ void FullLightingProgram::Impl::initializeShadowInfo(GLSLProgram& glsl, int inde
 }
 
 
+/**
+   The contents of the texture are discarded when the number of the layers is changed.
+   Note that the texture is bound to the texture unit of the shadow map.
+*/
+void FullLightingProgram::Impl::allocateDepthTexture
+(int shadowIndex, GLuint texture, int numLayers, bool isComparable)
+{
+    glActiveTexture(GL_TEXTURE0 + shadowMapTextureTopIndex + shadowIndex);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, texture);
+    glTexImage3D(GL_TEXTURE_2D_ARRAY, 0, GL_DEPTH_COMPONENT24, shadowMapWidth, shadowMapHeight, numLayers,
+                 0, GL_DEPTH_COMPONENT, GL_FLOAT, NULL);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+    if(isComparable){
+        static const GLfloat border[] = { 1.0f, 0.0f, 0.0f, 0.0f };
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_BORDER);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_BORDER);
+        glTexParameterfv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_BORDER_COLOR, border);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_MODE, GL_COMPARE_REF_TO_TEXTURE);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_COMPARE_FUNC, GL_LESS);
+    } else {
+        // The texture only keeps the depth image, and the shadow map texture must be bound again
+        glBindTexture(GL_TEXTURE_2D_ARRAY, shadowInfos[shadowIndex].depthTexture);
+    }
+}
+
+
 void FullLightingProgram::release()
 {
     for(int i=0; i < impl->maxNumShadows; ++i){
         auto& shadow = impl->shadowInfos[i];
         glDeleteFramebuffers(1, &shadow.frameBuffer);
         glDeleteTextures(1, &shadow.depthTexture);
+        if(shadow.staticFrameBuffer){
+            glDeleteFramebuffers(1, &shadow.staticFrameBuffer);
+            glDeleteTextures(1, &shadow.staticDepthTexture);
+        }
     }
     impl->shadowInfos.clear();
 
@@ -1360,7 +1425,8 @@ void FullLightingProgram::setTransform
 (const Matrix4& PV, const Isometry3& V, const Affine3& M, const Matrix4* L)
 {
     const Affine3f VM = (V * M).cast<float>();
-    const Matrix3f N = VM.linear();
+    // The inverse transpose is necessary for the non-uniform scaling
+    const Matrix3f N = (V.linear() * M.linear().inverse().transpose()).cast<float>();
 
     Matrix4f PVM;
     if(L){
@@ -1382,12 +1448,21 @@ void FullLightingProgram::setTransform
 
     for(int i=0; i < impl->numShadows; ++i){
         auto& shadow = impl->shadowInfos[i];
-        const Matrix4f BPVM = (shadow.BPV * M.matrix()).cast<float>();
+        const Matrix4f BPVM = (shadow.BPVs[0] * M.matrix()).cast<float>();
         glUniformMatrix4fv(shadow.shadowMatrixLocation, 1, GL_FALSE, BPVM.data());
     }
 }
 
 
+void FullLightingProgram::setInstancingEnabled(bool on)
+{
+    if(on != impl->isInstancingEnabled){
+        glUniform1i(impl->isInstancingEnabledLocation, on);
+        impl->isInstancingEnabled = on;
+    }
+}
+
+
 void FullLightingProgram::enableWireframe(const Vector4f& color, float width)
 {
     if(!impl->isWireframeEnabled || color != impl->wireframeColor || width != impl->wireframeWidth){
@@ -1467,6 +1542,27 @@ void FullLightingProgram::activateMainRenderingPass()
     if(impl->numShadows > 0){
         glUniform1i(impl->isShadowAntiAliasingEnabledLocation, impl->isShadowAntiAliasingEnabled);
     }
+
+    for(int i=0; i < impl->numShadows; ++i){
+        auto& shadow = impl->shadowInfos[i];
+        glUniform1i(shadow.numCascadesLocation, shadow.numCascades);
+        if(shadow.numCascades == 1){
+            glUniform1f(shadow.cascadeFarDepthLocations[0], std::numeric_limits<float>::max());
+            glUniform3f(shadow.cascadeScaleLocations[0], 1.0f, 1.0f, 1.0f);
+            glUniform3f(shadow.cascadeOffsetLocations[0], 0.0f, 0.0f, 0.0f);
+        } else {
+            // The shadow coordinate of a cascade is given by the transformation from that of the first cascade
+            const Matrix4 BPV0inv = shadow.BPVs[0].inverse();
+            for(int j=0; j < shadow.numCascades; ++j){
+                const Matrix4 A = shadow.BPVs[j] * BPV0inv;
+                const Vector3f scale = A.diagonal().head<3>().cast<float>();
+                const Vector3f offset = A.col(3).head<3>().cast<float>();
+                glUniform1f(shadow.cascadeFarDepthLocations[j], shadow.cascadeFarDepths[j]);
+                glUniform3fv(shadow.cascadeScaleLocations[j], 1, scale.data());
+                glUniform3fv(shadow.cascadeOffsetLocations[j], 1, offset.data());
+            }
+        }
+    }
 }
 
 
@@ -1522,7 +1618,35 @@ SgCamera* FullLightingProgram::getShadowMapCamera(SgLight* light, Isometry3& io_
 
 void FullLightingProgram::setShadowMapViewProjection(const Matrix4& PV)
 {
-    impl->shadowInfos[impl->currentShadowIndex].BPV = impl->shadowBias * PV;
+    auto& shadow = impl->shadowInfos[impl->currentShadowIndex];
+    shadow.numCascades = 1;
+    shadow.BPVs[0] = impl->shadowBias * PV;
+}
+
+
+int FullLightingProgram::maxNumShadowMapCascades() const
+{
+    return impl->maxNumCascades;
+}
+
+
+void FullLightingProgram::setNumShadowMapCascades(int n)
+{
+    n = std::max(1, std::min(n, static_cast<int>(impl->maxNumCascades)));
+    auto& shadow = impl->shadowInfos[impl->currentShadowIndex];
+    shadow.numCascades = n;
+    if(n > shadow.numDepthTextureLayers){
+        impl->allocateDepthTexture(impl->currentShadowIndex, shadow.depthTexture, n, true);
+        shadow.numDepthTextureLayers = n;
+    }
+}
+
+
+void FullLightingProgram::setShadowMapCascade(int cascadeIndex, const Matrix4& PV, double farDepth)
+{
+    auto& shadow = impl->shadowInfos[impl->currentShadowIndex];
+    shadow.BPVs[cascadeIndex] = impl->shadowBias * PV;
+    shadow.cascadeFarDepths[cascadeIndex] = farDepth;
 }
 
 
@@ -1551,24 +1675,88 @@ void ShadowMapProgram::initialize()
 }
 
 
-void ShadowMapProgram::initializeShadowMapBuffer()
+void ShadowMapProgram::initializeShadowMapBuffer(int cascadeIndex)
 {
     auto& mainImpl = mainProgram->impl;
     auto& shadow = mainImpl->shadowInfos[mainImpl->currentShadowIndex];
+    mainImpl->currentCascadeIndex = cascadeIndex;
+    
     glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
+    glFramebufferTextureLayer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow.depthTexture, 0, cascadeIndex);
 
+    glActiveTexture(GL_TEXTURE0 + mainImpl->shadowMapTextureTopIndex + mainImpl->currentShadowIndex);
     if(mainImpl->isShadowAntiAliasingEnabled){
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
     } else {
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
     }
 
     glClear(GL_DEPTH_BUFFER_BIT);
 }
 
 
+bool ShadowMapProgram::restoreStaticShadowMap(unsigned int revision)
+{
+    auto& mainImpl = mainProgram->impl;
+    auto& shadow = mainImpl->shadowInfos[mainImpl->currentShadowIndex];
+    const int cascade = mainImpl->currentCascadeIndex;
+
+    if(!shadow.isStaticDepthImageValid[cascade] ||
+       shadow.staticRevisions[cascade] != revision ||
+       shadow.staticBPVs[cascade] != shadow.BPVs[cascade]){
+        return false;
+    }
+
+    const int w = mainImpl->shadowMapWidth;
+    const int h = mainImpl->shadowMapHeight;
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadow.staticFrameBuffer);
+    glFramebufferTextureLayer(GL_READ_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow.staticDepthTexture, 0, cascade);
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow.frameBuffer);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
+
+    return true;
+}
+
+
+void ShadowMapProgram::storeStaticShadowMap(unsigned int revision)
+{
+    auto& mainImpl = mainProgram->impl;
+    const int shadowIndex = mainImpl->currentShadowIndex;
+    auto& shadow = mainImpl->shadowInfos[shadowIndex];
+    const int cascade = mainImpl->currentCascadeIndex;
+
+    if(!shadow.staticFrameBuffer){
+        glGenFramebuffers(1, &shadow.staticFrameBuffer);
+        glBindFramebuffer(GL_FRAMEBUFFER, shadow.staticFrameBuffer);
+        glDrawBuffer(GL_NONE);
+        glReadBuffer(GL_NONE);
+        glGenTextures(1, &shadow.staticDepthTexture);
+    }
+    if(shadow.numStaticDepthTextureLayers < shadow.numDepthTextureLayers){
+        mainImpl->allocateDepthTexture(shadowIndex, shadow.staticDepthTexture, shadow.numDepthTextureLayers, false);
+        shadow.numStaticDepthTextureLayers = shadow.numDepthTextureLayers;
+        for(int i=0; i < mainImpl->maxNumCascades; ++i){
+            shadow.isStaticDepthImageValid[i] = false;
+        }
+    }
+
+    const int w = mainImpl->shadowMapWidth;
+    const int h = mainImpl->shadowMapHeight;
+    glBindFramebuffer(GL_DRAW_FRAMEBUFFER, shadow.staticFrameBuffer);
+    glFramebufferTextureLayer(GL_DRAW_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, shadow.staticDepthTexture, 0, cascade);
+    glBindFramebuffer(GL_READ_FRAMEBUFFER, shadow.frameBuffer);
+    glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_DEPTH_BUFFER_BIT, GL_NEAREST);
+    glBindFramebuffer(GL_FRAMEBUFFER, shadow.frameBuffer);
+
+    shadow.staticBPVs[cascade] = shadow.BPVs[cascade];
+    shadow.staticRevisions[cascade] = revision;
+    shadow.isStaticDepthImageValid[cascade] = true;
+}
+
+
 void ShadowMapProgram::activate()
 {
     NolightingProgram::activate();
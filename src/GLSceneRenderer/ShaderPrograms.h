@@ -324,6 +324,12 @@ public:
         int index, const SgLight* light, const Isometry3& T, const Isometry3& view, bool shadowCasting) override;
     virtual void setTransform(const Matrix4& PV, const Isometry3& V, const Affine3& M, const Matrix4* L) override;
 
+    /**
+       When this is enabled, the model matrices are given as the per-instance vertex attributes
+       at location 4 to 7, and the model matrix given to setTransform must be the identity.
+    */
+    void setInstancingEnabled(bool on);
+
     void enableWireframe(const Vector4f& color, float width);
     void disableWireframe();
     bool isWireframeEnabled() const;
@@ -338,6 +344,16 @@ public:
     void getShadowMapSize(int& width, int& height) const;
     SgCamera* getShadowMapCamera(SgLight* light, Isometry3& io_T);
     void setShadowMapViewProjection(const Matrix4& PV);
+
+    /**
+       The shadow map of a light can be divided into the cascades that cover the consecutive
+       depth ranges of the view frustum. The projection-view matrices of the cascades must be
+       the orthographic projections with the same view direction.
+    */
+    int maxNumShadowMapCascades() const;
+    void setNumShadowMapCascades(int n);
+    void setShadowMapCascade(int cascadeIndex, const Matrix4& PV, double farDepth);
+    
     void setShadowAntiAliasingEnabled(bool on);
     bool isShadowAntiAliasingEnabled() const;
 
@@ -356,7 +372,16 @@ public:
     ShadowMapProgram(FullLightingProgram* mainProgram);
     virtual void initialize() override;
     virtual void activate() override;
-    void initializeShadowMapBuffer();
+    void initializeShadowMapBuffer(int cascadeIndex = 0);
+
+    /**
+       The depth image of the static shadow casters can be cached for the shadow map being
+       rendered. The cached image is restored when the projection-view matrix of the shadow map
+       and the given revision of the static shadow casters are same as those of the cached one.
+    */
+    bool restoreStaticShadowMap(unsigned int revision);
+    void storeStaticShadowMap(unsigned int revision);
+    
     virtual void deactivate() override;
 
 private:
@@ -6,6 +6,7 @@
 
 #define MAX_NUM_LIGHTS 20
 #define MAX_NUM_SHADOWS 2
+#define MAX_NUM_SHADOW_MAP_CASCADES 4
 
 #define USE_BLINN_PHONG_MODEL 1
 
@@ -84,9 +85,19 @@ uniform float wireframeWidth;
 
 uniform int numShadows;
 
+/*
+  The shadow map of each light consists of the layers of the cascades. The shadow coordinate
+  given by the vertex shader is the coordinate of the first cascade, and it is converted to
+  the coordinate of the k-th cascade by the scale and the offset of the cascade. The cascade
+  is selected by the depth of the fragment in the view coordinate.
+*/
 struct ShadowInfo {
     int lightIndex;
-    sampler2DShadow shadowMap;
+    sampler2DArrayShadow shadowMap;
+    int numCascades;
+    float cascadeFarDepths[MAX_NUM_SHADOW_MAP_CASCADES];
+    vec3 cascadeScales[MAX_NUM_SHADOW_MAP_CASCADES];
+    vec3 cascadeOffsets[MAX_NUM_SHADOW_MAP_CASCADES];
 };
 
 /*
@@ -105,6 +116,7 @@ uniform bool isShadowAntiAliasingEnabled;
 layout(location = 0) out vec4 color4;
 
 vec3 calcDiffuseAndSpecularElements(LightInfo light, vec3 diffuseColor);
+float calcShadow(int shadowIndex, sampler2DArrayShadow shadowMap);
 void renderWireframe();
 
 void main()
@@ -137,18 +149,7 @@ void main()
     }
 
     for(int i=0; i < numShadows; ++i){
-        float shadow;
-        vec4 shadowCoord = inData.shadowCoords[i];
-        if(isShadowAntiAliasingEnabled){
-            shadow  = textureProjOffset(shadows[i].shadowMap, shadowCoord, ivec2(-1, -1));
-            shadow += textureProjOffset(shadows[i].shadowMap, shadowCoord, ivec2(-1,  1));
-            shadow += textureProjOffset(shadows[i].shadowMap, shadowCoord, ivec2( 1,  1));
-            shadow += textureProjOffset(shadows[i].shadowMap, shadowCoord, ivec2( 1, -1));
-            shadow *= 0.25;
-        } else {
-            shadow = textureProj(shadows[i].shadowMap, shadowCoord);
-        }
-        reflectionElements[shadows[i].lightIndex] *= shadow;
+        reflectionElements[shadows[i].lightIndex] *= calcShadow(i, shadows[i].shadowMap);
     }
 
     for(int i=0; i < numLights; ++i){
@@ -171,6 +172,38 @@ void main()
 }
 
 
+float calcShadow(int shadowIndex, sampler2DArrayShadow shadowMap)
+{
+    int n = shadows[shadowIndex].numCascades;
+    float depth = -inData.position.z;
+    int cascade = n - 1;
+    for(int i=0; i < n - 1; ++i){
+        if(depth < shadows[shadowIndex].cascadeFarDepths[i]){
+            cascade = i;
+            break;
+        }
+    }
+
+    vec4 shadowCoord = inData.shadowCoords[shadowIndex];
+    vec3 coord = shadowCoord.xyz / shadowCoord.w;
+    coord = coord * shadows[shadowIndex].cascadeScales[cascade] + shadows[shadowIndex].cascadeOffsets[cascade];
+    vec4 coord4 = vec4(coord.xy, float(cascade), coord.z);
+
+    float shadow;
+    if(isShadowAntiAliasingEnabled){
+        vec2 texelSize = 1.0 / vec2(textureSize(shadowMap, 0).xy);
+        shadow  = texture(shadowMap, coord4 + vec4(vec2(-1.0, -1.0) * texelSize, 0.0, 0.0));
+        shadow += texture(shadowMap, coord4 + vec4(vec2(-1.0,  1.0) * texelSize, 0.0, 0.0));
+        shadow += texture(shadowMap, coord4 + vec4(vec2( 1.0,  1.0) * texelSize, 0.0, 0.0));
+        shadow += texture(shadowMap, coord4 + vec4(vec2( 1.0, -1.0) * texelSize, 0.0, 0.0));
+        shadow *= 0.25;
+    } else {
+        shadow = texture(shadowMap, coord4);
+    }
+    return shadow;
+}
+
+
 vec3 calcDiffuseAndSpecularElements(LightInfo light, vec3 diffuseColor)
 {
     if(light.position.w == 0.0){
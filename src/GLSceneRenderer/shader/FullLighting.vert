@@ -6,6 +6,8 @@ layout (location = 0) in vec4 vertexPosition;
 layout (location = 1) in vec3 vertexNormal;
 layout (location = 2) in vec2 vertexTexCoord;
 layout (location = 3) in vec3 vertexColor;
+layout (location = 4) in mat4 instanceModelMatrix;
+layout (location = 8) in mat3 instanceNormalMatrix;
 
 out VertexData {
     vec3 position;
@@ -36,17 +38,32 @@ uniform mat3 normalMatrix;
 uniform int numShadows;
 uniform mat4 shadowMatrices[MAX_NUM_SHADOWS];
 
+/*
+  When the instanced rendering is enabled, the model matrix of each instance is given
+  by instanceModelMatrix and the uniform matrices above do not include the model matrix.
+  instanceNormalMatrix is the inverse transpose of the model matrix, which is necessary
+  for the instances with non-uniform scaling.
+*/
+uniform bool isInstancingEnabled;
+
 void main()
 {
-    outData.normal = normalize(normalMatrix * vertexNormal);
-    outData.position = vec3(modelViewMatrix * vertexPosition);
+    vec4 position = vertexPosition;
+    vec3 normal = vertexNormal;
+    if(isInstancingEnabled){
+        position = instanceModelMatrix * vertexPosition;
+        normal = instanceNormalMatrix * vertexNormal;
+    }
+    
+    outData.normal = normalize(normalMatrix * normal);
+    outData.position = vec3(modelViewMatrix * position);
 
     outData.texCoord = vertexTexCoord;
     outData.colorV = vertexColor;
     
     for(int i=0; i < numShadows; ++i){
-        outData.shadowCoords[i] = shadowMatrices[i] * vertexPosition;
+        outData.shadowCoords[i] = shadowMatrices[i] * position;
     }
     
-    gl_Position = MVP * vertexPosition;
+    gl_Position = MVP * position;
 }
@@ -188,3 +188,46 @@ void CollisionDetector::detectCollisions
 {
 
 }
+
+
+bool CollisionDetectorDistanceAPI::detectDistances
+(double maxDistance,
+ std::function<void(const CollisionPair& collisionPair, double distance,
+                    const Vector3& point1, const Vector3& point2)> callback)
+{
+    Vector3 point1, point2;
+    return forEachDistanceTargetPair(
+        [&](const CollisionPair& collisionPair){
+            double distance =
+                detectDistance(collisionPair.geometry(0), collisionPair.geometry(1), point1, point2);
+            if(distance < maxDistance){
+                callback(collisionPair, distance, point1, point2);
+            }
+        });
+}
+
+
+bool CollisionDetectorDistanceAPI::detectDistances
+(CollisionDetector::GeometryHandle geometry, double maxDistance,
+ std::function<void(const CollisionPair& collisionPair, double distance,
+                    const Vector3& point1, const Vector3& point2)> callback)
+{
+    Vector3 point1, point2;
+    return forEachDistanceTargetPair(
+        [&](const CollisionPair& collisionPair){
+            if(collisionPair.geometry(0) == geometry || collisionPair.geometry(1) == geometry){
+                double distance =
+                    detectDistance(collisionPair.geometry(0), collisionPair.geometry(1), point1, point2);
+                if(distance < maxDistance){
+                    callback(collisionPair, distance, point1, point2);
+                }
+            }
+        });
+}
+
+
+bool CollisionDetectorDistanceAPI::forEachDistanceTargetPair
+(std::function<void(const CollisionPair& collisionPair)> /* callback */)
+{
+    return false;
+}
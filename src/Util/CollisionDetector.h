@@ -84,12 +84,66 @@ public:
 typedef ref_ptr<CollisionDetector> CollisionDetectorPtr;
 
 
-class CollisionDetectorDistanceAPI
+class CNOID_EXPORT CollisionDetectorDistanceAPI
 {
 public:
     virtual double detectDistance(
         CollisionDetector::GeometryHandle geometry1, CollisionDetector::GeometryHandle geometry2,
         Vector3& out_point1, Vector3& out_point2) = 0;
+
+    /**
+       This function computes the distances of all the geometry pairs that are the targets of the
+       collision detection at once, and calls the callback for each pair closer than maxDistance
+       with the distance and the closest points. The collisions of the pair are not set.
+       The implementation may use the closest features found by the previous call to make the
+       computation faster when the geometries move a little between the calls.
+       The default implementation calls detectDistance for each pair given by forEachDistanceTargetPair.
+       \return false if the target geometry pairs are not available in the detector.
+    */
+    virtual bool detectDistances(
+        double maxDistance,
+        std::function<void(const CollisionPair& collisionPair, double distance,
+                           const Vector3& point1, const Vector3& point2)> callback);
+
+    //! This function only targets the geometry pairs including the given geometry.
+    virtual bool detectDistances(
+        CollisionDetector::GeometryHandle geometry, double maxDistance,
+        std::function<void(const CollisionPair& collisionPair, double distance,
+                           const Vector3& point1, const Vector3& point2)> callback);
+
+protected:
+    /**
+       This function is used by the default implementation of detectDistances to enumerate the
+       geometry pairs that are the targets of the collision detection. The objects of each pair
+       given to the callback are the custom objects of the geometries.
+       \return false if the pairs cannot be enumerated, which is the case of the default implementation.
+    */
+    virtual bool forEachDistanceTargetPair(std::function<void(const CollisionPair& collisionPair)> callback);
+};
+
+
+/**
+   The interface of the collision detectors that can detect the collisions of the geometries
+   moving between two positions, which are missed by the collision detection at the positions
+   when the geometries move fast.
+*/
+class CollisionDetectorContinuousDetectionAPI
+{
+public:
+    /**
+       This function detects the first contacts of the geometry pairs while the geometries move from
+       the positions given by the last position update to the positions given by endPositionQuery.
+       Each geometry is assumed to move with the linear interpolation of its translation and the
+       interpolation of its rotation about a fixed axis. The callback is called for each pair of the
+       geometries that come in contact with the contact time normalized to [0, 1]. The collisions of
+       the pair are not set. The positions of the geometries are not changed by this function.
+    */
+    virtual void detectContinuousCollisions(
+        std::function<void(Referenced* object, Isometry3*& out_position)> endPositionQuery,
+        std::function<void(const CollisionPair& collisionPair, double time)> callback) = 0;
+
+    //! The geometries closer than this distance are regarded as being in contact.
+    virtual void setContinuousDetectionTolerance(double distance) = 0;
 };
 
 
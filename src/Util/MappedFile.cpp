@@ -0,0 +1,141 @@
+#include "MappedFile.h"
+#include "UTF8.h"
+#include <fmt/format.h>
+#include <cstring>
+#include <cerrno>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include "gettext.h"
+
+using namespace std;
+using namespace cnoid;
+using fmt::format;
+
+
+MappedFile::MappedFile()
+{
+    data_ = nullptr;
+    size_ = 0;
+    isOpen_ = false;
+#ifdef _WIN32
+    fileHandle = INVALID_HANDLE_VALUE;
+    mappingHandle = nullptr;
+#endif
+}
+
+
+MappedFile::MappedFile(const std::string& filename)
+    : MappedFile()
+{
+    open(filename);
+}
+
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+
+bool MappedFile::open(const std::string& filename)
+{
+    close();
+    errorMessage_.clear();
+
+#ifdef _WIN32
+    HANDLE file = CreateFileA(
+        fromUTF8(filename).c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+    if(file == INVALID_HANDLE_VALUE){
+        errorMessage_ = format(_("\"{0}\" cannot be opened."), filename);
+        return false;
+    }
+    LARGE_INTEGER fileSize;
+    if(!GetFileSizeEx(file, &fileSize)){
+        CloseHandle(file);
+        errorMessage_ = format(_("The size of \"{0}\" cannot be obtained."), filename);
+        return false;
+    }
+    fileHandle = file;
+    size_ = static_cast<size_t>(fileSize.QuadPart);
+    if(size_ > 0){
+        HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+        if(!mapping){
+            close();
+            errorMessage_ = format(_("\"{0}\" cannot be mapped into memory."), filename);
+            return false;
+        }
+        mappingHandle = mapping;
+        data_ = static_cast<const char*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+        if(!data_){
+            close();
+            errorMessage_ = format(_("\"{0}\" cannot be mapped into memory."), filename);
+            return false;
+        }
+    }
+
+#else
+    int fd = ::open(fromUTF8(filename).c_str(), O_RDONLY);
+    if(fd < 0){
+        errorMessage_ = format(_("\"{0}\" cannot be opened: {1}"), filename, strerror(errno));
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) != 0){
+        errorMessage_ = format(_("The size of \"{0}\" cannot be obtained: {1}"), filename, strerror(errno));
+        ::close(fd);
+        return false;
+    }
+    size_ = st.st_size;
+    if(size_ > 0){
+        void* p = mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+        if(p == MAP_FAILED){
+            errorMessage_ = format(_("\"{0}\" cannot be mapped into memory: {1}"), filename, strerror(errno));
+            ::close(fd);
+            size_ = 0;
+            return false;
+        }
+        // The file is mostly read from the head to the tail
+        madvise(p, size_, MADV_SEQUENTIAL);
+        data_ = static_cast<const char*>(p);
+    }
+    // The mapping is kept alive without the file descriptor
+    ::close(fd);
+#endif
+
+    isOpen_ = true;
+    return true;
+}
+
+
+void MappedFile::close()
+{
+#ifdef _WIN32
+    if(data_){
+        UnmapViewOfFile(data_);
+    }
+    if(mappingHandle){
+        CloseHandle(mappingHandle);
+        mappingHandle = nullptr;
+    }
+    if(fileHandle != INVALID_HANDLE_VALUE){
+        CloseHandle(fileHandle);
+        fileHandle = INVALID_HANDLE_VALUE;
+    }
+#else
+    if(data_){
+        munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    isOpen_ = false;
+}
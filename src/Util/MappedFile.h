@@ -0,0 +1,46 @@
+#ifndef CNOID_UTIL_MAPPED_FILE_H
+#define CNOID_UTIL_MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+/**
+   This class maps the contents of a file into the memory space as a read-only buffer.
+   The buffer is valid until the object is closed or destroyed.
+*/
+class CNOID_EXPORT MappedFile
+{
+public:
+    MappedFile();
+    MappedFile(const std::string& filename);
+    MappedFile(const MappedFile&) = delete;
+    ~MappedFile();
+
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    bool open(const std::string& filename);
+    void close();
+    bool isOpen() const { return isOpen_; }
+    const char* data() const { return data_; }
+    const char* begin() const { return data_; }
+    const char* end() const { return data_ + size_; }
+    size_t size() const { return size_; }
+    const std::string& errorMessage() const { return errorMessage_; }
+
+private:
+    const char* data_;
+    size_t size_;
+    bool isOpen_;
+#ifdef _WIN32
+    void* fileHandle;
+    void* mappingHandle;
+#endif
+    std::string errorMessage_;
+};
+
+}
+
+#endif
@@ -0,0 +1,397 @@
+#include "MeshBVH.h"
+#include "SceneDrawables.h"
+#include <unordered_map>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <algorithm>
+#include <limits>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+constexpr int MaxNumTrianglesInLeaf = 4;
+
+// The median split is used for the deeper nodes to limit the depth of the tree
+constexpr int MaxDepthForMidpointSplit = 32;
+constexpr int MaxTraversalStackSize = 128;
+
+struct CacheEntry
+{
+    weak_ref_ptr<SgMesh> mesh;
+    MeshBVHPtr bvh;
+    size_t memorySize;
+    bool isUpdated;
+    ScopedConnection connection;
+    // The position in lruList
+    list<SgMesh*>::iterator lruPosition;
+};
+
+typedef unordered_map<SgMesh*, unique_ptr<CacheEntry>> CacheMap;
+
+std::mutex cacheMutex;
+CacheMap cache;
+size_t cacheSizeToSweep = 256;
+// The most recently used mesh is at the front
+list<SgMesh*> lruList;
+size_t cachedMemorySize = 0;
+size_t maxCachedMemorySize = 256 * 1024 * 1024;
+
+
+CacheMap::iterator eraseCacheEntry(CacheMap::iterator p)
+{
+    auto& entry = p->second;
+    cachedMemorySize -= entry->memorySize;
+    lruList.erase(entry->lruPosition);
+    return cache.erase(p);
+}
+
+
+void removeLeastRecentlyUsedEntries()
+{
+    // The most recently used entry is kept even if it exceeds the limit by itself
+    while(cachedMemorySize > maxCachedMemorySize && lruList.size() > 1){
+        eraseCacheEntry(cache.find(lruList.back()));
+    }
+}
+
+
+inline bool intersectBox
+(const Vector3f& min, const Vector3f& max, const Vector3f& origin, const Vector3f& invDir,
+ float maxDistance, float& out_entryDistance)
+{
+    float t0 = 0.0f;
+    float t1 = maxDistance;
+    for(int i=0; i < 3; ++i){
+        float tNear = (min[i] - origin[i]) * invDir[i];
+        float tFar = (max[i] - origin[i]) * invDir[i];
+        if(tNear > tFar){
+            std::swap(tNear, tFar);
+        }
+        if(tNear > t0){
+            t0 = tNear;
+        }
+        if(tFar < t1){
+            t1 = tFar;
+        }
+        if(t0 > t1){
+            return false;
+        }
+    }
+    out_entryDistance = t0;
+    return true;
+}
+
+}
+
+
+MeshBVHPtr MeshBVH::getOrCreate(SgMesh* mesh)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    if(cache.size() >= cacheSizeToSweep){
+        auto p = cache.begin();
+        while(p != cache.end()){
+            if(p->second->mesh.expired()){
+                p = eraseCacheEntry(p);
+            } else {
+                ++p;
+            }
+        }
+        cacheSizeToSweep = std::max(cache.size() * 2, static_cast<size_t>(256));
+    }
+
+    auto p = cache.find(mesh);
+    if(p != cache.end() && p->second->mesh.expired()){
+        // Another mesh has been created at the same address
+        eraseCacheEntry(p);
+        p = cache.end();
+    }
+    CacheEntry* entry;
+    if(p != cache.end()){
+        entry = p->second.get();
+        lruList.splice(lruList.begin(), lruList, entry->lruPosition);
+    } else {
+        entry = new CacheEntry;
+        cache[mesh].reset(entry);
+        entry->mesh = weak_ref_ptr<SgMesh>(mesh);
+        entry->memorySize = 0;
+        entry->isUpdated = true;
+        entry->connection =
+            mesh->sigUpdated().connect(
+                [entry](const SgUpdate&){
+                    std::lock_guard<std::mutex> lock(cacheMutex);
+                    entry->isUpdated = true;
+                });
+        lruList.push_front(mesh);
+        entry->lruPosition = lruList.begin();
+    }
+    
+    MeshBVHPtr bvh = entry->bvh;
+    if(entry->isUpdated){
+        bvh = new MeshBVH(mesh);
+        entry->bvh = bvh;
+        entry->isUpdated = false;
+        cachedMemorySize -= entry->memorySize;
+        entry->memorySize = bvh->memorySize();
+        cachedMemorySize += entry->memorySize;
+        removeLeastRecentlyUsedEntries();
+    }
+
+    return bvh;
+}
+
+
+void MeshBVH::setMaxCachedMemorySize(size_t size)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    maxCachedMemorySize = size;
+    removeLeastRecentlyUsedEntries();
+}
+
+
+MeshBVH::MeshBVH()
+{
+
+}
+
+
+MeshBVH::MeshBVH(SgMesh* mesh)
+{
+    build(mesh);
+}
+
+
+size_t MeshBVH::memorySize() const
+{
+    return (nodes.capacity() * sizeof(Node) +
+            triangleIndices.capacity() * sizeof(int) +
+            triangleVertices.capacity() * sizeof(Vector3f));
+}
+
+
+void MeshBVH::clear()
+{
+    nodes.clear();
+    triangleIndices.clear();
+    triangleVertices.clear();
+}
+
+
+void MeshBVH::build(SgMesh* mesh)
+{
+    clear();
+
+    if(!mesh->hasVertices()){
+        return;
+    }
+    const auto& vertices = *mesh->vertices();
+    const int numVertices = vertices.size();
+    const auto& indices = mesh->triangleVertices();
+    const int numTriangles = mesh->numTriangles();
+
+    // The vertices are stored in the order of the original triangle indices while building the tree
+    triangleVertices.resize(numTriangles * 3);
+    vector<Vector3f> centroids(numTriangles);
+    triangleIndices.reserve(numTriangles);
+
+    for(int i=0; i < numTriangles; ++i){
+        bool isValid = true;
+        for(int j=0; j < 3; ++j){
+            int index = indices[i * 3 + j];
+            if(index < 0 || index >= numVertices){
+                isValid = false;
+                break;
+            }
+            triangleVertices[i * 3 + j] = vertices[index];
+        }
+        if(isValid){
+            triangleIndices.push_back(i);
+            centroids[i] = (triangleVertices[i * 3] + triangleVertices[i * 3 + 1] + triangleVertices[i * 3 + 2]) / 3.0f;
+        }
+    }
+
+    if(triangleIndices.empty()){
+        triangleVertices.clear();
+        return;
+    }
+
+    nodes.reserve(2 * (triangleIndices.size() / MaxNumTrianglesInLeaf + 1));
+    buildSubTree(centroids, 0, triangleIndices.size(), 0);
+
+    // Reorder the vertices to store them in the order of the leaf nodes
+    vector<Vector3f> orderedVertices(triangleIndices.size() * 3);
+    for(size_t i=0; i < triangleIndices.size(); ++i){
+        int index = triangleIndices[i];
+        for(int j=0; j < 3; ++j){
+            orderedVertices[i * 3 + j] = triangleVertices[index * 3 + j];
+        }
+    }
+    triangleVertices.swap(orderedVertices);
+}
+
+
+int MeshBVH::buildSubTree(std::vector<Vector3f>& centroids, int begin, int end, int depth)
+{
+    const int nodeIndex = nodes.size();
+    nodes.emplace_back();
+
+    constexpr float inf = std::numeric_limits<float>::max();
+    Vector3f bmin(inf, inf, inf);
+    Vector3f bmax(-inf, -inf, -inf);
+    Vector3f cmin(bmin);
+    Vector3f cmax(bmax);
+    for(int i = begin; i < end; ++i){
+        int index = triangleIndices[i];
+        for(int j=0; j < 3; ++j){
+            const Vector3f& v = triangleVertices[index * 3 + j];
+            bmin = bmin.cwiseMin(v);
+            bmax = bmax.cwiseMax(v);
+        }
+        const Vector3f& c = centroids[index];
+        cmin = cmin.cwiseMin(c);
+        cmax = cmax.cwiseMax(c);
+    }
+
+    const int numTriangles = end - begin;
+    int axis;
+    float maxExtent = (cmax - cmin).maxCoeff(&axis);
+
+    if(numTriangles <= MaxNumTrianglesInLeaf || maxExtent <= 0.0f){
+        auto& node = nodes[nodeIndex];
+        node.min = bmin;
+        node.max = bmax;
+        node.index = begin;
+        node.numTriangles = numTriangles;
+        return nodeIndex;
+    }
+
+    auto first = triangleIndices.begin();
+    int mid = begin;
+    if(depth < MaxDepthForMidpointSplit){
+        const float split = 0.5f * (cmin[axis] + cmax[axis]);
+        mid = std::partition(
+            first + begin, first + end,
+            [&](int index){ return centroids[index][axis] < split; }) - first;
+    }
+    if(mid == begin || mid == end){
+        mid = (begin + end) / 2;
+        std::nth_element(
+            first + begin, first + mid, first + end,
+            [&](int index1, int index2){ return centroids[index1][axis] < centroids[index2][axis]; });
+    }
+
+    buildSubTree(centroids, begin, mid, depth + 1);
+    int secondChild = buildSubTree(centroids, mid, end, depth + 1);
+
+    auto& node = nodes[nodeIndex];
+    node.min = bmin;
+    node.max = bmax;
+    node.index = secondChild;
+    node.numTriangles = 0;
+
+    return nodeIndex;
+}
+
+
+bool MeshBVH::intersect
+(const Vector3f& origin, const Vector3f& direction, float maxDistance, int faceCulling,
+ float& out_distance, int& out_triangleIndex) const
+{
+    if(nodes.empty()){
+        return false;
+    }
+
+    const Vector3f invDir = direction.cwiseInverse();
+    float nearestDistance = maxDistance;
+    int nearestTriangle = -1;
+
+    struct StackElement {
+        int nodeIndex;
+        float entryDistance;
+    };
+    StackElement stack[MaxTraversalStackSize];
+    int stackSize = 0;
+
+    float entryDistance;
+    if(intersectBox(nodes[0].min, nodes[0].max, origin, invDir, nearestDistance, entryDistance)){
+        stack[stackSize++] = { 0, entryDistance };
+    }
+
+    while(stackSize > 0){
+        auto& element = stack[--stackSize];
+        if(element.entryDistance > nearestDistance){
+            continue;
+        }
+        const int nodeIndex = element.nodeIndex;
+        const Node& node = nodes[nodeIndex];
+
+        if(node.numTriangles > 0){
+            const int end = node.index + node.numTriangles;
+            for(int i = node.index; i < end; ++i){
+                const Vector3f& v0 = triangleVertices[i * 3];
+                const Vector3f e1 = triangleVertices[i * 3 + 1] - v0;
+                const Vector3f e2 = triangleVertices[i * 3 + 2] - v0;
+                const Vector3f p = direction.cross(e2);
+                // The determinant is positive when the front face is hit
+                const float det = e1.dot(p);
+                if(faceCulling == BackFaceCulling){
+                    if(det <= 0.0f){
+                        continue;
+                    }
+                } else if(faceCulling == FrontFaceCulling){
+                    if(det >= 0.0f){
+                        continue;
+                    }
+                } else if(det == 0.0f){
+                    continue;
+                }
+                const float invDet = 1.0f / det;
+                const Vector3f s = origin - v0;
+                const float u = s.dot(p) * invDet;
+                if(u < 0.0f || u > 1.0f){
+                    continue;
+                }
+                const Vector3f q = s.cross(e1);
+                const float v = direction.dot(q) * invDet;
+                if(v < 0.0f || u + v > 1.0f){
+                    continue;
+                }
+                const float t = e2.dot(q) * invDet;
+                if(t >= 0.0f && t < nearestDistance){
+                    nearestDistance = t;
+                    nearestTriangle = triangleIndices[i];
+                }
+            }
+        } else {
+            const int child1 = nodeIndex + 1;
+            const int child2 = node.index;
+            float d1, d2;
+            bool hit1 = intersectBox(nodes[child1].min, nodes[child1].max, origin, invDir, nearestDistance, d1);
+            bool hit2 = intersectBox(nodes[child2].min, nodes[child2].max, origin, invDir, nearestDistance, d2);
+            // Push the farther child first to visit the nearer one first
+            if(hit1 && hit2){
+                if(d1 <= d2){
+                    stack[stackSize++] = { child2, d2 };
+                    stack[stackSize++] = { child1, d1 };
+                } else {
+                    stack[stackSize++] = { child1, d1 };
+                    stack[stackSize++] = { child2, d2 };
+                }
+            } else if(hit1){
+                stack[stackSize++] = { child1, d1 };
+            } else if(hit2){
+                stack[stackSize++] = { child2, d2 };
+            }
+        }
+    }
+
+    if(nearestTriangle >= 0){
+        out_distance = nearestDistance;
+        out_triangleIndex = nearestTriangle;
+        return true;
+    }
+    return false;
+}
@@ -0,0 +1,80 @@
+#ifndef CNOID_UTIL_MESH_BVH_H
+#define CNOID_UTIL_MESH_BVH_H
+
+#include "Referenced.h"
+#include "EigenTypes.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class SgMesh;
+class MeshBVH;
+typedef ref_ptr<MeshBVH> MeshBVHPtr;
+
+/**
+   This class builds a bounding volume hierarchy of the triangles of a mesh to accelerate
+   the ray intersection queries. The hierarchy is defined in the local coordinate of the mesh.
+*/
+class CNOID_EXPORT MeshBVH : public Referenced
+{
+public:
+    /**
+       This function returns the hierarchy of the mesh that is shared by all the users.
+       The hierarchy is built when the function is called for the mesh for the first time,
+       and it is rebuilt when the function is called after the mesh notifies an update.
+       The shared hierarchies are cached up to the size given by setMaxCachedMemorySize,
+       and the least recently used ones are removed from the cache when the size is exceeded.
+       The entries of the destroyed meshes are also removed.
+    */
+    static MeshBVHPtr getOrCreate(SgMesh* mesh);
+
+    //! The default size is 256 MiB
+    static void setMaxCachedMemorySize(size_t size);
+
+    MeshBVH();
+    MeshBVH(SgMesh* mesh);
+
+    void build(SgMesh* mesh);
+    void clear();
+    int numTriangles() const { return static_cast<int>(triangleIndices.size()); }
+    size_t memorySize() const;
+
+    enum FaceCulling { NoFaceCulling, BackFaceCulling, FrontFaceCulling };
+
+    /**
+       \param origin The origin of the ray in the local coordinate of the mesh.
+       \param direction The direction of the ray. This does not have to be a unit vector and
+       the distance is measured in the unit of the length of this vector.
+       \param maxDistance Only the intersections nearer than this distance are checked.
+       \param faceCulling The triangles facing in the specified direction are ignored.
+       A front face is the face whose vertices are counter clockwise when viewed from the origin.
+       \param out_distance The distance to the nearest intersection.
+       \param out_triangleIndex The index of the nearest triangle in the mesh.
+    */
+    bool intersect(
+        const Vector3f& origin, const Vector3f& direction, float maxDistance, int faceCulling,
+        float& out_distance, int& out_triangleIndex) const;
+
+private:
+    struct Node {
+        Vector3f min;
+        Vector3f max;
+        // For a leaf node, this is the index of the first triangle in triangleIndices.
+        // For an internal node, this is the index of the second child. The first child
+        // always follows the node itself.
+        int index;
+        // This is zero for an internal node
+        int numTriangles;
+    };
+    std::vector<Node> nodes;
+    std::vector<int> triangleIndices;
+    // The vertex positions of the triangles stored in the order of triangleIndices
+    std::vector<Vector3f> triangleVertices;
+
+    int buildSubTree(std::vector<Vector3f>& centroids, int begin, int end, int depth);
+};
+
+}
+
+#endif
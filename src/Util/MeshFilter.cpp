@@ -6,6 +6,12 @@
 #include <unordered_map>
 #include <unordered_set>
 #include <array>
+#include <queue>
+#include <cstring>
+#include <cstdint>
+#include <limits>
+#include <thread>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -93,14 +99,730 @@ template<> struct hash<EdgeId>
 
 }
 
+namespace {
+
+// The loops over the faces are split into the threads only if each thread has at least this number of faces
+constexpr int MinNumFacesPerThread = 8192;
+
+/**
+   This class finds the vector that is approximately equal to a given vector among the vectors
+   added so far. The result is the same as comparing the vector with all the added vectors in
+   the order of the addition by Eigen's isApprox function, but only the vectors in the neighboring
+   cells of a uniform grid are compared. The cell size is determined so that any vector
+   satisfying isApprox is contained in the neighboring cells.
+*/
+class ApproximateVectorFinder
+{
+public:
+    ApproximateVectorFinder(const SgVectorArray<Vector3f>& vectors, const vector<bool>& usedFlags);
+    int findOrAdd(const Vector3f& v, SgVectorArray<Vector3f>& addedVectors);
+
+private:
+    double invCellSize;
+    std::unordered_map<uint64_t, int> cellToLastVectorMap;
+    // The index of the previous vector added to the same cell
+    vector<int> previousVectorsInCell;
+
+    bool getCell(const Vector3f& v, int64_t* out_cell) const;
+    static uint64_t getCellKey(int64_t x, int64_t y, int64_t z){
+        return (static_cast<uint64_t>(x) * 73856093u) ^ (static_cast<uint64_t>(y) * 19349663u) ^
+            (static_cast<uint64_t>(z) * 83492791u);
+    }
+};
+
+
+ApproximateVectorFinder::ApproximateVectorFinder
+(const SgVectorArray<Vector3f>& vectors, const vector<bool>& usedFlags)
+{
+    double maxNorm = 0.0;
+    int numUsedVectors = 0;
+    for(size_t i=0; i < vectors.size(); ++i){
+        if(usedFlags[i]){
+            const auto& v = vectors[i];
+            if(v.allFinite()){
+                maxNorm = std::max(maxNorm, static_cast<double>(v.norm()));
+            }
+            ++numUsedVectors;
+        }
+    }
+    // The margin covers the rounding errors of isApprox
+    double cellSize = Eigen::NumTraits<float>::dummy_precision() * maxNorm * 1.01;
+    if(cellSize == 0.0){
+        cellSize = 1.0;
+    }
+    invCellSize = 1.0 / cellSize;
+    cellToLastVectorMap.reserve(numUsedVectors);
+    previousVectorsInCell.reserve(numUsedVectors);
+}
+
+
+bool ApproximateVectorFinder::getCell(const Vector3f& v, int64_t* out_cell) const
+{
+    if(!v.allFinite()){
+        // A non-finite vector is not approximately equal to any vector
+        return false;
+    }
+    for(int i=0; i < 3; ++i){
+        out_cell[i] = static_cast<int64_t>(std::floor(v[i] * invCellSize));
+    }
+    return true;
+}
+
+
+int ApproximateVectorFinder::findOrAdd(const Vector3f& v, SgVectorArray<Vector3f>& addedVectors)
+{
+    int64_t cell[3];
+    const bool isFinite = getCell(v, cell);
+    if(isFinite){
+        int foundIndex = -1;
+        for(int64_t x = cell[0] - 1; x <= cell[0] + 1; ++x){
+            for(int64_t y = cell[1] - 1; y <= cell[1] + 1; ++y){
+                for(int64_t z = cell[2] - 1; z <= cell[2] + 1; ++z){
+                    auto p = cellToLastVectorMap.find(getCellKey(x, y, z));
+                    if(p != cellToLastVectorMap.end()){
+                        int index = p->second;
+                        while(index >= 0){
+                            if((foundIndex < 0 || index < foundIndex) && v.isApprox(addedVectors[index])){
+                                foundIndex = index;
+                            }
+                            index = previousVectorsInCell[index];
+                        }
+                    }
+                }
+            }
+        }
+        if(foundIndex >= 0){
+            return foundIndex;
+        }
+    }
+    
+    const int newIndex = addedVectors.size();
+    addedVectors.push_back(v);
+    previousVectorsInCell.push_back(-1);
+    if(isFinite){
+        auto inserted = cellToLastVectorMap.emplace(getCellKey(cell[0], cell[1], cell[2]), newIndex);
+        if(!inserted.second){
+            previousVectorsInCell[newIndex] = inserted.first->second;
+            inserted.first->second = newIndex;
+        }
+    }
+    return newIndex;
+}
+
+
+// The weight of the planes that keep the boundary edges in the simplification
+constexpr double BoundaryQuadricWeight = 1.0e3;
+
+struct PositionHash
+{
+    std::size_t operator()(const Vector3f& p) const {
+        std::size_t seed = 0;
+        for(int i=0; i < 3; ++i){
+            uint32_t bits;
+            std::memcpy(&bits, &p[i], sizeof(bits));
+            seed ^= std::hash<uint32_t>()(bits) + 0x9e3779b9 + (seed<<6) + (seed>>2);
+        }
+        return seed;
+    }
+};
+
+/**
+   This class implements the mesh simplification based on the quadric error metrics
+   (Garland and Heckbert, 1997). The position of a collapsed edge is selected from the
+   positions of its vertices so that the vertex attributes other than the normals can be
+   inherited from the original mesh. A seam vertex, whose corners have different texture
+   coordinates or colors, is never removed so that the seams are kept, and a boundary
+   vertex is not removed into a vertex inside the mesh.
+*/
+class MeshSimplifier
+{
+public:
+    bool initialize(SgMesh* mesh);
+    void reduce(int targetNumTriangles);
+    SgMesh* createMesh();
+    int numTriangles() const { return numLiveTriangles; }
+    double error() const { return maxError; }
+
+private:
+    struct Quadric
+    {
+        // The elements of the upper triangle of the symmetric 4x4 matrix
+        double a[10];
+        
+        Quadric() { std::fill(a, a + 10, 0.0); }
+
+        void addPlane(const Vector3& n, double d, double w){
+            a[0] += w * n.x() * n.x();
+            a[1] += w * n.x() * n.y();
+            a[2] += w * n.x() * n.z();
+            a[3] += w * n.x() * d;
+            a[4] += w * n.y() * n.y();
+            a[5] += w * n.y() * n.z();
+            a[6] += w * n.y() * d;
+            a[7] += w * n.z() * n.z();
+            a[8] += w * n.z() * d;
+            a[9] += w * d * d;
+        }
+
+        void add(const Quadric& q){
+            for(int i=0; i < 10; ++i){
+                a[i] += q.a[i];
+            }
+        }
+
+        double evaluate(const Vector3f& p) const {
+            const double x = p.x();
+            const double y = p.y();
+            const double z = p.z();
+            return a[0] * x * x + 2.0 * a[1] * x * y + 2.0 * a[2] * x * z + 2.0 * a[3] * x
+                + a[4] * y * y + 2.0 * a[5] * y * z + 2.0 * a[6] * y
+                + a[7] * z * z + 2.0 * a[8] * z + a[9];
+        }
+    };
+
+    struct Collapse
+    {
+        double cost;
+        int vertexToKeep;
+        int vertexToRemove;
+        unsigned int versionToKeep;
+        unsigned int versionToRemove;
+
+        // The collapse with the least cost comes first in the priority queue
+        bool operator<(const Collapse& rhs) const { return cost > rhs.cost; }
+    };
+
+    SgMeshPtr orgMesh;
+    vector<Vector3f> positions;
+    vector<Quadric> quadrics;
+    vector<double> areas;
+    vector<unsigned int> versions;
+    vector<bool> isVertexRemoved;
+    // A corner of the original triangles that refers to the vertex
+    vector<int> orgCornerOfVertex;
+    vector<bool> isSeamVertex;
+    vector<bool> isBoundaryVertex;
+    vector<vector<int>> trianglesOfVertex;
+    vector<array<int, 3>> triangles;
+    // The corners of the original triangles that give the attributes of the triangle corners
+    vector<array<int, 3>> orgCorners;
+    vector<bool> isTriangleRemoved;
+    int numLiveTriangles;
+    std::priority_queue<Collapse> collapseQueue;
+    vector<int> vertexMarks;
+    int markId;
+    double maxError;
+
+    void addCollapse(int vertex1, int vertex2);
+    int newMarkId(int n);
+    bool hasSameAttributes(int orgCorner1, int orgCorner2) const;
+    const Vector2f& texCoordOfCorner(int orgCorner) const;
+    bool isCollapsible(int vertexToKeep, int vertexToRemove, int& out_orgCornerToKeep);
+    void collapse(const Collapse& c, int orgCornerToKeep);
+};
+
+
+bool MeshSimplifier::initialize(SgMesh* mesh)
+{
+    orgMesh = mesh;
+    
+    const auto& vertices = *mesh->vertices();
+    const int numOrgVertices = vertices.size();
+    const auto& orgIndices = mesh->triangleVertices();
+    const int numOrgTriangles = mesh->numTriangles();
+
+    // The vertices at the same position are integrated to make the mesh connected
+    vector<int> vertexIndexMap(numOrgVertices);
+    unordered_map<Vector3f, int, PositionHash> positionToVertexMap;
+    positionToVertexMap.reserve(numOrgVertices);
+    for(int i=0; i < numOrgVertices; ++i){
+        Vector3f p = vertices[i];
+        for(int j=0; j < 3; ++j){
+            p[j] += 0.0f; // Unify -0.0 and 0.0
+        }
+        auto inserted = positionToVertexMap.emplace(p, static_cast<int>(positions.size()));
+        if(inserted.second){
+            positions.push_back(p);
+        }
+        vertexIndexMap[i] = inserted.first->second;
+    }
+
+    const int numVertices = positions.size();
+    quadrics.resize(numVertices);
+    areas.resize(numVertices, 0.0);
+    versions.resize(numVertices, 0);
+    isVertexRemoved.resize(numVertices, false);
+    orgCornerOfVertex.resize(numVertices, -1);
+    isSeamVertex.resize(numVertices, false);
+    isBoundaryVertex.resize(numVertices, false);
+    trianglesOfVertex.resize(numVertices);
+    vertexMarks.resize(numVertices, 0);
+    markId = 0;
+    maxError = 0.0;
+
+    triangles.reserve(numOrgTriangles);
+    orgCorners.reserve(numOrgTriangles);
+    for(int i=0; i < numOrgTriangles; ++i){
+        array<int, 3> triangle;
+        bool isValid = true;
+        for(int j=0; j < 3; ++j){
+            int index = orgIndices[i * 3 + j];
+            if(index < 0 || index >= numOrgVertices){
+                isValid = false;
+                break;
+            }
+            triangle[j] = vertexIndexMap[index];
+        }
+        if(!isValid ||
+           triangle[0] == triangle[1] || triangle[1] == triangle[2] || triangle[2] == triangle[0]){
+            continue;
+        }
+        const int triangleIndex = triangles.size();
+        triangles.push_back(triangle);
+        orgCorners.push_back({ i * 3, i * 3 + 1, i * 3 + 2 });
+        for(int j=0; j < 3; ++j){
+            int vertex = triangle[j];
+            if(orgCornerOfVertex[vertex] < 0){
+                orgCornerOfVertex[vertex] = i * 3 + j;
+            } else if(!isSeamVertex[vertex] && !hasSameAttributes(orgCornerOfVertex[vertex], i * 3 + j)){
+                isSeamVertex[vertex] = true;
+            }
+            trianglesOfVertex[vertex].push_back(triangleIndex);
+        }
+    }
+    numLiveTriangles = triangles.size();
+    isTriangleRemoved.resize(numLiveTriangles, false);
+
+    if(numLiveTriangles == 0){
+        return false;
+    }
+
+    auto getEdgeKey = [](int vertex1, int vertex2){
+        if(vertex1 > vertex2){
+            std::swap(vertex1, vertex2);
+        }
+        return (static_cast<uint64_t>(vertex1) << 32) | static_cast<uint64_t>(vertex2);
+    };
+
+    unordered_map<uint64_t, int> edgeCounts;
+    edgeCounts.reserve(numLiveTriangles * 2);
+    vector<Vector3> faceNormals(numLiveTriangles);
+    
+    for(int i=0; i < numLiveTriangles; ++i){
+        auto& triangle = triangles[i];
+        const Vector3 p0 = positions[triangle[0]].cast<double>();
+        Vector3 n = (positions[triangle[1]].cast<double>() - p0).cross(positions[triangle[2]].cast<double>() - p0);
+        double norm = n.norm();
+        if(norm > 0.0){
+            n /= norm;
+            const double d = -n.dot(p0);
+            // The planes are weighted by the areas of the triangles
+            const double area = 0.5 * norm;
+            for(int j=0; j < 3; ++j){
+                quadrics[triangle[j]].addPlane(n, d, area);
+                areas[triangle[j]] += area;
+            }
+        } else {
+            n.setZero();
+        }
+        faceNormals[i] = n;
+        for(int j=0; j < 3; ++j){
+            ++edgeCounts[getEdgeKey(triangle[j], triangle[(j + 1) % 3])];
+        }
+    }
+
+    // The planes perpendicular to the triangles are added to keep the boundary edges
+    for(int i=0; i < numLiveTriangles; ++i){
+        auto& triangle = triangles[i];
+        const Vector3& n = faceNormals[i];
+        if(n.isZero()){
+            continue;
+        }
+        for(int j=0; j < 3; ++j){
+            const int vertex1 = triangle[j];
+            const int vertex2 = triangle[(j + 1) % 3];
+            if(edgeCounts[getEdgeKey(vertex1, vertex2)] == 1){
+                isBoundaryVertex[vertex1] = true;
+                isBoundaryVertex[vertex2] = true;
+                const Vector3 p1 = positions[vertex1].cast<double>();
+                const Vector3 e = positions[vertex2].cast<double>() - p1;
+                Vector3 bn = e.cross(n);
+                double norm = bn.norm();
+                if(norm > 0.0){
+                    bn /= norm;
+                    const double d = -bn.dot(p1);
+                    const double w = BoundaryQuadricWeight * e.squaredNorm();
+                    quadrics[vertex1].addPlane(bn, d, w);
+                    quadrics[vertex2].addPlane(bn, d, w);
+                }
+            }
+        }
+    }
+
+    for(auto& kv : edgeCounts){
+        addCollapse(static_cast<int>(kv.first >> 32), static_cast<int>(kv.first & 0xffffffff));
+    }
+
+    return true;
+}
+
+
+void MeshSimplifier::addCollapse(int vertex1, int vertex2)
+{
+    Quadric q = quadrics[vertex1];
+    q.add(quadrics[vertex2]);
+    const double cost1 = q.evaluate(positions[vertex1]);
+    const double cost2 = q.evaluate(positions[vertex2]);
+
+    Collapse c;
+    if(cost1 <= cost2){
+        c.cost = cost1;
+        c.vertexToKeep = vertex1;
+        c.vertexToRemove = vertex2;
+    } else {
+        c.cost = cost2;
+        c.vertexToKeep = vertex2;
+        c.vertexToRemove = vertex1;
+    }
+    if(c.cost < 0.0){
+        c.cost = 0.0;
+    }
+    c.versionToKeep = versions[c.vertexToKeep];
+    c.versionToRemove = versions[c.vertexToRemove];
+    collapseQueue.push(c);
+}
+
+
+int MeshSimplifier::newMarkId(int n)
+{
+    if(markId > std::numeric_limits<int>::max() - n){
+        std::fill(vertexMarks.begin(), vertexMarks.end(), 0);
+        markId = 0;
+    }
+    int id = markId + 1;
+    markId += n;
+    return id;
+}
+
+
+bool MeshSimplifier::hasSameAttributes(int orgCorner1, int orgCorner2) const
+{
+    // The invalid indices are replaced with zero as in createMesh
+    auto getIndex = [](const SgIndexArray& indices, int corner, int numValues){
+        int index = (corner < static_cast<int>(indices.size())) ? indices[corner] : -1;
+        return (index < 0 || index >= numValues) ? 0 : index;
+    };
+    const auto& orgIndices = orgMesh->triangleVertices();
+    if(orgMesh->hasTexCoords()){
+        const auto& texCoords = *orgMesh->texCoords();
+        const auto& indices = orgMesh->hasTexCoordIndices() ? orgMesh->texCoordIndices() : orgIndices;
+        const int n = texCoords.size();
+        if(texCoords[getIndex(indices, orgCorner1, n)] != texCoords[getIndex(indices, orgCorner2, n)]){
+            return false;
+        }
+    }
+    if(orgMesh->hasColors()){
+        const auto& colors = *orgMesh->colors();
+        const auto& indices = orgMesh->hasColorIndices() ? orgMesh->colorIndices() : orgIndices;
+        const int n = colors.size();
+        if(colors[getIndex(indices, orgCorner1, n)] != colors[getIndex(indices, orgCorner2, n)]){
+            return false;
+        }
+    }
+    return true;
+}
+
+
+const Vector2f& MeshSimplifier::texCoordOfCorner(int orgCorner) const
+{
+    const auto& texCoords = *orgMesh->texCoords();
+    const auto& indices =
+        orgMesh->hasTexCoordIndices() ? orgMesh->texCoordIndices() : orgMesh->triangleVertices();
+    int index = (orgCorner < static_cast<int>(indices.size())) ? indices[orgCorner] : -1;
+    if(index < 0 || index >= static_cast<int>(texCoords.size())){
+        index = 0;
+    }
+    return texCoords[index];
+}
+
+
+/**
+   \param out_orgCornerToKeep The original corner that gives the attributes of the corners
+   of the removed vertex after the collapse.
+*/
+bool MeshSimplifier::isCollapsible(int vertexToKeep, int vertexToRemove, int& out_orgCornerToKeep)
+{
+    if(isSeamVertex[vertexToRemove] || (isBoundaryVertex[vertexToRemove] && !isBoundaryVertex[vertexToKeep])){
+        return false;
+    }
+
+    /*
+      The corners of a seam vertex have different attributes. The corner on the side of
+      the removed vertex is given by the triangles sharing the edge, and they must agree.
+    */
+    out_orgCornerToKeep = orgCornerOfVertex[vertexToKeep];
+    if(isSeamVertex[vertexToKeep]){
+        bool isCornerFound = false;
+        for(auto& t : trianglesOfVertex[vertexToRemove]){
+            if(isTriangleRemoved[t]){
+                continue;
+            }
+            auto& triangle = triangles[t];
+            for(int j=0; j < 3; ++j){
+                if(triangle[j] == vertexToKeep){
+                    const int corner = orgCorners[t][j];
+                    if(!isCornerFound){
+                        out_orgCornerToKeep = corner;
+                        isCornerFound = true;
+                    } else if(!hasSameAttributes(corner, out_orgCornerToKeep)){
+                        return false;
+                    }
+                }
+            }
+        }
+    }
+    
+    // The number of the vertices adjacent to both the vertices must be the same as
+    // the number of the triangles sharing the edge to keep the mesh manifold
+    const int mark = newMarkId(2);
+    for(auto& t : trianglesOfVertex[vertexToKeep]){
+        if(!isTriangleRemoved[t]){
+            for(auto& vertex : triangles[t]){
+                vertexMarks[vertex] = mark;
+            }
+        }
+    }
+    int numCommonVertices = 0;
+    int numSharedTriangles = 0;
+    for(auto& t : trianglesOfVertex[vertexToRemove]){
+        if(!isTriangleRemoved[t]){
+            for(auto& vertex : triangles[t]){
+                if(vertex == vertexToKeep){
+                    ++numSharedTriangles;
+                } else if(vertex != vertexToRemove && vertexMarks[vertex] == mark){
+                    ++numCommonVertices;
+                    vertexMarks[vertex] = mark + 1;
+                }
+            }
+        }
+    }
+    if(numCommonVertices > numSharedTriangles){
+        return false;
+    }
+
+    // The collapse must not flip the triangles
+    const Vector3f& p = positions[vertexToKeep];
+    for(auto& t : trianglesOfVertex[vertexToRemove]){
+        if(isTriangleRemoved[t]){
+            continue;
+        }
+        auto& triangle = triangles[t];
+        if(triangle[0] == vertexToKeep || triangle[1] == vertexToKeep || triangle[2] == vertexToKeep){
+            continue;
+        }
+        const Vector3f& p0 = positions[triangle[0]];
+        const Vector3f& p1 = positions[triangle[1]];
+        const Vector3f& p2 = positions[triangle[2]];
+        const Vector3f n0 = (p1 - p0).cross(p2 - p0);
+        const Vector3f& q0 = (triangle[0] == vertexToRemove) ? p : p0;
+        const Vector3f& q1 = (triangle[1] == vertexToRemove) ? p : p1;
+        const Vector3f& q2 = (triangle[2] == vertexToRemove) ? p : p2;
+        const Vector3f n1 = (q1 - q0).cross(q2 - q0);
+        if(n0.dot(n1) <= 0.0f){
+            return false;
+        }
+        /*
+          The texture coordinates must not be flipped either. This rejects the collapse that
+          moves a corner across a seam, where the triangle would span the texture space.
+        */
+        if(orgMesh->hasTexCoords()){
+            auto& corners = orgCorners[t];
+            const Vector2f& u0 = texCoordOfCorner(corners[0]);
+            const Vector2f& u1 = texCoordOfCorner(corners[1]);
+            const Vector2f& u2 = texCoordOfCorner(corners[2]);
+            const Vector2f& uk = texCoordOfCorner(out_orgCornerToKeep);
+            const Vector2f& v0 = (triangle[0] == vertexToRemove) ? uk : u0;
+            const Vector2f& v1 = (triangle[1] == vertexToRemove) ? uk : u1;
+            const Vector2f& v2 = (triangle[2] == vertexToRemove) ? uk : u2;
+            auto cross = [](const Vector2f& a, const Vector2f& b){ return a.x() * b.y() - a.y() * b.x(); };
+            const float a0 = cross(u1 - u0, u2 - u0);
+            const float a1 = cross(v1 - v0, v2 - v0);
+            if(a0 != 0.0f && a0 * a1 <= 0.0f){
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+
+void MeshSimplifier::collapse(const Collapse& c, int orgCornerToKeep)
+{
+    const int vertexToKeep = c.vertexToKeep;
+    const int vertexToRemove = c.vertexToRemove;
+
+    quadrics[vertexToKeep].add(quadrics[vertexToRemove]);
+    areas[vertexToKeep] += areas[vertexToRemove];
+
+    auto& trianglesToKeep = trianglesOfVertex[vertexToKeep];
+    for(auto& t : trianglesOfVertex[vertexToRemove]){
+        if(isTriangleRemoved[t]){
+            continue;
+        }
+        auto& triangle = triangles[t];
+        if(triangle[0] == vertexToKeep || triangle[1] == vertexToKeep || triangle[2] == vertexToKeep){
+            isTriangleRemoved[t] = true;
+            --numLiveTriangles;
+        } else {
+            for(int j=0; j < 3; ++j){
+                if(triangle[j] == vertexToRemove){
+                    triangle[j] = vertexToKeep;
+                    orgCorners[t][j] = orgCornerToKeep;
+                }
+            }
+            trianglesToKeep.push_back(t);
+        }
+    }
+    vector<int>().swap(trianglesOfVertex[vertexToRemove]);
+    isVertexRemoved[vertexToRemove] = true;
+    ++versions[vertexToKeep];
+
+    trianglesToKeep.erase(
+        std::remove_if(trianglesToKeep.begin(), trianglesToKeep.end(),
+                       [&](int t){ return isTriangleRemoved[t]; }),
+        trianglesToKeep.end());
+
+    if(areas[vertexToKeep] > 0.0){
+        // The root mean square of the distances to the planes of the merged triangles
+        maxError = std::max(maxError, sqrt(c.cost / areas[vertexToKeep]));
+    }
+
+    const int mark = newMarkId(1);
+    for(auto& t : trianglesToKeep){
+        for(auto& vertex : triangles[t]){
+            if(vertex != vertexToKeep && vertexMarks[vertex] != mark){
+                vertexMarks[vertex] = mark;
+                addCollapse(vertexToKeep, vertex);
+            }
+        }
+    }
+}
+
+
+void MeshSimplifier::reduce(int targetNumTriangles)
+{
+    while(numLiveTriangles > targetNumTriangles && !collapseQueue.empty()){
+        Collapse c = collapseQueue.top();
+        collapseQueue.pop();
+        if(isVertexRemoved[c.vertexToKeep] || isVertexRemoved[c.vertexToRemove] ||
+           versions[c.vertexToKeep] != c.versionToKeep ||
+           versions[c.vertexToRemove] != c.versionToRemove){
+            continue;
+        }
+        int orgCornerToKeep;
+        if(isCollapsible(c.vertexToKeep, c.vertexToRemove, orgCornerToKeep)){
+            collapse(c, orgCornerToKeep);
+        }
+    }
+}
+
+
+SgMesh* MeshSimplifier::createMesh()
+{
+    auto mesh = new SgMesh;
+    auto& vertices = *mesh->getOrCreateVertices();
+    auto& indices = mesh->triangleVertices();
+    indices.reserve(numLiveTriangles * 3);
+    vector<int> vertexIndexMap(positions.size(), -1);
+
+    const auto& orgIndices = orgMesh->triangleVertices();
+
+    const SgTexCoordArray* orgTexCoords = orgMesh->hasTexCoords() ? orgMesh->texCoords() : nullptr;
+    const SgIndexArray* orgTexCoordIndices = orgMesh->hasTexCoordIndices() ? &orgMesh->texCoordIndices() : &orgIndices;
+    SgTexCoordArray* texCoords = nullptr;
+    vector<int> texCoordIndexMap;
+    if(orgTexCoords){
+        texCoords = mesh->getOrCreateTexCoords();
+        texCoordIndexMap.resize(orgTexCoords->size(), -1);
+        mesh->texCoordIndices().reserve(numLiveTriangles * 3);
+    }
+
+    const SgColorArray* orgColors = orgMesh->hasColors() ? orgMesh->colors() : nullptr;
+    const SgIndexArray* orgColorIndices = orgMesh->hasColorIndices() ? &orgMesh->colorIndices() : &orgIndices;
+    SgColorArray* colors = nullptr;
+    vector<int> colorIndexMap;
+    if(orgColors){
+        colors = mesh->getOrCreateColors();
+        colorIndexMap.resize(orgColors->size(), -1);
+        mesh->colorIndices().reserve(numLiveTriangles * 3);
+    }
+
+    const int numTriangles = triangles.size();
+    for(int i=0; i < numTriangles; ++i){
+        if(isTriangleRemoved[i]){
+            continue;
+        }
+        auto& triangle = triangles[i];
+        for(int j=0; j < 3; ++j){
+            int& index = vertexIndexMap[triangle[j]];
+            if(index < 0){
+                index = vertices.size();
+                vertices.push_back(positions[triangle[j]]);
+            }
+            indices.push_back(index);
+
+            const int orgCorner = orgCorners[i][j];
+            if(texCoords){
+                int orgIndex = (orgCorner < static_cast<int>(orgTexCoordIndices->size())) ? (*orgTexCoordIndices)[orgCorner] : -1;
+                if(orgIndex < 0 || orgIndex >= static_cast<int>(orgTexCoords->size())){
+                    orgIndex = 0;
+                }
+                int& texCoordIndex = texCoordIndexMap[orgIndex];
+                if(texCoordIndex < 0){
+                    texCoordIndex = texCoords->size();
+                    texCoords->push_back((*orgTexCoords)[orgIndex]);
+                }
+                mesh->texCoordIndices().push_back(texCoordIndex);
+            }
+            if(colors){
+                int orgIndex = (orgCorner < static_cast<int>(orgColorIndices->size())) ? (*orgColorIndices)[orgCorner] : -1;
+                if(orgIndex < 0 || orgIndex >= static_cast<int>(orgColors->size())){
+                    orgIndex = 0;
+                }
+                int& colorIndex = colorIndexMap[orgIndex];
+                if(colorIndex < 0){
+                    colorIndex = colors->size();
+                    colors->push_back((*orgColors)[orgIndex]);
+                }
+                mesh->colorIndices().push_back(colorIndex);
+            }
+        }
+    }
+
+    mesh->setSolid(orgMesh->isSolid());
+    mesh->setCreaseAngle(orgMesh->creaseAngle());
+    mesh->updateBoundingBox();
+
+    return mesh;
+}
+
+}
+
 namespace cnoid {
 
 class MeshFilter::Impl
 {
 public:
     unique_ptr<MeshExtractor> meshExtractor;
+    int maxNumThreads;
     vector<Vector3f> faceNormals;
-    vector<vector<int>> facesOfVertexMap;
+    // The faces of vertex i are stored in facesOfVertices from facesOfVertexOffsets[i]
+    // and the number of them is numFacesOfVertices[i]
+    vector<int> facesOfVertices;
+    vector<int> facesOfVertexOffsets;
+    vector<int> numFacesOfVertices;
+    vector<Vector3f> cornerNormals;
     unordered_map<EdgeId, vector<int>> facesOfEdgeMap;
     vector<vector<int>> normalsOfVertexMap;
     float minCreaseAngle;
@@ -109,7 +831,8 @@ public:
 
     Impl();
     Impl(const Impl& org);
-    void forAllMeshes(SgNode* node, function<void(SgMesh* mesh)> callback);
+    template<class Function> void parallelFor(int size, int minSizePerThread, Function func);
+    void forAllMeshes(SgNode* node, const function<void(Impl* impl, SgMesh* mesh)>& callback);
     void removeRedundantVertices(SgMesh* mesh);
     void removeRedundantFaces(SgMesh* mesh, int reductionMode);
     void removeNormalIndicesOfRedundantFaces(SgMesh* mesh, const vector<int>& validFaceIndices);
@@ -118,6 +841,11 @@ public:
     void makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFaces = false);
     void makeFacesOfEdgeMap(SgMesh* mesh);
     void setVertexNormals(SgMesh* mesh, float creaseAngle);
+    void generateNormalsOfSimplifiedMesh(SgMesh* simplifiedMesh, SgMesh* orgMesh);
+    SgMesh* simplify(SgMesh* mesh, int targetNumTriangles, double* out_error);
+    int generateSimplifiedMeshes(
+        SgMesh* mesh, double reductionRatio, int minNumTriangles,
+        const std::function<bool(SgMesh* simplifiedMesh, double error)>& callback);
 };
 
 }
@@ -134,6 +862,7 @@ MeshFilter::Impl::Impl()
     isNormalOverwritingEnabled = false;
     minCreaseAngle = 0.0f;
     maxCreaseAngle = static_cast<float>(PI);
+    maxNumThreads = std::max(1u, std::thread::hardware_concurrency());
 }
 
 
@@ -148,6 +877,7 @@ MeshFilter::Impl::Impl(const Impl& org)
     isNormalOverwritingEnabled = org.isNormalOverwritingEnabled;
     minCreaseAngle = org.minCreaseAngle;
     maxCreaseAngle = org.maxCreaseAngle;
+    maxNumThreads = org.maxNumThreads;
 }
 
 
@@ -157,12 +887,92 @@ MeshFilter::~MeshFilter()
 }
 
 
-void MeshFilter::Impl::forAllMeshes(SgNode* node, function<void(SgMesh* mesh)> callback)
+void MeshFilter::setMaxNumThreads(int n)
+{
+    impl->maxNumThreads = std::max(1, n);
+}
+
+
+/**
+   The function is called for the ranges [begin, end) that divide [0, size) in the threads.
+*/
+template<class Function>
+void MeshFilter::Impl::parallelFor(int size, int minSizePerThread, Function func)
+{
+    const int numThreads = std::min(maxNumThreads, size / minSizePerThread);
+    if(numThreads <= 1){
+        func(0, size);
+        return;
+    }
+    vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    const int sizePerThread = size / numThreads;
+    int begin = 0;
+    for(int i=0; i < numThreads - 1; ++i){
+        threads.emplace_back([&func, begin, sizePerThread](){ func(begin, begin + sizePerThread); });
+        begin += sizePerThread;
+    }
+    func(begin, size);
+    for(auto& thread : threads){
+        thread.join();
+    }
+}
+
+
+/**
+   The meshes are processed in parallel if they do not share the vertex or normal arrays.
+   Each thread uses its own Impl object to keep the working buffers.
+*/
+void MeshFilter::Impl::forAllMeshes(SgNode* node, const function<void(Impl* impl, SgMesh* mesh)>& callback)
 {
     if(!meshExtractor){
         meshExtractor.reset(new MeshExtractor);
     }
-    meshExtractor->extract(node, callback);
+    vector<SgMesh*> meshes;
+    unordered_set<SgMesh*> meshSet;
+    unordered_set<SgObject*> arraySet;
+    bool isArrayShared = false;
+    meshExtractor->extract(
+        node,
+        [&](SgMesh* mesh){
+            if(meshSet.insert(mesh).second){
+                meshes.push_back(mesh);
+                for(SgObject* array : { static_cast<SgObject*>(mesh->vertices()), static_cast<SgObject*>(mesh->normals()) }){
+                    if(array && !arraySet.insert(array).second){
+                        isArrayShared = true;
+                    }
+                }
+            }
+        });
+
+    const int numThreads = std::min(maxNumThreads, static_cast<int>(meshes.size()));
+    if(numThreads <= 1 || isArrayShared){
+        for(auto& mesh : meshes){
+            callback(this, mesh);
+        }
+        return;
+    }
+
+    std::atomic<int> nextMeshIndex(0);
+    auto processMeshes =
+        [&](){
+            Impl impl(*this);
+            // The meshes are already processed in parallel
+            impl.maxNumThreads = 1;
+            int index;
+            while((index = nextMeshIndex++) < static_cast<int>(meshes.size())){
+                callback(&impl, meshes[index]);
+            }
+        };
+    vector<std::thread> threads;
+    threads.reserve(numThreads - 1);
+    for(int i=0; i < numThreads - 1; ++i){
+        threads.emplace_back(processMeshes);
+    }
+    processMeshes();
+    for(auto& thread : threads){
+        thread.join();
+    }
 }
 
 
@@ -207,7 +1017,7 @@ void MeshFilter::integrateMeshes(SgMesh* mesh1, SgMesh* mesh2)
 
 void MeshFilter::removeRedundantVertices(SgNode* scene)
 {
-    impl->forAllMeshes(scene, [&](SgMesh* mesh){ impl->removeRedundantVertices(mesh); });
+    impl->forAllMeshes(scene, [](Impl* impl, SgMesh* mesh){ impl->removeRedundantVertices(mesh); });
 }
 
 
@@ -235,23 +1045,10 @@ void MeshFilter::Impl::removeRedundantVertices(SgMesh* mesh)
         usedVertexFlags[triangleVertices[i]] = true;
     }
 
+    ApproximateVectorFinder finder(*pOrgVertices, usedVertexFlags);
     for(size_t i=0; i < numOrgVertices; ++i){
-        if(!usedVertexFlags[i]){
-            continue;
-        }
-        const auto& vertex = pOrgVertices->at(i);
-        bool found = false;
-        size_t index = 0;
-        while(index < vertices.size()){
-            if(vertex.isApprox(vertices[index])){
-                found = true;
-                break;
-            }
-            ++index;
-        }
-        indexMap[i] = index;
-        if(!found){
-            vertices.emplace_back(vertex);
+        if(usedVertexFlags[i]){
+            indexMap[i] = finder.findOrAdd(pOrgVertices->at(i), vertices);
         }
     }
     vertices.shrink_to_fit();
@@ -283,7 +1080,7 @@ void MeshFilter::removeRedundantFaces(SgNode* scene, int reductionMode)
 {
     impl->forAllMeshes(
         scene,
-        [&, reductionMode](SgMesh* mesh){
+        [reductionMode](Impl* impl, SgMesh* mesh){
             impl->removeRedundantFaces(mesh, reductionMode);
         });
 }
@@ -381,7 +1178,7 @@ void MeshFilter::Impl::removeNormalIndicesOfRedundantFaces(SgMesh* mesh, const v
 
 void MeshFilter::removeRedundantNormals(SgNode* scene)
 {
-    impl->forAllMeshes(scene, [&](SgMesh* mesh){ impl->removeRedundantNormals(mesh); });
+    impl->forAllMeshes(scene, [](Impl* impl, SgMesh* mesh){ impl->removeRedundantNormals(mesh); });
 }
 
 
@@ -417,23 +1214,10 @@ void MeshFilter::Impl::removeRedundantNormals(SgMesh* mesh)
     normals.clear();
     vector<int> indexMap(numOrgNormals);
 
+    ApproximateVectorFinder finder(*pOrgNormals, usedNormalFlags);
     for(size_t i=0; i< numOrgNormals; ++i){
-        if(!usedNormalFlags[i]){
-            continue;
-        }
-        const auto& normal = pOrgNormals->at(i);
-        bool found = false;
-        size_t index = 0;
-        while(index < normals.size()){
-            if(normal.isApprox(normals[index])){
-                found = true;
-                break;
-            }
-            ++index;
-        }
-        indexMap[i] = index;
-        if(!found){
-            normals.emplace_back(normal);
+        if(usedNormalFlags[i]){
+            indexMap[i] = finder.findOrAdd(pOrgNormals->at(i), normals);
         }
     }
     normals.shrink_to_fit();
@@ -496,62 +1280,88 @@ void MeshFilter::Impl::calculateFaceNormals(SgMesh* mesh, bool ignoreZeroNormals
 {
     const SgVertexArray& vertices = *mesh->vertices();
     const int numTriangles = mesh->numTriangles();
-    faceNormals.clear();
-    faceNormals.reserve(numTriangles);
-
-    for(int i=0; i < numTriangles; ++i){
-        SgMesh::TriangleRef triangle = mesh->triangle(i);
-        const Vector3f& v0 = vertices[triangle[0]];
-        const Vector3f& v1 = vertices[triangle[1]];
-        const Vector3f& v2 = vertices[triangle[2]];
-        Vector3f normal((v1 - v0).cross(v2 - v0));
-        // prevent NaN
-        if(normal.norm() > 0.0){
-            normal.normalize();
-        } else {
-            if(!ignoreZeroNormals){
-                //! \todo remove degenerate faces
-                normal = Vector3f::UnitZ();
+    faceNormals.resize(numTriangles);
+
+    parallelFor(
+        numTriangles, MinNumFacesPerThread,
+        [&](int begin, int end){
+            for(int i=begin; i < end; ++i){
+                SgMesh::TriangleRef triangle = mesh->triangle(i);
+                const Vector3f& v0 = vertices[triangle[0]];
+                const Vector3f& v1 = vertices[triangle[1]];
+                const Vector3f& v2 = vertices[triangle[2]];
+                Vector3f normal((v1 - v0).cross(v2 - v0));
+                // prevent NaN
+                if(normal.norm() > 0.0){
+                    normal.normalize();
+                } else {
+                    if(!ignoreZeroNormals){
+                        //! \todo remove degenerate faces
+                        normal = Vector3f::UnitZ();
+                    }
+                }
+                faceNormals[i] = normal;
             }
-        }
-        faceNormals.emplace_back(normal);
-    }
+        });
 }
 
 
 void MeshFilter::Impl::makeFacesOfVertexMap(SgMesh* mesh, bool removeSameNormalFaces)
 {
-    facesOfVertexMap.clear();
-    facesOfVertexMap.resize(mesh->vertices()->size());
+    const int numVertices = mesh->vertices()->size();
     const int numTriangles = mesh->numTriangles();
-    
+    const auto& triangleVertices = mesh->triangleVertices();
+
+    // The faces are distributed to the vertices by the counting sort to keep the order of the faces
+    facesOfVertexOffsets.assign(numVertices + 1, 0);
+    for(int i=0; i < numTriangles * 3; ++i){
+        ++facesOfVertexOffsets[triangleVertices[i] + 1];
+    }
+    for(int i=0; i < numVertices; ++i){
+        facesOfVertexOffsets[i + 1] += facesOfVertexOffsets[i];
+    }
+    facesOfVertices.resize(numTriangles * 3);
+    numFacesOfVertices.assign(numVertices, 0);
     for(int i=0; i < numTriangles; ++i){
-        SgMesh::TriangleRef triangle = mesh->triangle(i);
         for(int j=0; j < 3; ++j){
-            auto& faceIndicesOfVertex = facesOfVertexMap[triangle[j]];
-            if(!removeSameNormalFaces){
-                faceIndicesOfVertex.push_back(i);
-            } else {
-                /**
-                   \todo Angle between adjacent edges should be taken into account
-                   to generate natural normals
-                */
-                const auto& normal = faceNormals[i];
-                bool isSameNormalFaceFound = false;
-                for(size_t k=0; k < faceIndicesOfVertex.size(); ++k){
-                    const auto& adjacentFaceNormal = faceNormals[faceIndicesOfVertex[k]];
-                    // the same face is not appended
-                    if(adjacentFaceNormal.isApprox(normal, 5.0e-4f)){
-                        isSameNormalFaceFound = true;
-                        break;
+            const int vertexIndex = triangleVertices[i * 3 + j];
+            facesOfVertices[facesOfVertexOffsets[vertexIndex] + numFacesOfVertices[vertexIndex]++] = i;
+        }
+    }
+
+    if(!removeSameNormalFaces){
+        return;
+    }
+    
+    parallelFor(
+        numVertices, MinNumFacesPerThread,
+        [&](int begin, int end){
+            for(int i=begin; i < end; ++i){
+                int* faceIndicesOfVertex = &facesOfVertices[facesOfVertexOffsets[i]];
+                const int numFaces = numFacesOfVertices[i];
+                int numRemainingFaces = 0;
+                for(int j=0; j < numFaces; ++j){
+                    /**
+                       \todo Angle between adjacent edges should be taken into account
+                       to generate natural normals
+                    */
+                    const auto& normal = faceNormals[faceIndicesOfVertex[j]];
+                    bool isSameNormalFaceFound = false;
+                    for(int k=0; k < numRemainingFaces; ++k){
+                        const auto& adjacentFaceNormal = faceNormals[faceIndicesOfVertex[k]];
+                        // the same face is not appended
+                        if(adjacentFaceNormal.isApprox(normal, 5.0e-4f)){
+                            isSameNormalFaceFound = true;
+                            break;
+                        }
+                    }
+                    if(!isSameNormalFaceFound){
+                        faceIndicesOfVertex[numRemainingFaces++] = faceIndicesOfVertex[j];
                     }
                 }
-                if(!isSameNormalFaceFound){
-                    faceIndicesOfVertex.push_back(i);
-                }
+                numFacesOfVertices[i] = numRemainingFaces;
             }
-        }
-    }
+        });
 }
     
 
@@ -576,6 +1386,45 @@ void MeshFilter::Impl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
     const int numVertices = mesh->vertices()->size();
     const int numTriangles = mesh->numTriangles();
 
+    // The normals of the face corners are calculated in parallel
+    cornerNormals.resize(numTriangles * 3);
+    parallelFor(
+        numTriangles, MinNumFacesPerThread,
+        [&](int begin, int end){
+            for(int faceIndex=begin; faceIndex < end; ++faceIndex){
+                SgMesh::TriangleRef triangle = mesh->triangle(faceIndex);
+                for(int i=0; i < 3; ++i){
+                    const int vertexIndex = triangle[i];
+                    const int* faceIndicesOfVertex = &facesOfVertices[facesOfVertexOffsets[vertexIndex]];
+                    const int numFaces = numFacesOfVertices[vertexIndex];
+                    const Vector3f& currentFaceNormal = faceNormals[faceIndex];
+                    Vector3f normal = currentFaceNormal;
+                    bool normalIsFaceNormal = true;
+                
+                    // avarage normals of the faces whose crease angle is below the 'creaseAngle' variable
+                    for(int j=0; j < numFaces; ++j){
+                        const int adjacentFaceIndex = faceIndicesOfVertex[j];
+                        const Vector3f& adjacentFaceNormal = faceNormals[adjacentFaceIndex];
+                        float cosAngle = currentFaceNormal.dot(adjacentFaceNormal)
+                            / (currentFaceNormal.norm() * adjacentFaceNormal.norm());
+                        //prevent NaN
+                        if (cosAngle >  1.0) cosAngle =  1.0;
+                        if (cosAngle < -1.0) cosAngle = -1.0;
+                        const float angle = acosf(cosAngle);
+                        if(angle > 0.0f && angle < creaseAngle){
+                            normal += adjacentFaceNormal;
+                            normalIsFaceNormal = false;
+                        }
+                    }
+                    if(!normalIsFaceNormal){
+                        normal.normalize();
+                    }
+                    cornerNormals[faceIndex * 3 + i] = normal;
+                }
+            }
+        });
+
+    // The normals are shared in the order of the faces to make the same indices in any number of threads
     mesh->setNormals(new SgNormalArray);
     SgNormalArray& normals = *mesh->normals();
     SgIndexArray& normalIndices = mesh->normalIndices();
@@ -592,29 +1441,7 @@ void MeshFilter::Impl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
         for(int i=0; i < 3; ++i){
 
             const int vertexIndex = triangle[i];
-            const auto& faceIndicesOfVertex = facesOfVertexMap[vertexIndex];
-            const Vector3f& currentFaceNormal = faceNormals[faceIndex];
-            Vector3f normal = currentFaceNormal;
-            bool normalIsFaceNormal = true;
-                
-            // avarage normals of the faces whose crease angle is below the 'creaseAngle' variable
-            for(size_t j=0; j < faceIndicesOfVertex.size(); ++j){
-                const int adjacentFaceIndex = faceIndicesOfVertex[j];
-                const Vector3f& adjacentFaceNormal = faceNormals[adjacentFaceIndex];
-                float cosAngle = currentFaceNormal.dot(adjacentFaceNormal)
-                  / (currentFaceNormal.norm() * adjacentFaceNormal.norm());
-                //prevent NaN
-                if (cosAngle >  1.0) cosAngle =  1.0;
-                if (cosAngle < -1.0) cosAngle = -1.0;
-                const float angle = acosf(cosAngle);
-                if(angle > 0.0f && angle < creaseAngle){
-                    normal += adjacentFaceNormal;
-                    normalIsFaceNormal = false;
-                }
-            }
-            if(!normalIsFaceNormal){
-                normal.normalize();
-            }
+            const Vector3f& normal = cornerNormals[faceIndex * 3 + i];
             
             int normalIndex = -1;
             
@@ -640,3 +1467,93 @@ void MeshFilter::Impl::setVertexNormals(SgMesh* mesh, float givenCreaseAngle)
         }
     }
 }
+
+
+SgMesh* MeshFilter::simplify(SgMesh* mesh, int targetNumTriangles, double* out_error)
+{
+    return impl->simplify(mesh, targetNumTriangles, out_error);
+}
+
+
+SgMesh* MeshFilter::Impl::simplify(SgMesh* mesh, int targetNumTriangles, double* out_error)
+{
+    if(!mesh->hasVertices()){
+        return nullptr;
+    }
+    MeshSimplifier simplifier;
+    if(!simplifier.initialize(mesh)){
+        return nullptr;
+    }
+    simplifier.reduce(targetNumTriangles);
+    if(simplifier.numTriangles() >= mesh->numTriangles()){
+        return nullptr;
+    }
+    auto simplifiedMesh = simplifier.createMesh();
+    generateNormalsOfSimplifiedMesh(simplifiedMesh, mesh);
+    if(out_error){
+        *out_error = simplifier.error();
+    }
+    return simplifiedMesh;
+}
+
+
+int MeshFilter::generateSimplifiedMeshes
+(SgMesh* mesh, double reductionRatio, int minNumTriangles,
+ std::function<bool(SgMesh* simplifiedMesh, double error)> callback)
+{
+    return impl->generateSimplifiedMeshes(mesh, reductionRatio, minNumTriangles, callback);
+}
+
+
+int MeshFilter::Impl::generateSimplifiedMeshes
+(SgMesh* mesh, double reductionRatio, int minNumTriangles,
+ const std::function<bool(SgMesh* simplifiedMesh, double error)>& callback)
+{
+    if(!mesh->hasVertices() || reductionRatio <= 0.0 || reductionRatio >= 1.0){
+        return 0;
+    }
+    MeshSimplifier simplifier;
+    if(!simplifier.initialize(mesh)){
+        return 0;
+    }
+
+    // The simplification is continued from the previous mesh
+    int numGeneratedMeshes = 0;
+    int numTriangles = mesh->numTriangles();
+    while(true){
+        const int targetNumTriangles = static_cast<int>(numTriangles * reductionRatio);
+        if(targetNumTriangles < minNumTriangles){
+            break;
+        }
+        simplifier.reduce(targetNumTriangles);
+        if(simplifier.numTriangles() >= numTriangles){
+            break;
+        }
+        numTriangles = simplifier.numTriangles();
+        SgMeshPtr simplifiedMesh = simplifier.createMesh();
+        generateNormalsOfSimplifiedMesh(simplifiedMesh, mesh);
+        ++numGeneratedMeshes;
+        if(!callback(simplifiedMesh, simplifier.error())){
+            break;
+        }
+        if(numTriangles > targetNumTriangles){
+            // No more edges can be collapsed
+            break;
+        }
+    }
+
+    return numGeneratedMeshes;
+}
+
+
+void MeshFilter::Impl::generateNormalsOfSimplifiedMesh(SgMesh* simplifiedMesh, SgMesh* orgMesh)
+{
+    float creaseAngle = orgMesh->creaseAngle();
+    if(creaseAngle == 0.0f && orgMesh->hasNormals()){
+        // The crease angle is not given for the mesh that has the normals given explicitly
+        creaseAngle = static_cast<float>(radian(45.0));
+    }
+    calculateFaceNormals(simplifiedMesh, false);
+    makeFacesOfVertexMap(simplifiedMesh, true);
+    setVertexNormals(simplifiedMesh, creaseAngle);
+}
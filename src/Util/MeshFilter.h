@@ -1,6 +1,7 @@
 #ifndef CNOID_UTIL_MESH_FILTER_H
 #define CNOID_UTIL_MESH_FILTER_H
 
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -39,7 +40,36 @@ public:
     void setNormalOverwritingEnabled(bool on);
     void setMinCreaseAngle(float angle);
     void setMaxCreaseAngle(float angle);
+
+    /**
+       The processing of a large mesh and the processing of the meshes in a scene are parallelized
+       with this number of threads. The default number is the number of the hardware threads.
+       The results do not depend on the number of threads.
+    */
+    void setMaxNumThreads(int n);
     
+    /**
+       This function generates a mesh simplified by the edge collapses based on the quadric error
+       metrics. The vertex attributes other than the normals are inherited from the original mesh,
+       and the normals are generated with the crease angle of the original mesh.
+       \param targetNumTriangles The simplification stops when the number of triangles reaches this number.
+       \param out_error The approximate error of the simplified mesh is returned as a distance in the
+       mesh coordinate if this parameter is given.
+       \return The simplified mesh or nullptr if the number of triangles cannot be reduced.
+    */
+    SgMesh* simplify(SgMesh* mesh, int targetNumTriangles, double* out_error = nullptr);
+
+    /**
+       This function generates a chain of the simplified meshes for the level of detail rendering.
+       The number of triangles of each mesh is reduced from the previous one by the reduction ratio
+       until it becomes less than minNumTriangles. The callback function is called for each
+       generated mesh with its error, and the generation is stopped when the function returns false.
+       \return The number of the generated meshes
+    */
+    int generateSimplifiedMeshes(
+        SgMesh* mesh, double reductionRatio, int minNumTriangles,
+        std::function<bool(SgMesh* simplifiedMesh, double error)> callback);
+
     [[deprecated("Use setNormalOverwritingEnabled")]]
     void setOverwritingEnabled(bool on);
 
@@ -0,0 +1,219 @@
+#include "MeshLodChain.h"
+#include "MeshFilter.h"
+#include "ThreadPool.h"
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <algorithm>
+
+using namespace std;
+using namespace cnoid;
+
+namespace {
+
+// The number of triangles is reduced to this ratio at each level
+constexpr double ReductionRatio = 0.25;
+constexpr int MinNumTrianglesOfSimplifiedMesh = 128;
+
+struct CacheEntry
+{
+    weak_ref_ptr<SgMesh> mesh;
+    MeshLodChainPtr chain;
+    // The id of the latest generation request. The results of the other requests are discarded.
+    unsigned int requestId;
+    bool isRequested;
+    bool isUpdated;
+    ScopedConnection connection;
+};
+
+std::mutex cacheMutex;
+unordered_map<SgMesh*, unique_ptr<CacheEntry>> cache;
+size_t cacheSizeToSweep = 256;
+unsigned int requestIdCounter = 0;
+
+class Generator
+{
+public:
+    std::atomic<bool> isExiting;
+    unique_ptr<ThreadPool> threadPool;
+
+    Generator() : isExiting(false) { }
+
+    ~Generator(){
+        // The generations in progress are stopped as soon as possible at exit
+        isExiting = true;
+        threadPool.reset();
+    }
+
+    ThreadPool* getOrCreateThreadPool(){
+        if(!threadPool){
+            int numThreads = std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1);
+            threadPool.reset(new ThreadPool(numThreads));
+        }
+        return threadPool.get();
+    }
+};
+
+// This must be defined after the cache variables to be destroyed before them
+Generator generator;
+
+
+/**
+   The data of the mesh is copied so that the mesh can be simplified in a background thread
+   while the original mesh is being used or modified in the main thread.
+*/
+SgMesh* copyMeshData(SgMesh* mesh)
+{
+    auto copy = new SgMesh;
+    copy->setVertices(new SgVertexArray(*mesh->vertices()));
+    copy->triangleVertices() = mesh->triangleVertices();
+    if(mesh->hasNormals()){
+        copy->setNormals(new SgNormalArray(*mesh->normals()));
+        copy->normalIndices() = mesh->normalIndices();
+    }
+    if(mesh->hasColors()){
+        copy->setColors(new SgColorArray(*mesh->colors()));
+        copy->colorIndices() = mesh->colorIndices();
+    }
+    if(mesh->hasTexCoords()){
+        copy->setTexCoords(new SgTexCoordArray(*mesh->texCoords()));
+        copy->texCoordIndices() = mesh->texCoordIndices();
+    }
+    copy->setCreaseAngle(mesh->creaseAngle());
+    copy->setSolid(mesh->isSolid());
+    return copy;
+}
+
+
+CacheEntry* getOrCreateCacheEntry(SgMesh* mesh)
+{
+    if(cache.size() >= cacheSizeToSweep){
+        auto p = cache.begin();
+        while(p != cache.end()){
+            if(p->second->mesh.expired()){
+                p = cache.erase(p);
+            } else {
+                ++p;
+            }
+        }
+        cacheSizeToSweep = std::max(cache.size() * 2, static_cast<size_t>(256));
+    }
+
+    auto& entry = cache[mesh];
+    if(entry && entry->mesh.expired()){
+        // Another mesh has been created at the same address
+        entry.reset();
+    }
+    if(!entry){
+        entry.reset(new CacheEntry);
+        entry->mesh = weak_ref_ptr<SgMesh>(mesh);
+        entry->requestId = 0;
+        entry->isRequested = false;
+        entry->isUpdated = false;
+        auto pEntry = entry.get();
+        entry->connection =
+            mesh->sigUpdated().connect(
+                [pEntry](const SgUpdate&){
+                    std::lock_guard<std::mutex> lock(cacheMutex);
+                    pEntry->isUpdated = true;
+                });
+    }
+    if(entry->isUpdated){
+        entry->chain.reset();
+        entry->isRequested = false;
+        entry->isUpdated = false;
+    }
+    return entry.get();
+}
+
+}
+
+
+MeshLodChainPtr MeshLodChain::findOrRequest(SgMesh* mesh)
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+
+    auto entry = getOrCreateCacheEntry(mesh);
+    if(entry->chain){
+        return entry->chain;
+    }
+    if(!entry->isRequested){
+        entry->isRequested = true;
+        const unsigned int requestId = ++requestIdCounter;
+        entry->requestId = requestId;
+        SgMeshPtr meshData = copyMeshData(mesh);
+        generator.getOrCreateThreadPool()->start(
+            [mesh, meshData, requestId](){
+                if(generator.isExiting){
+                    return;
+                }
+                MeshLodChainPtr chain = new MeshLodChain;
+                chain->generate(meshData);
+                std::lock_guard<std::mutex> lock(cacheMutex);
+                auto p = cache.find(mesh);
+                if(p != cache.end()){
+                    auto& entry = p->second;
+                    if(entry->requestId == requestId && !entry->mesh.expired()){
+                        entry->chain = chain;
+                        entry->isRequested = false;
+                    }
+                }
+            });
+    }
+    return nullptr;
+}
+
+
+MeshLodChainPtr MeshLodChain::getOrCreate(SgMesh* mesh)
+{
+    {
+        std::lock_guard<std::mutex> lock(cacheMutex);
+        auto entry = getOrCreateCacheEntry(mesh);
+        if(entry->chain){
+            return entry->chain;
+        }
+    }
+
+    // The chain is generated without locking the cache
+    MeshLodChainPtr chain = new MeshLodChain;
+    chain->generate(mesh);
+
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    auto entry = getOrCreateCacheEntry(mesh);
+    entry->chain = chain;
+    entry->isRequested = false;
+    // The result of the request in progress is not necessary
+    entry->requestId = ++requestIdCounter;
+    return entry->chain;
+}
+
+
+void MeshLodChain::clearCache()
+{
+    std::lock_guard<std::mutex> lock(cacheMutex);
+    cache.clear();
+}
+
+
+MeshLodChain::MeshLodChain()
+{
+
+}
+
+
+void MeshLodChain::generate(SgMesh* mesh)
+{
+    meshes.clear();
+    errors.clear();
+
+    MeshFilter filter;
+    filter.generateSimplifiedMeshes(
+        mesh, ReductionRatio, MinNumTrianglesOfSimplifiedMesh,
+        [this](SgMesh* simplifiedMesh, double error){
+            meshes.push_back(simplifiedMesh);
+            errors.push_back(error);
+            return !generator.isExiting;
+        });
+}
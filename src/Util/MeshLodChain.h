@@ -0,0 +1,54 @@
+#ifndef CNOID_UTIL_MESH_LOD_CHAIN_H
+#define CNOID_UTIL_MESH_LOD_CHAIN_H
+
+#include "SceneDrawables.h"
+#include <vector>
+#include "exportdecl.h"
+
+namespace cnoid {
+
+class MeshLodChain;
+typedef ref_ptr<MeshLodChain> MeshLodChainPtr;
+
+/**
+   This class keeps the simplified meshes of a mesh for the level of detail (LOD) rendering.
+   Level 0 corresponds to the original mesh, and the number of triangles is reduced as the
+   level increases.
+*/
+class CNOID_EXPORT MeshLodChain : public Referenced
+{
+public:
+    /**
+       This function returns the chain of the mesh shared by all the users if it has been generated.
+       Otherwise the generation is started in a background thread and nullptr is returned.
+       The chain is generated again when the function is called after the mesh notifies an update.
+    */
+    static MeshLodChainPtr findOrRequest(SgMesh* mesh);
+
+    //! This function generates the chain in the calling thread if it is not available.
+    static MeshLodChainPtr getOrCreate(SgMesh* mesh);
+
+    //! This function releases the chains cached for the meshes.
+    static void clearCache();
+
+    MeshLodChain();
+
+    void generate(SgMesh* mesh);
+
+    //! The number of the levels including the original mesh
+    int numLevels() const { return static_cast<int>(meshes.size()) + 1; }
+
+    //! \param level The level of the simplified mesh, which must be larger than 0.
+    SgMesh* simplifiedMesh(int level) const { return meshes[level - 1]; }
+
+    //! The approximate error of the mesh at the level as a distance in the mesh coordinate
+    double error(int level) const { return (level == 0) ? 0.0 : errors[level - 1]; }
+
+private:
+    std::vector<SgMeshPtr> meshes;
+    std::vector<double> errors;
+};
+
+}
+
+#endif
@@ -4,9 +4,12 @@
 #include "SceneLoader.h"
 #include "Triangulator.h"
 #include "ImageIO.h"
+#include "MappedFile.h"
 #include "NullOut.h"
 #include <unordered_map>
 #include <algorithm>
+#include <thread>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -16,6 +19,9 @@ namespace filesystem = stdx::filesystem;
 
 namespace {
 
+//! The minimum size of the file region parsed by each thread
+const size_t ChunkSizePerThread = 1024 * 1024;
+
 struct Registration {
     Registration(){
         SceneLoader::registerLoader(
@@ -68,7 +74,6 @@ class ObjSceneLoader::Impl
 {
 public:
     ObjSceneLoader* self;
-    SimpleScanner scanner;
     SimpleScanner subScanner;
     string token;
     SgGroupPtr group;
@@ -86,6 +91,52 @@ public:
     SgIndexArray* currentTexCoordIndices;
     Triangulator<SgVertexArray> triangulator;
     vector<int> polygon;
+    size_t maxNumThreads;
+
+    /**
+       A directive which affects the node and material states.
+       It is applied before the face specified by faceIndex in the chunk.
+    */
+    struct Directive
+    {
+        enum Type { NewNode, UseMaterial, MaterialLibrary };
+        Type type;
+        string argument;
+        size_t faceIndex;
+        Directive(Type type, const string& argument, size_t faceIndex)
+            : type(type), argument(argument), faceIndex(faceIndex) { }
+    };
+
+    struct FaceSize
+    {
+        int numVertices;
+        int numTexCoords;
+        int numNormals;
+    };
+
+    /**
+       A line-aligned region of the file and the elements parsed from it.
+       Chunks are parsed concurrently and are merged in order.
+    */
+    struct Chunk
+    {
+        const char* begin;
+        const char* end;
+        vector<Vector3f> vertices;
+        vector<Vector3f> normals;
+        vector<Vector2f> texCoords;
+        vector<int> vertexIndices;
+        vector<int> texCoordIndices;
+        vector<int> normalIndices;
+        vector<FaceSize> faces;
+        vector<Directive> directives;
+        bool isFailed;
+        string errorMessage;
+
+        Chunk(const char* begin, const char* end)
+            : begin(begin), end(end), isFailed(false) { }
+        void clearElements();
+    };
 
     struct MaterialInfo
     {
@@ -108,6 +159,7 @@ public:
     ostream* os_;
     ostream& os() { return *os_; }
 
+    string filename;
     filesystem::path filePath;
     string fileBaseName;
     filesystem::path directoryPath;
@@ -116,14 +168,20 @@ public:
     Impl(ObjSceneLoader* self);
     void clearBufObjects();
     SgNode* load(const string& filename);
-    SgNodePtr loadScene();
+    SgNodePtr loadScene(const MappedFile& file);
+    void parseChunks(const MappedFile& file, vector<Chunk>& chunks);
+    void parseChunk(Chunk& chunk, size_t lineNumberOffset);
+    void readVertex(SimpleScanner& scanner, Chunk& chunk);
+    void readNormal(SimpleScanner& scanner, Chunk& chunk);
+    void readTextureCoordinate(SimpleScanner& scanner, Chunk& chunk);
+    void readFace(SimpleScanner& scanner, Chunk& chunk);
+    void mergeVertexElements(vector<Chunk>& chunks);
+    void buildShapes(Chunk& chunk);
+    void applyDirectives(Chunk& chunk, size_t& directiveIndex, size_t faceIndex);
     void createNewNode(const std::string& name);
     bool checkAndAddCurrentNode();
-    void readVertex();
-    void readNormal();
-    void readTextureCoordinate();
-    void readFace();
-    bool readFaceElement(int axis);
+    void addFace(Chunk& chunk, const FaceSize& face, size_t& vertexIndexPos, size_t& texCoordIndexPos, size_t& normalIndexPos);
+    void triangulateLastPolygon(int numPolygonVertices);
     bool loadMaterialTemplateLibrary(std::string filename);
     void readMaterial(const std::string& name);
     void createNewMaterial(const string& name, const string& filename);
@@ -154,6 +212,7 @@ ObjSceneLoader::Impl::Impl(ObjSceneLoader* self)
     : self(self)
 {
     imageIO.setUpsideDown(true);
+    maxNumThreads = std::max((unsigned)1, thread::hardware_concurrency());
     os_ = &nullout();
 }
 
@@ -196,10 +255,13 @@ SgNode* ObjSceneLoader::load(const std::string& filename)
 
 SgNode* ObjSceneLoader::Impl::load(const string& filename)
 {
-    if(!scanner.open(filename.c_str())){
+    // The whole file is mapped into the memory so that it can be parsed by multiple threads
+    MappedFile file;
+    if(!file.open(filename)){
         os() << format(_("Unable to open file \"{}\"."), filename) << endl;
         return nullptr;
     }
+    this->filename = filename;
     filePath = fromUTF8(filename);
     fileBaseName = toUTF8(filePath.stem().string());
     directoryPath = filePath.parent_path();
@@ -240,7 +302,7 @@ SgNode* ObjSceneLoader::Impl::load(const string& filename)
     }
     
     try {
-        scene = loadScene();
+        scene = loadScene(file);
     }
     catch(const std::exception& ex){
         os() << ex.what() << endl;
@@ -253,19 +315,134 @@ SgNode* ObjSceneLoader::Impl::load(const string& filename)
         }
     }
 
-    scanner.close();
+    file.close();
     clearBufObjects();
 
     return scene.retn();
 }
 
 
-SgNodePtr ObjSceneLoader::Impl::loadScene()
+SgNodePtr ObjSceneLoader::Impl::loadScene(const MappedFile& file)
 {
+    vector<Chunk> chunks;
+    parseChunks(file, chunks);
+    mergeVertexElements(chunks);
+
     group = new SgGroup;
 
     createNewNode(fileBaseName);
 
+    for(auto& chunk : chunks){
+        buildShapes(chunk);
+        chunk.clearElements();
+    }
+
+    checkAndAddCurrentNode();
+
+    normalizeNormals();
+    updateAmbientIntensities();
+
+    SgNodePtr scene;
+
+    if(!group->empty()){
+        if(group->numChildren() == 1){
+            scene = group->child(0);
+        } else {
+            scene = group;
+        }
+    }
+    group.reset();
+    return scene.retn();
+}
+
+
+void ObjSceneLoader::Impl::Chunk::clearElements()
+{
+    vertices = vector<Vector3f>();
+    normals = vector<Vector3f>();
+    texCoords = vector<Vector2f>();
+    vertexIndices = vector<int>();
+    texCoordIndices = vector<int>();
+    normalIndices = vector<int>();
+    faces = vector<FaceSize>();
+    directives = vector<Directive>();
+}
+
+
+void ObjSceneLoader::Impl::parseChunks(const MappedFile& file, vector<Chunk>& chunks)
+{
+    const char* fileBegin = file.begin();
+    const char* fileEnd = file.end();
+    size_t fileSize = file.size();
+    
+    size_t numThreads = std::min(maxNumThreads, std::max(size_t(1), fileSize / ChunkSizePerThread));
+
+    if(numThreads == 1){
+        chunks.emplace_back(fileBegin, fileEnd);
+        parseChunk(chunks.front(), 0);
+        return;
+    }
+
+    // Split the file into the line-aligned chunks
+    const char* chunkBegin = fileBegin;
+    for(size_t i=0; i < numThreads; ++i){
+        const char* chunkEnd = fileEnd;
+        if(i < numThreads - 1){
+            chunkEnd = fileBegin + fileSize * (i + 1) / numThreads;
+            if(chunkEnd < chunkBegin){
+                chunkEnd = chunkBegin;
+            }
+            auto lf = static_cast<const char*>(std::memchr(chunkEnd, '\n', fileEnd - chunkEnd));
+            chunkEnd = lf ? (lf + 1) : fileEnd;
+        }
+        if(chunkEnd > chunkBegin){
+            chunks.emplace_back(chunkBegin, chunkEnd);
+        }
+        chunkBegin = chunkEnd;
+    }
+
+    auto parse = [this](Chunk& chunk){
+        try {
+            parseChunk(chunk, 0);
+        }
+        catch(const std::exception& ex){
+            chunk.isFailed = true;
+            chunk.errorMessage = ex.what();
+        }
+    };
+    
+    vector<thread> threads;
+    threads.reserve(chunks.size() - 1);
+    for(size_t i=1; i < chunks.size(); ++i){
+        threads.emplace_back([&parse, &chunks, i](){ parse(chunks[i]); });
+    }
+    parse(chunks.front());
+    for(auto& t : threads){
+        t.join();
+    }
+
+    for(auto& chunk : chunks){
+        if(chunk.isFailed){
+            /*
+              The line number in the error message of a chunk is relative to the chunk head.
+              The chunk is parsed again with the actual line number offset to report the error
+              in the same way as the sequential parsing.
+            */
+            size_t lineNumberOffset = std::count(fileBegin, chunk.begin, '\n');
+            chunk.clearElements();
+            parseChunk(chunk, lineNumberOffset);
+            throw std::runtime_error(chunk.errorMessage);
+        }
+    }
+}
+
+
+void ObjSceneLoader::Impl::parseChunk(Chunk& chunk, size_t lineNumberOffset)
+{
+    SimpleScanner scanner;
+    scanner.open(chunk.begin, chunk.end, filename, lineNumberOffset);
+    string token;
+
     while(scanner.getLine()){
 
         switch(scanner.peekChar()){
@@ -273,13 +450,13 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
         case 'v':
             scanner.moveForward();
             if(scanner.peekChar() == ' '){
-                readVertex();
+                readVertex(scanner, chunk);
             } else if(scanner.peekChar() == 'n'){
                 scanner.moveForward();
-                readNormal();
+                readNormal(scanner, chunk);
             } else if(scanner.peekChar() == 't'){
                 scanner.moveForward();
-                readTextureCoordinate();
+                readTextureCoordinate(scanner, chunk);
             } else {
                 scanner.throwEx("Unsupported directive");
             }
@@ -287,7 +464,7 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
             
         case 'f':
             scanner.moveForward();
-            readFace();
+            readFace(scanner, chunk);
             break;
 
         case 'l':
@@ -296,7 +473,7 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
         case 'm':
             if(scanner.checkStringAtCurrentPosition("mtllib ")){
                 scanner.readStringToEOL(token);
-                loadMaterialTemplateLibrary(token);
+                chunk.directives.emplace_back(Directive::MaterialLibrary, token, chunk.faces.size());
             } else {
                 scanner.readString(token);
                 scanner.throwEx(format("Unsupported directive '{0}'", token));
@@ -306,7 +483,7 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
         case 'u':
             if(scanner.checkStringAtCurrentPosition("usemtl")){
                 scanner.readStringToEOL(token);
-                readMaterial(token);
+                chunk.directives.emplace_back(Directive::UseMaterial, token, chunk.faces.size());
             } else {
                 scanner.readString(token);
                 scanner.throwEx(format("Unsupported directive '{0}'", token));
@@ -316,13 +493,13 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
         case 'o':
             scanner.moveForward();
             scanner.readString(token);
-            createNewNode(token);
+            chunk.directives.emplace_back(Directive::NewNode, token, chunk.faces.size());
             break;
 
         case 'g':
             scanner.moveForward();
             scanner.readString(token);
-            createNewNode(token);
+            chunk.directives.emplace_back(Directive::NewNode, token, chunk.faces.size());
             break;
 
         case 's':
@@ -339,23 +516,69 @@ SgNodePtr ObjSceneLoader::Impl::loadScene()
             break;
         }
     }
+}
 
-    checkAndAddCurrentNode();
 
-    normalizeNormals();
-    updateAmbientIntensities();
+void ObjSceneLoader::Impl::mergeVertexElements(vector<Chunk>& chunks)
+{
+    size_t numVertices = 0;
+    size_t numNormals = 0;
+    size_t numTexCoords = 0;
+    for(auto& chunk : chunks){
+        numVertices += chunk.vertices.size();
+        numNormals += chunk.normals.size();
+        numTexCoords += chunk.texCoords.size();
+    }
+    vertices->resize(numVertices);
+    normals->resize(numNormals);
+    texCoords->resize(numTexCoords);
+
+    auto vpos = vertices->begin();
+    auto npos = normals->begin();
+    auto tpos = texCoords->begin();
+    for(auto& chunk : chunks){
+        vpos = std::copy(chunk.vertices.begin(), chunk.vertices.end(), vpos);
+        npos = std::copy(chunk.normals.begin(), chunk.normals.end(), npos);
+        tpos = std::copy(chunk.texCoords.begin(), chunk.texCoords.end(), tpos);
+        chunk.vertices = vector<Vector3f>();
+        chunk.normals = vector<Vector3f>();
+        chunk.texCoords = vector<Vector2f>();
+    }
+}
 
-    SgNodePtr scene;
 
-    if(!group->empty()){
-        if(group->numChildren() == 1){
-            scene = group->child(0);
-        } else {
-            scene = group;
+void ObjSceneLoader::Impl::buildShapes(Chunk& chunk)
+{
+    size_t directiveIndex = 0;
+    size_t vertexIndexPos = 0;
+    size_t texCoordIndexPos = 0;
+    size_t normalIndexPos = 0;
+    const size_t numFaces = chunk.faces.size();
+    for(size_t i=0; i < numFaces; ++i){
+        applyDirectives(chunk, directiveIndex, i);
+        addFace(chunk, chunk.faces[i], vertexIndexPos, texCoordIndexPos, normalIndexPos);
+    }
+    applyDirectives(chunk, directiveIndex, numFaces);
+}
+
+
+void ObjSceneLoader::Impl::applyDirectives(Chunk& chunk, size_t& directiveIndex, size_t faceIndex)
+{
+    auto& directives = chunk.directives;
+    while(directiveIndex < directives.size() && directives[directiveIndex].faceIndex <= faceIndex){
+        auto& directive = directives[directiveIndex++];
+        switch(directive.type){
+        case Directive::NewNode:
+            createNewNode(directive.argument);
+            break;
+        case Directive::UseMaterial:
+            readMaterial(directive.argument);
+            break;
+        case Directive::MaterialLibrary:
+            loadMaterialTemplateLibrary(directive.argument);
+            break;
         }
     }
-    group.reset();
-    return scene.retn();
 }
 
 
@@ -437,118 +660,139 @@ bool ObjSceneLoader::Impl::checkAndAddCurrentNode()
 }
 
 
-void ObjSceneLoader::Impl::readVertex()
+void ObjSceneLoader::Impl::readVertex(SimpleScanner& scanner, Chunk& chunk)
 {
-    vertices->emplace_back();
+    chunk.vertices.emplace_back();
 
     if(!doCoordinateConversion){
-        readVector3Ex(scanner, vertices->back());
+        readVector3Ex(scanner, chunk.vertices.back());
     } else {
         if(upperAxis == Y_Upper){
-            readYUpVector3Ex(scanner, scale, vertices->back());
+            readYUpVector3Ex(scanner, scale, chunk.vertices.back());
         } else {
-            readVector3Ex(scanner, scale, vertices->back());
+            readVector3Ex(scanner, scale, chunk.vertices.back());
         }
     }
 }
 
 
-void ObjSceneLoader::Impl::readNormal()
+void ObjSceneLoader::Impl::readNormal(SimpleScanner& scanner, Chunk& chunk)
 {
-    normals->emplace_back();
+    chunk.normals.emplace_back();
 
     if(upperAxis == Z_Upper){        
-        readVector3Ex(scanner, normals->back());
+        readVector3Ex(scanner, chunk.normals.back());
     } else {
-        readYUpVector3Ex(scanner, normals->back());
+        readYUpVector3Ex(scanner, chunk.normals.back());
     }
 }
 
 
-void ObjSceneLoader::Impl::readTextureCoordinate()
+void ObjSceneLoader::Impl::readTextureCoordinate(SimpleScanner& scanner, Chunk& chunk)
 {
-    texCoords->emplace_back();
-    readVector2Ex(scanner, texCoords->back());
+    chunk.texCoords.emplace_back();
+    readVector2Ex(scanner, chunk.texCoords.back());
 }
 
 
-void ObjSceneLoader::Impl::readFace()
+void ObjSceneLoader::Impl::readFace(SimpleScanner& scanner, Chunk& chunk)
 {
-    int axis = 0;
-    while(true){
-        if(!readFaceElement(axis)){
-            break;
-        }
-        ++axis;
-    }
-    if(axis <= 2){
-        scanner.throwEx("The number of face elements is less than thrree");
+    FaceSize face;
+    face.numVertices = 0;
+    face.numTexCoords = 0;
+    face.numNormals = 0;
 
-    } else if(axis >= 4){
-        int index0 = currentVertexIndices->size() - axis;
-        polygon.resize(axis);
-        auto vpos = currentVertexIndices->begin() + index0;
-        std::copy(vpos, vpos + axis, polygon.begin());
-        int numTriangles = triangulator.apply(polygon);
-        const auto& triangles = triangulator.triangles();
-
-        bool needTofixNormalIndices =
-            currentVertexIndices->size() == currentNormalIndices->size();
-        bool needTofixTexCoordIndices =
-            currentVertexIndices->size() == currentTexCoordIndices->size();
-        
-        currentVertexIndices->resize(index0);
-        int localIndex = 0;
-        for(int i=0; i < numTriangles; ++i){
-            for(int j=0; j < 3; ++j){
-                currentVertexIndices->push_back(polygon[triangles[localIndex++]]);
-            }
-        }
-        if(needTofixNormalIndices){
-            auto npos = currentNormalIndices->begin() + index0;
-            std::copy(npos, npos + axis, polygon.begin());
-            currentNormalIndices->resize(index0);
-            int localIndex = 0;
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    currentNormalIndices->push_back(polygon[triangles[localIndex++]]);
-                }
+    int index;
+    while(scanner.readInt(index)){
+        chunk.vertexIndices.push_back(index - 1);
+        ++face.numVertices;
+        if(scanner.checkCharAtCurrentPosition('/')){
+            if(scanner.readInt(index)){
+                chunk.texCoordIndices.push_back(index - 1);
+                ++face.numTexCoords;
             }
-        }
-        if(needTofixTexCoordIndices){
-            auto npos = currentTexCoordIndices->begin() + index0;
-            std::copy(npos, npos + axis, polygon.begin());
-            currentTexCoordIndices->resize(index0);
-            int localIndex = 0;
-            for(int i=0; i < numTriangles; ++i){
-                for(int j=0; j < 3; ++j){
-                    currentTexCoordIndices->push_back(polygon[triangles[localIndex++]]);
-                }
+            if(scanner.checkCharAtCurrentPosition('/')){
+                chunk.normalIndices.push_back(scanner.readIntEx() - 1);
+                ++face.numNormals;
             }
         }
     }
+    if(face.numVertices <= 2){
+        scanner.throwEx("The number of face elements is less than thrree");
+    }
+
+    chunk.faces.push_back(face);
 }
 
 
-bool ObjSceneLoader::Impl::readFaceElement(int axis)
+void ObjSceneLoader::Impl::addFace
+(Chunk& chunk, const FaceSize& face, size_t& vertexIndexPos, size_t& texCoordIndexPos, size_t& normalIndexPos)
 {
-    int index;
-    if(!scanner.readInt(index)){
-        return false;
+    auto vpos = chunk.vertexIndices.begin() + vertexIndexPos;
+    currentVertexIndices->insert(currentVertexIndices->end(), vpos, vpos + face.numVertices);
+    vertexIndexPos += face.numVertices;
+
+    if(face.numTexCoords > 0){
+        auto tpos = chunk.texCoordIndices.begin() + texCoordIndexPos;
+        currentTexCoordIndices->insert(currentTexCoordIndices->end(), tpos, tpos + face.numTexCoords);
+        texCoordIndexPos += face.numTexCoords;
     }
-        
-    currentVertexIndices->push_back(index - 1);
+    if(face.numNormals > 0){
+        auto npos = chunk.normalIndices.begin() + normalIndexPos;
+        currentNormalIndices->insert(currentNormalIndices->end(), npos, npos + face.numNormals);
+        normalIndexPos += face.numNormals;
+    }
+
+    if(face.numVertices >= 4){
+        triangulateLastPolygon(face.numVertices);
+    }
+}
+
 
-    if(scanner.checkCharAtCurrentPosition('/')){
-        if(scanner.readInt(index)){
-            currentTexCoordIndices->push_back(index - 1);
+void ObjSceneLoader::Impl::triangulateLastPolygon(int numPolygonVertices)
+{
+    int axis = numPolygonVertices;
+    int index0 = currentVertexIndices->size() - axis;
+    polygon.resize(axis);
+    auto vpos = currentVertexIndices->begin() + index0;
+    std::copy(vpos, vpos + axis, polygon.begin());
+    int numTriangles = triangulator.apply(polygon);
+    const auto& triangles = triangulator.triangles();
+
+    bool needTofixNormalIndices =
+        currentVertexIndices->size() == currentNormalIndices->size();
+    bool needTofixTexCoordIndices =
+        currentVertexIndices->size() == currentTexCoordIndices->size();
+        
+    currentVertexIndices->resize(index0);
+    int localIndex = 0;
+    for(int i=0; i < numTriangles; ++i){
+        for(int j=0; j < 3; ++j){
+            currentVertexIndices->push_back(polygon[triangles[localIndex++]]);
         }
-        if(scanner.checkCharAtCurrentPosition('/')){
-            currentNormalIndices->push_back(scanner.readIntEx() - 1);
+    }
+    if(needTofixNormalIndices){
+        auto npos = currentNormalIndices->begin() + index0;
+        std::copy(npos, npos + axis, polygon.begin());
+        currentNormalIndices->resize(index0);
+        int localIndex = 0;
+        for(int i=0; i < numTriangles; ++i){
+            for(int j=0; j < 3; ++j){
+                currentNormalIndices->push_back(polygon[triangles[localIndex++]]);
+            }
+        }
+    }
+    if(needTofixTexCoordIndices){
+        auto npos = currentTexCoordIndices->begin() + index0;
+        std::copy(npos, npos + axis, polygon.begin());
+        currentTexCoordIndices->resize(index0);
+        int localIndex = 0;
+        for(int i=0; i < numTriangles; ++i){
+            for(int j=0; j < 3; ++j){
+                currentTexCoordIndices->push_back(polygon[triangles[localIndex++]]);
+            }
         }
     }
-
-    return true;
 }
 
 
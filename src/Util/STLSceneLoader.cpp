@@ -6,6 +6,7 @@
 #include "SimpleScanner.h"
 #include "SceneDrawables.h"
 #include "SceneLoader.h"
+#include "MappedFile.h"
 #include "NullOut.h"
 #include "strtofloat.h"
 #include "UTF8.h"
@@ -14,6 +15,7 @@
 #include <thread>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
 #include "gettext.h"
 
 using namespace std;
@@ -106,8 +108,8 @@ public:
     void initializeArrays(size_t triangleOffset, size_t numTriangles);
     void addNormal(const Vector3f& normal);
     void addVertex(const Vector3f& vertex);
-    void load(ifstream& ifs, size_t triangleOffset, size_t numTriangles);
-    void loadConcurrently(const string& filename, size_t triangleOffset, size_t numTriangles);
+    void load(const char* data, size_t triangleOffset, size_t numTriangles);
+    void loadConcurrently(const char* data, size_t triangleOffset, size_t numTriangles);
 };
 
 class AsciiMeshLoader : public MeshLoader
@@ -155,9 +157,9 @@ public:
 
     Impl();
     SgNode* load(const string& filename);
-    SgMeshPtr loadBinaryFormat(const string& filename, ifstream& ifs, size_t numTriangles);
+    SgMeshPtr loadBinaryFormat(const string& filename, const char* data, size_t numTriangles);
     SgMeshPtr loadBinaryFormatConcurrently(
-        const string& filename, ifstream& ifs, size_t numTriangles, size_t numThreads, BinaryMeshLoader& mainLoader);
+        const char* data, size_t numTriangles, size_t numThreads, BinaryMeshLoader& mainLoader);
     SgMeshPtr loadAsciiFormat(const string& filename, pos_type fileSize);
     SgMeshPtr loadAsciiFormatConcurrently(
         const string& filename, AsciiMeshLoader& mainLoader, pos_type fileSize, size_t numThreads);
@@ -475,23 +477,23 @@ SgNode* STLSceneLoader::load(const std::string& filename)
 
 SgNode* STLSceneLoader::Impl::load(const string& filename)
 {
-    ifstream ifs(fromUTF8(filename).c_str(), std::ios::in | std::ios::binary);
-    if(!ifs.is_open()){
+    /*
+      The file is mapped into the memory so that the binary format can directly be read
+      from the mapped region by multiple threads without any intermediate buffers.
+    */
+    MappedFile file;
+    if(!file.open(filename)){
         os() << format(_("Unable to open file \"{}\"."), filename) << endl;
         return nullptr;
     }
-    
-    ifs.seekg(0, fstream::end);
-    pos_type fileSize = ifs.tellg();
-    ifs.seekg(0, fstream::beg);
 
+    size_t fileSize = file.size();
     bool isBinary = false;
     size_t numTriangles = 0;
-    uint8_t buf[STL_BINARY_HEADER_SIZE];
-    ifs.read((char*)buf, STL_BINARY_HEADER_SIZE);
-    if(ifs.gcount() == STL_BINARY_HEADER_SIZE){
-        numTriangles = buf[80] + (buf[81] << 8) + (buf[82] << 16) + (buf[83] << 24);
-        pos_type expectedSize = numTriangles * 50 + STL_BINARY_HEADER_SIZE;
+    if(fileSize >= STL_BINARY_HEADER_SIZE){
+        auto buf = reinterpret_cast<const uint8_t*>(file.data());
+        numTriangles = buf[80] + (buf[81] << 8) + (buf[82] << 16) + (size_t(buf[83]) << 24);
+        size_t expectedSize = numTriangles * 50 + STL_BINARY_HEADER_SIZE;
         if(expectedSize == fileSize){
             isBinary = true;
         }
@@ -499,13 +501,13 @@ SgNode* STLSceneLoader::Impl::load(const string& filename)
 
     SgMeshPtr mesh;
     if(isBinary){
-        mesh = loadBinaryFormat(filename, ifs, numTriangles);
+        mesh = loadBinaryFormat(filename, file.data(), numTriangles);
+        file.close();
     } else {
+        file.close();
         mesh = loadAsciiFormat(filename, fileSize);
     }
 
-    ifs.close();
-
     if(!mesh){
         return nullptr;
     }
@@ -518,7 +520,7 @@ SgNode* STLSceneLoader::Impl::load(const string& filename)
 }
 
 
-SgMeshPtr STLSceneLoader::Impl::loadBinaryFormat(const string& filename, ifstream& ifs, size_t numTriangles)
+SgMeshPtr STLSceneLoader::Impl::loadBinaryFormat(const string& filename, const char* data, size_t numTriangles)
 {
     if(numTriangles == 0){
         os() << format(_("No triangles in \"{1}\"."), filename) << endl;
@@ -531,28 +533,23 @@ SgMeshPtr STLSceneLoader::Impl::loadBinaryFormat(const string& filename, ifstrea
     
     BinaryMeshLoader mainLoader(numTriangles);
 
-    size_t numThreads = std::min(maxNumThreads, std::max(size_t(1), numTriangles / NumTrianglesPerThread));
-
     /**
-       The number of threads is limited to 4 at maximum because just increasing
-       the number of threds accessing the same file will slow down overall file
-       reading speed.
+       The number of threads is not limited to a small number here because the threads
+       share the mapped memory region and do not compete for the file stream access.
     */
-    if(numThreads > 4){
-        numThreads = 4;
-    }
+    size_t numThreads = std::min(maxNumThreads, std::max(size_t(1), numTriangles / NumTrianglesPerThread));
 
     if(numThreads == 1){
-        mainLoader.load(ifs, 0, numTriangles);
+        mainLoader.load(data, 0, numTriangles);
         return mainLoader.completeMesh(true);
     } else {
-        return loadBinaryFormatConcurrently(filename, ifs, numTriangles, numThreads, mainLoader);
+        return loadBinaryFormatConcurrently(data, numTriangles, numThreads, mainLoader);
     }
 }
 
 
 SgMeshPtr STLSceneLoader::Impl::loadBinaryFormatConcurrently
-(const string& filename, ifstream& ifs, size_t numTriangles, size_t numThreads, BinaryMeshLoader& mainLoader)
+(const char* data, size_t numTriangles, size_t numThreads, BinaryMeshLoader& mainLoader)
 {
     vector<BinaryMeshLoader> loaders(numThreads, mainLoader);
     
@@ -560,11 +557,11 @@ SgMeshPtr STLSceneLoader::Impl::loadBinaryFormatConcurrently
     size_t triangleOffset = 0;
     size_t numTrianglesPerThread = numTriangles / numThreads;
     while(index < numThreads - 1){
-        loaders[index].loadConcurrently(filename, triangleOffset, numTrianglesPerThread);
+        loaders[index].loadConcurrently(data, triangleOffset, numTrianglesPerThread);
         ++index;
         triangleOffset += numTrianglesPerThread;
     }
-    loaders[index].load(ifs, triangleOffset, numTriangles - triangleOffset);
+    loaders[index].load(data, triangleOffset, numTriangles - triangleOffset);
 
     for(auto& loader : loaders){
         loader.join();
@@ -613,40 +610,31 @@ void BinaryMeshLoader::addVertex(const Vector3f& vertex)
 }
 
 
-void BinaryMeshLoader::load(ifstream& ifs, size_t triangleOffset, size_t numTriangles)
+void BinaryMeshLoader::load(const char* data, size_t triangleOffset, size_t numTriangles)
 {
-    ifs.seekg(STL_BINARY_HEADER_SIZE + triangleOffset * 50);
-
-    /**
-       Buffer size can be specified by the following code.
-       It is currently disabled becasue it does not especially obtain a better result
-       on both Ubuntu 18.04 + GCC 8.3.0 and Visual C++ 2017.
-    */
-    /*
-    vector<char> buf(1 * 1024 * 1024);
-    ifs.rdbuf()->pubsetbuf(&buf.front(), buf.size());
-    */
-    
     initializeArrays(triangleOffset, numTriangles);
 
     const size_t datasize = sizeof(float) * 3 * 4 + 2;
-    char data[datasize];
+    const char* p = data + STL_BINARY_HEADER_SIZE + triangleOffset * datasize;
+    
+    // The records are not aligned to the float size in the file image
+    float v[12];
     for(size_t i = 0; i < numTriangles; ++i){
-        ifs.read(data, datasize);
-        addNormal(Vector3f(reinterpret_cast<float*>(data)));
-        addVertex(Vector3f(reinterpret_cast<float*>(&data[12])));
-        addVertex(Vector3f(reinterpret_cast<float*>(&data[24])));
-        addVertex(Vector3f(reinterpret_cast<float*>(&data[36])));
+        std::memcpy(v, p, sizeof(v));
+        addNormal(Vector3f(v));
+        addVertex(Vector3f(&v[3]));
+        addVertex(Vector3f(&v[6]));
+        addVertex(Vector3f(&v[9]));
+        p += datasize;
     }
 }
 
 
-void BinaryMeshLoader::loadConcurrently(const string& filename, size_t triangleOffset, size_t numTriangles)
+void BinaryMeshLoader::loadConcurrently(const char* data, size_t triangleOffset, size_t numTriangles)
 {
     loaderThread = thread(
-        [this, filename, triangleOffset, numTriangles](){
-            ifstream ifs(filename.c_str(), std::ios::in | std::ios::binary);
-            load(ifs, triangleOffset, numTriangles);
+        [this, data, triangleOffset, numTriangles](){
+            load(data, triangleOffset, numTriangles);
         });
 }
 
@@ -8,6 +8,7 @@
 #include <unordered_map>
 #include <typeindex>
 #include <mutex>
+#include <atomic>
 
 using namespace std;
 using namespace cnoid;
@@ -22,6 +23,103 @@ CloneMap::FlagId DisableMetaSceneCloning("SgObjectDisableMetaSceneCloning");
 
 const BoundingBox emptyBoundingBox;
 
+struct UpdateBatchRecord
+{
+    SgObject* object;
+    // Keeps the object alive until the commit if it is owned by some reference
+    SgObjectPtr holder;
+    int action;
+    bool isBoundingBoxInvalidated;
+    // True if the object itself has been modified
+    bool isModified;
+};
+
+struct UpdateBatchState
+{
+    int depth;
+    vector<UpdateBatchRecord> records;
+    unordered_map<SgObject*, int> recordIndexMap;
+    UpdateBatchState() : depth(0) { }
+};
+
+thread_local UpdateBatchState updateBatchState;
+
+struct UpdateBatchNotification
+{
+    int recordIndex;
+    SgUpdate::Path path;
+};
+
+/*
+  Collects the notifications from a modified object to its ancestors recorded in the batch
+  in the order in which notifyUpperNodesOfUpdate delivers them.
+*/
+void collectUpdateBatchNotifications
+(const vector<UpdateBatchRecord>& records, const unordered_map<SgObject*, int>& recordIndexMap,
+ int index, SgUpdate::Path& path, vector<UpdateBatchNotification>& notifications)
+{
+    auto object = records[index].object;
+    path.push_back(object);
+    notifications.push_back({ index, path });
+    for(auto p = object->parentBegin(); p != object->parentEnd(); ++p){
+        auto q = recordIndexMap.find(*p);
+        if(q != recordIndexMap.end()){
+            collectUpdateBatchNotifications(records, recordIndexMap, q->second, path, notifications);
+        }
+    }
+    path.pop_back();
+}
+
+/*
+  The child bounding boxes of a group are cached in a binary tree when the group has this
+  number of children or more so that the recomputation of the group bounding box only
+  visits the updated children and their ancestors in the tree.
+*/
+constexpr int MinNumChildrenToCacheChildBoundingBoxes = 32;
+
+std::atomic<long> numFullBoundingBoxUpdates(0);
+std::atomic<long> numIncrementalBoundingBoxUpdates(0);
+std::atomic<long> numVisitedChildBoundingBoxes(0);
+
+}
+
+namespace cnoid {
+
+class SgGroup::ChildBoundingBoxCache
+{
+public:
+    bool isValid;
+    int leafOffset;
+    // The leaves begin at leafOffset and the root is the element 1
+    vector<BoundingBox> nodes;
+    // A child contained more than once is mapped to -1
+    unordered_map<SgNode*, int> childIndexMap;
+    vector<int> updatedChildIndices;
+    vector<bool> updatedChildFlags;
+
+    ChildBoundingBoxCache() : isValid(false), leafOffset(0) { }
+    void rebuild(const SgGroup::Container& children);
+    void updateLeaf(int index, const SgNode* child){
+        auto& leaf = nodes[leafOffset + index];
+        if(child->hasAttribute(SgObject::Marker)){
+            leaf.clear();
+        } else {
+            leaf = child->boundingBox();
+        }
+    }
+    void updateInnerNode(int index){
+        auto& node = nodes[index];
+        node = nodes[index * 2];
+        node.expandBy(nodes[index * 2 + 1]);
+    }
+    void clearUpdatedChildren(){
+        for(auto& index : updatedChildIndices){
+            updatedChildFlags[index] = false;
+        }
+        updatedChildIndices.clear();
+    }
+};
+
 }
 
 
@@ -29,12 +127,14 @@ SgObject::SgObject()
 {
     attributes_ = 0;
     hasValidBoundingBoxCache_ = false;
+    isBoundingBoxPartiallyInvalidated_ = false;
 }
 
 
 SgObject::SgObject(const SgObject& org)
     : attributes_(org.attributes_),
       hasValidBoundingBoxCache_(false),
+      isBoundingBoxPartiallyInvalidated_(false),
       name_(org.name_)
 {
     if(org.uriInfo){
@@ -93,9 +193,21 @@ void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update)
 
 void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBoundingBox)
 {
+    /*
+      An object which is not owned by any reference yet is excluded from the batch
+      because the reference kept in the batch would delete the object at the commit.
+    */
+    if(updateBatchState.depth > 0 && refCount() > 0 &&
+       !update.hasAction(SgUpdate::Added | SgUpdate::Removed)){
+        SgUpdateBatch::addUpdate(this, nullptr, update.action(), doInvalidateBoundingBox);
+        return;
+    }
+    
+    auto& path = update.path();
+    SgObject* child = path.empty() ? nullptr : path.back();
     update.pushNode(this);
     if(doInvalidateBoundingBox){
-        invalidateBoundingBox();
+        invalidateBoundingBoxThroughChild(child);
     }
     sigUpdated_(update);
     for(const_parentIter p = parents.begin(); p != parents.end(); ++p){
@@ -105,6 +217,149 @@ void SgObject::notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBound
 }
 
 
+void SgObject::invalidateBoundingBoxThroughChild(SgObject* child)
+{
+    if(child && isGroupNode() && child->isNode()){
+        static_cast<SgGroup*>(this)->invalidateChildBoundingBox(static_cast<SgNode*>(child));
+    } else {
+        invalidateBoundingBox();
+    }
+}
+
+
+SgUpdateBatch::SgUpdateBatch(bool doBegin)
+{
+    isBegun_ = false;
+    if(doBegin){
+        begin();
+    }
+}
+
+
+SgUpdateBatch::~SgUpdateBatch()
+{
+    commit();
+}
+
+
+void SgUpdateBatch::begin()
+{
+    if(!isBegun_){
+        ++updateBatchState.depth;
+        isBegun_ = true;
+    }
+}
+
+
+bool SgUpdateBatch::isActive()
+{
+    return updateBatchState.depth > 0;
+}
+
+
+void SgUpdateBatch::addUpdate(SgObject* object, SgObject* child, int action, bool doInvalidateBoundingBox)
+{
+    auto& state = updateBatchState;
+
+    while(true){
+        int index;
+        auto inserted = state.recordIndexMap.emplace(object, static_cast<int>(state.records.size()));
+        if(inserted.second){
+            index = inserted.first->second;
+            state.records.push_back(
+                { object, (object->refCount() > 0) ? object : nullptr, action, false, !child });
+        } else {
+            index = inserted.first->second;
+            auto& record = state.records[index];
+            if(!child){
+                record.isModified = true;
+            }
+            bool hasNewActions = (action & ~record.action);
+            bool hasNewInvalidation = doInvalidateBoundingBox && !record.isBoundingBoxInvalidated;
+            if(doInvalidateBoundingBox && !hasNewInvalidation){
+                /*
+                  The update through another child must also be recorded in the object, and
+                  the invalidation must be propagated again if the bounding box has been
+                  recomputed after the previous invalidation.
+                */
+                hasNewInvalidation = object->hasValidBoundingBoxCache();
+                object->invalidateBoundingBoxThroughChild(child);
+            }
+            if(!hasNewActions && !hasNewInvalidation){
+                // The update has already been propagated to the ancestors
+                return;
+            }
+            record.action |= action;
+        }
+        if(doInvalidateBoundingBox){
+            object->invalidateBoundingBoxThroughChild(child);
+            state.records[index].isBoundingBoxInvalidated = true;
+        }
+
+        auto& parents = object->parents;
+        if(parents.empty()){
+            break;
+        }
+        // Only the first parent is traced in this loop to avoid recursion in the common case
+        auto p = parents.begin();
+        for(++p; p != parents.end(); ++p){
+            SgObject* parent = *p;
+            addUpdate(parent, object, action, doInvalidateBoundingBox);
+        }
+        child = object;
+        object = *parents.begin();
+    }
+}
+
+
+void SgUpdateBatch::commit()
+{
+    if(!isBegun_){
+        return;
+    }
+    isBegun_ = false;
+
+    auto& state = updateBatchState;
+    if(--state.depth > 0){
+        return;
+    }
+    if(state.records.empty()){
+        return;
+    }
+
+    // The records are moved out so that the updates caused by the signal handlers are processed normally
+    vector<UpdateBatchRecord> records;
+    records.swap(state.records);
+    unordered_map<SgObject*, int> recordIndexMap;
+    recordIndexMap.swap(state.recordIndexMap);
+
+    /*
+      The notifications are collected before any signal is emitted because the signal handlers
+      may modify the scene graph. Each object is notified once for each distinct path from the
+      modified objects so that the listeners using the path do not miss any modified object.
+    */
+    vector<UpdateBatchNotification> notifications;
+    SgUpdate::Path path;
+    const int numRecords = records.size();
+    for(int i=0; i < numRecords; ++i){
+        if(records[i].isModified){
+            collectUpdateBatchNotifications(records, recordIndexMap, i, path, notifications);
+        }
+    }
+
+    SgUpdate update;
+    for(auto& notification : notifications){
+        auto& record = records[notification.recordIndex];
+        update.clearPath();
+        for(auto& object : notification.path){
+            update.pushNode(object);
+        }
+        update.setAction(record.action);
+        record.object->emitSigUpdated(update);
+    }
+}
+
+
 void SgObject::addParent(SgObject* parent, SgUpdateRef update)
 {
     parents.insert(parent);
@@ -397,6 +652,7 @@ SgGroup::SgGroup()
     : SgNode(findClassId<SgGroup>())
 {
     setAttribute(GroupNode);
+    childBboxCache = nullptr;
 }
 
 
@@ -404,12 +660,15 @@ SgGroup::SgGroup(int classId)
     : SgNode(classId)
 {
     setAttribute(GroupNode);
+    childBboxCache = nullptr;
 }
 
 
 SgGroup::SgGroup(const SgGroup& org, CloneMap* cloneMap)
     : SgNode(org)
 {
+    childBboxCache = nullptr;
+
     children.reserve(org.numChildren());
 
     if(cloneMap){
@@ -448,6 +707,7 @@ SgGroup::~SgGroup()
     for(const_iterator p = begin(); p != end(); ++p){
         (*p)->removeParent(this);
     }
+    delete childBboxCache;
 }
 
 
@@ -474,19 +734,150 @@ const BoundingBox& SgGroup::boundingBox() const
     if(hasValidBoundingBoxCache()){
         return bboxCache;
     }
-    bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy(node->boundingBox());
-        }
-    }
+    calcUnionOfChildBoundingBoxes(bboxCache);
     setBoundingBoxCacheReady();
 
     return bboxCache;
 }
 
 
+void SgGroup::calcUnionOfChildBoundingBoxes(BoundingBox& out_bbox) const
+{
+    const int n = children.size();
+
+    if(n < MinNumChildrenToCacheChildBoundingBoxes){
+        if(childBboxCache){
+            delete childBboxCache;
+            childBboxCache = nullptr;
+        }
+        out_bbox.clear();
+        for(auto& node : children){
+            if(!node->hasAttribute(Marker)){
+                out_bbox.expandBy(node->boundingBox());
+            }
+        }
+        numFullBoundingBoxUpdates.fetch_add(1, std::memory_order_relaxed);
+        numVisitedChildBoundingBoxes.fetch_add(n, std::memory_order_relaxed);
+        return;
+    }
+
+    if(!childBboxCache){
+        childBboxCache = new ChildBoundingBoxCache;
+    }
+    auto& cache = *childBboxCache;
+    
+    bool isIncremental = false;
+    if(cache.isValid && isBoundingBoxPartiallyInvalidated()){
+        // Each updated child requires the update of the tree nodes from the leaf to the root
+        int depth = 1;
+        while((1 << depth) < cache.leafOffset){
+            ++depth;
+        }
+        isIncremental = (static_cast<int>(cache.updatedChildIndices.size()) * depth < n);
+    }
+
+    if(isIncremental){
+        for(auto& index : cache.updatedChildIndices){
+            cache.updateLeaf(index, children[index]);
+            int node = (cache.leafOffset + index) / 2;
+            while(node > 0){
+                cache.updateInnerNode(node);
+                node /= 2;
+            }
+        }
+        numIncrementalBoundingBoxUpdates.fetch_add(1, std::memory_order_relaxed);
+        numVisitedChildBoundingBoxes.fetch_add(
+            cache.updatedChildIndices.size(), std::memory_order_relaxed);
+    } else {
+        if(!cache.isValid){
+            cache.rebuild(children);
+        }
+        for(int i=0; i < n; ++i){
+            cache.updateLeaf(i, children[i]);
+        }
+        for(int i = cache.leafOffset - 1; i > 0; --i){
+            cache.updateInnerNode(i);
+        }
+        numFullBoundingBoxUpdates.fetch_add(1, std::memory_order_relaxed);
+        numVisitedChildBoundingBoxes.fetch_add(n, std::memory_order_relaxed);
+    }
+    cache.clearUpdatedChildren();
+
+    out_bbox = cache.nodes[1];
+}
+
+
+void SgGroup::ChildBoundingBoxCache::rebuild(const SgGroup::Container& children)
+{
+    const int n = children.size();
+    leafOffset = 1;
+    while(leafOffset < n){
+        leafOffset *= 2;
+    }
+    nodes.clear();
+    nodes.resize(leafOffset * 2);
+
+    childIndexMap.clear();
+    childIndexMap.reserve(n);
+    for(int i=0; i < n; ++i){
+        auto inserted = childIndexMap.emplace(children[i].get(), i);
+        if(!inserted.second){
+            inserted.first->second = -1;
+        }
+    }
+    updatedChildIndices.clear();
+    updatedChildFlags.assign(n, false);
+    
+    isValid = true;
+}
+
+
+void SgGroup::invalidateChildBoundingBox(SgNode* child)
+{
+    if(childBboxCache && childBboxCache->isValid &&
+       (hasValidBoundingBoxCache() || isBoundingBoxPartiallyInvalidated())){
+        auto& cache = *childBboxCache;
+        auto p = cache.childIndexMap.find(child);
+        if(p != cache.childIndexMap.end() && p->second >= 0){
+            int index = p->second;
+            if(!cache.updatedChildFlags[index]){
+                cache.updatedChildFlags[index] = true;
+                cache.updatedChildIndices.push_back(index);
+            }
+            invalidateBoundingBoxPartially();
+            return;
+        }
+    }
+    invalidateBoundingBox();
+}
+
+
+void SgGroup::invalidateChildBoundingBoxCache()
+{
+    if(childBboxCache){
+        childBboxCache->isValid = false;
+    }
+}
+
+
+SgGroup::BoundingBoxStatistics SgGroup::boundingBoxStatistics()
+{
+    BoundingBoxStatistics statistics;
+    statistics.numFullUpdates = numFullBoundingBoxUpdates.load(std::memory_order_relaxed);
+    statistics.numIncrementalUpdates = numIncrementalBoundingBoxUpdates.load(std::memory_order_relaxed);
+    statistics.numVisitedChildren = numVisitedChildBoundingBoxes.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+
+void SgGroup::resetBoundingBoxStatistics()
+{
+    numFullBoundingBoxUpdates = 0;
+    numIncrementalBoundingBoxUpdates = 0;
+    numVisitedChildBoundingBoxes = 0;
+}
+
+
 bool SgGroup::contains(SgNode* node) const
 {
     for(const_iterator p = begin(); p != end(); ++p){
@@ -509,10 +900,18 @@ int SgGroup::findChildIndex(SgNode* child) const
 }
 
 
+SgGroup::iterator SgGroup::erase(iterator pos)
+{
+    invalidateChildBoundingBoxCache();
+    return children.erase(pos);
+}
+
+
 void SgGroup::addChild(SgNode* node, SgUpdateRef update)
 {
     if(node){
         children.push_back(node);
+        invalidateChildBoundingBoxCache();
         node->addParent(this, update);
     }
 }
@@ -535,6 +934,7 @@ void SgGroup::insertChild(int index, SgNode* node, SgUpdateRef update)
             index = children.size();
         }
         children.insert(children.begin() + index, node);
+        invalidateChildBoundingBoxCache();
 
         node->addParent(this, update);
     }
@@ -580,9 +980,11 @@ SgGroup::iterator SgGroup::removeChild(iterator childIter, SgUpdateRef update)
     
     if(!update){
         next = children.erase(childIter);
+        invalidateChildBoundingBoxCache();
     } else {
         SgNodePtr childHolder = child;
         next = children.erase(childIter);
+        invalidateChildBoundingBoxCache();
         update->clearPath();
         update->pushNode(child);
         notifyUpperNodesOfUpdate(
@@ -793,13 +1195,7 @@ const BoundingBox& SgPosTransform::boundingBox() const
     if(hasValidBoundingBoxCache()){
         return bboxCache;
     }
-    bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy(node->boundingBox());
-        }
-    }
+    calcUnionOfChildBoundingBoxes(bboxCache);
     untransformedBboxCache = bboxCache;
     bboxCache.transform(T_);
     setBoundingBoxCacheReady();
@@ -862,13 +1258,7 @@ const BoundingBox& SgScaleTransform::boundingBox() const
     if(hasValidBoundingBoxCache()){
         return bboxCache;
     }
-    bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy(node->boundingBox());
-        }
-    }
+    calcUnionOfChildBoundingBoxes(bboxCache);
     untransformedBboxCache = bboxCache;
     bboxCache.transform(Affine3(scale_.asDiagonal()));
     setBoundingBoxCacheReady();
@@ -924,13 +1314,7 @@ const BoundingBox& SgAffineTransform::boundingBox() const
     if(hasValidBoundingBoxCache()){
         return bboxCache;
     }
-    bboxCache.clear();
-    for(const_iterator p = begin(); p != end(); ++p){
-        auto& node = *p;
-        if(!node->hasAttribute(Marker)){
-            bboxCache.expandBy((*p)->boundingBox());
-        }
-    }
+    calcUnionOfChildBoundingBoxes(bboxCache);
     untransformedBboxCache = bboxCache;
     bboxCache.transform(T_);
     setBoundingBoxCacheReady();
@@ -1096,6 +1480,116 @@ Referenced* SgUnpickableGroup::doClone(CloneMap* cloneMap) const
 }
 
 
+SgDeferredGroup::SgDeferredGroup()
+    : SgGroup(findClassId<SgDeferredGroup>())
+{
+
+}
+
+
+SgDeferredGroup::SgDeferredGroup(const SgDeferredGroup& org, CloneMap* cloneMap)
+    : SgGroup(org, cloneMap),
+      boundingBoxHint(org.boundingBoxHint)
+{
+    if(org.materializationFunction){
+        if(!cloneMap){
+            materializationFunction = org.materializationFunction;
+        } else {
+            /*
+              The materialization function may return a node shared with the original
+              deferred node, so the node is cloned for the clone of the deferred node.
+            */
+            bool isNonNodeCloningEnabled = checkNonNodeCloning(*cloneMap);
+            materializationFunction =
+                [func = org.materializationFunction, isNonNodeCloningEnabled]() -> SgNode* {
+                    SgNodePtr node = func();
+                    if(node){
+                        CloneMap cloneMap;
+                        setNonNodeCloning(cloneMap, isNonNodeCloningEnabled);
+                        node = node->cloneNode(cloneMap);
+                    }
+                    return node.retn();
+                };
+        }
+    }
+}
+
+
+Referenced* SgDeferredGroup::doClone(CloneMap* cloneMap) const
+{
+    return new SgDeferredGroup(*this, cloneMap);
+}
+
+
+void SgDeferredGroup::setMaterializationFunction(std::function<SgNode*()> func)
+{
+    materializationFunction = func;
+}
+
+
+bool SgDeferredGroup::materialize(SgUpdateRef update)
+{
+    if(!materializationFunction){
+        return false;
+    }
+    auto func = std::move(materializationFunction);
+    materializationFunction = nullptr;
+
+    SgNodePtr node = func();
+    if(!node){
+        return false;
+    }
+    invalidateBoundingBox();
+    addChild(node, update);
+    return true;
+}
+
+
+const BoundingBox& SgDeferredGroup::boundingBox() const
+{
+    if(materializationFunction){
+        return boundingBoxHint;
+    }
+    return SgGroup::boundingBox();
+}
+
+
+int SgDeferredGroup::materializeSubTree(SgNode* node, SgUpdateRef update)
+{
+    int numMaterialized = 0;
+    if(auto group = node->toGroupNode()){
+        if(auto deferred = dynamic_cast<SgDeferredGroup*>(group)){
+            if(deferred->materialize(update)){
+                ++numMaterialized;
+            }
+        }
+        for(auto& child : *group){
+            numMaterialized += materializeSubTree(child, update);
+        }
+    }
+    return numMaterialized;
+}
+
+
+bool SgDeferredGroup::hasDeferredNodes(const SgNode* node)
+{
+    if(node->isGroupNode()){
+        auto group = static_cast<const SgGroup*>(node);
+        if(auto deferred = dynamic_cast<const SgDeferredGroup*>(group)){
+            if(!deferred->isMaterialized()){
+                return true;
+            }
+        }
+        for(auto& child : *group){
+            if(hasDeferredNodes(child)){
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+
 SgPreprocessed::SgPreprocessed(int classId)
     : SgNode(classId)
 {
@@ -1125,6 +1619,7 @@ struct NodeClassRegistration {
             .registerClass<SgFixedPixelSizeGroup, SgGroup>("SgFixedPixelSizeGroup")
             .registerClass<SgSwitchableGroup, SgGroup>("SgSwitchableGroup")
             .registerClass<SgUnpickableGroup, SgGroup>("SgUnpickableGroup")
+            .registerClass<SgDeferredGroup, SgGroup>("SgDeferredGroup")
             .registerClass<SgPreprocessed, SgNode>("SgPreprocessed");
     }
 } registration;
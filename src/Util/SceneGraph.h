@@ -9,6 +9,7 @@
 #include <vector>
 #include <set>
 #include <memory>
+#include <functional>
 #include "exportdecl.h"
 
 namespace cnoid {
@@ -113,8 +114,14 @@ public:
     }
 
     bool hasValidBoundingBoxCache() const { return hasValidBoundingBoxCache_; }
-    void invalidateBoundingBox() { hasValidBoundingBoxCache_ = false; }
-    void setBoundingBoxCacheReady() const { hasValidBoundingBoxCache_ = true; }
+    void invalidateBoundingBox() {
+        hasValidBoundingBoxCache_ = false;
+        isBoundingBoxPartiallyInvalidated_ = false;
+    }
+    void setBoundingBoxCacheReady() const {
+        hasValidBoundingBoxCache_ = true;
+        isBoundingBoxPartiallyInvalidated_ = false;
+    }
 
     bool hasUri() const { return uriInfo && !uriInfo->uri.empty(); }
     const std::string& uri() const;
@@ -150,10 +157,26 @@ protected:
     virtual Referenced* doClone(CloneMap* cloneMap) const override;
     void notifyUpperNodesOfUpdate(SgUpdate& update);
     void notifyUpperNodesOfUpdate(SgUpdate& update, bool doInvalidateBoundingBox);
+
+    /**
+       The bounding box is invalidated with this function when the cached bounding boxes of
+       the sub objects are still valid except for the ones recorded by the derived class.
+    */
+    void invalidateBoundingBoxPartially() {
+        if(hasValidBoundingBoxCache_){
+            hasValidBoundingBoxCache_ = false;
+            isBoundingBoxPartiallyInvalidated_ = true;
+        }
+    }
+    bool isBoundingBoxPartiallyInvalidated() const { return isBoundingBoxPartiallyInvalidated_; }
             
 private:
+    void emitSigUpdated(const SgUpdate& update) { sigUpdated_(update); }
+    void invalidateBoundingBoxThroughChild(SgObject* child);
+    
     unsigned short attributes_;
     mutable bool hasValidBoundingBoxCache_;
+    mutable bool isBoundingBoxPartiallyInvalidated_;
     ParentContainer parents;
     Signal<void(const SgUpdate& update)> sigUpdated_;
     Signal<void(bool on)> sigGraphConnection_;
@@ -167,11 +190,47 @@ private:
     };
     
     mutable std::unique_ptr<UriInfo> uriInfo;
+
+    friend class SgUpdateBatch;
 };
 
 typedef ref_ptr<SgObject> SgObjectPtr;
 
 
+/**
+   The update notifications of the scene objects are coalesced while an object of this class
+   is active in the current thread. When the outermost batch is committed, each modified object
+   and each of its ancestors emits sigUpdated once for each distinct path from the modified
+   objects with the actions accumulated in the batch.
+   Bounding box caches are invalidated without waiting for the commit.
+   Notifications with the Added or Removed action are not batched and are delivered immediately
+   because their paths are used to identify the added or removed nodes.
+*/
+class CNOID_EXPORT SgUpdateBatch
+{
+public:
+    SgUpdateBatch(bool doBegin = true);
+    SgUpdateBatch(const SgUpdateBatch&) = delete;
+    ~SgUpdateBatch();
+
+    SgUpdateBatch& operator=(const SgUpdateBatch&) = delete;
+
+    void begin();
+    void commit();
+    bool isBegun() const { return isBegun_; }
+    
+    //! Returns true if a batch is active in the current thread.
+    static bool isActive();
+
+private:
+    bool isBegun_;
+
+    static void addUpdate(SgObject* object, SgObject* child, int action, bool doInvalidateBoundingBox);
+    
+    friend class SgObject;
+};
+
+
 class CNOID_EXPORT SgNode : public SgObject
 {
 public:
@@ -267,7 +326,7 @@ public:
     const_reverse_iterator rbegin() const { return children.rbegin(); }
     const_reverse_iterator rend() const { return children.rend(); }
 
-    iterator erase(iterator pos) { return children.erase(pos); }
+    iterator erase(iterator pos);
 
     bool empty() const { return children.empty(); }
     int numChildren() const { return static_cast<int>(children.size()); }
@@ -304,6 +363,29 @@ public:
     void insertChainedGroup(SgGroup* group, SgUpdateRef update = nullptr);
     void removeChainedGroup(SgGroup* group, SgUpdateRef update = nullptr);
 
+    /**
+       This function invalidates the bounding box of the group with the information that
+       only the bounding box of the specified child has been changed. A group with many
+       children keeps the bounding boxes of the children, and only the bounding boxes of
+       the children specified with this function are updated in the next recomputation.
+       This function is called in the update notification of the child.
+    */
+    void invalidateChildBoundingBox(SgNode* child);
+
+    struct BoundingBoxStatistics
+    {
+        //! The number of the recomputations of the group bounding boxes that visit all the children
+        long numFullUpdates;
+        //! The number of the recomputations only visiting the children whose bounding boxes are updated
+        long numIncrementalUpdates;
+        //! The total number of the child bounding boxes visited in the recomputations
+        long numVisitedChildren;
+    };
+
+    //! The statistics are accumulated over all the groups since the program started or the last reset.
+    static BoundingBoxStatistics boundingBoxStatistics();
+    static void resetBoundingBoxStatistics();
+
     template<class NodeType> NodeType* findNodeOfType(int depth = -1) {
         for(int i=0; i < numChildren(); ++i){
             if(NodeType* node = dynamic_cast<NodeType*>(child(i))) return node;
@@ -324,10 +406,15 @@ public:
 protected:
     SgGroup(int classId);
     virtual Referenced* doClone(CloneMap* cloneMap) const override;
+    void calcUnionOfChildBoundingBoxes(BoundingBox& out_bbox) const;
     mutable BoundingBox bboxCache;
 
 private:
     Container children;
+    class ChildBoundingBoxCache;
+    mutable ChildBoundingBoxCache* childBboxCache;
+    
+    void invalidateChildBoundingBoxCache();
     static void throwTypeMismatchError();
 };
 
@@ -611,6 +698,43 @@ protected:
 typedef ref_ptr<SgUnpickableGroup> SgUnpickableGroupPtr;
 
 
+/**
+   This node is a placeholder of a sub scene whose actual contents are created only when
+   they are needed. The function given by setMaterializationFunction is called when the
+   materialize function is executed and the returned node is added as the child.
+   The bounding box hint is returned as the bounding box until the node is materialized.
+   It must enclose the contents to be created because a scene renderer culls the node with it,
+   and it should be left empty if it is unknown. A scene renderer materializes the node after
+   the rendering in which the node is visible, or is visited if it does not have the hint.
+*/
+class CNOID_EXPORT SgDeferredGroup : public SgGroup
+{
+public:
+    SgDeferredGroup();
+    SgDeferredGroup(const SgDeferredGroup& org, CloneMap* cloneMap = nullptr);
+
+    void setMaterializationFunction(std::function<SgNode*()> func);
+    bool isMaterialized() const { return !materializationFunction; }
+    bool materialize(SgUpdateRef update = nullptr);
+
+    void setBoundingBoxHint(const BoundingBox& bbox) { boundingBoxHint = bbox; }
+    virtual const BoundingBox& boundingBox() const override;
+
+    //! \return The number of the materialized nodes
+    static int materializeSubTree(SgNode* node, SgUpdateRef update = nullptr);
+    static bool hasDeferredNodes(const SgNode* node);
+
+protected:
+    virtual Referenced* doClone(CloneMap* cloneMap) const override;
+
+private:
+    std::function<SgNode*()> materializationFunction;
+    BoundingBox boundingBoxHint;
+};
+
+typedef ref_ptr<SgDeferredGroup> SgDeferredGroupPtr;
+
+
 class CNOID_EXPORT SgPreprocessed : public SgNode
 {
 protected:
@@ -83,6 +83,7 @@ public:
     bool builtinFlagToUpdatePreprocessedNodeTree;
     bool* pFlagToUpdatePreprocessedNodeTree;
     PreproNodeInfoPtr preproNodeTree;
+    unsigned int preproNodeTreeRevision;
     PolymorphicSceneNodeFunctionSet preproNodeFunctions;
     PreproNodeInfoPtr foundPreproNodeInfo;
     bool isPreproNodeFound;
@@ -164,6 +165,8 @@ public:
     std::mutex newExtensionMutex;
     vector<std::function<void(SceneRenderer* renderer)>> newExtendFunctions;
 
+    vector<SgDeferredGroupPtr> deferredGroupsToMaterialize;
+
     typedef stdx::variant<bool, int, double> PropertyValue;
     vector<PropertyValue> properties;
     
@@ -220,6 +223,7 @@ SceneRenderer::Impl::Impl(SceneRenderer* self)
 {
     builtinFlagToUpdatePreprocessedNodeTree = true;
     pFlagToUpdatePreprocessedNodeTree = &builtinFlagToUpdatePreprocessedNodeTree;
+    preproNodeTreeRevision = 0;
     initializePreproNodeFunctions();
 
     isCurrentCameraAutoRestorationMode = false;
@@ -276,6 +280,27 @@ void SceneRenderer::clearScene()
 void SceneRenderer::render()
 {
     doRender();
+
+    /*
+      The deferred groups are materialized after the traversal because the materialization
+      modifies the scene graph and notifies the update to the upper nodes.
+    */
+    if(!impl->deferredGroupsToMaterialize.empty()){
+        vector<SgDeferredGroupPtr> groups;
+        groups.swap(impl->deferredGroupsToMaterialize);
+        SgTmpUpdate update;
+        for(auto& group : groups){
+            group->materialize(update);
+        }
+    }
+}
+
+
+void SceneRenderer::requestDeferredGroupMaterialization(SgDeferredGroup* group)
+{
+    if(!group->isMaterialized()){
+        impl->deferredGroupsToMaterialize.push_back(group);
+    }
 }
 
 
@@ -340,6 +365,12 @@ void SceneRenderer::setFlagVariableToUpdatePreprocessedNodeTree(bool& flag)
 }
 
 
+unsigned int SceneRenderer::preprocessedNodeTreeRevision() const
+{
+    return impl->preproNodeTreeRevision;
+}
+
+
 void SceneRenderer::Impl::initializePreproNodeFunctions()
 {
     auto& funcs = preproNodeFunctions;
@@ -446,6 +477,7 @@ void SceneRenderer::Impl::extractPreproNodes()
     if(*pFlagToUpdatePreprocessedNodeTree){
         visibilityProcessors.clear();
         preproNodeTree.reset(extractPreproNodeTree(self->sceneRoot()));
+        ++preproNodeTreeRevision;
         *pFlagToUpdatePreprocessedNodeTree = false;
         builtinFlagToUpdatePreprocessedNodeTree = true;
     }
@@ -910,6 +942,21 @@ void SceneRenderer::addExtension(std::function<void(SceneRenderer* renderer)> fu
 
 void SceneRenderer::applyExtensions()
 {
+    /*
+      A deferred group is materialized when it is visited in rendering other than picking.
+      A renderer that can cull the groups should override this function to only materialize
+      the visible ones.
+    */
+    auto functions = renderingFunctions();
+    functions->setFunction<SgDeferredGroup>(
+        [this, functions](SgDeferredGroup* group){
+            if(group->isMaterialized()){
+                functions->dispatchAs<SgGroup>(group);
+            } else if(!isRenderingPickingImage()){
+                requestDeferredGroupMaterialization(group);
+            }
+        });
+    
     std::lock_guard<std::mutex> guard(extensionMutex);
     for(size_t i=0; i < extendFunctions.size(); ++i){
         extendFunctions[i](this);
@@ -95,10 +95,22 @@ public:
        when the tree is not changed.
     */
     void setFlagVariableToUpdatePreprocessedNodeTree(bool& flag);
+
+    /**
+       This number is incremented when the tree of preprocessed nodes is updated.
+       A renderer can use it to detect that the structure of the scene graph may have been changed.
+    */
+    unsigned int preprocessedNodeTreeRevision() const;
     
     void render();
     bool pick(int x, int y);
 
+    /**
+       The group is materialized when the current rendering is finished so that the scene graph
+       is not modified during the traversal. The materialized nodes are rendered in the next frame.
+    */
+    void requestDeferredGroupMaterialization(SgDeferredGroup* group);
+
     virtual bool isRenderingPickingImage() const;
     
     class CNOID_EXPORT PropertyKey {
@@ -45,6 +45,17 @@ public:
         return *this;
     }
 
+    SeqType& operator=(SeqType&& rhs)
+    {
+        if(this != &rhs){
+            AbstractSeq::operator=(rhs);
+            container = std::move(rhs.container);
+            frameRate_ = rhs.frameRate_;
+            offsetTime_ = rhs.offsetTime_;
+        }
+        return *this;
+    }
+
     virtual AbstractSeq& operator=(const AbstractSeq& rhs) override {
         const SeqType* rhsSeq = dynamic_cast<const SeqType*>(&rhs);
         if(rhsSeq){
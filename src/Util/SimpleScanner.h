@@ -8,6 +8,7 @@
 #include <fstream>
 #include <stdexcept>
 #include <cstdlib>
+#include <cstring>
 
 namespace cnoid {
 
@@ -30,6 +31,11 @@ public:
     char buf1[buf1size];
     std::vector<char> buf2;
 
+    // Source memory region used instead of the file stream
+    const char* srcPos;
+    const char* srcEnd;
+    bool isMemorySource;
+
     SimpleScanner()
     {
         clear(false);
@@ -43,6 +49,9 @@ public:
         buf[0] = '\0';
         pos = buf;
         lineNumber = 0;
+        srcPos = nullptr;
+        srcEnd = nullptr;
+        isMemorySource = false;
 
         if(doRelease){
             buf2.clear();
@@ -63,15 +72,69 @@ public:
         return false;
     }
 
+    /**
+       This function makes the scanner read lines from the memory region [begin, end).
+       The region must be kept until the scanning is finished.
+       \param filename The file name used in error messages
+       \param lineNumberOffset The number of lines preceding the region in the file
+    */
+    void open(const char* begin, const char* end, const std::string& filename, size_t lineNumberOffset = 0)
+    {
+        close();
+        clear();
+        srcPos = begin;
+        srcEnd = end;
+        isMemorySource = true;
+        lineNumber = lineNumberOffset;
+        this->filename = filename;
+    }
+
     void close()
     {
         if(ifs.is_open()){
             ifs.close();
         }
+        isMemorySource = false;
+    }
+
+    bool getLineFromMemory()
+    {
+        pos = buf;
+        if(srcPos >= srcEnd){
+            buf[0] = '\0';
+            return false;
+        }
+        const char* lineEnd = static_cast<const char*>(std::memchr(srcPos, '\n', srcEnd - srcPos));
+        const char* nextPos;
+        if(lineEnd){
+            nextPos = lineEnd + 1;
+        } else {
+            lineEnd = srcEnd;
+            nextPos = srcEnd;
+        }
+        size_t length = lineEnd - srcPos;
+        if(length >= bufsize){
+            while(length >= bufsize){
+                bufsize *= 2;
+            }
+            buf2.resize(bufsize);
+            buf = &buf2[0];
+            bufEndPos = buf + bufsize;
+            pos = buf;
+        }
+        std::memcpy(buf, srcPos, length);
+        buf[length] = '\0';
+        srcPos = nextPos;
+        ++lineNumber;
+        return true;
     }
 
     bool getLine()
     {
+        if(isMemorySource){
+            return getLineFromMemory();
+        }
+        
         pos = buf;
         bool result = false;
 
@@ -198,7 +261,7 @@ public:
     bool checkEOF()
     {
         if(checkLF()){
-            return ifs.eof();
+            return isMemorySource ? (srcPos >= srcEnd) : ifs.eof();
         }
         return false;
     }
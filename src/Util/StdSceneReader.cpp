@@ -73,7 +73,21 @@ public:
     };
     typedef ref_ptr<ResourceInfo> ResourceInfoPtr;
 
-    map<string, ResourceInfoPtr> resourceInfoMap;
+    typedef map<string, ResourceInfoPtr> ResourceInfoMap;
+    // This is shared with the reader of the deferred nodes
+    shared_ptr<ResourceInfoMap> resourceInfoMap;
+
+    /*
+      The deferred nodes are read by this reader after the main reader finishes reading the
+      whole file. It is shared by all the deferred nodes and it shares the resource info map
+      with the main reader so that a resource used by multiple nodes is loaded only once.
+    */
+    struct DeferredNodeReader
+    {
+        StdSceneReader reader;
+        std::mutex mutex;
+    };
+    shared_ptr<DeferredNodeReader> deferredNodeReader;
 
     string baseDirectory;
     SceneLoader sceneLoader;
@@ -137,6 +151,7 @@ public:
     SgNode* readText(Mapping* info);
     SgNode* readResourceAsScene(Mapping* info);
     Resource readResourceNode(Mapping* info, bool doSetUri);
+    SgDeferredGroup* readNodeAsDeferred(Mapping* info, const string& type);
     void extractNamedSceneNodes(Mapping* resourceNode, ResourceInfo* info, Resource& resource);
     ResourceInfo* getOrCreateResourceInfo(Mapping* resourceNode, const string& uri, const string& metadata);
     stdx::filesystem::path findFileInPackage(const string& file);
@@ -336,7 +351,9 @@ void StdSceneReader::clear()
     isDegreeMode_ = true;
     impl->sharedObjectMap.clear();
     impl->defaultMaterial.reset();
-    impl->resourceInfoMap.clear();
+    // The map is not cleared but replaced because the deferred nodes may still use it
+    impl->resourceInfoMap = make_shared<Impl::ResourceInfoMap>();
+    impl->deferredNodeReader.reset();
     impl->imagePathToSgImageMap.clear();
     impl->scaling = 1.0;
     impl->isGroupOptimizationEnabled = false;
@@ -1720,6 +1737,83 @@ StdSceneReader::Resource StdSceneReader::Impl::readResourceNode(Mapping* info, b
 }
 
 
+SgDeferredGroup* StdSceneReader::readNodeAsDeferred(Mapping* info, const std::string& type)
+{
+    return impl->readNodeAsDeferred(info, type);
+}
+
+
+SgDeferredGroup* StdSceneReader::Impl::readNodeAsDeferred(Mapping* info, const string& type)
+{
+    Mapping* resourceNode = nullptr;
+    if(type == "Resource"){
+        resourceNode = info;
+    } else if(type == "Shape"){
+        auto geometry = info->findMapping("geometry");
+        if(geometry->isValid() && geometry->get("type", "") == "Resource"){
+            resourceNode = geometry;
+        }
+    }
+    if(!resourceNode){
+        return nullptr;
+    }
+    
+    string uri = resourceNode->get("uri", "");
+    if(uri.empty() || resourceInfoMap->find(uri) != resourceInfoMap->end()){
+        return nullptr;
+    }
+    ensureUriSchemeProcessor();
+    string file = uriSchemeProcessor->getFilePath(uri);
+    if(file.empty()){
+        return nullptr;
+    }
+    filesystem::path filePath(fromUTF8(file));
+    string ext = filePath.extension().string();
+    std::transform(ext.begin(), ext.end(), ext.begin(), ::tolower);
+    if(ext == ".yaml" || ext == ".yml"){
+        return nullptr;
+    }
+    stdx::error_code ec;
+    if(!filesystem::exists(filePath, ec)){
+        return nullptr;
+    }
+
+    if(!deferredNodeReader){
+        deferredNodeReader = make_shared<DeferredNodeReader>();
+        deferredNodeReader->reader.impl->resourceInfoMap = resourceInfoMap;
+    }
+    auto reader = deferredNodeReader;
+    MappingPtr nodeInfo = info->cloneMapping();
+    string directory = getBaseDirectory();
+    int divisionNumber = meshGenerator.divisionNumber();
+    bool isDegreeMode = self->isDegreeMode();
+    double scaling_ = scaling;
+
+    auto deferred = new SgDeferredGroup;
+    deferred->setMaterializationFunction(
+        [reader, nodeInfo, type, directory, divisionNumber, isDegreeMode, scaling_]() -> SgNode* {
+            // The function may be called by the clones of the deferred node in other threads
+            lock_guard<mutex> lock(reader->mutex);
+            auto& r = reader->reader;
+            r.setBaseDirectory(directory);
+            r.setDefaultDivisionNumber(divisionNumber);
+            r.setAngleUnit(isDegreeMode ? DEGREE : RADIAN);
+            r.setScaling(scaling_);
+            // The node info is cloned because the reader may modify it
+            MappingPtr info = nodeInfo->cloneMapping();
+            SgNodePtr scene;
+            try {
+                scene = r.readNode(info, type);
+            } catch(const ValueNode::Exception&){
+                scene.reset();
+            }
+            return scene.retn();
+        });
+
+    return deferred;
+}
+
+
 void StdSceneReader::Impl::extractNamedSceneNodes
 (Mapping* resourceNode, ResourceInfo* info, Resource& resource)
 {
@@ -1746,9 +1840,9 @@ void StdSceneReader::Impl::extractNamedSceneNodes
 StdSceneReader::Impl::ResourceInfo*
 StdSceneReader::Impl::getOrCreateResourceInfo(Mapping* resourceNode, const string& uri, const string& metadata)
 {
-    auto iter = resourceInfoMap.find(uri);
+    auto iter = resourceInfoMap->find(uri);
 
-    if(iter != resourceInfoMap.end()){
+    if(iter != resourceInfoMap->end()){
         return iter->second;
     }
 
@@ -1810,7 +1904,7 @@ StdSceneReader::Impl::getOrCreateResourceInfo(Mapping* resourceNode, const strin
 
     info->directory = toUTF8(filePath.parent_path().string());
     
-    resourceInfoMap[uri] = info;
+    (*resourceInfoMap)[uri] = info;
 
     return info;
 }
@@ -73,6 +73,16 @@ public:
         std::string metadata;
     };
     Resource readResourceNode(Mapping* info);
+
+    /**
+       This function returns a placeholder node that reads the node when the placeholder is
+       materialized instead of reading it immediately. Only a Resource node and a Shape node
+       with a resource geometry can be deferred. Nullptr is returned when the node cannot be
+       deferred, i.e., it is another type of node, the resource is a YAML file, the resource has
+       already been loaded, or the resource file does not exist. In that case the node should
+       be read with the readNode function or the readResourceNode function.
+    */
+    SgDeferredGroup* readNodeAsDeferred(Mapping* info, const std::string& type);
     
     typedef std::function<std::string(const std::string& path, std::ostream& os)> UriSchemeHandler;
     
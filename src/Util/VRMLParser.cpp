@@ -11,8 +11,11 @@
 #include "UTF8.h"
 #include <cnoid/stdx/filesystem>
 #include <boost/algorithm/string/predicate.hpp>
+#include <fast_float/fast_float.h>
 #include <list>
 #include <cmath>
+#include <cstring>
+#include <cstdint>
 #include <vector>
 #include <mutex>
 
@@ -2022,6 +2025,156 @@ VRMLVariantField& VRMLParserImpl::readProtoField(VRMLFieldTypeId fieldTypeId)
 }
 
 
+namespace {
+
+/*
+  The following functions implement the fast path to read a long numeric array such as
+  the coordinates and indices of IndexedFaceSet. The elements are directly parsed from
+  the text buffer of the scanner and the array capacity is reserved in advance.
+  When the array contains something else than numbers and separators, the fast path
+  gives up and the array is read by the ordinary scanner functions.
+*/
+
+struct SeparatorTable
+{
+    bool isSeparator[256];
+    SeparatorTable(){
+        memset(isSeparator, 0, sizeof(isSeparator));
+        isSeparator[(unsigned char)' '] = true;
+        isSeparator[(unsigned char)'\t'] = true;
+        isSeparator[(unsigned char)','] = true;
+        isSeparator[(unsigned char)'\n'] = true;
+        isSeparator[(unsigned char)'\r'] = true;
+    }
+};
+
+const SeparatorTable separatorTable;
+
+inline bool isSeparator(char c)
+{
+    return separatorTable.isSeparator[(unsigned char)c];
+}
+
+inline bool parseNumber(const char*& pos, const char* end, int& out_value)
+{
+    const char* p = pos;
+    bool isNegative = false;
+    if(*p == '-'){
+        isNegative = true;
+        ++p;
+    } else if(*p == '+'){
+        ++p;
+    }
+    if(p == end || *p < '0' || *p > '9'){
+        return false;
+    }
+    // Octal numbers are processed by the scanner
+    if(*p == '0' && (p + 1) != end && p[1] >= '0' && p[1] <= '9'){
+        return false;
+    }
+    int64_t value = 0;
+    do {
+        value = value * 10 + (*p++ - '0');
+    } while(p != end && *p >= '0' && *p <= '9' && value < (int64_t(1) << 40));
+    
+    // Other formats such as hexadecimal numbers are processed by the scanner
+    if(p != end && !isSeparator(*p)){
+        return false;
+    }
+    out_value = static_cast<int>(isNegative ? -value : value);
+    pos = p;
+    return true;
+}
+
+template<class Scalar>
+inline bool parseNumber(const char*& pos, const char* end, Scalar& out_value)
+{
+    const char* p = pos;
+    if(*p == '+'){
+        ++p;
+        if(*p == '-'){
+            return false;
+        }
+    }
+    auto result = fast_float::from_chars(p, end, out_value);
+    if(result.ec != std::errc() || (result.ptr != end && !isSeparator(*result.ptr))){
+        return false;
+    }
+    pos = result.ptr;
+    return true;
+}
+
+template<class Element, class Scalar>
+inline void setComponent(Element& element, int index, Scalar value)
+{
+    element[index] = static_cast<typename Element::Scalar>(value);
+}
+
+inline void setComponent(int& element, int /* index */, int value)
+{
+    element = value;
+}
+
+inline void setComponent(double& element, int /* index */, double value)
+{
+    element = value;
+}
+
+/**
+   This function must be called just after the opening bracket is read.
+   \return true if the whole array including the closing bracket has been read.
+*/
+template<class Scalar, int NumComponents, class MFType>
+bool readNumericMFFast(EasyScanner* scanner, MFType& out_values)
+{
+    const char* begin = scanner->text;
+    const char* end = strchr(begin, ']');
+    if(!end || memchr(begin, '#', end - begin)){
+        return false;
+    }
+
+    // Count the numbers and lines in advance to reserve the array capacity
+    size_t numNumbers = 0;
+    int numLines = 0;
+    bool prevIsSeparator = true;
+    for(const char* p = begin; p != end; ++p){
+        const bool currentIsSeparator = isSeparator(*p);
+        numNumbers += (prevIsSeparator && !currentIsSeparator);
+        numLines += (*p == '\n') | ((*p == '\r') & (p[1] != '\n'));
+        prevIsSeparator = currentIsSeparator;
+    }
+    if(numNumbers % NumComponents != 0){
+        return false;
+    }
+    const size_t numElements = numNumbers / NumComponents;
+    out_values.reserve(out_values.size() + numElements);
+
+    typename MFType::value_type element;
+    const char* pos = begin;
+    for(size_t i=0; i < numElements; ++i){
+        for(int j=0; j < NumComponents; ++j){
+            while(isSeparator(*pos)){
+                ++pos;
+            }
+            Scalar value;
+            if(!parseNumber(pos, end, value)){
+                out_values.clear();
+                return false;
+            }
+            setComponent(element, j, value);
+        }
+        out_values.push_back(element);
+    }
+
+    scanner->text += (end - begin) + 1;
+    scanner->lineNumber += numLines;
+
+    return true;
+}
+
+}
+
+
 void VRMLParserImpl::readSFInt32(SFInt32& out_value)
 {
     if(scanner->readSymbol(F_IS)){
@@ -2040,7 +2193,7 @@ void VRMLParserImpl::readMFInt32(MFInt32& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readIntEx("illegal int value"));
-        } else {
+        } else if(!readNumericMFFast<int, 1>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(scanner->readIntEx("illegal int value"));
             }
@@ -2067,7 +2220,7 @@ void VRMLParserImpl::readMFFloat(MFFloat& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(scanner->readDoubleEx("illegal float value"));
-        } else {
+        } else if(!readNumericMFFast<double, 1>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(scanner->readDoubleEx("illegal float value"));
             }
@@ -2104,7 +2257,7 @@ void VRMLParserImpl::readMFColor(MFColor& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFColor(scanner));
-        } else {
+        } else if(!readNumericMFFast<double, 3>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFColor(scanner));
             }
@@ -2168,7 +2321,7 @@ void VRMLParserImpl::readMFVec2f(MFVec2f& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2f(scanner));
-        } else {
+        } else if(!readNumericMFFast<double, 2>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec2f(scanner));
             }
@@ -2210,7 +2363,7 @@ void VRMLParserImpl::readMFVec2s(MFVec2s& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec2s(scanner));
-        } else {
+        } else if(!readNumericMFFast<float, 2>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec2s(scanner));
             }
@@ -2247,7 +2400,7 @@ void VRMLParserImpl::readMFVec3f(MFVec3f& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3f(scanner));
-        } else {
+        } else if(!readNumericMFFast<double, 3>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec3f(scanner));
             }
@@ -2289,7 +2442,7 @@ void VRMLParserImpl::readMFVec3s(MFVec3s& out_value)
         out_value.clear();
         if(!scanner->readChar('[')){
             out_value.push_back(::readSFVec3s(scanner));
-        } else {
+        } else if(!readNumericMFFast<float, 3>(scanner, out_value)){
             while(!scanner->readChar(']')){
                 out_value.push_back(::readSFVec3s(scanner));
             }